@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+TINY_MODEL = os.path.join(ROOT, "examples", "tiny_model.bwpp")
+LAYER_PARAMS = [
+    ("wq", "D,D"), ("wk", "D,D"), ("wv", "D,D"), ("wo", "D,D"),
+    ("w1", "D,H"), ("w2", "H,D"), ("g1", "D"), ("g2", "D"),
+]
+
+
+def stress_source(layers):
+    """examples/tiny_model.bwpp with its entry replaced by `layers` calls of `block`."""
+    with open(TINY_MODEL, "r", encoding="utf-8") as f:
+        text = f.read()
+    head = text[:text.index("fn tiny_model(")]
+    params = ["x: tensor<f16,[T,D],row_major>"]
+    for i in range(layers):
+        params += [f"{name}_{i}: tensor<f16,[{dims}],row_major>" for name, dims in LAYER_PARAMS]
+    params.append("wcls: tensor<f16,[D,V],row_major>")
+    lines = [f"// {layers}-layer stress model generated by bench/bench_compile.py", head.rstrip(), ""]
+    lines.append("fn stress_model(" + ",\n                 ".join(params) + ")")
+    lines.append("  -> tensor<f16,[T,V],row_major> {")
+    prev = "x"
+    for i in range(layers):
+        args = ", ".join([prev] + [f"{name}_{i}" for name, _ in LAYER_PARAMS])
+        lines.append(f"  let h{i} = block({args})")
+        prev = f"h{i}"
+    lines.append(f"  let logits = {prev} @ wcls")
+    lines.append("  return softmax(logits)")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def time_passes(bwppc, layers, extra):
+    with tempfile.TemporaryDirectory(prefix="bwpp_compile_") as tmp:
+        src = os.path.join(tmp, f"stress_{layers}.bwpp")
+        with open(src, "w", encoding="utf-8") as f:
+            f.write(stress_source(layers))
+        cmd = [bwppc, src, os.path.join(tmp, "out.metal"), "--entry", "stress_model", "--time-passes=json"] + extra
+        proc = subprocess.run(cmd, check=False, capture_output=True, text=True)
+    for line in reversed(proc.stderr.splitlines()):
+        if line.startswith('{"passes":'):
+            return json.loads(line)
+    print(f"bwppc failed for {layers} layers (rc={proc.returncode}):\n{proc.stderr}")
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="BW++ compile-time benchmark over N-layer stress models")
+    parser.add_argument("--layers", default="1,8,32", help="comma-separated layer counts")
+    parser.add_argument("--bwppc", default=os.path.join(ROOT, "compiler", "bwppc"))
+    parser.add_argument("--extra", default="", help="more bwppc flags, e.g. '--run --fusion-plan /dev/null'")
+    parser.add_argument("--emit", default=None, help="write the stress source for the first layer count and exit")
+    parser.add_argument("--json", default=None, help="write every pass table to this file")
+    parser.add_argument("--baseline", default=None, help="json from an earlier --json run to compare total_ms")
+    parser.add_argument("--tol", type=float, default=0.20, help="max slowdown ratio (e.g. 0.2 = 20%%)")
+    args = parser.parse_args()
+
+    layer_counts = [int(x) for x in args.layers.split(",") if x]
+    if args.emit:
+        with open(args.emit, "w", encoding="utf-8") as f:
+            f.write(stress_source(layer_counts[0]))
+        print(f"wrote {args.emit} ({layer_counts[0]} layers)")
+        return 0
+    if not os.path.exists(args.bwppc):
+        print("bwppc not found. Build it with: make -C compiler")
+        return 1
+
+    results = {}
+    for layers in layer_counts:
+        data = time_passes(args.bwppc, layers, args.extra.split())
+        if data is None:
+            return 1
+        results[str(layers)] = data
+        slowest = sorted(data["passes"], key=lambda p: p["ms"], reverse=True)[:3]
+        rss = max((p["peak_rss_kb"] for p in data["passes"]), default=0)
+        counted = [p["allocs"] for p in data["passes"] if p["allocs"] is not None]
+        allocs = sum(counted) if counted else "-"
+        top = " ".join(f"{p['name']}={p['ms']:.2f}ms" for p in slowest)
+        print(f"layers={layers}: total={data['total_ms']:.2f}ms peak_rss_kb={rss} allocs={allocs} [{top}]")
+
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as f:
+            json.dump(results, f, indent=2)
+
+    if args.baseline:
+        with open(args.baseline, "r", encoding="utf-8") as f:
+            base = json.load(f)
+        failed = 0
+        for layers, data in results.items():
+            if layers not in base:
+                continue
+            b = float(base[layers]["total_ms"])
+            c = float(data["total_ms"])
+            ok = b <= 0.0 or c / b <= 1.0 + args.tol
+            print(f"layers={layers}: base={b:.2f}ms cur={c:.2f}ms [{'OK' if ok else 'SLOW'}]")
+            failed += 0 if ok else 1
+        if failed:
+            print(f"regression detected: {failed} layer count(s) exceeded tolerance")
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,3 +1,8 @@
+#define _POSIX_C_SOURCE 199309L
+#include "bwpp_cpu_attention.h"
+#include "bwpp_cpu_context.h"
+#include "bwpp_cpu_gemm.h"
+#include "bwpp_cpu_kernels.h"
 #include "bwpp_cpu_ref.h"
 #include <math.h>
 #include <stdio.h>
@@ -41,6 +46,19 @@ int main(int argc, char **argv) {
   uint32_t cols = 256;
   const char *metal_path = NULL;
   const char *json_path = NULL;
+  const char *matmul_impl = "ref";
+  const char *norm_impl = "ref";
+  const char *attn_impl = "ref";
+  uint32_t seq = 256;
+  uint32_t head_dim = 64;
+  uint32_t heads = 1;
+  uint32_t kv_heads = 0;
+  uint32_t causal = 0;
+  uint32_t decode = 0;
+  const char *isa_name = NULL;
+  int threaded = 0;
+  uint32_t threads_req = 0;
+  BwppCpuMatmulFn matmul = bwpp_cpu_matmul_f32;
 
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
@@ -59,9 +77,74 @@ int main(int argc, char **argv) {
       metal_path = argv[++i];
     } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
       json_path = argv[++i];
+    } else if (strcmp(argv[i], "--matmul") == 0 && i + 1 < argc) {
+      matmul_impl = argv[++i];
+    } else if (strcmp(argv[i], "--norm") == 0 && i + 1 < argc) {
+      norm_impl = argv[++i];
+    } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+      isa_name = argv[++i];
+    } else if (strcmp(argv[i], "--attention") == 0 && i + 1 < argc) {
+      attn_impl = argv[++i];
+    } else if (strcmp(argv[i], "--seq") == 0 && i + 1 < argc) {
+      seq = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--head-dim") == 0 && i + 1 < argc) {
+      head_dim = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--heads") == 0 && i + 1 < argc) {
+      heads = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--kv-heads") == 0 && i + 1 < argc) {
+      kv_heads = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--causal") == 0) {
+      causal = 1;
+    } else if (strcmp(argv[i], "--decode") == 0 && i + 1 < argc) {
+      decode = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads_req = (uint32_t)strtoul(argv[++i], NULL, 10);
+      threaded = 1;
     }
   }
 
+  if (strcmp(matmul_impl, "gemm") == 0) {
+    matmul = bwpp_cpu_gemm_f32;
+  } else if (strcmp(matmul_impl, "ref") != 0) {
+    fprintf(stderr, "bench: unknown --matmul %s (expected ref|gemm)\n", matmul_impl);
+    return 1;
+  }
+  int norm_simd = strcmp(norm_impl, "simd") == 0;
+  if (!norm_simd && strcmp(norm_impl, "ref") != 0) {
+    fprintf(stderr, "bench: unknown --norm %s (expected ref|simd)\n", norm_impl);
+    return 1;
+  }
+  int attn_tiled = strcmp(attn_impl, "tiled") == 0;
+  if (!attn_tiled && strcmp(attn_impl, "ref") != 0) {
+    fprintf(stderr, "bench: unknown --attention %s (expected ref|tiled)\n", attn_impl);
+    return 1;
+  }
+  if (isa_name) {
+    BwppCpuIsa isa;
+    if (!bwpp_cpu_isa_parse(isa_name, &isa)) {
+      fprintf(stderr, "bench: unknown --isa %s (expected scalar|sse4|avx2|avx512|neon)\n", isa_name);
+      return 1;
+    }
+    if (!bwpp_cpu_kernels_select(isa)) {
+      fprintf(stderr, "bench: isa %s not supported on this host\n", isa_name);
+      return 1;
+    }
+  }
+  const char *isa_active = bwpp_cpu_kernels()->name;
+  /* --threads runs the pooled kernels (packed GEMM, SIMD rows); 0 = all cores */
+  BwppCpuContext *ctx = NULL;
+  if (threaded) {
+    ctx = bwpp_cpu_context_create(threads_req);
+    if (!ctx) {
+      fprintf(stderr, "bench: failed to create cpu context\n");
+      return 1;
+    }
+    matmul_impl = "gemm";
+    norm_impl = "simd";
+    attn_impl = "tiled";
+  }
+  uint32_t threads = ctx ? ctx->threads : 1;
+
   if (metal_path) {
     printf("== MSL metadata ==\n");
     parse_meta(metal_path);
@@ -73,6 +156,7 @@ int main(int argc, char **argv) {
   float *bias = (float *)malloc(sizeof(float) * N);
   if (!a || !b || !c || !bias) {
     fprintf(stderr, "bench: alloc failed\n");
+    bwpp_cpu_context_destroy(ctx);
     free(a);
     free(b);
     free(c);
@@ -90,20 +174,25 @@ int main(int argc, char **argv) {
 
   double t0 = now_sec();
   for (uint32_t i = 0; i < iters; ++i) {
-    bwpp_cpu_matmul_f32(a, b, c, M, N, K, K, N, N, bias, 0, 0);
+    if (ctx) {
+      bwpp_cpu_matmul_ctx_f32(ctx, a, b, c, M, N, K, K, N, N, bias, 0, 0);
+    } else {
+      matmul(a, b, c, M, N, K, K, N, N, bias, 0, 0);
+    }
   }
   double t1 = now_sec();
   double matmul_secs = t1 - t0;
   double flops = 2.0 * (double)M * (double)N * (double)K * (double)iters;
   double matmul_gflops = (flops / 1e9) / (matmul_secs > 0.0 ? matmul_secs : 1.0);
-  printf("matmul: M=%u N=%u K=%u iters=%u time=%.6fs gflops=%.2f\n",
-         M, N, K, iters, matmul_secs, matmul_gflops);
+  printf("matmul: impl=%s isa=%s threads=%u M=%u N=%u K=%u iters=%u time=%.6fs gflops=%.2f\n",
+         matmul_impl, isa_active, threads, M, N, K, iters, matmul_secs, matmul_gflops);
   float *x = (float *)malloc(sizeof(float) * rows * cols);
   float *y = (float *)malloc(sizeof(float) * rows * cols);
   float *z = (float *)malloc(sizeof(float) * rows * cols);
   float *gamma = (float *)malloc(sizeof(float) * cols);
   if (!x || !y || !z || !gamma) {
     fprintf(stderr, "bench: alloc failed for norm buffers\n");
+    bwpp_cpu_context_destroy(ctx);
     free(a);
     free(b);
     free(c);
@@ -125,19 +214,80 @@ int main(int argc, char **argv) {
 
   t0 = now_sec();
   for (uint32_t i = 0; i < iters; ++i) {
-    bwpp_cpu_softmax_f32(x, y, rows, cols, cols);
+    if (ctx) {
+      bwpp_cpu_softmax_ctx_f32(ctx, x, y, rows, cols, cols);
+    } else if (norm_simd) {
+      bwpp_cpu_softmax_simd_f32(x, y, rows, cols, cols);
+    } else {
+      bwpp_cpu_softmax_f32(x, y, rows, cols, cols);
+    }
   }
   t1 = now_sec();
   double softmax_secs = t1 - t0;
-  printf("softmax: rows=%u cols=%u iters=%u time=%.6fs\n", rows, cols, iters, softmax_secs);
+  printf("softmax: impl=%s threads=%u rows=%u cols=%u iters=%u time=%.6fs\n",
+         norm_impl, threads, rows, cols, iters, softmax_secs);
 
   t0 = now_sec();
   for (uint32_t i = 0; i < iters; ++i) {
-    bwpp_cpu_rmsnorm_f32(x, z, gamma, NULL, rows, cols, cols, 1e-5f);
+    if (ctx) {
+      bwpp_cpu_rmsnorm_ctx_f32(ctx, x, z, gamma, NULL, rows, cols, cols, 1e-5f);
+    } else if (norm_simd) {
+      bwpp_cpu_rmsnorm_simd_f32(x, z, gamma, NULL, rows, cols, cols, 1e-5f);
+    } else {
+      bwpp_cpu_rmsnorm_f32(x, z, gamma, NULL, rows, cols, cols, 1e-5f);
+    }
   }
   t1 = now_sec();
   double rmsnorm_secs = t1 - t0;
-  printf("rmsnorm: rows=%u cols=%u iters=%u time=%.6fs\n", rows, cols, iters, rmsnorm_secs);
+  printf("rmsnorm: impl=%s threads=%u rows=%u cols=%u iters=%u time=%.6fs\n",
+         norm_impl, threads, rows, cols, iters, rmsnorm_secs);
+
+  /* self-attention: Q/O are heads x queries x head_dim, K/V kv_heads x seq x head_dim;
+     --decode runs that many query rows against the seq-long cache */
+  if (heads == 0) {
+    heads = 1;
+  }
+  if (kv_heads == 0 || kv_heads > heads) {
+    kv_heads = heads;
+  }
+  uint32_t queries = decode && decode < seq ? decode : seq;
+  BwppCpuAttentionParams att = { queries, seq, head_dim, head_dim, head_dim, head_dim, head_dim, head_dim,
+                                 1, heads, kv_heads, causal, 0 };
+  size_t q_count = (size_t)heads * queries * head_dim;
+  size_t kv_count = (size_t)kv_heads * seq * head_dim;
+  float *att_q = (float *)malloc(sizeof(float) * (q_count ? q_count : 1));
+  float *att_kv = (float *)malloc(sizeof(float) * (kv_count ? kv_count : 1));
+  float *att_out = (float *)malloc(sizeof(float) * (q_count ? q_count : 1));
+  double attention_secs = 0.0;
+  if (!att_q || !att_kv || !att_out) {
+    fprintf(stderr, "bench: alloc failed for attention buffers\n");
+  } else {
+    for (size_t i = 0; i < q_count; ++i) {
+      att_q[i] = (float)(i % 97) * 0.001f;
+    }
+    for (size_t i = 0; i < kv_count; ++i) {
+      att_kv[i] = (float)(i % 89) * 0.001f;
+    }
+    t0 = now_sec();
+    for (uint32_t i = 0; i < iters; ++i) {
+      if (ctx && decode) {
+        bwpp_cpu_attention_decode_ctx_f32(ctx, att_q, att_kv, att_kv, att_out, NULL, &att);
+      } else if (ctx) {
+        bwpp_cpu_attention_masked_ctx_f32(ctx, att_q, att_kv, att_kv, att_out, NULL, &att);
+      } else if (attn_tiled) {
+        bwpp_cpu_attention_masked_f32(att_q, att_kv, att_kv, att_out, NULL, &att);
+      } else {
+        bwpp_cpu_attention_masked_ref_f32(att_q, att_kv, att_kv, att_out, NULL, &att);
+      }
+    }
+    t1 = now_sec();
+    attention_secs = t1 - t0;
+    printf("attention: impl=%s threads=%u queries=%u seq=%u head_dim=%u heads=%u kv_heads=%u causal=%u iters=%u time=%.6fs\n",
+           attn_impl, threads, queries, seq, head_dim, heads, kv_heads, causal, iters, attention_secs);
+  }
+  free(att_q);
+  free(att_kv);
+  free(att_out);
 
   if (json_path) {
     FILE *jf = fopen(json_path, "w");
@@ -146,17 +296,20 @@ int main(int argc, char **argv) {
     } else {
       fprintf(jf,
               "{\n"
-              "  \"matmul\": {\"M\": %u, \"N\": %u, \"K\": %u, \"iters\": %u, \"time_s\": %.9f, \"gflops\": %.3f},\n"
-              "  \"softmax\": {\"rows\": %u, \"cols\": %u, \"iters\": %u, \"time_s\": %.9f},\n"
-              "  \"rmsnorm\": {\"rows\": %u, \"cols\": %u, \"iters\": %u, \"time_s\": %.9f}\n"
+              "  \"matmul\": {\"impl\": \"%s\", \"isa\": \"%s\", \"threads\": %u, \"M\": %u, \"N\": %u, \"K\": %u, \"iters\": %u, \"time_s\": %.9f, \"gflops\": %.3f},\n"
+              "  \"softmax\": {\"impl\": \"%s\", \"threads\": %u, \"rows\": %u, \"cols\": %u, \"iters\": %u, \"time_s\": %.9f},\n"
+              "  \"rmsnorm\": {\"impl\": \"%s\", \"threads\": %u, \"rows\": %u, \"cols\": %u, \"iters\": %u, \"time_s\": %.9f},\n"
+              "  \"attention\": {\"impl\": \"%s\", \"threads\": %u, \"queries\": %u, \"seq\": %u, \"head_dim\": %u, \"heads\": %u, \"kv_heads\": %u, \"causal\": %u, \"iters\": %u, \"time_s\": %.9f}\n"
               "}\n",
-              M, N, K, iters, matmul_secs, matmul_gflops,
-              rows, cols, iters, softmax_secs,
-              rows, cols, iters, rmsnorm_secs);
+              matmul_impl, isa_active, threads, M, N, K, iters, matmul_secs, matmul_gflops,
+              norm_impl, threads, rows, cols, iters, softmax_secs,
+              norm_impl, threads, rows, cols, iters, rmsnorm_secs,
+              attn_impl, threads, queries, seq, head_dim, heads, kv_heads, causal, iters, attention_secs);
       fclose(jf);
     }
   }
 
+  bwpp_cpu_context_destroy(ctx);
   free(a);
   free(b);
   free(c);
@@ -23,6 +23,13 @@ def run_bench(bench_path, args):
     cmd += ["--iters", str(args.iters)]
     cmd += ["--m", str(args.m), "--n", str(args.n), "--k", str(args.k)]
     cmd += ["--rows", str(args.rows), "--cols", str(args.cols)]
+    cmd += ["--matmul", args.matmul]
+    cmd += ["--norm", args.norm]
+    cmd += ["--attention", args.attention]
+    if args.isa:
+        cmd += ["--isa", args.isa]
+    if args.threads is not None:
+        cmd += ["--threads", str(args.threads)]
     if args.metal:
         cmd += ["--metal", args.metal]
 
@@ -63,6 +70,11 @@ def main():
     parser.add_argument("--rows", type=int, default=256)
     parser.add_argument("--cols", type=int, default=256)
     parser.add_argument("--metal", type=str, default=None)
+    parser.add_argument("--matmul", choices=["ref", "gemm"], default="ref")
+    parser.add_argument("--norm", choices=["ref", "simd"], default="ref")
+    parser.add_argument("--attention", choices=["ref", "tiled"], default="ref")
+    parser.add_argument("--threads", type=int, default=None)
+    parser.add_argument("--isa", choices=["scalar", "sse4", "avx2", "avx512", "neon"], default=None)
     parser.add_argument("--no-build", action="store_true")
     args = parser.parse_args()
 
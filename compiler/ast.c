@@ -1,11 +1,14 @@
 #include "ast.h"
 #include <stdlib.h>
+#include <string.h>
 
 BwppAstModule *bwpp_ast_module_create(const char *source, size_t length) {
-  BwppAstModule *module = (BwppAstModule *)calloc(1, sizeof(BwppAstModule));
+  BwppAstModule *module = (BwppAstModule *)bwpp_xcalloc(1, sizeof(BwppAstModule));
   if (!module) {
     return NULL;
   }
+  bwpp_chunk_arena_init(&module->arena, 64 * 1024);
+  bwpp_interner_init(&module->symbols, &module->arena);
   module->source = source;
   module->length = length;
   return module;
@@ -15,30 +18,24 @@ void bwpp_ast_module_destroy(BwppAstModule *module) {
   if (!module) {
     return;
   }
-  free(module->ops);
-  free(module->regions);
+  bwpp_chunk_arena_destroy(&module->arena);
   free(module);
 }
 
-static int bwpp_ast_grow_ops(BwppAstModule *module) {
-  uint32_t next = module->op_capacity ? module->op_capacity * 2u : 8u;
-  BwppAstOp *ops = (BwppAstOp *)realloc(module->ops, next * sizeof(BwppAstOp));
-  if (!ops) {
-    return 0;
+/* Doubles `*items` (of `size`-byte entries) in the module arena when
+   `count` has reached `*capacity`. */
+static int bwpp_ast_reserve(BwppAstModule *module, void **items, uint32_t count, uint32_t *capacity,
+                            size_t size, size_t align) {
+  if (count < *capacity) {
+    return 1;
   }
-  module->ops = ops;
-  module->op_capacity = next;
-  return 1;
-}
-
-static int bwpp_ast_grow_regions(BwppAstModule *module) {
-  uint32_t next = module->region_capacity ? module->region_capacity * 2u : 4u;
-  BwppAstRegion *regions = (BwppAstRegion *)realloc(module->regions, next * sizeof(BwppAstRegion));
-  if (!regions) {
+  uint32_t next = *capacity ? *capacity * 2u : 16u;
+  void *grown = bwpp_chunk_arena_grow(&module->arena, *items, *capacity * size, next * size, align);
+  if (!grown) {
     return 0;
   }
-  module->regions = regions;
-  module->region_capacity = next;
+  *items = grown;
+  *capacity = next;
   return 1;
 }
 
@@ -46,7 +43,8 @@ uint32_t bwpp_ast_add_region(BwppAstModule *module, BwppAstRegionKind kind, Bwpp
   if (!module) {
     return BWPP_AST_NO_REGION;
   }
-  if (module->region_count >= module->region_capacity && !bwpp_ast_grow_regions(module)) {
+  if (!bwpp_ast_reserve(module, (void **)&module->regions, module->region_count, &module->region_capacity,
+                        sizeof(BwppAstRegion), _Alignof(BwppAstRegion))) {
     return BWPP_AST_NO_REGION;
   }
   uint32_t id = module->region_count;
@@ -62,7 +60,8 @@ BwppStatus bwpp_ast_add_op(BwppAstModule *module, BwppAstOpKind op, uint32_t reg
   if (!module) {
     return BWPP_ERR;
   }
-  if (module->op_count >= module->op_capacity && !bwpp_ast_grow_ops(module)) {
+  if (!bwpp_ast_reserve(module, (void **)&module->ops, module->op_count, &module->op_capacity,
+                        sizeof(BwppAstOp), _Alignof(BwppAstOp))) {
     return BWPP_ERR;
   }
   BwppAstOp entry;
@@ -72,3 +71,135 @@ BwppStatus bwpp_ast_add_op(BwppAstModule *module, BwppAstOpKind op, uint32_t reg
   module->ops[module->op_count++] = entry;
   return BWPP_OK;
 }
+
+uint32_t bwpp_ast_add_fn(BwppAstModule *module, const BwppAstFn *fn) {
+  if (!module || !bwpp_ast_reserve(module, (void **)&module->fns, module->fn_count, &module->fn_capacity,
+                                   sizeof(BwppAstFn), _Alignof(BwppAstFn))) {
+    return BWPP_AST_NONE;
+  }
+  uint32_t sym = bwpp_intern(&module->symbols, fn->name);
+  if (sym == BWPP_SYM_NONE) {
+    return BWPP_AST_NONE;
+  }
+  if (sym >= module->fn_of_sym_count) {
+    uint32_t next = module->symbols.capacity;
+    uint32_t *map = (uint32_t *)bwpp_chunk_arena_grow(&module->arena, module->fn_of_sym,
+                                                      module->fn_of_sym_count * sizeof(uint32_t),
+                                                      next * sizeof(uint32_t), sizeof(uint32_t));
+    if (!map) {
+      return BWPP_AST_NONE;
+    }
+    for (uint32_t i = module->fn_of_sym_count; i < next; ++i) {
+      map[i] = BWPP_AST_NONE;
+    }
+    module->fn_of_sym = map;
+    module->fn_of_sym_count = next;
+  }
+  if (module->fn_of_sym[sym] == BWPP_AST_NONE) {
+    module->fn_of_sym[sym] = module->fn_count;
+  }
+  module->fns[module->fn_count] = *fn;
+  module->fns[module->fn_count].sym = sym;
+  return module->fn_count++;
+}
+
+uint32_t bwpp_ast_add_param(BwppAstModule *module, const BwppAstParam *param) {
+  if (!module || !bwpp_ast_reserve(module, (void **)&module->params, module->param_count,
+                                   &module->param_capacity, sizeof(BwppAstParam), _Alignof(BwppAstParam))) {
+    return BWPP_AST_NONE;
+  }
+  uint32_t sym = bwpp_intern(&module->symbols, param->name);
+  if (sym == BWPP_SYM_NONE) {
+    return BWPP_AST_NONE;
+  }
+  module->params[module->param_count] = *param;
+  module->params[module->param_count].sym = sym;
+  return module->param_count++;
+}
+
+uint32_t bwpp_ast_add_stmt(BwppAstModule *module, const BwppAstStmt *stmt) {
+  if (!module || !bwpp_ast_reserve(module, (void **)&module->stmts, module->stmt_count,
+                                   &module->stmt_capacity, sizeof(BwppAstStmt), _Alignof(BwppAstStmt))) {
+    return BWPP_AST_NONE;
+  }
+  uint32_t sym = BWPP_SYM_NONE;
+  if (stmt->kind == BWPP_AST_STMT_LET) {
+    sym = bwpp_intern(&module->symbols, stmt->name);
+    if (sym == BWPP_SYM_NONE) {
+      return BWPP_AST_NONE;
+    }
+  }
+  module->stmts[module->stmt_count] = *stmt;
+  module->stmts[module->stmt_count].sym = sym;
+  return module->stmt_count++;
+}
+
+uint32_t bwpp_ast_add_expr(BwppAstModule *module, BwppAstExprKind kind, BwppStr text) {
+  if (!module || !bwpp_ast_reserve(module, (void **)&module->exprs, module->expr_count,
+                                   &module->expr_capacity, sizeof(BwppAstExpr), _Alignof(BwppAstExpr))) {
+    return BWPP_AST_NONE;
+  }
+  BwppAstExpr e;
+  e.kind = kind;
+  e.text = text;
+  e.sym = BWPP_SYM_NONE;
+  if (kind == BWPP_AST_EXPR_NAME || kind == BWPP_AST_EXPR_CALL) {
+    e.sym = bwpp_intern(&module->symbols, text);
+    if (e.sym == BWPP_SYM_NONE) {
+      return BWPP_AST_NONE;
+    }
+  }
+  e.first = BWPP_AST_NO_EXPR;
+  e.last = BWPP_AST_NO_EXPR;
+  e.next = BWPP_AST_NO_EXPR;
+  e.arg_count = 0;
+  module->exprs[module->expr_count] = e;
+  return module->expr_count++;
+}
+
+uint32_t bwpp_ast_add_dim(BwppAstModule *module, BwppStr name, uint32_t value) {
+  if (!module || !bwpp_ast_reserve(module, (void **)&module->dims, module->dim_count,
+                                   &module->dim_capacity, sizeof(BwppAstDim), _Alignof(BwppAstDim))) {
+    return BWPP_AST_NONE;
+  }
+  module->dims[module->dim_count].name = name;
+  module->dims[module->dim_count].value = value;
+  return module->dim_count++;
+}
+
+void bwpp_ast_append_arg(BwppAstModule *module, uint32_t parent, uint32_t child) {
+  if (!module || parent >= module->expr_count || child >= module->expr_count) {
+    return;
+  }
+  BwppAstExpr *p = &module->exprs[parent];
+  if (p->first == BWPP_AST_NO_EXPR) {
+    p->first = child;
+  } else {
+    module->exprs[p->last].next = child;
+  }
+  p->last = child;
+  p->arg_count++;
+}
+
+uint32_t bwpp_ast_arg(const BwppAstModule *module, uint32_t expr, uint32_t i) {
+  if (!module || expr >= module->expr_count) {
+    return BWPP_AST_NO_EXPR;
+  }
+  uint32_t a = module->exprs[expr].first;
+  while (a != BWPP_AST_NO_EXPR && i > 0) {
+    a = module->exprs[a].next;
+    i--;
+  }
+  return a;
+}
+
+const BwppAstFn *bwpp_ast_fn_of(const BwppAstModule *module, uint32_t sym) {
+  if (!module || sym >= module->fn_of_sym_count || module->fn_of_sym[sym] == BWPP_AST_NONE) {
+    return NULL;
+  }
+  return &module->fns[module->fn_of_sym[sym]];
+}
+
+const BwppAstFn *bwpp_ast_find_fn(const BwppAstModule *module, BwppStr name) {
+  return module ? bwpp_ast_fn_of(module, bwpp_intern_find(&module->symbols, name)) : NULL;
+}
@@ -0,0 +1,509 @@
+#include "codegen_c.h"
+#include "tile_ir.h"
+#include <stdio.h>
+
+typedef struct {
+  uint32_t rank;
+  uint32_t dims[BWPP_GRAPH_MAX_DIMS];
+} BwppCShape;
+
+static int bwpp_c_shape(const BwppGraph *graph, uint32_t value, BwppCShape *out) {
+  if (value >= graph->value_count) {
+    return 0;
+  }
+  const BwppShape *s = &graph->values[value].shape;
+  if (s->rank == 0) {
+    fprintf(stderr, "codegen_c: v%u has no static shape\n", value);
+    return 0;
+  }
+  if (!bwpp_shape_bound(s)) {
+    BwppStr dim = bwpp_shape_unbound_dim(s);
+    fprintf(stderr, "dim %.*s is not bound (use --dim %.*s=N or @dims)\n",
+            (int)dim.len, dim.ptr, (int)dim.len, dim.ptr);
+    return 0;
+  }
+  out->rank = s->rank;
+  for (uint32_t i = 0; i < s->rank; ++i) {
+    out->dims[i] = s->sizes[i];
+  }
+  return 1;
+}
+
+/* product of all but the innermost `keep` dims */
+static uint32_t bwpp_c_outer(const BwppCShape *s, uint32_t keep) {
+  uint32_t n = 1;
+  for (uint32_t i = 0; i + keep < s->rank; ++i) {
+    n *= s->dims[i];
+  }
+  return n;
+}
+
+static const BwppGraphNode *bwpp_c_find(const BwppGraph *graph, BwppGraphOpKind op) {
+  for (uint32_t i = 0; graph && i < graph->node_count; ++i) {
+    if (graph->nodes[i].op == op) {
+      return &graph->nodes[i];
+    }
+  }
+  return NULL;
+}
+
+static void bwpp_c_emit_prelude(FILE *f) {
+  fputs("#include <math.h>\n", f);
+  fputs("#include <stddef.h>\n", f);
+  fputs("#include <stdint.h>\n", f);
+  fputs("#include <string.h>\n\n", f);
+  fputs("#if defined(__AVX512F__)\n", f);
+  fputs("#include <immintrin.h>\n", f);
+  fputs("#define BWPP_SIMD \"avx512\"\n", f);
+  fputs("#elif defined(__AVX2__) && defined(__FMA__)\n", f);
+  fputs("#include <immintrin.h>\n", f);
+  fputs("#define BWPP_SIMD \"avx2\"\n", f);
+  fputs("#elif defined(__ARM_NEON)\n", f);
+  fputs("#include <arm_neon.h>\n", f);
+  fputs("#define BWPP_SIMD \"neon\"\n", f);
+  fputs("#elif defined(__SSE2__)\n", f);
+  fputs("#include <emmintrin.h>\n", f);
+  fputs("#define BWPP_SIMD \"sse2\"\n", f);
+  fputs("#else\n", f);
+  fputs("#define BWPP_SIMD \"scalar\"\n", f);
+  fputs("#endif\n\n", f);
+  fputs("#if defined(__GNUC__)\n", f);
+  fputs("#define BWPP_EXPORT __attribute__((visibility(\"default\")))\n", f);
+  fputs("#else\n", f);
+  fputs("#define BWPP_EXPORT\n", f);
+  fputs("#endif\n\n", f);
+  fputs("BWPP_EXPORT const char bwpp_simd[] = BWPP_SIMD;\n\n", f);
+
+  fputs("/* y += a * x */\n", f);
+  fputs("static inline void bwpp_axpy(float *y, const float *x, float a, uint32_t n) {\n", f);
+  fputs("  uint32_t i = 0;\n", f);
+  fputs("#if defined(__AVX512F__)\n", f);
+  fputs("  __m512 va = _mm512_set1_ps(a);\n", f);
+  fputs("  for (; i + 16 <= n; i += 16) {\n", f);
+  fputs("    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));\n", f);
+  fputs("  }\n", f);
+  fputs("#elif defined(__AVX2__) && defined(__FMA__)\n", f);
+  fputs("  __m256 va = _mm256_set1_ps(a);\n", f);
+  fputs("  for (; i + 8 <= n; i += 8) {\n", f);
+  fputs("    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));\n", f);
+  fputs("  }\n", f);
+  fputs("#elif defined(__ARM_NEON)\n", f);
+  fputs("  float32x4_t va = vdupq_n_f32(a);\n", f);
+  fputs("  for (; i + 4 <= n; i += 4) {\n", f);
+  fputs("    vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), va, vld1q_f32(x + i)));\n", f);
+  fputs("  }\n", f);
+  fputs("#elif defined(__SSE2__)\n", f);
+  fputs("  __m128 va = _mm_set1_ps(a);\n", f);
+  fputs("  for (; i + 4 <= n; i += 4) {\n", f);
+  fputs("    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));\n", f);
+  fputs("  }\n", f);
+  fputs("#endif\n", f);
+  fputs("  for (; i < n; ++i) {\n", f);
+  fputs("    y[i] += a * x[i];\n", f);
+  fputs("  }\n", f);
+  fputs("}\n\n", f);
+
+  fputs("static inline float bwpp_dot(const float *a, const float *b, uint32_t n) {\n", f);
+  fputs("  uint32_t i = 0;\n", f);
+  fputs("  float sum = 0.0f;\n", f);
+  fputs("#if defined(__AVX512F__)\n", f);
+  fputs("  __m512 acc = _mm512_setzero_ps();\n", f);
+  fputs("  for (; i + 16 <= n; i += 16) {\n", f);
+  fputs("    acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);\n", f);
+  fputs("  }\n", f);
+  fputs("  sum = _mm512_reduce_add_ps(acc);\n", f);
+  fputs("#elif defined(__AVX2__) && defined(__FMA__)\n", f);
+  fputs("  __m256 acc = _mm256_setzero_ps();\n", f);
+  fputs("  for (; i + 8 <= n; i += 8) {\n", f);
+  fputs("    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);\n", f);
+  fputs("  }\n", f);
+  fputs("  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));\n", f);
+  fputs("  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));\n", f);
+  fputs("  lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));\n", f);
+  fputs("  sum = _mm_cvtss_f32(lo);\n", f);
+  fputs("#elif defined(__ARM_NEON)\n", f);
+  fputs("  float32x4_t acc = vdupq_n_f32(0.0f);\n", f);
+  fputs("  for (; i + 4 <= n; i += 4) {\n", f);
+  fputs("    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));\n", f);
+  fputs("  }\n", f);
+  fputs("  sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) +\n", f);
+  fputs("        vgetq_lane_f32(acc, 3);\n", f);
+  fputs("#elif defined(__SSE2__)\n", f);
+  fputs("  __m128 acc = _mm_setzero_ps();\n", f);
+  fputs("  for (; i + 4 <= n; i += 4) {\n", f);
+  fputs("    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));\n", f);
+  fputs("  }\n", f);
+  fputs("  float lanes[4];\n", f);
+  fputs("  _mm_storeu_ps(lanes, acc);\n", f);
+  fputs("  sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];\n", f);
+  fputs("#endif\n", f);
+  fputs("  for (; i < n; ++i) {\n", f);
+  fputs("    sum += a[i] * b[i];\n", f);
+  fputs("  }\n", f);
+  fputs("  return sum;\n", f);
+  fputs("}\n\n", f);
+
+  fputs("static inline float bwpp_silu(float x) {\n", f);
+  fputs("  return x / (1.0f + expf(-x));\n", f);
+  fputs("}\n", f);
+}
+
+static int bwpp_c_emit_matmul(FILE *f, const BwppGraph *graph, const BwppTileKernel *tile) {
+  const BwppGraphNode *mm = bwpp_c_find(graph, BWPP_GOP_MATMUL);
+  BwppCShape a = {0};
+  BwppCShape b = {0};
+  if (!mm || mm->input_count < 2 ||
+      !bwpp_c_shape(graph, mm->inputs[0], &a) ||
+      !bwpp_c_shape(graph, mm->inputs[1], &b)) {
+    fprintf(stderr, "codegen_c: cannot resolve the matmul shapes\n");
+    return 0;
+  }
+  /* a transposed operand is read in place: A stored [K, M], B stored [N, K] */
+  int trans_a = (mm->flags & BWPP_GRAPH_OPF_TRANS_A) != 0;
+  int trans_b = (mm->flags & BWPP_GRAPH_OPF_TRANS_B) != 0;
+  if (a.rank < 2 || b.rank < 2 ||
+      a.dims[a.rank - (trans_a ? 2 : 1)] != b.dims[b.rank - (trans_b ? 1 : 2)]) {
+    fprintf(stderr, "codegen_c: matmul operands do not line up\n");
+    return 0;
+  }
+  uint32_t M = a.dims[a.rank - (trans_a ? 1 : 2)];
+  uint32_t K = a.dims[a.rank - (trans_a ? 2 : 1)];
+  uint32_t N = b.dims[b.rank - (trans_b ? 2 : 1)];
+  uint32_t a_batch = bwpp_c_outer(&a, 2);
+  uint32_t b_batch = bwpp_c_outer(&b, 2);
+  if (a.rank > 2 && b.rank > 2 && a_batch != b_batch) {
+    fprintf(stderr, "codegen_c: matmul batch dims do not line up\n");
+    return 0;
+  }
+  uint32_t batch = a_batch > b_batch ? a_batch : b_batch;
+  int ep_add = 0;
+  int ep_silu = 0;
+  for (uint32_t i = 0; i < tile->op_count; ++i) {
+    BwppTileEpilogue ep = tile->ops[i].epilogue;
+    if (tile->ops[i].kind != BWPP_TILE_OP_ELEMENTWISE) {
+      continue;
+    }
+    ep_add = ep == BWPP_TILE_EPILOGUE_ADD || ep == BWPP_TILE_EPILOGUE_ADD_SILU;
+    ep_silu = ep == BWPP_TILE_EPILOGUE_SILU || ep == BWPP_TILE_EPILOGUE_ADD_SILU;
+  }
+
+  fprintf(f, "\n#define BWPP_MM_BATCH %u\n", batch);
+  fprintf(f, "#define BWPP_MM_M %u\n", M);
+  fprintf(f, "#define BWPP_MM_N %u\n", N);
+  fprintf(f, "#define BWPP_MM_K %u\n", K);
+  fprintf(f, "#define BWPP_MM_A_STRIDE %u\n", a.rank > 2 ? M * K : 0);
+  fprintf(f, "#define BWPP_MM_B_STRIDE %u\n", b.rank > 2 ? K * N : 0);
+  fprintf(f, "#define BWPP_MM_TRANS_A %d\n", trans_a);
+  fprintf(f, "#define BWPP_MM_TRANS_B %d\n", trans_b);
+  fprintf(f, "#define BWPP_BLOCK_M %u\n", tile->block.m);
+  fprintf(f, "#define BWPP_BLOCK_N %u\n", tile->block.n);
+  fprintf(f, "#define BWPP_BLOCK_K %u\n", tile->block.k);
+  fprintf(f, "#define BWPP_EPILOGUE_ADD %d\n", ep_add);
+  fprintf(f, "#define BWPP_EPILOGUE_SILU %d\n\n", ep_silu);
+  fputs("BWPP_EXPORT const uint32_t bwpp_matmul_shape[6] = {\n", f);
+  fputs("  BWPP_MM_BATCH, BWPP_MM_M, BWPP_MM_N, BWPP_MM_K, BWPP_MM_A_STRIDE, BWPP_MM_B_STRIDE\n", f);
+  fputs("};\n", f);
+  fputs("BWPP_EXPORT const int bwpp_matmul_epilogue[2] = { BWPP_EPILOGUE_ADD, BWPP_EPILOGUE_SILU };\n", f);
+  fputs("BWPP_EXPORT const int bwpp_matmul_trans[2] = { BWPP_MM_TRANS_A, BWPP_MM_TRANS_B };\n\n", f);
+  fputs("/* C[b] = A[b] @ B[b] (+ Bias, silu); dense row-major, A stored [K, M] when\n", f);
+  fputs("   BWPP_MM_TRANS_A and B stored [N, K] when BWPP_MM_TRANS_B, Bias has N entries. */\n", f);
+  fputs("BWPP_EXPORT void bwpp_matmul_f32(const float *A, const float *B, float *C, const float *Bias) {\n", f);
+  fputs("  (void)Bias;\n", f);
+  fputs("  for (uint32_t b = 0; b < BWPP_MM_BATCH; ++b) {\n", f);
+  fputs("    const float *a = A + (size_t)b * BWPP_MM_A_STRIDE;\n", f);
+  fputs("    const float *bm = B + (size_t)b * BWPP_MM_B_STRIDE;\n", f);
+  fputs("    float *c = C + (size_t)b * BWPP_MM_M * BWPP_MM_N;\n", f);
+  fputs("    memset(c, 0, sizeof(float) * BWPP_MM_M * BWPP_MM_N);\n", f);
+  fputs("    for (uint32_t i0 = 0; i0 < BWPP_MM_M; i0 += BWPP_BLOCK_M) {\n", f);
+  fputs("      uint32_t i1 = i0 + BWPP_BLOCK_M < BWPP_MM_M ? i0 + BWPP_BLOCK_M : BWPP_MM_M;\n", f);
+  fputs("      for (uint32_t k0 = 0; k0 < BWPP_MM_K; k0 += BWPP_BLOCK_K) {\n", f);
+  fputs("        uint32_t k1 = k0 + BWPP_BLOCK_K < BWPP_MM_K ? k0 + BWPP_BLOCK_K : BWPP_MM_K;\n", f);
+  fputs("        for (uint32_t j0 = 0; j0 < BWPP_MM_N; j0 += BWPP_BLOCK_N) {\n", f);
+  fputs("          uint32_t j1 = j0 + BWPP_BLOCK_N < BWPP_MM_N ? j0 + BWPP_BLOCK_N : BWPP_MM_N;\n", f);
+  fputs("          for (uint32_t i = i0; i < i1; ++i) {\n", f);
+  fputs("            float *crow = c + (size_t)i * BWPP_MM_N + j0;\n", f);
+  const char *a_at = trans_a ? "a[(size_t)k * BWPP_MM_M + i]" : "a[(size_t)i * BWPP_MM_K + k]";
+  if (trans_b) {
+    /* each output is a dot of an A row with a B row */
+    fputs("            for (uint32_t j = j0; j < j1; ++j) {\n", f);
+    fputs("              const float *brow = bm + (size_t)j * BWPP_MM_K;\n", f);
+    if (trans_a) {
+      fputs("              float s = 0.0f;\n", f);
+      fputs("              for (uint32_t k = k0; k < k1; ++k) {\n", f);
+      fprintf(f, "                s += %s * brow[k];\n", a_at);
+      fputs("              }\n", f);
+      fputs("              crow[j - j0] += s;\n", f);
+    } else {
+      fputs("              crow[j - j0] += bwpp_dot(a + (size_t)i * BWPP_MM_K + k0, brow + k0, k1 - k0);\n", f);
+    }
+    fputs("            }\n", f);
+  } else {
+    fputs("            for (uint32_t k = k0; k < k1; ++k) {\n", f);
+    fprintf(f, "              bwpp_axpy(crow, bm + (size_t)k * BWPP_MM_N + j0, %s, j1 - j0);\n", a_at);
+    fputs("            }\n", f);
+  }
+  fputs("          }\n", f);
+  fputs("        }\n", f);
+  fputs("      }\n", f);
+  fputs("#if BWPP_EPILOGUE_ADD || BWPP_EPILOGUE_SILU\n", f);
+  fputs("      /* fused epilogue while the block's rows are still in cache */\n", f);
+  fputs("      for (uint32_t i = i0; i < i1; ++i) {\n", f);
+  fputs("        float *row = c + (size_t)i * BWPP_MM_N;\n", f);
+  fputs("#if BWPP_EPILOGUE_ADD\n", f);
+  fputs("        bwpp_axpy(row, Bias, 1.0f, BWPP_MM_N);\n", f);
+  fputs("#endif\n", f);
+  fputs("#if BWPP_EPILOGUE_SILU\n", f);
+  fputs("        for (uint32_t j = 0; j < BWPP_MM_N; ++j) {\n", f);
+  fputs("          row[j] = bwpp_silu(row[j]);\n", f);
+  fputs("        }\n", f);
+  fputs("#endif\n", f);
+  fputs("      }\n", f);
+  fputs("#endif\n", f);
+  fputs("    }\n", f);
+  fputs("  }\n", f);
+  fputs("}\n", f);
+  return 1;
+}
+
+static int bwpp_c_emit_attention(FILE *f, const BwppGraph *graph, const BwppTileKernel *tile) {
+  BwppGraphAttentionInfo info;
+  BwppCShape q = {0};
+  BwppCShape k = {0};
+  BwppCShape v = {0};
+  if (!bwpp_graph_attention_info(graph, &info) ||
+      !bwpp_c_shape(graph, info.q, &q) ||
+      !bwpp_c_shape(graph, info.k, &k) ||
+      !bwpp_c_shape(graph, info.v, &v)) {
+    fprintf(stderr, "codegen_c: cannot resolve the attention shapes\n");
+    return 0;
+  }
+  if (q.rank < 2 || q.rank != k.rank || k.rank != v.rank) {
+    fprintf(stderr, "codegen_c: attention operands do not line up\n");
+    return 0;
+  }
+  /* [..., heads, rows, width]; anything left of heads is batch */
+  uint32_t r = q.rank;
+  uint32_t batch = bwpp_c_outer(&q, 3);
+  uint32_t heads = r >= 3 ? q.dims[r - 3] : 1;
+  uint32_t kv_heads = r >= 3 ? k.dims[r - 3] : 1;
+  uint32_t M = q.dims[r - 2];
+  uint32_t K = q.dims[r - 1];
+  uint32_t N = k.dims[r - 2];
+  uint32_t D = v.dims[r - 1];
+  if (k.dims[r - 1] != K || v.dims[r - 2] != N || bwpp_c_outer(&k, 3) != batch ||
+      kv_heads == 0 || kv_heads > heads || heads % kv_heads != 0) {
+    fprintf(stderr, "codegen_c: attention operands do not line up\n");
+    return 0;
+  }
+
+  fprintf(f, "\n#define BWPP_ATT_BATCH %u\n", batch);
+  fprintf(f, "#define BWPP_ATT_HEADS %u\n", heads);
+  fprintf(f, "#define BWPP_ATT_KV_HEADS %u\n", kv_heads);
+  fprintf(f, "#define BWPP_ATT_M %u\n", M);
+  fprintf(f, "#define BWPP_ATT_N %u\n", N);
+  fprintf(f, "#define BWPP_ATT_K %u\n", K);
+  fprintf(f, "#define BWPP_ATT_D %u\n", D);
+  fprintf(f, "#define BWPP_ATT_BLOCK_N %u\n", tile->block.n);
+  fprintf(f, "#define BWPP_ATT_CAUSAL %d\n", (info.mask & BWPP_GRAPH_MASK_CAUSAL) ? 1 : 0);
+  fprintf(f, "#define BWPP_ATT_KV_LEN %d\n\n", (info.mask & BWPP_GRAPH_MASK_KV_LEN) ? 1 : 0);
+  fputs("BWPP_EXPORT const uint32_t bwpp_attention_shape[9] = {\n", f);
+  fputs("  BWPP_ATT_BATCH, BWPP_ATT_HEADS, BWPP_ATT_KV_HEADS, BWPP_ATT_M, BWPP_ATT_N,\n", f);
+  fputs("  BWPP_ATT_K, BWPP_ATT_D, BWPP_ATT_CAUSAL, BWPP_ATT_KV_LEN\n", f);
+  fputs("};\n\n", f);
+  fputs("/* softmax(Q K^T) V per head with an online softmax over BLOCK_N keys at a\n", f);
+  fputs("   time. Q/O are [batch, heads, M, *], K/V [batch, kv_heads, N, *]; KvLen\n", f);
+  fputs("   holds one key length per batch entry. */\n", f);
+  fputs("BWPP_EXPORT void bwpp_attention_f32(const float *Q,\n", f);
+  fputs("                                    const float *K,\n", f);
+  fputs("                                    const float *V,\n", f);
+  fputs("                                    float *O,\n", f);
+  fputs("                                    const uint32_t *KvLen) {\n", f);
+  fputs("  (void)KvLen;\n", f);
+  fputs("  for (uint32_t bh = 0; bh < BWPP_ATT_BATCH * BWPP_ATT_HEADS; ++bh) {\n", f);
+  fputs("    uint32_t b = bh / BWPP_ATT_HEADS;\n", f);
+  fputs("    uint32_t kvh = (bh % BWPP_ATT_HEADS) / (BWPP_ATT_HEADS / BWPP_ATT_KV_HEADS);\n", f);
+  fputs("    const float *qh = Q + (size_t)bh * BWPP_ATT_M * BWPP_ATT_K;\n", f);
+  fputs("    float *oh = O + (size_t)bh * BWPP_ATT_M * BWPP_ATT_D;\n", f);
+  fputs("    const float *kh = K + ((size_t)b * BWPP_ATT_KV_HEADS + kvh) * BWPP_ATT_N * BWPP_ATT_K;\n", f);
+  fputs("    const float *vh = V + ((size_t)b * BWPP_ATT_KV_HEADS + kvh) * BWPP_ATT_N * BWPP_ATT_D;\n", f);
+  fputs("    uint32_t n_len = BWPP_ATT_N;\n", f);
+  fputs("#if BWPP_ATT_KV_LEN\n", f);
+  fputs("    if (KvLen && KvLen[b] < n_len) {\n", f);
+  fputs("      n_len = KvLen[b];\n", f);
+  fputs("    }\n", f);
+  fputs("#endif\n", f);
+  fputs("    for (uint32_t m = 0; m < BWPP_ATT_M; ++m) {\n", f);
+  fputs("      const float *q = qh + (size_t)m * BWPP_ATT_K;\n", f);
+  fputs("      float *o = oh + (size_t)m * BWPP_ATT_D;\n", f);
+  fputs("      uint32_t n_end = n_len;\n", f);
+  fputs("#if BWPP_ATT_CAUSAL\n", f);
+  fputs("      /* bottom-right aligned: row m sees keys n <= m + n_len - M */\n", f);
+  fputs("      int64_t lim = (int64_t)m + (int64_t)n_len - BWPP_ATT_M + 1;\n", f);
+  fputs("      n_end = lim <= 0 ? 0 : (lim < (int64_t)n_len ? (uint32_t)lim : n_len);\n", f);
+  fputs("#endif\n", f);
+  fputs("      float acc[BWPP_ATT_D];\n", f);
+  fputs("      float s[BWPP_ATT_BLOCK_N];\n", f);
+  fputs("      float maxv = -INFINITY;\n", f);
+  fputs("      float sum = 0.0f;\n", f);
+  fputs("      memset(acc, 0, sizeof(acc));\n", f);
+  fputs("      for (uint32_t n0 = 0; n0 < n_end; n0 += BWPP_ATT_BLOCK_N) {\n", f);
+  fputs("        uint32_t n1 = n0 + BWPP_ATT_BLOCK_N < n_end ? n0 + BWPP_ATT_BLOCK_N : n_end;\n", f);
+  fputs("        float bmax = -INFINITY;\n", f);
+  fputs("        for (uint32_t n = n0; n < n1; ++n) {\n", f);
+  fputs("          s[n - n0] = bwpp_dot(q, kh + (size_t)n * BWPP_ATT_K, BWPP_ATT_K);\n", f);
+  fputs("          bmax = s[n - n0] > bmax ? s[n - n0] : bmax;\n", f);
+  fputs("        }\n", f);
+  fputs("        if (bmax > maxv) {\n", f);
+  fputs("          float scale = expf(maxv - bmax);\n", f);
+  fputs("          for (uint32_t d = 0; d < BWPP_ATT_D; ++d) {\n", f);
+  fputs("            acc[d] *= scale;\n", f);
+  fputs("          }\n", f);
+  fputs("          sum *= scale;\n", f);
+  fputs("          maxv = bmax;\n", f);
+  fputs("        }\n", f);
+  fputs("        for (uint32_t n = n0; n < n1; ++n) {\n", f);
+  fputs("          float w = expf(s[n - n0] - maxv);\n", f);
+  fputs("          sum += w;\n", f);
+  fputs("          bwpp_axpy(acc, vh + (size_t)n * BWPP_ATT_D, w, BWPP_ATT_D);\n", f);
+  fputs("        }\n", f);
+  fputs("      }\n", f);
+  fputs("      float inv = sum > 0.0f ? 1.0f / sum : 0.0f;\n", f);
+  fputs("      for (uint32_t d = 0; d < BWPP_ATT_D; ++d) {\n", f);
+  fputs("        o[d] = acc[d] * inv;\n", f);
+  fputs("      }\n", f);
+  fputs("    }\n", f);
+  fputs("  }\n", f);
+  fputs("}\n", f);
+  return 1;
+}
+
+static int bwpp_c_emit_softmax(FILE *f, const BwppGraph *graph) {
+  const BwppGraphNode *n = bwpp_c_find(graph, BWPP_GOP_SOFTMAX);
+  BwppCShape x = {0};
+  if (!n || !bwpp_c_shape(graph, n->inputs[0], &x)) {
+    fprintf(stderr, "codegen_c: cannot resolve the softmax shape\n");
+    return 0;
+  }
+  fprintf(f, "\n#define BWPP_SOFTMAX_ROWS %u\n", bwpp_c_outer(&x, 1));
+  fprintf(f, "#define BWPP_SOFTMAX_COLS %u\n\n", x.dims[x.rank - 1]);
+  fputs("BWPP_EXPORT const uint32_t bwpp_softmax_shape[2] = { BWPP_SOFTMAX_ROWS, BWPP_SOFTMAX_COLS };\n\n", f);
+  fputs("BWPP_EXPORT void bwpp_softmax_f32(const float *X, float *Y) {\n", f);
+  fputs("  for (uint32_t r = 0; r < BWPP_SOFTMAX_ROWS; ++r) {\n", f);
+  fputs("    const float *x = X + (size_t)r * BWPP_SOFTMAX_COLS;\n", f);
+  fputs("    float *y = Y + (size_t)r * BWPP_SOFTMAX_COLS;\n", f);
+  fputs("    float maxv = -INFINITY;\n", f);
+  fputs("    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {\n", f);
+  fputs("      maxv = x[c] > maxv ? x[c] : maxv;\n", f);
+  fputs("    }\n", f);
+  fputs("    float sum = 0.0f;\n", f);
+  fputs("    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {\n", f);
+  fputs("      y[c] = expf(x[c] - maxv);\n", f);
+  fputs("      sum += y[c];\n", f);
+  fputs("    }\n", f);
+  fputs("    float inv = sum > 0.0f ? 1.0f / sum : 0.0f;\n", f);
+  fputs("    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {\n", f);
+  fputs("      y[c] *= inv;\n", f);
+  fputs("    }\n", f);
+  fputs("  }\n", f);
+  fputs("}\n", f);
+  return 1;
+}
+
+static int bwpp_c_emit_rmsnorm(FILE *f, const BwppGraph *graph) {
+  const BwppGraphNode *n = bwpp_c_find(graph, BWPP_GOP_RMSNORM);
+  BwppCShape x = {0};
+  if (!n || !bwpp_c_shape(graph, n->inputs[0], &x)) {
+    fprintf(stderr, "codegen_c: cannot resolve the rmsnorm shape\n");
+    return 0;
+  }
+  float eps = n->attr.has_epsilon ? n->attr.epsilon : 1e-5f;
+  fprintf(f, "\n#define BWPP_RMSNORM_ROWS %u\n", bwpp_c_outer(&x, 1));
+  fprintf(f, "#define BWPP_RMSNORM_COLS %u\n", x.dims[x.rank - 1]);
+  fprintf(f, "#define BWPP_RMSNORM_EPS %.9gf\n\n", eps);
+  fputs("BWPP_EXPORT const uint32_t bwpp_rmsnorm_shape[2] = { BWPP_RMSNORM_ROWS, BWPP_RMSNORM_COLS };\n", f);
+  fputs("BWPP_EXPORT const float bwpp_rmsnorm_eps = BWPP_RMSNORM_EPS;\n\n", f);
+  fputs("/* Gamma and Beta hold COLS entries each and may be NULL. */\n", f);
+  fputs("BWPP_EXPORT void bwpp_rmsnorm_f32(const float *X, const float *Gamma, float *Y, const float *Beta) {\n", f);
+  fputs("  for (uint32_t r = 0; r < BWPP_RMSNORM_ROWS; ++r) {\n", f);
+  fputs("    const float *x = X + (size_t)r * BWPP_RMSNORM_COLS;\n", f);
+  fputs("    float *y = Y + (size_t)r * BWPP_RMSNORM_COLS;\n", f);
+  fputs("    float sumsq = bwpp_dot(x, x, BWPP_RMSNORM_COLS);\n", f);
+  fputs("    float inv = 1.0f / sqrtf(sumsq / (float)BWPP_RMSNORM_COLS + BWPP_RMSNORM_EPS);\n", f);
+  fputs("    for (uint32_t c = 0; c < BWPP_RMSNORM_COLS; ++c) {\n", f);
+  fputs("      float g = Gamma ? Gamma[c] : 1.0f;\n", f);
+  fputs("      float b = Beta ? Beta[c] : 0.0f;\n", f);
+  fputs("      y[c] = x[c] * inv * g + b;\n", f);
+  fputs("    }\n", f);
+  fputs("  }\n", f);
+  fputs("}\n", f);
+  return 1;
+}
+
+BwppStatus bwpp_codegen_c(const BwppIrModule *ir, const BwppGraph *graph, const char *out_path) {
+  if (!graph) {
+    fprintf(stderr, "codegen_c: needs a graph (see --entry)\n");
+    return BWPP_ERR;
+  }
+  int has_softmax = 0;
+  int has_rmsnorm = 0;
+  for (uint32_t i = 0; ir && i < ir->node_count; ++i) {
+    if (ir->nodes[i].op == BWPP_OP_SOFTMAX) {
+      has_softmax = 1;
+    } else if (ir->nodes[i].op == BWPP_OP_RMSNORM) {
+      has_rmsnorm = 1;
+    }
+  }
+  int has_attention = ir && (ir->flags & BWPP_IRF_HAS_ATTENTION);
+  BwppTileKernel *tile = has_attention ? bwpp_tile_lower_attention() : bwpp_tile_lower_matmul(ir);
+  bwpp_tile_bind_problem(tile, graph, has_attention);
+  FILE *f = fopen(out_path, "w");
+  if (!f) {
+    bwpp_tile_kernel_destroy(tile);
+    return BWPP_ERR;
+  }
+  fputs("/* BW++ C output: C11 + SIMD intrinsics, shapes baked in.\n", f);
+  fputs("   Build: cc -std=c11 -O3 -march=native -shared -fPIC <this.c> -o <lib.so> -lm */\n", f);
+  fprintf(f, "/* bwpp.meta: ops=%u reversible_regions=%u */\n",
+          ir ? ir->node_count : 0, ir ? ir->region_count : 0);
+  if (tile) {
+    fprintf(f, "/* bwpp.meta: kernel=%s */\n", has_attention ? "attention_f32" : "matmul_f32");
+    fprintf(f, "/* bwpp.meta: block=%u,%u,%u */\n", tile->block.m, tile->block.n, tile->block.k);
+    if (tile->problem.m) {
+      fprintf(f, "/* bwpp.meta: problem=%u,%u,%u,%u */\n",
+              tile->problem.batch, tile->problem.m, tile->problem.n, tile->problem.k);
+    }
+    for (uint32_t i = 0; i < tile->op_count; ++i) {
+      const BwppTileOp *op = &tile->ops[i];
+      fprintf(f, "/* bwpp.plan: %u=%s role=%u */\n", i, bwpp_tile_op_name(op->kind), (unsigned)op->role);
+    }
+  } else {
+    fputs("/* bwpp.meta: kernel=none */\n", f);
+  }
+  if (has_softmax) {
+    fputs("/* bwpp.meta: aux_kernel=softmax_f32 */\n", f);
+  }
+  if (has_rmsnorm) {
+    fputs("/* bwpp.meta: aux_kernel=rmsnorm_f32 */\n", f);
+  }
+  fputs("\n", f);
+  bwpp_c_emit_prelude(f);
+
+  int ok = 1;
+  if (tile) {
+    ok = has_attention ? bwpp_c_emit_attention(f, graph, tile)
+                       : bwpp_c_emit_matmul(f, graph, tile);
+  }
+  if (ok && has_softmax) {
+    ok = bwpp_c_emit_softmax(f, graph);
+  }
+  if (ok && has_rmsnorm) {
+    ok = bwpp_c_emit_rmsnorm(f, graph);
+  }
+  fclose(f);
+  bwpp_tile_kernel_destroy(tile);
+  if (!ok) {
+    remove(out_path);
+    return BWPP_ERR;
+  }
+  return BWPP_OK;
+}
@@ -1,217 +1,677 @@
 #include "codegen_metal.h"
+#include "dispatch.h"
+#include "fusion.h"
 #include "tile_ir.h"
 #include <stdio.h>
+#include <string.h>
 
-static const char *bwpp_tile_op_name(BwppTileOpKind kind) {
-  switch (kind) {
-    case BWPP_TILE_OP_MATMUL: return "matmul";
-    case BWPP_TILE_OP_LOAD: return "load";
-    case BWPP_TILE_OP_STORE: return "store";
-    case BWPP_TILE_OP_ELEMENTWISE: return "elementwise";
-    case BWPP_TILE_OP_SOFTMAX: return "softmax";
-    case BWPP_TILE_OP_ATTENTION: return "attention";
-  }
-  return "unknown";
+/* Per-region kernels: one per distinct kernel of the dispatch schedule
+   (written from the first region that launches it), every shape baked in,
+   buffers bound in the order of the schedule (inputs, then the output). */
+typedef struct {
+  FILE *f;
+  const BwppGraph *g;
+  const BwppFusionRegion *r;
+  const BwppDispatch *d;
+  const BwppDispatchSchedule *s;
+} BwppMetalRegion;
+
+static const char *bwpp_metal_type(BwppDType dtype) {
+  switch (dtype) {
+    case BWPP_DTYPE_F16: return "half";
+    case BWPP_DTYPE_BF16: return "bfloat";
+    case BWPP_DTYPE_U32: return "uint";
+    default: return "float";
+  }
+}
+
+static const BwppShape *bwpp_metal_shape(const BwppMetalRegion *c, uint32_t v) {
+  return &c->g->values[v].shape;
+}
+
+static uint32_t bwpp_metal_buffer(const BwppMetalRegion *c, uint32_t v) {
+  for (uint32_t i = 0; i < c->d->binding_count; ++i) {
+    if (c->d->bindings[i].value == v) {
+      return i;
+    }
+  }
+  return 0;
 }
 
-static BwppTileKernel *bwpp_lower_tile_matmul(const BwppIrModule *ir) {
-  if (!ir) {
-    return NULL;
-  }
-  int has_matmul = 0;
-  int has_add = 0;
-  int has_silu = 0;
-  for (uint32_t i = 0; i < ir->node_count; ++i) {
-    if (ir->nodes[i].op == BWPP_OP_MATMUL) {
-      has_matmul = 1;
-    } else if (ir->nodes[i].op == BWPP_OP_ADD) {
-      if (ir->nodes[i].flags & BWPP_IR_OPF_HAS_BIAS) {
-        has_add = 1;
+static uint32_t bwpp_metal_axis(const BwppGraphNode *n, const BwppShape *s) {
+  if (n->attr.has_axis && n->attr.axis >= 0) {
+    return (uint32_t)n->attr.axis;
+  }
+  return s->rank ? s->rank - 1 : 0;
+}
+
+static void bwpp_metal_axis_split(const BwppShape *s, uint32_t axis, uint64_t *outer, uint32_t *len,
+                                  uint64_t *inner) {
+  *outer = 1;
+  *inner = 1;
+  *len = axis < s->rank ? s->sizes[axis] : 1;
+  for (uint32_t i = 0; i < s->rank; ++i) {
+    if (i < axis) {
+      *outer *= s->sizes[i];
+    } else if (i > axis) {
+      *inner *= s->sizes[i];
+    }
+  }
+}
+
+/* Element of `in` read at linear index `idx` of `out`, numpy broadcasting. */
+static void bwpp_metal_index(FILE *f, const BwppShape *in, const BwppShape *out, const char *idx) {
+  if (in->rank == out->rank && memcmp(in->sizes, out->sizes, sizeof(uint32_t) * in->rank) == 0) {
+    fputs(idx, f);
+    return;
+  }
+  int terms = 0;
+  uint64_t stride = 1;
+  uint64_t below = 1;
+  for (uint32_t i = out->rank; i > 0; --i) {
+    uint32_t o = i - 1;
+    uint32_t back = out->rank - o;
+    if (back <= in->rank) {
+      uint32_t d = in->sizes[in->rank - back];
+      if (d != 1) {
+        fprintf(f, "%s(%s / %lluu %% %uu) * %lluu", terms ? " + " : "", idx, (unsigned long long)below,
+                out->sizes[o], (unsigned long long)stride);
+        terms++;
       }
-    } else if (ir->nodes[i].op == BWPP_OP_SILU) {
-      has_silu = 1;
-    }
-  }
-  if (!has_matmul) {
-    return NULL;
-  }
-  BwppTileKernel *kernel = bwpp_tile_kernel_create();
-  if (!kernel) {
-    return NULL;
-  }
-  kernel->block.m = 128;
-  kernel->block.n = 128;
-  kernel->block.k = 32;
-  BwppTileOp load_a;
-  load_a.kind = BWPP_TILE_OP_LOAD;
-  load_a.tile.m = 16;
-  load_a.tile.n = 16;
-  load_a.tile.k = 16;
-  load_a.src_mem = BWPP_TILE_MEM_GLOBAL;
-  load_a.dst_mem = BWPP_TILE_MEM_THREADGROUP;
-  load_a.role = BWPP_TILE_ROLE_A;
-  load_a.epilogue = BWPP_TILE_EPILOGUE_NONE;
-  load_a.a_mem = BWPP_TILE_MEM_GLOBAL;
-  load_a.b_mem = BWPP_TILE_MEM_GLOBAL;
-  load_a.c_mem = BWPP_TILE_MEM_GLOBAL;
-  if (bwpp_tile_kernel_add_op(kernel, &load_a) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+      stride *= d;
+    }
+    below *= out->sizes[o];
+  }
+  if (!terms) {
+    fputs("0u", f);
+  }
+}
+
+static void bwpp_metal_params(const BwppMetalRegion *c) {
+  for (uint32_t i = 0; i + 1 < c->d->binding_count; ++i) {
+    fprintf(c->f, ", device const %s *b%u", bwpp_metal_type(c->g->values[c->d->bindings[i].value].dtype), i);
   }
+}
 
-  BwppTileOp load_b = load_a;
-  load_b.role = BWPP_TILE_ROLE_B;
-  if (bwpp_tile_kernel_add_op(kernel, &load_b) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+static void bwpp_metal_args(const BwppMetalRegion *c) {
+  for (uint32_t i = 0; i + 1 < c->d->binding_count; ++i) {
+    fprintf(c->f, ", b%u", i);
   }
+}
 
-  BwppTileOp op;
-  op.kind = BWPP_TILE_OP_MATMUL;
-  op.tile.m = 16;
-  op.tile.n = 16;
-  op.tile.k = 16;
-  op.a_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.b_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.c_mem = BWPP_TILE_MEM_REGISTER;
-  op.src_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.dst_mem = BWPP_TILE_MEM_REGISTER;
-  op.role = BWPP_TILE_ROLE_C;
-  op.epilogue = BWPP_TILE_EPILOGUE_NONE;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
-  }
-  if (has_add || has_silu) {
-    BwppTileOp epi;
-    epi.kind = BWPP_TILE_OP_ELEMENTWISE;
-    epi.tile = op.tile;
-    epi.a_mem = BWPP_TILE_MEM_REGISTER;
-    epi.b_mem = BWPP_TILE_MEM_REGISTER;
-    epi.c_mem = BWPP_TILE_MEM_REGISTER;
-    epi.src_mem = BWPP_TILE_MEM_REGISTER;
-    epi.dst_mem = BWPP_TILE_MEM_REGISTER;
-    epi.role = BWPP_TILE_ROLE_C;
-    if (has_add && has_silu) {
-      epi.epilogue = BWPP_TILE_EPILOGUE_ADD_SILU;
-    } else if (has_add) {
-      epi.epilogue = BWPP_TILE_EPILOGUE_ADD;
-    } else {
-      epi.epilogue = BWPP_TILE_EPILOGUE_SILU;
+static void bwpp_metal_load(const BwppMetalRegion *c, uint32_t v, const BwppShape *at, const char *idx) {
+  fprintf(c->f, "float(b%u[", bwpp_metal_buffer(c, v));
+  bwpp_metal_index(c->f, bwpp_metal_shape(c, v), at, idx);
+  fputs("])", c->f);
+}
+
+/* `float t<k> = ...;` for region nodes [from, to) at index `i`; `seed` (if
+   not NO_VALUE) is read as `x`. */
+static void bwpp_metal_chain(const BwppMetalRegion *c, uint32_t from, uint32_t to, uint32_t seed) {
+  for (uint32_t k = from; k < to; ++k) {
+    const BwppGraphNode *n = &c->g->nodes[c->r->nodes[k]];
+    const BwppShape *at = bwpp_metal_shape(c, n->output);
+    const char *sym = "+";
+    switch (n->op) {
+      case BWPP_GOP_SUB: sym = "-"; break;
+      case BWPP_GOP_MUL: sym = "*"; break;
+      case BWPP_GOP_DIV: sym = "/"; break;
+      default: break;
+    }
+    fprintf(c->f, "  float t%u = ", k);
+    if (n->op == BWPP_GOP_SILU) {
+      fputs("bwpp_region_silu(", c->f);
+    } else if (n->op == BWPP_GOP_SILU_GRAD) {
+      fputs("bwpp_region_silu_grad(", c->f);
+    }
+    for (uint32_t j = 0; j < n->input_count && j < 2; ++j) {
+      uint32_t v = n->inputs[j];
+      if (j) {
+        fprintf(c->f, n->op == BWPP_GOP_SILU_GRAD ? ", " : " %s ", sym);
+      }
+      uint32_t local = UINT32_MAX;
+      for (uint32_t m = from; m < k; ++m) {
+        if (c->g->nodes[c->r->nodes[m]].output == v) {
+          local = m;
+        }
+      }
+      if (v == seed) {
+        fputs("x", c->f);
+      } else if (local != UINT32_MAX) {
+        fprintf(c->f, "t%u", local);
+      } else {
+        bwpp_metal_load(c, v, at, "i");
+      }
+      if (n->op == BWPP_GOP_SILU) {
+        break;
+      }
     }
-    if (bwpp_tile_kernel_add_op(kernel, &epi) != BWPP_OK) {
-      bwpp_tile_kernel_destroy(kernel);
-      return NULL;
+    fputs(n->op == BWPP_GOP_SILU || n->op == BWPP_GOP_SILU_GRAD ? ");\n" : ";\n", c->f);
+  }
+}
+
+/* bwpp_r<N>_pro(i): the elementwise chain feeding the anchor; _epi(i, x):
+   the chain after it, applied to the anchor's result x. */
+static void bwpp_metal_helper(const BwppMetalRegion *c, const char *name, uint32_t from, uint32_t to,
+                              uint32_t seed) {
+  fprintf(c->f, "inline float %s_%s(uint i%s", c->d->kernel, name, seed != BWPP_GRAPH_NO_VALUE ? ", float x" : "");
+  bwpp_metal_params(c);
+  fputs(") {\n", c->f);
+  bwpp_metal_chain(c, from, to, seed);
+  fprintf(c->f, "  return t%u;\n}\n\n", to - 1);
+}
+
+static uint32_t bwpp_metal_position(const BwppFusionRegion *r, uint32_t node) {
+  for (uint32_t k = 0; k < r->node_count; ++k) {
+    if (r->nodes[k] == node) {
+      return k;
     }
   }
+  return 0;
+}
 
-  BwppTileOp store_c;
-  store_c.kind = BWPP_TILE_OP_STORE;
-  store_c.tile = op.tile;
-  store_c.src_mem = BWPP_TILE_MEM_REGISTER;
-  store_c.dst_mem = BWPP_TILE_MEM_GLOBAL;
-  store_c.role = BWPP_TILE_ROLE_C;
-  store_c.epilogue = BWPP_TILE_EPILOGUE_NONE;
-  store_c.a_mem = BWPP_TILE_MEM_REGISTER;
-  store_c.b_mem = BWPP_TILE_MEM_REGISTER;
-  store_c.c_mem = BWPP_TILE_MEM_GLOBAL;
-  if (bwpp_tile_kernel_add_op(kernel, &store_c) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
-  }
-  return kernel;
+/* Value `v` at index expression `idx`: through the prologue when the region
+   computes it, else straight from its buffer. */
+static void bwpp_metal_input(const BwppMetalRegion *c, uint32_t v, int pro, const char *idx) {
+  if (pro) {
+    fprintf(c->f, "%s_pro(%s", c->d->kernel, idx);
+    bwpp_metal_args(c);
+    fputs(")", c->f);
+  } else {
+    fprintf(c->f, "float(b%u[%s])", bwpp_metal_buffer(c, v), idx);
+  }
 }
 
-static BwppTileKernel *bwpp_lower_tile_attention_stub(void) {
-  BwppTileKernel *kernel = bwpp_tile_kernel_create();
-  if (!kernel) {
-    return NULL;
-  }
-  kernel->block.m = 128;
-  kernel->block.n = 128;
-  kernel->block.k = 32;
-  BwppTileOp op;
-  op.tile.m = 16;
-  op.tile.n = 16;
-  op.tile.k = 16;
-  op.epilogue = BWPP_TILE_EPILOGUE_NONE;
+static void bwpp_metal_store(const BwppMetalRegion *c, int epi, const char *idx, const char *value,
+                             const char *indent) {
+  uint32_t out = c->d->binding_count - 1;
+  fprintf(c->f, "%sb%u[%s] = %s(", indent, out, idx, bwpp_metal_type(c->g->values[c->r->output].dtype));
+  if (epi) {
+    fprintf(c->f, "%s_epi(%s, %s", c->d->kernel, idx, value);
+    bwpp_metal_args(c);
+    fputs(")", c->f);
+  } else {
+    fputs(value, c->f);
+  }
+  fputs(");\n", c->f);
+}
 
-  op.kind = BWPP_TILE_OP_LOAD;
-  op.role = BWPP_TILE_ROLE_A; /* Q */
-  op.src_mem = BWPP_TILE_MEM_GLOBAL;
-  op.dst_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.a_mem = BWPP_TILE_MEM_GLOBAL;
-  op.b_mem = BWPP_TILE_MEM_GLOBAL;
-  op.c_mem = BWPP_TILE_MEM_GLOBAL;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+static void bwpp_metal_signature(const BwppMetalRegion *c, int tiled) {
+  fprintf(c->f, "kernel void %s(\n", c->d->kernel);
+  for (uint32_t i = 0; i < c->d->binding_count; ++i) {
+    int out = i + 1 == c->d->binding_count;
+    fprintf(c->f, "    device %s%s *b%u [[buffer(%u)]],\n", out ? "" : "const ",
+            bwpp_metal_type(c->g->values[c->d->bindings[i].value].dtype), i, i);
+  }
+  if (tiled) {
+    fputs("    uint3 tid [[thread_position_in_threadgroup]],\n", c->f);
+    fputs("    uint3 tgid [[threadgroup_position_in_grid]]) {\n", c->f);
+  } else {
+    fputs("    uint gid [[thread_position_in_grid]]) {\n", c->f);
+  }
+}
+
+/* Element offset of batch `tgid.z` of a [..., rows, cols] operand inside the
+   batch dims of `out`; smaller batch dims divide the larger (broadcast or
+   grouped heads), as in the CPU executor. */
+static void bwpp_metal_batch(const BwppMetalRegion *c, const char *name, const BwppShape *s,
+                             const BwppShape *out) {
+  fprintf(c->f, "  uint %s = 0;\n", name);
+  uint64_t stride = 1;
+  uint64_t below = 1;
+  uint64_t mat = (uint64_t)s->sizes[s->rank - 2] * s->sizes[s->rank - 1];
+  for (uint32_t i = out->rank - 2; i > 0; --i) {
+    uint32_t d = i - 1;
+    uint32_t back = out->rank - 2 - d;
+    if (back <= s->rank - 2) {
+      uint32_t sd = s->sizes[s->rank - 2 - back];
+      if (sd > 1) {
+        fprintf(c->f, "  %s += (tgid.z / %lluu %% %uu) / %uu * %lluu;\n", name, (unsigned long long)below, out->sizes[d],
+                out->sizes[d] / sd, (unsigned long long)(stride * mat));
+      }
+      stride *= sd;
+    }
+    below *= out->sizes[d];
+  }
+}
+
+static void bwpp_metal_matmul(const BwppMetalRegion *c, int epi) {
+  const BwppGraphNode *mm = &c->g->nodes[c->r->anchor];
+  const BwppShape *as = bwpp_metal_shape(c, mm->inputs[0]);
+  const BwppShape *bs = bwpp_metal_shape(c, mm->inputs[1]);
+  const BwppShape *ys = bwpp_metal_shape(c, mm->output);
+  int trans_a = (mm->flags & BWPP_GRAPH_OPF_TRANS_A) != 0;
+  int trans_b = (mm->flags & BWPP_GRAPH_OPF_TRANS_B) != 0;
+  uint32_t M = as->sizes[as->rank - (trans_a ? 1 : 2)];
+  uint32_t K = as->sizes[as->rank - (trans_a ? 2 : 1)];
+  uint32_t N = bs->sizes[bs->rank - (trans_b ? 2 : 1)];
+  bwpp_metal_signature(c, 1);
+  FILE *f = c->f;
+  fputs("  threadgroup float As[16][16];\n", f);
+  fputs("  threadgroup float Bs[16][16];\n", f);
+  fputs("  uint row = tgid.y * 16 + tid.y;\n", f);
+  fputs("  uint col = tgid.x * 16 + tid.x;\n", f);
+  bwpp_metal_batch(c, "oa", as, ys);
+  bwpp_metal_batch(c, "ob", bs, ys);
+  fprintf(f, "  device const %s *A = b%u + oa;\n", bwpp_metal_type(c->g->values[mm->inputs[0]].dtype),
+          bwpp_metal_buffer(c, mm->inputs[0]));
+  fprintf(f, "  device const %s *B = b%u + ob;\n", bwpp_metal_type(c->g->values[mm->inputs[1]].dtype),
+          bwpp_metal_buffer(c, mm->inputs[1]));
+  fputs("  float acc = 0.0f;\n", f);
+  fprintf(f, "  for (uint k0 = 0; k0 < %uu; k0 += 16) {\n", K);
+  /* a transposed operand is read in place: A[k][row], B[col][k] */
+  if (trans_a) {
+    fprintf(f, "    As[tid.y][tid.x] = row < %uu && k0 + tid.x < %uu ? float(A[(k0 + tid.x) * %uu + row]) : 0.0f;\n", M, K, M);
+  } else {
+    fprintf(f, "    As[tid.y][tid.x] = row < %uu && k0 + tid.x < %uu ? float(A[row * %uu + k0 + tid.x]) : 0.0f;\n", M, K, K);
+  }
+  if (trans_b) {
+    fprintf(f, "    Bs[tid.y][tid.x] = k0 + tid.y < %uu && col < %uu ? float(B[col * %uu + k0 + tid.y]) : 0.0f;\n", K, N, K);
+  } else {
+    fprintf(f, "    Bs[tid.y][tid.x] = k0 + tid.y < %uu && col < %uu ? float(B[(k0 + tid.y) * %uu + col]) : 0.0f;\n", K, N, N);
+  }
+  fputs("    threadgroup_barrier(mem_flags::mem_threadgroup);\n", f);
+  fputs("    for (uint k = 0; k < 16; ++k) {\n", f);
+  fputs("      acc += As[tid.y][k] * Bs[k][tid.x];\n", f);
+  fputs("    }\n", f);
+  fputs("    threadgroup_barrier(mem_flags::mem_threadgroup);\n", f);
+  fputs("  }\n", f);
+  fprintf(f, "  if (row < %uu && col < %uu) {\n", M, N);
+  fprintf(f, "    uint i = tgid.z * %lluu + row * %uu + col;\n", (unsigned long long)M * N, N);
+  bwpp_metal_store(c, epi, "i", "acc", "    ");
+  fputs("  }\n}\n\n", f);
+}
+
+/* The stored value behind `v`: the source of a transpose the region folds
+   into its loads, else `v` itself. */
+static uint32_t bwpp_metal_unfold(const BwppMetalRegion *c, uint32_t v) {
+  uint32_t p = c->g->values[v].producer;
+  if (p >= c->g->node_count || c->g->nodes[p].op != BWPP_GOP_TRANSPOSE) {
+    return v;
+  }
+  for (uint32_t k = 0; k < c->r->node_count; ++k) {
+    if (c->r->nodes[k] == p) {
+      return c->g->nodes[p].inputs[0];
+    }
   }
+  return v;
+}
+
+/* Element (row, col) of matmul operand `v` at batch offset `base`; a
+   transpose inside the region, or a TRANS_A/TRANS_B read (`trans`), is
+   read through. */
+static void bwpp_metal_operand(const BwppMetalRegion *c, uint32_t v, int trans, const char *base, const char *row,
+                               const char *col) {
+  uint32_t src = bwpp_metal_unfold(c, v);
+  int folded = (src != v) != (trans != 0);
+  const BwppShape *s = bwpp_metal_shape(c, src);
+  fprintf(c->f, "float(b%u[%s + %s * %uu + %s])", bwpp_metal_buffer(c, src), base, folded ? col : row,
+          s->sizes[s->rank - 1], folded ? row : col);
+}
 
-  op.kind = BWPP_TILE_OP_LOAD;
-  op.role = BWPP_TILE_ROLE_B; /* K */
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+/* Row limit of a masked softmax over `rows` x `cols` scores whose row index
+   is `r`: the key length of the row's batch, cut at the diagonal if causal. */
+static void bwpp_metal_mask(const BwppMetalRegion *c, const BwppGraphNode *sm, const BwppShape *xs,
+                            const char *r) {
+  uint32_t cols = xs->rank ? xs->sizes[xs->rank - 1] : 1;
+  uint64_t rows = cols ? bwpp_shape_elems(xs) / cols : 0;
+  uint32_t M = xs->rank >= 2 ? xs->sizes[xs->rank - 2] : 1;
+  uint64_t per_batch = xs->rank >= 3 ? rows / xs->sizes[0] : rows;
+  if (!sm->attr.mask) {
+    fprintf(c->f, "  int lim = %d;\n", (int)cols);
+    return;
+  }
+  fprintf(c->f, "  uint len = %uu;\n", cols);
+  if ((sm->attr.mask & BWPP_GRAPH_MASK_KV_LEN) && sm->input_count >= 2) {
+    uint32_t kv = sm->inputs[1];
+    if (c->g->values[kv].dtype == BWPP_DTYPE_U32) {
+      fprintf(c->f, "  uint kv = uint(b%u[%s / %lluu]);\n", bwpp_metal_buffer(c, kv), r,
+              (unsigned long long)per_batch);
+      fprintf(c->f, "  if (kv < %uu) { len = kv; }\n", cols);
+    } else {
+      fprintf(c->f, "  float kv = float(b%u[%s / %lluu]);\n", bwpp_metal_buffer(c, kv), r,
+              (unsigned long long)per_batch);
+      fprintf(c->f, "  if (kv >= 0.0f && kv < %u.0f) { len = uint(kv); }\n", cols);
+    }
+  }
+  fputs("  int lim = int(len);\n", c->f);
+  if (sm->attr.mask & BWPP_GRAPH_MASK_CAUSAL) {
+    fprintf(c->f, "  lim = clamp(int(%s %% %uu) + int(len) - %d + 1, 0, lim);\n", r, M, (int)M);
   }
+}
 
-  op.kind = BWPP_TILE_OP_MATMUL; /* QK^T */
-  op.role = BWPP_TILE_ROLE_C;
-  op.a_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.b_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.c_mem = BWPP_TILE_MEM_REGISTER;
-  op.src_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.dst_mem = BWPP_TILE_MEM_REGISTER;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+static void bwpp_metal_attention(const BwppMetalRegion *c, int epi) {
+  const BwppGraph *g = c->g;
+  const BwppGraphNode *sm = &g->nodes[c->r->anchor];
+  const BwppGraphNode *mm = &g->nodes[g->values[sm->inputs[0]].producer];
+  uint32_t mm2_node = UINT32_MAX;
+  for (uint32_t k = 0; k < c->r->node_count; ++k) {
+    const BwppGraphNode *n = &g->nodes[c->r->nodes[k]];
+    if ((n->op == BWPP_GOP_MATMUL || n->op == BWPP_GOP_BATCH_MATMUL) && n->inputs[0] == sm->output) {
+      mm2_node = c->r->nodes[k];
+    }
+  }
+  const BwppGraphNode *mm2 = &g->nodes[mm2_node];
+  const BwppShape *ss = bwpp_metal_shape(c, sm->inputs[0]);
+  const BwppShape *ys = bwpp_metal_shape(c, mm2->output);
+  const BwppShape *qs = bwpp_metal_shape(c, mm->inputs[0]);
+  uint32_t M = ss->sizes[ss->rank - 2];
+  uint32_t K = qs->sizes[qs->rank - ((mm->flags & BWPP_GRAPH_OPF_TRANS_A) ? 2 : 1)];
+  uint32_t D = ys->sizes[ys->rank - 1];
+  FILE *f = c->f;
+  bwpp_metal_signature(c, 1);
+  fputs("  uint m = tgid.y * 16 + tid.y;\n", f);
+  fputs("  uint d = tgid.x * 16 + tid.x;\n", f);
+  fprintf(f, "  if (m >= %uu || d >= %uu) { return; }\n", M, D);
+  if (sm->attr.mask) {
+    fprintf(f, "  uint r = tgid.z * %uu + m;\n", M);
+  }
+  /* batch offsets in the layout each operand is stored in */
+  for (uint32_t j = 0; j < 3; ++j) {
+    uint32_t v = bwpp_metal_unfold(c, j < 2 ? mm->inputs[j] : mm2->inputs[1]);
+    bwpp_metal_batch(c, j == 0 ? "oq" : (j == 1 ? "ok" : "ov"), bwpp_metal_shape(c, v), j < 2 ? ss : ys);
   }
+  bwpp_metal_mask(c, sm, ss, "r");
+  fputs("  float maxv = -INFINITY;\n", f);
+  fputs("  float sum = 0.0f;\n", f);
+  fputs("  float acc = 0.0f;\n", f);
+  fputs("  for (int n = 0; n < lim; ++n) {\n", f);
+  fputs("    float s = 0.0f;\n", f);
+  fprintf(f, "    for (uint k = 0; k < %uu; ++k) {\n", K);
+  fputs("      s += ", f);
+  bwpp_metal_operand(c, mm->inputs[0], (mm->flags & BWPP_GRAPH_OPF_TRANS_A) != 0, "oq", "m", "k");
+  fputs(" * ", f);
+  bwpp_metal_operand(c, mm->inputs[1], (mm->flags & BWPP_GRAPH_OPF_TRANS_B) != 0, "ok", "k", "uint(n)");
+  fputs(";\n    }\n", f);
+  fputs("    float mx = max(maxv, s);\n", f);
+  fputs("    float scale = exp(maxv - mx);\n", f);
+  fputs("    float w = exp(s - mx);\n", f);
+  fputs("    sum = sum * scale + w;\n", f);
+  fputs("    acc = acc * scale + w * ", f);
+  bwpp_metal_operand(c, mm2->inputs[1], (mm2->flags & BWPP_GRAPH_OPF_TRANS_B) != 0, "ov", "uint(n)", "d");
+  fputs(";\n    maxv = mx;\n  }\n", f);
+  fputs("  float y = sum > 0.0f ? acc / sum : 0.0f;\n", f);
+  fprintf(f, "  uint i = tgid.z * %lluu + m * %uu + d;\n", (unsigned long long)M * D, D);
+  bwpp_metal_store(c, epi, "i", "y", "  ");
+  fputs("}\n\n", f);
+}
 
-  op.kind = BWPP_TILE_OP_SOFTMAX; /* softmax(scores) */
-  op.role = BWPP_TILE_ROLE_C;
-  op.src_mem = BWPP_TILE_MEM_REGISTER;
-  op.dst_mem = BWPP_TILE_MEM_REGISTER;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+static void bwpp_metal_reduction(const BwppMetalRegion *c, int pro, int epi) {
+  const BwppGraphNode *n = &c->g->nodes[c->r->anchor];
+  const BwppShape *xs = bwpp_metal_shape(c, n->inputs[0]);
+  uint64_t elems = bwpp_shape_elems(xs);
+  uint32_t cols = xs->rank ? xs->sizes[xs->rank - 1] : 1;
+  FILE *f = c->f;
+  bwpp_metal_signature(c, 0);
+  if (n->op == BWPP_GOP_REDUCE_MAX_GRAD) {
+    /* mask * dy, dy broadcast over the reduced axis */
+    uint64_t outer = 1;
+    uint64_t inner = 1;
+    uint32_t len = 1;
+    bwpp_metal_axis_split(xs, bwpp_metal_axis(n, xs), &outer, &len, &inner);
+    fprintf(f, "  if (gid >= %lluu) { return; }\n", (unsigned long long)elems);
+    fputs("  float y = ", f);
+    bwpp_metal_input(c, n->inputs[0], 0, "gid");
+    if (bwpp_shape_elems(bwpp_metal_shape(c, n->inputs[1])) == elems) {
+      fprintf(f, " * float(b%u[gid]);\n", bwpp_metal_buffer(c, n->inputs[1]));
+    } else {
+      fprintf(f, " * float(b%u[gid / %lluu * %lluu + gid %% %lluu]);\n", bwpp_metal_buffer(c, n->inputs[1]),
+              (unsigned long long)len * inner, (unsigned long long)inner, (unsigned long long)inner);
+    }
+    bwpp_metal_store(c, epi, "gid", "y", "  ");
+    fputs("}\n\n", f);
+    return;
   }
+  if (n->op == BWPP_GOP_REDUCE_SUM || n->op == BWPP_GOP_REDUCE_MAX || n->op == BWPP_GOP_REDUCE_MAX_MASK) {
+    uint64_t outer = 1;
+    uint64_t inner = 1;
+    uint32_t len = 1;
+    bwpp_metal_axis_split(xs, bwpp_metal_axis(n, xs), &outer, &len, &inner);
+    fprintf(f, "  if (gid >= %lluu) { return; }\n", (unsigned long long)(outer * inner));
+    fprintf(f, "  uint base = gid / %lluu * %lluu + gid %% %lluu;\n", (unsigned long long)inner,
+            (unsigned long long)len * inner, (unsigned long long)inner);
+    fprintf(f, "  float acc = %s;\n", n->op == BWPP_GOP_REDUCE_SUM ? "0.0f" : "-INFINITY");
+    fprintf(f, "  for (uint k = 0; k < %uu; ++k) {\n", len);
+    fprintf(f, "    uint j = base + k * %lluu;\n", (unsigned long long)inner);
+    fputs("    float v = ", f);
+    bwpp_metal_input(c, n->inputs[0], pro, "j");
+    fprintf(f, ";\n    acc = %s;\n  }\n", n->op == BWPP_GOP_REDUCE_SUM ? "acc + v" : "max(acc, v)");
+    if (n->op != BWPP_GOP_REDUCE_MAX_MASK) {
+      bwpp_metal_store(c, epi, "gid", "acc", "  ");
+    } else {
+      fprintf(f, "  for (uint k = 0; k < %uu; ++k) {\n", len);
+      fprintf(f, "    uint j = base + k * %lluu;\n", (unsigned long long)inner);
+      fputs("    float y = ", f);
+      bwpp_metal_input(c, n->inputs[0], pro, "j");
+      fputs(" == acc ? 1.0f : 0.0f;\n", f);
+      bwpp_metal_store(c, epi, "j", "y", "    ");
+      fputs("  }\n", f);
+    }
+    fputs("}\n\n", f);
+    return;
+  }
+  /* row kinds: softmax, rmsnorm and their grads */
+  fprintf(f, "  if (gid >= %lluu) { return; }\n", (unsigned long long)(cols ? elems / cols : 0));
+  fprintf(f, "  uint base = gid * %uu;\n", cols);
+  switch (n->op) {
+    case BWPP_GOP_SOFTMAX:
+      bwpp_metal_mask(c, n, xs, "gid");
+      fputs("  float maxv = -INFINITY;\n", f);
+      fputs("  for (int c = 0; c < lim; ++c) {\n    maxv = max(maxv, ", f);
+      bwpp_metal_input(c, n->inputs[0], pro, "base + uint(c)");
+      fputs(");\n  }\n", f);
+      fputs("  float sum = 0.0f;\n", f);
+      fputs("  for (int c = 0; c < lim; ++c) {\n    sum += exp(", f);
+      bwpp_metal_input(c, n->inputs[0], pro, "base + uint(c)");
+      fputs(" - maxv);\n  }\n", f);
+      fputs("  float inv = sum > 0.0f ? 1.0f / sum : 0.0f;\n", f);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n", cols);
+      fputs("    uint i = base + c;\n", f);
+      fputs("    float y = int(c) < lim ? exp(", f);
+      bwpp_metal_input(c, n->inputs[0], pro, "i");
+      fputs(" - maxv) * inv : 0.0f;\n", f);
+      bwpp_metal_store(c, epi, "i", "y", "    ");
+      fputs("  }\n", f);
+      break;
+    case BWPP_GOP_RMSNORM:
+      fputs("  float sumsq = 0.0f;\n", f);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n    float v = ", cols);
+      bwpp_metal_input(c, n->inputs[0], pro, "base + c");
+      fputs(";\n    sumsq += v * v;\n  }\n", f);
+      fprintf(f, "  float inv = 1.0f / sqrt(sumsq / %u.0f + %.9ef);\n", cols,
+              n->attr.has_epsilon ? n->attr.epsilon : 1e-5f);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n", cols);
+      fputs("    uint i = base + c;\n", f);
+      fputs("    float y = ", f);
+      bwpp_metal_input(c, n->inputs[0], pro, "i");
+      fprintf(f, " * inv * float(b%u[c])", bwpp_metal_buffer(c, n->inputs[1]));
+      if (n->input_count >= 3) {
+        fprintf(f, " + float(b%u[c])", bwpp_metal_buffer(c, n->inputs[2]));
+      }
+      fputs(";\n", f);
+      bwpp_metal_store(c, epi, "i", "y", "    ");
+      fputs("  }\n", f);
+      break;
+    case BWPP_GOP_SOFTMAX_GRAD: {
+      uint32_t y = bwpp_metal_buffer(c, n->inputs[0]);
+      uint32_t dy = bwpp_metal_buffer(c, n->inputs[1]);
+      fputs("  float dot = 0.0f;\n", f);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n", cols);
+      fprintf(f, "    dot += float(b%u[base + c]) * float(b%u[base + c]);\n  }\n", dy, y);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n", cols);
+      fputs("    uint i = base + c;\n", f);
+      fprintf(f, "    float y = float(b%u[i]) * (float(b%u[i]) - dot);\n", y, dy);
+      bwpp_metal_store(c, epi, "i", "y", "    ");
+      fputs("  }\n", f);
+      break;
+    }
+    default: {
+      /* rmsnorm_grad(x, g, dy) */
+      uint32_t x = bwpp_metal_buffer(c, n->inputs[0]);
+      uint32_t gm = bwpp_metal_buffer(c, n->inputs[1]);
+      uint32_t dy = bwpp_metal_buffer(c, n->inputs[2]);
+      fputs("  float sumsq = 0.0f;\n", f);
+      fputs("  float dot = 0.0f;\n", f);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n", cols);
+      fprintf(f, "    float v = float(b%u[base + c]);\n", x);
+      fputs("    sumsq += v * v;\n", f);
+      fprintf(f, "    dot += float(b%u[c]) * float(b%u[base + c]) * v;\n  }\n", gm, dy);
+      fprintf(f, "  float inv = 1.0f / sqrt(sumsq / %u.0f + %.9ef);\n", cols,
+              n->attr.has_epsilon ? n->attr.epsilon : 1e-5f);
+      fprintf(f, "  float k = inv * inv * inv * dot / %u.0f;\n", cols);
+      fprintf(f, "  for (uint c = 0; c < %uu; ++c) {\n", cols);
+      fputs("    uint i = base + c;\n", f);
+      fprintf(f, "    float y = inv * float(b%u[c]) * float(b%u[i]) - float(b%u[i]) * k;\n", gm, dy, x);
+      bwpp_metal_store(c, epi, "i", "y", "    ");
+      fputs("  }\n", f);
+      break;
+    }
+  }
+  fputs("}\n\n", f);
+}
 
-  op.kind = BWPP_TILE_OP_LOAD;
-  op.role = BWPP_TILE_ROLE_B; /* V */
-  op.src_mem = BWPP_TILE_MEM_GLOBAL;
-  op.dst_mem = BWPP_TILE_MEM_THREADGROUP;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+static void bwpp_metal_layout(const BwppMetalRegion *c) {
+  const BwppGraphNode *n = &c->g->nodes[c->r->anchor];
+  const BwppShape *xs = bwpp_metal_shape(c, n->inputs[0]);
+  const BwppShape *ys = bwpp_metal_shape(c, n->output);
+  FILE *f = c->f;
+  bwpp_metal_signature(c, 0);
+  fprintf(f, "  if (gid >= %lluu) { return; }\n", (unsigned long long)bwpp_shape_elems(ys));
+  fputs("  uint src = ", f);
+  if (n->op == BWPP_GOP_TRANSPOSE || n->op == BWPP_GOP_PERMUTE) {
+    uint32_t perm[BWPP_GRAPH_MAX_DIMS] = { 0, 1, 2, 3 };
+    if (n->op == BWPP_GOP_PERMUTE) {
+      memcpy(perm, n->attr.perm, sizeof(uint32_t) * xs->rank);
+    } else if (xs->rank >= 2) {
+      perm[xs->rank - 2] = xs->rank - 1;
+      perm[xs->rank - 1] = xs->rank - 2;
+    }
+    uint64_t in_stride[BWPP_GRAPH_MAX_DIMS];
+    uint64_t s = 1;
+    for (uint32_t i = xs->rank; i > 0; --i) {
+      in_stride[i - 1] = s;
+      s *= xs->sizes[i - 1];
+    }
+    uint64_t below = 1;
+    for (uint32_t i = xs->rank; i > 0; --i) {
+      uint32_t d = xs->sizes[perm[i - 1]];
+      fprintf(f, "%s(gid / %lluu %% %uu) * %lluu", i == xs->rank ? "" : " + ", (unsigned long long)below, d,
+              (unsigned long long)in_stride[perm[i - 1]]);
+      below *= d;
+    }
+    if (!xs->rank) {
+      fputs("0u", f);
+    }
+  } else if (n->op == BWPP_GOP_BROADCAST) {
+    bwpp_metal_index(f, xs, ys, "gid");
+  } else {
+    fputs("gid", f);
   }
+  fputs(";\n", f);
+  fprintf(f, "  b%u[gid] = %s(b%u[src]);\n}\n\n", c->d->binding_count - 1,
+          bwpp_metal_type(c->g->values[n->output].dtype), bwpp_metal_buffer(c, n->inputs[0]));
+}
+
+static void bwpp_metal_elementwise(const BwppMetalRegion *c) {
+  FILE *f = c->f;
+  bwpp_metal_signature(c, 0);
+  fprintf(f, "  if (gid >= %lluu) { return; }\n", (unsigned long long)bwpp_shape_elems(bwpp_metal_shape(c, c->r->output)));
+  fputs("  uint i = gid;\n", f);
+  bwpp_metal_chain(c, 0, c->r->node_count, BWPP_GRAPH_NO_VALUE);
+  char value[16];
+  snprintf(value, sizeof(value), "t%u", c->r->node_count - 1);
+  bwpp_metal_store(c, 0, "i", value, "  ");
+  fputs("}\n\n", f);
+}
 
-  op.kind = BWPP_TILE_OP_MATMUL; /* softmax(QK^T) * V */
-  op.role = BWPP_TILE_ROLE_C;
-  op.a_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.b_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.c_mem = BWPP_TILE_MEM_REGISTER;
-  op.src_mem = BWPP_TILE_MEM_THREADGROUP;
-  op.dst_mem = BWPP_TILE_MEM_REGISTER;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
+static void bwpp_metal_region(const BwppMetalRegion *c) {
+  const BwppFusionRegion *r = c->r;
+  fprintf(c->f, "// %s: %s nodes=", c->d->kernel, bwpp_fusion_kind_name(r->kind));
+  for (uint32_t k = 0; k < r->node_count; ++k) {
+    fprintf(c->f, "%s%u", k ? "," : "", r->nodes[k]);
+  }
+  fputs(" dispatches=", c->f);
+  uint32_t launches = 0;
+  for (uint32_t i = 0; i < c->s->dispatch_count; ++i) {
+    if (c->s->dispatches[i].kernel_id == c->d->kernel_id) {
+      fprintf(c->f, "%s%u", launches++ ? "," : "", i);
+    }
+  }
+  fputs("\n", c->f);
+  if (r->kind == BWPP_FUSION_ELEMENTWISE) {
+    bwpp_metal_elementwise(c);
+    return;
+  }
+  if (r->kind == BWPP_FUSION_LAYOUT) {
+    bwpp_metal_layout(c);
+    return;
+  }
+  /* the node whose result the epilogue starts from */
+  uint32_t head = r->anchor;
+  if (r->kind == BWPP_FUSION_ATTENTION) {
+    for (uint32_t k = 0; k < r->node_count; ++k) {
+      const BwppGraphNode *n = &c->g->nodes[r->nodes[k]];
+      if (n->input_count && n->inputs[0] == c->g->nodes[r->anchor].output) {
+        head = r->nodes[k];
+      }
+    }
+  }
+  uint32_t a = bwpp_metal_position(r, r->anchor);
+  uint32_t h = bwpp_metal_position(r, head);
+  int pro = r->kind == BWPP_FUSION_REDUCTION && a > 0;
+  int epi = h + 1 < r->node_count;
+  if (pro) {
+    bwpp_metal_helper(c, "pro", 0, a, BWPP_GRAPH_NO_VALUE);
+  }
+  if (epi) {
+    bwpp_metal_helper(c, "epi", h + 1, r->node_count, c->g->nodes[head].output);
   }
+  if (r->kind == BWPP_FUSION_MATMUL) {
+    bwpp_metal_matmul(c, epi);
+  } else if (r->kind == BWPP_FUSION_ATTENTION) {
+    bwpp_metal_attention(c, epi);
+  } else {
+    bwpp_metal_reduction(c, pro, epi);
+  }
+}
 
-  op.kind = BWPP_TILE_OP_STORE;
-  op.role = BWPP_TILE_ROLE_C;
-  op.src_mem = BWPP_TILE_MEM_REGISTER;
-  op.dst_mem = BWPP_TILE_MEM_GLOBAL;
-  op.a_mem = BWPP_TILE_MEM_REGISTER;
-  op.b_mem = BWPP_TILE_MEM_REGISTER;
-  op.c_mem = BWPP_TILE_MEM_GLOBAL;
-  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
-    bwpp_tile_kernel_destroy(kernel);
-    return NULL;
-  }
-  return kernel;
+/* Appends the region kernels and their dispatch schedule; nothing while a
+   dim is unbound. */
+static void bwpp_metal_regions(FILE *f, const BwppGraph *graph, int has_stdlib) {
+  BwppFusionPlan *fusion = graph ? bwpp_fusion_plan_build(graph) : NULL;
+  BwppDispatchSchedule *sched = fusion ? bwpp_dispatch_schedule_build(graph, fusion, 0) : NULL;
+  if (!sched) {
+    fputs("\n// bwpp.meta: region_kernels=0\n", f);
+    bwpp_fusion_plan_destroy(fusion);
+    return;
+  }
+  fprintf(f, "\n// bwpp.meta: region_kernels=%u\n", sched->kernel_count);
+  bwpp_dispatch_schedule_write(sched, f);
+  if (!has_stdlib) {
+    fputs("\n#include <metal_stdlib>\n", f);
+    fputs("using namespace metal;\n", f);
+  }
+  fputs("\ninline float bwpp_region_silu(float x) {\n", f);
+  fputs("  return x / (1.0f + exp(-x));\n", f);
+  fputs("}\n\n", f);
+  fputs("inline float bwpp_region_silu_grad(float x, float dy) {\n", f);
+  fputs("  float s = 1.0f / (1.0f + exp(-x));\n", f);
+  fputs("  return dy * s * (1.0f + x * (1.0f - s));\n", f);
+  fputs("}\n\n", f);
+  uint32_t emitted = 0;
+  for (uint32_t r = 0; r < fusion->region_count; ++r) {
+    if (sched->dispatches[r].kernel_id < emitted) {
+      continue;
+    }
+    BwppMetalRegion c = { f, graph, &fusion->regions[r], &sched->dispatches[r], sched };
+    bwpp_metal_region(&c);
+    emitted++;
+  }
+  bwpp_dispatch_schedule_destroy(sched);
+  bwpp_fusion_plan_destroy(fusion);
 }
 
-BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
+BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const BwppGraph *graph, const char *out_path) {
   FILE *f = fopen(out_path, "w");
   if (!f) {
     return BWPP_ERR;
@@ -230,7 +690,11 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
     }
   }
   int has_attention = ir && (ir->flags & BWPP_IRF_HAS_ATTENTION);
-  BwppTileKernel *tile = has_attention ? bwpp_lower_tile_attention_stub() : bwpp_lower_tile_matmul(ir);
+  int att_causal = has_attention && (ir->flags & BWPP_IRF_ATT_CAUSAL);
+  int att_kv_len = has_attention && (ir->flags & BWPP_IRF_ATT_KV_LEN);
+  int att_gqa = has_attention && (ir->flags & BWPP_IRF_ATT_GQA);
+  BwppTileKernel *tile = has_attention ? bwpp_tile_lower_attention() : bwpp_tile_lower_matmul(ir);
+  bwpp_tile_bind_problem(tile, graph, has_attention);
   const BwppTileOp *matmul = NULL;
   const BwppTileOp *epi = NULL;
   uint32_t tile_m = 16;
@@ -310,11 +774,27 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("// bwpp.meta: kernel=attention_f16\n", f);
       fputs("// bwpp.meta: attention_plan=tile_ir_stub\n", f);
       fputs("// bwpp.meta: fused_attention_candidate=1\n", f);
+      const char *mask = "none";
+      if (att_causal && att_kv_len) {
+        mask = "causal,kv_len";
+      } else if (att_causal) {
+        mask = "causal";
+      } else if (att_kv_len) {
+        mask = "kv_len";
+      }
+      fprintf(f, "// bwpp.meta: attention_mask=%s\n", mask);
+      fprintf(f, "// bwpp.meta: attention_heads=%s\n", att_gqa ? "gqa" : "mha");
     } else {
       fputs("// bwpp.meta: kernel=matmul_f16\n", f);
     }
     fputs("// bwpp.meta: layout=row_major\n", f);
     fprintf(f, "// bwpp.meta: block=%u,%u,%u\n", tile->block.m, tile->block.n, tile->block.k);
+    if (tile->problem.m) {
+      const BwppTileProblem *p = &tile->problem;
+      fprintf(f, "// bwpp.meta: problem=%u,%u,%u,%u\n", p->batch, p->m, p->n, p->k);
+      fprintf(f, "// bwpp.meta: grid=%u,%u,%u\n", (p->n + tile->block.n - 1) / tile->block.n,
+              (p->m + tile->block.m - 1) / tile->block.m, p->batch);
+    }
     if (matmul) {
       if (tile_clamped) {
         fprintf(f, "// bwpp.meta: tile_requested=%u,%u,%u\n", tile_req_m, tile_req_n, tile_req_k);
@@ -334,7 +814,7 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fprintf(f, "// bwpp.meta: epilogue=%s\n", ep);
     }
     if (has_attention) {
-      fputs("// bwpp.meta: params=M,N,K,D,ldq,ldk,ldv,ldo\n\n", f);
+      fputs("// bwpp.meta: params=M,N,K,D,ldq,ldk,ldv,ldo,batch,heads,kv_heads,causal,kv_rows\n\n", f);
     } else {
       fputs("// bwpp.meta: params=M,N,K,lda,ldb,ldc\n\n", f);
     }
@@ -443,7 +923,9 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("#define BWPP_EXP(x) fast::exp(x)\n", f);
       fputs("#else\n", f);
       fputs("#define BWPP_EXP(x) exp(x)\n", f);
-      fputs("#endif\n\n", f);
+      fputs("#endif\n", f);
+      fprintf(f, "#define BWPP_ATT_CAUSAL %d\n", att_causal ? 1 : 0);
+      fprintf(f, "#define BWPP_ATT_KV_LEN %d\n\n", att_kv_len ? 1 : 0);
       fputs("struct BwppAttentionParams {\n", f);
       fputs("  uint M;\n", f);
       fputs("  uint N;\n", f);
@@ -453,6 +935,11 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("  uint ldk;\n", f);
       fputs("  uint ldv;\n", f);
       fputs("  uint ldo;\n", f);
+      fputs("  uint batch;\n", f);
+      fputs("  uint heads;\n", f);
+      fputs("  uint kv_heads;\n", f);
+      fputs("  uint causal;\n", f);
+      fputs("  uint kv_rows;\n", f);
       fputs("};\n\n", f);
       fputs("kernel void bwpp_attention_f16(\n", f);
       fputs("    device const half *Q [[buffer(0)]],\n", f);
@@ -460,9 +947,35 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("    device const half *V [[buffer(2)]],\n", f);
       fputs("    device half *O [[buffer(3)]],\n", f);
       fputs("    constant BwppAttentionParams &p [[buffer(4)]],\n", f);
-      fputs("    uint2 tid [[thread_position_in_threadgroup]],\n", f);
-      fputs("    uint2 tgid [[threadgroup_position_in_grid]]) {\n", f);
+      if (att_kv_len) {
+        fputs("    device const uint *KvLen [[buffer(5)]],\n", f);
+      }
+      fputs("    uint3 tid [[thread_position_in_threadgroup]],\n", f);
+      fputs("    uint3 tgid [[threadgroup_position_in_grid]]) {\n", f);
       fputs("  const uint tile = BWPP_ATT_TILE_M;\n", f);
+      fputs("  uint heads = p.heads ? p.heads : 1;\n", f);
+      fputs("  uint kv_heads = p.kv_heads ? p.kv_heads : heads;\n", f);
+      fputs("  uint group = heads / kv_heads;\n", f);
+      fputs("  uint b = tgid.z / heads;\n", f);
+      fputs("  uint h = tgid.z % heads;\n", f);
+      fputs("  uint kvh = h / group;\n", f);
+      fputs("  device const half *Qh = Q + (b * heads + h) * p.M * p.ldq;\n", f);
+      fputs("  device half *Oh = O + (b * heads + h) * p.M * p.ldo;\n", f);
+      fputs("  uint kv_rows = max(p.kv_rows, p.N);\n", f);
+      fputs("  device const half *Kh = K + (b * kv_heads + kvh) * kv_rows * p.ldk;\n", f);
+      fputs("  device const half *Vh = V + (b * kv_heads + kvh) * kv_rows * p.ldv;\n", f);
+      fputs("  uint n_len = p.N;\n", f);
+      fputs("#if BWPP_ATT_KV_LEN\n", f);
+      fputs("  n_len = min(p.N, KvLen[b]);\n", f);
+      fputs("#endif\n", f);
+      fputs("  bool causal = BWPP_ATT_CAUSAL || p.causal != 0;\n", f);
+      fputs("  int offset = int(n_len) - int(p.M);\n", f);
+      fputs("  uint n_end = n_len;\n", f);
+      fputs("  if (causal) {\n", f);
+      fputs("    // keys past the tile's last visible column are skipped as whole blocks\n", f);
+      fputs("    int lim = int(min(tgid.y * tile + tile, p.M)) + offset;\n", f);
+      fputs("    n_end = lim <= 0 ? 0 : min(n_len, uint(lim));\n", f);
+      fputs("  }\n", f);
       fputs("  uint m = tgid.y * tile + tid.y;\n", f);
       fputs("  uint d = tgid.x * tile + tid.x;\n", f);
       fputs("  if (m >= p.M || d >= p.D) { return; }\n", f);
@@ -478,13 +991,13 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("  float out = 0.0f;\n", f);
       fputs("  uint vd0 = tgid.x * tile + tid.x;\n", f);
       fputs("  uint vn0 = tid.y;\n", f);
-      fputs("  if (vn0 < p.N && vd0 < p.D) {\n", f);
-      fputs("    Vcur[tid.y][tid.x] = V[vn0 * p.ldv + vd0];\n", f);
+      fputs("  if (vn0 < n_end && vd0 < p.D) {\n", f);
+      fputs("    Vcur[tid.y][tid.x] = Vh[vn0 * p.ldv + vd0];\n", f);
       fputs("  } else {\n", f);
       fputs("    Vcur[tid.y][tid.x] = half(0.0f);\n", f);
       fputs("  }\n", f);
       fputs("  threadgroup_barrier(mem_flags::mem_threadgroup);\n", f);
-      fputs("  for (uint n0 = 0; n0 < p.N; n0 += tile) {\n", f);
+      fputs("  for (uint n0 = 0; n0 < n_end; n0 += tile) {\n", f);
         fputs("    if (tid.x == 0) {\n", f);
         fputs("      for (uint i = 0; i < BWPP_ATT_TILE_N; ++i) { Scores[tid.y][i] = 0.0f; }\n", f);
         fputs("    }\n", f);
@@ -492,13 +1005,13 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("    for (uint k0 = 0; k0 < p.K; k0 += tile) {\n", f);
       fputs("      uint qk = k0 + tid.x;\n", f);
       fputs("      if (m < p.M && qk < p.K) {\n", f);
-      fputs("        Qtg[tid.y][tid.x] = Q[m * p.ldq + qk];\n", f);
+      fputs("        Qtg[tid.y][tid.x] = Qh[m * p.ldq + qk];\n", f);
       fputs("      } else {\n", f);
       fputs("        Qtg[tid.y][tid.x] = half(0.0f);\n", f);
       fputs("      }\n", f);
       fputs("      uint nk = n0 + tid.y;\n", f);
-      fputs("      if (nk < p.N && qk < p.K) {\n", f);
-      fputs("        Ktg[tid.y][tid.x] = K[nk * p.ldk + qk];\n", f);
+      fputs("      if (nk < n_end && qk < p.K) {\n", f);
+      fputs("        Ktg[tid.y][tid.x] = Kh[nk * p.ldk + qk];\n", f);
       fputs("      } else {\n", f);
       fputs("        Ktg[tid.y][tid.x] = half(0.0f);\n", f);
       fputs("      }\n", f);
@@ -521,10 +1034,10 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("      threadgroup_barrier(mem_flags::mem_threadgroup);\n", f);
       fputs("    }\n", f);
       fputs("    uint next_n0 = n0 + tile;\n", f);
-      fputs("    if (next_n0 < p.N) {\n", f);
+      fputs("    if (next_n0 < n_end) {\n", f);
       fputs("      uint vn = next_n0 + tid.y;\n", f);
-      fputs("      if (vn < p.N && vd0 < p.D) {\n", f);
-      fputs("        Vnext[tid.y][tid.x] = V[vn * p.ldv + vd0];\n", f);
+      fputs("      if (vn < n_end && vd0 < p.D) {\n", f);
+      fputs("        Vnext[tid.y][tid.x] = Vh[vn * p.ldv + vd0];\n", f);
       fputs("      } else {\n", f);
       fputs("        Vnext[tid.y][tid.x] = half(0.0f);\n", f);
       fputs("      }\n", f);
@@ -533,7 +1046,8 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("    }\n", f);
       fputs("    for (uint n = 0; n < tile; ++n) {\n", f);
       fputs("      uint idx = n0 + n;\n", f);
-      fputs("      if (idx >= p.N) { continue; }\n", f);
+      fputs("      if (idx >= n_end) { continue; }\n", f);
+      fputs("      if (causal && int(idx) > int(m) + offset) { continue; }\n", f);
       fputs("      float score = Scores[tid.y][n];\n", f);
       fputs("      if (score > maxv) {\n", f);
       fputs("        float scale = BWPP_EXP(maxv - score);\n", f);
@@ -552,7 +1066,7 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
       fputs("    Vnext = Vtmp;\n", f);
       fputs("  }\n", f);
       fputs("  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;\n", f);
-      fputs("  O[m * p.ldo + d] = half(out * inv);\n", f);
+      fputs("  Oh[m * p.ldo + d] = half(out * inv);\n", f);
       fputs("}\n", f);
     }
   }
@@ -635,6 +1149,7 @@ BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path) {
     fputs("  }\n", f);
     fputs("}\n", f);
   }
+  bwpp_metal_regions(f, graph, tile != NULL);
   fclose(f);
   bwpp_tile_kernel_destroy(tile);
   return BWPP_OK;
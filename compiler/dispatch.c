@@ -0,0 +1,571 @@
+#include "dispatch.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BWPP_DISPATCH_TILE 16u
+#define BWPP_DISPATCH_ROW_THREADS 64u
+#define BWPP_DISPATCH_ELEM_THREADS 256u
+
+/* 2-D tiles for matmul and attention, one thread per row or output element
+   for the rest; the kernels in codegen_metal.c index the same way. */
+static void bwpp_dispatch_grid(const BwppGraph *g, const BwppFusionRegion *r, BwppDispatch *d) {
+  const BwppGraphNode *anchor = &g->nodes[r->anchor];
+  uint32_t rank = g->values[r->output].shape.rank;
+  const uint32_t *y = g->values[r->output].shape.sizes;
+  uint64_t threads = bwpp_shape_elems(&g->values[r->output].shape);
+  if ((r->kind == BWPP_FUSION_MATMUL || r->kind == BWPP_FUSION_ATTENTION) && rank >= 2) {
+    uint32_t m = y[rank - 2];
+    uint32_t n = y[rank - 1];
+    d->threadgroup[0] = BWPP_DISPATCH_TILE;
+    d->threadgroup[1] = BWPP_DISPATCH_TILE;
+    d->threadgroup[2] = 1;
+    d->grid[0] = (n + BWPP_DISPATCH_TILE - 1) / BWPP_DISPATCH_TILE;
+    d->grid[1] = (m + BWPP_DISPATCH_TILE - 1) / BWPP_DISPATCH_TILE;
+    d->grid[2] = m && n ? (uint32_t)(threads / ((uint64_t)m * n)) : 0;
+    return;
+  }
+  uint32_t per_group = BWPP_DISPATCH_ELEM_THREADS;
+  if (r->kind == BWPP_FUSION_REDUCTION && anchor->input_count) {
+    const BwppShape *xs = &g->values[anchor->inputs[0]].shape;
+    uint64_t elems = bwpp_shape_elems(xs);
+    per_group = BWPP_DISPATCH_ROW_THREADS;
+    switch (anchor->op) {
+      case BWPP_GOP_REDUCE_SUM:
+      case BWPP_GOP_REDUCE_MAX:
+      case BWPP_GOP_REDUCE_MAX_MASK: {
+        uint32_t axis = anchor->attr.has_axis && anchor->attr.axis >= 0 ? (uint32_t)anchor->attr.axis
+                                                                          : (xs->rank ? xs->rank - 1 : 0);
+        uint32_t len = axis < xs->rank ? xs->sizes[axis] : 1;
+        threads = len ? elems / len : 0;
+        break;
+      }
+      case BWPP_GOP_REDUCE_MAX_GRAD:
+        threads = elems;
+        per_group = BWPP_DISPATCH_ELEM_THREADS;
+        break;
+      default: {
+        uint32_t cols = xs->rank ? xs->sizes[xs->rank - 1] : 1;
+        threads = cols ? elems / cols : 0;
+        break;
+      }
+    }
+  }
+  d->threadgroup[0] = per_group;
+  d->threadgroup[1] = 1;
+  d->threadgroup[2] = 1;
+  d->grid[0] = (uint32_t)((threads + per_group - 1) / per_group);
+  d->grid[1] = 1;
+  d->grid[2] = 1;
+}
+
+/* A growable list of words: the signatures of the kernels emitted so far. */
+typedef struct {
+  uint32_t *words;
+  uint32_t count;
+  uint32_t capacity;
+} BwppDispatchWords;
+
+typedef struct {
+  uint32_t hash;
+  uint32_t start; /* signature: words [start, start + len) */
+  uint32_t len;
+  uint32_t first; /* dispatch that named it */
+} BwppDispatchKernel;
+
+static void bwpp_dispatch_word(BwppDispatchWords *w, uint32_t word, int *ok) {
+  if (w->count == w->capacity) {
+    uint32_t new_cap = w->capacity == 0 ? 256 : w->capacity * 2;
+    uint32_t *nw = (uint32_t *)bwpp_xrealloc(w->words, new_cap * sizeof(uint32_t));
+    if (!nw) {
+      *ok = 0;
+      return;
+    }
+    w->words = nw;
+    w->capacity = new_cap;
+  }
+  w->words[w->count++] = word;
+}
+
+static void bwpp_dispatch_shape(BwppDispatchWords *w, const BwppShape *s, int *ok) {
+  bwpp_dispatch_word(w, s->rank, ok);
+  for (uint32_t i = 0; i < s->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    bwpp_dispatch_word(w, s->sizes[i], ok);
+  }
+}
+
+static void bwpp_dispatch_value(BwppDispatchWords *w, const BwppGraphValue *v, int *ok) {
+  bwpp_dispatch_word(w, v->dtype, ok);
+  bwpp_dispatch_word(w, v->layout, ok);
+  bwpp_dispatch_shape(w, &v->shape, ok);
+}
+
+/* Everything the Metal kernel of `d` is generated from, as words: value
+   ids and node ids are replaced by buffer indices and region positions, so
+   two layers of the same block come out equal. */
+static void bwpp_dispatch_signature(BwppDispatchWords *w,
+                                    const BwppGraph *g,
+                                    const BwppFusionRegion *r,
+                                    const BwppDispatch *d,
+                                    int *ok) {
+  bwpp_dispatch_word(w, r->kind, ok);
+  bwpp_dispatch_word(w, r->node_count, ok);
+  bwpp_dispatch_word(w, d->binding_count, ok);
+  for (uint32_t i = 0; i < d->binding_count; ++i) {
+    bwpp_dispatch_value(w, &g->values[d->bindings[i].value], ok);
+  }
+  for (uint32_t k = 0; k < r->node_count; ++k) {
+    const BwppGraphNode *n = &g->nodes[r->nodes[k]];
+    bwpp_dispatch_word(w, r->nodes[k] == r->anchor, ok);
+    bwpp_dispatch_word(w, n->op, ok);
+    bwpp_dispatch_word(w, n->flags, ok);
+    bwpp_dispatch_word(w, n->input_count, ok);
+    for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+      uint32_t ref = UINT32_MAX;
+      for (uint32_t m = 0; m < k; ++m) {
+        if (g->nodes[r->nodes[m]].output == n->inputs[j]) {
+          ref = 0x80000000u | m;
+        }
+      }
+      for (uint32_t b = 0; ref == UINT32_MAX && b < d->binding_count; ++b) {
+        if (d->bindings[b].value == n->inputs[j]) {
+          ref = b;
+        }
+      }
+      bwpp_dispatch_word(w, ref, ok);
+    }
+    bwpp_dispatch_value(w, &g->values[n->output], ok);
+    const BwppGraphAttr *a = &n->attr;
+    uint32_t eps = 0;
+    memcpy(&eps, &a->epsilon, sizeof(eps));
+    bwpp_dispatch_word(w, (uint32_t)a->has_axis, ok);
+    bwpp_dispatch_word(w, (uint32_t)a->axis, ok);
+    bwpp_dispatch_word(w, (uint32_t)a->has_epsilon, ok);
+    bwpp_dispatch_word(w, a->has_epsilon ? eps : 0, ok);
+    bwpp_dispatch_word(w, a->mask, ok);
+    bwpp_dispatch_word(w, a->perm_rank, ok);
+    for (uint32_t i = 0; i < a->perm_rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+      bwpp_dispatch_word(w, a->perm[i], ok);
+    }
+    bwpp_dispatch_shape(w, &a->shape, ok);
+  }
+}
+
+static uint32_t bwpp_dispatch_hash(const uint32_t *words, uint32_t count) {
+  uint32_t h = 2166136261u;
+  for (uint32_t i = 0; i < count; ++i) {
+    h = (h ^ words[i]) * 16777619u;
+  }
+  return h;
+}
+
+static BwppDispatch *bwpp_dispatch_add(BwppDispatchSchedule *s) {
+  if (s->dispatch_count == s->dispatch_capacity) {
+    uint32_t new_cap = s->dispatch_capacity == 0 ? 16 : s->dispatch_capacity * 2;
+    BwppDispatch *nd = (BwppDispatch *)bwpp_xrealloc(s->dispatches, new_cap * sizeof(BwppDispatch));
+    if (!nd) {
+      return NULL;
+    }
+    s->dispatches = nd;
+    s->dispatch_capacity = new_cap;
+  }
+  BwppDispatch *d = &s->dispatches[s->dispatch_count++];
+  memset(d, 0, sizeof(*d));
+  return d;
+}
+
+static int bwpp_dispatch_bind(BwppDispatch *d, uint32_t value, uint64_t offset, uint32_t capacity) {
+  for (uint32_t i = 0; i < d->binding_count; ++i) {
+    if (d->bindings[i].value == value) {
+      return 1;
+    }
+  }
+  if (d->binding_count == capacity) {
+    return 0;
+  }
+  d->bindings[d->binding_count].value = value;
+  d->bindings[d->binding_count].offset = offset;
+  d->binding_count++;
+  return 1;
+}
+
+static int bwpp_dispatch_bound(const BwppGraph *graph) {
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    if (!bwpp_shape_bound(&graph->values[v].shape)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+BwppDispatchSchedule *bwpp_dispatch_schedule_build(const BwppGraph *graph,
+                                                   const BwppFusionPlan *fusion,
+                                                   uint32_t elem_bytes) {
+  if (!graph || !fusion || fusion->node_count != graph->node_count || !bwpp_dispatch_bound(graph)) {
+    return NULL;
+  }
+  BwppMemPlan *plan = bwpp_mem_plan_build_slab_steps(graph, elem_bytes, fusion->node_region);
+  BwppDispatchSchedule *s = (BwppDispatchSchedule *)bwpp_xcalloc(1, sizeof(BwppDispatchSchedule));
+  if (!plan || !s) {
+    bwpp_mem_plan_destroy(plan);
+    free(s);
+    return NULL;
+  }
+  s->slab_bytes = plan->slab_bytes;
+  BwppDispatchWords sigs = {0};
+  BwppDispatchKernel *kernels = (BwppDispatchKernel *)bwpp_xmalloc(sizeof(BwppDispatchKernel) * (fusion->region_count + 1));
+  int ok = kernels != NULL;
+  for (uint32_t r = 0; r < fusion->region_count && ok; ++r) {
+    const BwppFusionRegion *region = &fusion->regions[r];
+    BwppDispatch *d = bwpp_dispatch_add(s);
+    if (!d) {
+      ok = 0;
+      break;
+    }
+    uint32_t capacity = 1;
+    for (uint32_t i = 0; i < region->node_count; ++i) {
+      capacity += graph->nodes[region->nodes[i]].input_count;
+    }
+    d->nodes = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * region->node_count);
+    d->bindings = (BwppDispatchBinding *)bwpp_xmalloc(sizeof(BwppDispatchBinding) * capacity);
+    if (!d->nodes || !d->bindings) {
+      ok = 0;
+      break;
+    }
+    memcpy(d->nodes, region->nodes, sizeof(uint32_t) * region->node_count);
+    d->node_count = region->node_count;
+    for (uint32_t i = 0; i < region->node_count && ok; ++i) {
+      const BwppGraphNode *n = &graph->nodes[region->nodes[i]];
+      for (uint32_t j = 0; j < n->input_count && ok; ++j) {
+        uint32_t v = n->inputs[j];
+        uint32_t p = graph->values[v].producer;
+        if (p < graph->node_count && fusion->node_region[p] == r) {
+          continue;
+        }
+        ok = bwpp_dispatch_bind(d, v, plan->value_offset[v], capacity);
+      }
+    }
+    ok = ok && bwpp_dispatch_bind(d, region->output, plan->value_offset[region->output], capacity);
+    bwpp_dispatch_grid(graph, region, d);
+    if (!ok) {
+      break;
+    }
+    /* the new signature goes at the end; dropped again if a kernel has it */
+    uint32_t start = sigs.count;
+    bwpp_dispatch_signature(&sigs, graph, region, d, &ok);
+    uint32_t len = sigs.count - start;
+    uint32_t hash = bwpp_dispatch_hash(sigs.words + start, len);
+    d->kernel_id = s->kernel_count;
+    for (uint32_t k = 0; ok && k < s->kernel_count; ++k) {
+      if (kernels[k].hash == hash && kernels[k].len == len &&
+          memcmp(sigs.words + kernels[k].start, sigs.words + start, len * sizeof(uint32_t)) == 0) {
+        d->kernel_id = k;
+        break;
+      }
+    }
+    if (d->kernel_id < s->kernel_count) {
+      sigs.count = start;
+      memcpy(d->kernel, s->dispatches[kernels[d->kernel_id].first].kernel, sizeof(d->kernel));
+    } else if (ok) {
+      kernels[s->kernel_count].hash = hash;
+      kernels[s->kernel_count].start = start;
+      kernels[s->kernel_count].len = len;
+      kernels[s->kernel_count].first = r;
+      snprintf(d->kernel, sizeof(d->kernel), "bwpp_k%u_%s", s->kernel_count, bwpp_fusion_kind_name(region->kind));
+      s->kernel_count++;
+    }
+  }
+  free(sigs.words);
+  free(kernels);
+  bwpp_mem_plan_destroy(plan);
+  if (!ok) {
+    bwpp_dispatch_schedule_destroy(s);
+    return NULL;
+  }
+  return s;
+}
+
+void bwpp_dispatch_schedule_write(const BwppDispatchSchedule *sched, FILE *out) {
+  if (!sched || !out) {
+    return;
+  }
+  fprintf(out, "// bwpp.schedule: dispatches=%u kernels=%u slab_bytes=%llu\n", sched->dispatch_count,
+          sched->kernel_count, (unsigned long long)sched->slab_bytes);
+  for (uint32_t i = 0; i < sched->dispatch_count; ++i) {
+    const BwppDispatch *d = &sched->dispatches[i];
+    fprintf(out, "// bwpp.schedule: dispatch=%u kernel=%s nodes=", i, d->kernel);
+    for (uint32_t k = 0; k < d->node_count; ++k) {
+      fprintf(out, "%s%u", k ? "," : "", d->nodes[k]);
+    }
+    fprintf(out, " grid=%u,%u,%u threadgroup=%u,%u,%u buffers=", d->grid[0], d->grid[1], d->grid[2],
+            d->threadgroup[0], d->threadgroup[1], d->threadgroup[2]);
+    for (uint32_t k = 0; k < d->binding_count; ++k) {
+      const BwppDispatchBinding *b = &d->bindings[k];
+      if (b->offset == BWPP_MEM_NO_OFFSET) {
+        fprintf(out, "%sv%u:input", k ? "," : "", b->value);
+      } else {
+        fprintf(out, "%sv%u:slab+%llu", k ? "," : "", b->value, (unsigned long long)b->offset);
+      }
+    }
+    fprintf(out, "\n");
+  }
+}
+
+/* Comma-separated unsigned list after `key=` in `line`; count of items, or
+   UINT32_MAX if the key is missing. */
+static uint32_t bwpp_dispatch_list(const char *line, const char *key, uint32_t *items, uint32_t cap) {
+  const char *p = strstr(line, key);
+  if (!p) {
+    return UINT32_MAX;
+  }
+  p += strlen(key);
+  uint32_t count = 0;
+  for (;;) {
+    char *end = NULL;
+    unsigned long x = strtoul(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    if (items && count < cap) {
+      items[count] = (uint32_t)x;
+    }
+    count++;
+    if (*end != ',') {
+      break;
+    }
+    p = end + 1;
+  }
+  return count;
+}
+
+static int bwpp_dispatch_parse(BwppDispatch *d, const char *line) {
+  const char *k = strstr(line, "kernel=");
+  if (!k) {
+    return 0;
+  }
+  size_t len = strcspn(k + 7, " \n");
+  if (len == 0 || len >= sizeof(d->kernel)) {
+    return 0;
+  }
+  memcpy(d->kernel, k + 7, len);
+  d->kernel[len] = '\0';
+  uint32_t count = bwpp_dispatch_list(line, " nodes=", NULL, 0);
+  if (count == UINT32_MAX || count == 0) {
+    return 0;
+  }
+  d->nodes = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * count);
+  if (!d->nodes) {
+    return 0;
+  }
+  d->node_count = bwpp_dispatch_list(line, " nodes=", d->nodes, count);
+  if (bwpp_dispatch_list(line, " grid=", d->grid, 3) != 3 ||
+      bwpp_dispatch_list(line, " threadgroup=", d->threadgroup, 3) != 3) {
+    return 0;
+  }
+  const char *p = strstr(line, " buffers=");
+  if (!p) {
+    return 0;
+  }
+  p += 9;
+  uint32_t cap = 1;
+  for (const char *c = p; *c && *c != '\n'; ++c) {
+    cap += *c == ',';
+  }
+  d->bindings = (BwppDispatchBinding *)bwpp_xmalloc(sizeof(BwppDispatchBinding) * cap);
+  if (!d->bindings) {
+    return 0;
+  }
+  while (*p == 'v') {
+    char *end = NULL;
+    BwppDispatchBinding *b = &d->bindings[d->binding_count];
+    b->value = (uint32_t)strtoul(p + 1, &end, 10);
+    if (strncmp(end, ":input", 6) == 0) {
+      b->offset = BWPP_MEM_NO_OFFSET;
+      end += 6;
+    } else if (strncmp(end, ":slab+", 6) == 0) {
+      b->offset = strtoull(end + 6, &end, 10);
+    } else {
+      return 0;
+    }
+    d->binding_count++;
+    if (*end != ',' || d->binding_count == cap) {
+      break;
+    }
+    p = end + 1;
+  }
+  return d->binding_count > 0;
+}
+
+BwppDispatchSchedule *bwpp_dispatch_schedule_read(FILE *in) {
+  if (!in) {
+    return NULL;
+  }
+  BwppDispatchSchedule *s = (BwppDispatchSchedule *)bwpp_xcalloc(1, sizeof(BwppDispatchSchedule));
+  if (!s) {
+    return NULL;
+  }
+  static const char tag[] = "// bwpp.schedule: ";
+  char line[8192];
+  int header = 0;
+  while (fgets(line, sizeof(line), in)) {
+    if (strncmp(line, tag, sizeof(tag) - 1) != 0) {
+      continue;
+    }
+    const char *body = line + sizeof(tag) - 1;
+    if (strncmp(body, "dispatches=", 11) == 0) {
+      const char *slab = strstr(body, "slab_bytes=");
+      s->slab_bytes = slab ? strtoull(slab + 11, NULL, 10) : 0;
+      header = 1;
+      continue;
+    }
+    BwppDispatch *d = bwpp_dispatch_add(s);
+    if (!d || !bwpp_dispatch_parse(d, body)) {
+      fprintf(stderr, "schedule: bad line: %s", line);
+      bwpp_dispatch_schedule_destroy(s);
+      return NULL;
+    }
+    /* launches naming the same kernel share its id */
+    d->kernel_id = s->kernel_count;
+    for (uint32_t i = 0; i + 1 < s->dispatch_count; ++i) {
+      if (strcmp(s->dispatches[i].kernel, d->kernel) == 0) {
+        d->kernel_id = s->dispatches[i].kernel_id;
+        break;
+      }
+    }
+    if (d->kernel_id == s->kernel_count) {
+      s->kernel_count++;
+    }
+  }
+  if (!header) {
+    bwpp_dispatch_schedule_destroy(s);
+    return NULL;
+  }
+  return s;
+}
+
+void bwpp_dispatch_schedule_destroy(BwppDispatchSchedule *sched) {
+  if (!sched) {
+    return;
+  }
+  for (uint32_t i = 0; i < sched->dispatch_count; ++i) {
+    free(sched->dispatches[i].nodes);
+    free(sched->dispatches[i].bindings);
+  }
+  free(sched->dispatches);
+  free(sched);
+}
+
+static int bwpp_dispatch_binds(const BwppDispatch *d, uint32_t value) {
+  for (uint32_t i = 0; i < d->binding_count; ++i) {
+    if (d->bindings[i].value == value) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+BwppGraph *bwpp_dispatch_replay_graph(const BwppGraph *graph,
+                                      const BwppDispatchSchedule *sched,
+                                      BwppMemPlan **plan_out) {
+  if (!graph || !sched || !plan_out) {
+    return NULL;
+  }
+  *plan_out = NULL;
+  uint32_t ncount = graph->node_count ? graph->node_count : 1;
+  uint32_t *step = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * ncount);
+  uint32_t *order = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * ncount);
+  BwppMemPlan *plan = bwpp_mem_plan_create(graph->value_count, 1);
+  int ok = step && order && plan;
+  for (uint32_t i = 0; ok && i < graph->node_count; ++i) {
+    step[i] = UINT32_MAX;
+  }
+
+  /* f16 slots hold f32 elements at twice the offset */
+  uint32_t min_bytes = 4;
+  for (uint32_t v = 0; ok && v < graph->value_count; ++v) {
+    uint32_t b = bwpp_dtype_bytes(graph->values[v].dtype);
+    min_bytes = b < min_bytes ? b : min_bytes;
+  }
+  uint64_t scale = 4 / min_bytes;
+  uint32_t placed = 0;
+  for (uint32_t k = 0; ok && k < sched->dispatch_count; ++k) {
+    const BwppDispatch *d = &sched->dispatches[k];
+    for (uint32_t i = 0; i < d->node_count && ok; ++i) {
+      uint32_t node = d->nodes[i];
+      if (node >= graph->node_count || step[node] != UINT32_MAX) {
+        fprintf(stderr, "replay: dispatch %u lists node %u twice or out of range\n", k, node);
+        ok = 0;
+        break;
+      }
+      step[node] = k;
+      order[placed++] = node;
+    }
+    for (uint32_t i = 0; i < d->binding_count && ok; ++i) {
+      const BwppDispatchBinding *b = &d->bindings[i];
+      if (b->value >= graph->value_count) {
+        fprintf(stderr, "replay: dispatch %u binds unknown v%u\n", k, b->value);
+        ok = 0;
+      } else if (b->offset != BWPP_MEM_NO_OFFSET) {
+        uint64_t off = b->offset * scale;
+        if (plan->value_offset[b->value] != BWPP_MEM_NO_OFFSET && plan->value_offset[b->value] != off) {
+          fprintf(stderr, "replay: v%u is bound at two offsets\n", b->value);
+          ok = 0;
+        }
+        plan->value_offset[b->value] = off;
+      }
+    }
+  }
+  if (ok && placed != graph->node_count) {
+    fprintf(stderr, "replay: schedule runs %u of %u nodes\n", placed, graph->node_count);
+    ok = 0;
+  }
+  /* anything a kernel reads from outside itself must be one of its buffers */
+  for (uint32_t k = 0; ok && k < sched->dispatch_count; ++k) {
+    const BwppDispatch *d = &sched->dispatches[k];
+    for (uint32_t i = 0; i < d->node_count && ok; ++i) {
+      const BwppGraphNode *n = &graph->nodes[d->nodes[i]];
+      for (uint32_t j = 0; j < n->input_count && ok; ++j) {
+        uint32_t v = n->inputs[j];
+        uint32_t p = graph->values[v].producer;
+        if (p < graph->node_count && step[p] == k) {
+          continue;
+        }
+        if (p < graph->node_count && step[p] > k) {
+          fprintf(stderr, "replay: dispatch %u reads v%u before it is made\n", k, v);
+          ok = 0;
+        } else if (!bwpp_dispatch_binds(d, v)) {
+          fprintf(stderr, "replay: dispatch %u reads v%u without binding it\n", k, v);
+          ok = 0;
+        }
+      }
+    }
+  }
+  for (uint32_t i = 0; ok && i < graph->output_count; ++i) {
+    uint32_t v = graph->outputs[i];
+    if (v < graph->value_count && graph->values[v].producer < graph->node_count &&
+        plan->value_offset[v] == BWPP_MEM_NO_OFFSET) {
+      fprintf(stderr, "replay: output v%u is never written to the slab\n", v);
+      ok = 0;
+    }
+  }
+  BwppGraph *out = ok ? bwpp_graph_clone(graph) : NULL;
+  if (out) {
+    for (uint32_t k = 0; k < graph->node_count; ++k) {
+      BwppGraphNode node = graph->nodes[order[k]];
+      node.id = k;
+      out->nodes[k] = node;
+      if (node.output < out->value_count) {
+        out->values[node.output].producer = k;
+      }
+    }
+    plan->slab_bytes = sched->slab_bytes * scale;
+    plan->total_bytes = plan->slab_bytes;
+  }
+  free(step);
+  free(order);
+  if (!out) {
+    bwpp_mem_plan_destroy(plan);
+    return NULL;
+  }
+  *plan_out = plan;
+  return out;
+}
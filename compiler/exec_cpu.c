@@ -0,0 +1,681 @@
+#define _POSIX_C_SOURCE 199309L
+#include "exec_cpu.h"
+#include "bwpp_cpu_ref.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BWPP_EXEC_ALIGN 64
+
+static double bwpp_exec_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t bwpp_exec_align(size_t bytes) {
+  return (bytes + BWPP_EXEC_ALIGN - 1) & ~(size_t)(BWPP_EXEC_ALIGN - 1);
+}
+
+static size_t bwpp_exec_shape_elems(const BwppExecShape *s) {
+  size_t n = 1;
+  for (uint32_t i = 0; i < s->rank; ++i) {
+    n *= s->dims[i];
+  }
+  return n;
+}
+
+static int bwpp_exec_resolve(const BwppShape *shape, BwppExecShape *out) {
+  memset(out, 0, sizeof(*out));
+  out->rank = shape->rank;
+  if (!bwpp_shape_bound(shape)) {
+    BwppStr dim = bwpp_shape_unbound_dim(shape);
+    fprintf(stderr, "dim %.*s is not bound (use --dim %.*s=N or @dims)\n",
+            (int)dim.len, dim.ptr, (int)dim.len, dim.ptr);
+    return 0;
+  }
+  for (uint32_t i = 0; i < shape->rank; ++i) {
+    out->dims[i] = shape->sizes[i];
+  }
+  return 1;
+}
+
+/* numpy-style broadcast of a and b; 0 if a dim pair is neither equal nor 1 */
+static int bwpp_exec_broadcast(const BwppExecShape *a, const BwppExecShape *b, BwppExecShape *out) {
+  uint32_t rank = a->rank > b->rank ? a->rank : b->rank;
+  memset(out, 0, sizeof(*out));
+  out->rank = rank;
+  for (uint32_t i = 0; i < rank; ++i) {
+    uint32_t ad = i < a->rank ? a->dims[a->rank - 1 - i] : 1;
+    uint32_t bd = i < b->rank ? b->dims[b->rank - 1 - i] : 1;
+    if (ad != bd && ad != 1 && bd != 1) {
+      return 0;
+    }
+    out->dims[rank - 1 - i] = ad == 1 ? bd : ad;
+  }
+  return 1;
+}
+
+/* Splits shape around `axis` into outer x n x inner. */
+static void bwpp_exec_axis_split(const BwppExecShape *s, uint32_t axis,
+                                 size_t *outer, uint32_t *n, size_t *inner) {
+  *outer = 1;
+  *inner = 1;
+  *n = axis < s->rank ? s->dims[axis] : 1;
+  for (uint32_t i = 0; i < s->rank; ++i) {
+    if (i < axis) {
+      *outer *= s->dims[i];
+    } else if (i > axis) {
+      *inner *= s->dims[i];
+    }
+  }
+}
+
+static uint32_t bwpp_exec_axis(const BwppGraphNode *n, const BwppExecShape *s) {
+  if (n->attr.has_axis && n->attr.axis >= 0) {
+    return (uint32_t)n->attr.axis;
+  }
+  return s->rank ? s->rank - 1 : 0;
+}
+
+static const BwppExecShape *bwpp_exec_in(const BwppCpuExec *exec, const BwppGraphNode *n, uint32_t i) {
+  return &exec->shapes[n->inputs[i]];
+}
+
+/* Matmul operand `i` as it is multiplied: stored transposed under
+   TRANS_A/TRANS_B, so the last two dims swap. */
+static BwppExecShape bwpp_exec_operand(const BwppCpuExec *exec, const BwppGraphNode *n, uint32_t i) {
+  BwppExecShape s = *bwpp_exec_in(exec, n, i);
+  if ((n->flags & (i == 0 ? BWPP_GRAPH_OPF_TRANS_A : BWPP_GRAPH_OPF_TRANS_B)) && s.rank >= 2) {
+    uint32_t tmp = s.dims[s.rank - 2];
+    s.dims[s.rank - 2] = s.dims[s.rank - 1];
+    s.dims[s.rank - 1] = tmp;
+  }
+  return s;
+}
+
+static int bwpp_exec_infer(BwppCpuExec *exec, const BwppGraphNode *n, BwppExecShape *out) {
+  static const uint32_t min_inputs[] = {
+    [BWPP_GOP_MATMUL] = 2, [BWPP_GOP_BATCH_MATMUL] = 2, [BWPP_GOP_TRANSPOSE] = 1,
+    [BWPP_GOP_PERMUTE] = 1, [BWPP_GOP_RESHAPE] = 1, [BWPP_GOP_BROADCAST] = 1,
+    [BWPP_GOP_ADD] = 2, [BWPP_GOP_SUB] = 2, [BWPP_GOP_MUL] = 2, [BWPP_GOP_DIV] = 2,
+    [BWPP_GOP_REDUCE_SUM] = 1, [BWPP_GOP_REDUCE_MAX] = 1, [BWPP_GOP_REDUCE_MAX_MASK] = 1,
+    [BWPP_GOP_REDUCE_MAX_GRAD] = 2, [BWPP_GOP_SOFTMAX] = 1, [BWPP_GOP_RMSNORM] = 2,
+    [BWPP_GOP_SILU] = 1, [BWPP_GOP_SILU_GRAD] = 2, [BWPP_GOP_SOFTMAX_GRAD] = 2,
+    [BWPP_GOP_RMSNORM_GRAD] = 3,
+  };
+  if (n->input_count < min_inputs[n->op]) {
+    return 0;
+  }
+  const BwppExecShape *a = bwpp_exec_in(exec, n, 0);
+  *out = *a;
+  switch (n->op) {
+    case BWPP_GOP_MATMUL:
+    case BWPP_GOP_BATCH_MATMUL: {
+      BwppExecShape a_op = bwpp_exec_operand(exec, n, 0);
+      BwppExecShape b_op = bwpp_exec_operand(exec, n, 1);
+      a = &a_op;
+      const BwppExecShape *b = &b_op;
+      if (a->rank < 2 || b->rank < 2 || a->dims[a->rank - 1] != b->dims[b->rank - 2]) {
+        return 0;
+      }
+      /* leading dims are batch; a smaller one must divide the larger
+         (broadcast, or grouped heads sharing K/V) */
+      const BwppExecShape *big = a->rank >= b->rank ? a : b;
+      *out = *big;
+      for (uint32_t i = 0; i + 2 < big->rank; ++i) {
+        uint32_t off_a = big->rank - a->rank;
+        uint32_t off_b = big->rank - b->rank;
+        uint32_t ad = i >= off_a ? a->dims[i - off_a] : 1;
+        uint32_t bd = i >= off_b ? b->dims[i - off_b] : 1;
+        uint32_t hi = ad > bd ? ad : bd;
+        uint32_t lo = ad > bd ? bd : ad;
+        if (lo == 0 || hi % lo != 0) {
+          return 0;
+        }
+        out->dims[i] = hi;
+      }
+      out->dims[out->rank - 2] = a->dims[a->rank - 2];
+      out->dims[out->rank - 1] = b->dims[b->rank - 1];
+      return 1;
+    }
+    case BWPP_GOP_TRANSPOSE:
+      if (a->rank >= 2) {
+        out->dims[a->rank - 2] = a->dims[a->rank - 1];
+        out->dims[a->rank - 1] = a->dims[a->rank - 2];
+      }
+      return 1;
+    case BWPP_GOP_PERMUTE:
+      if (n->attr.perm_rank != a->rank) {
+        return 0;
+      }
+      for (uint32_t i = 0; i < a->rank; ++i) {
+        if (n->attr.perm[i] >= a->rank) {
+          return 0;
+        }
+        out->dims[i] = a->dims[n->attr.perm[i]];
+      }
+      return 1;
+    case BWPP_GOP_RESHAPE:
+      return bwpp_exec_resolve(&n->attr.shape, out) &&
+             bwpp_exec_shape_elems(out) == bwpp_exec_shape_elems(a);
+    case BWPP_GOP_BROADCAST: {
+      BwppExecShape check;
+      return bwpp_exec_resolve(&n->attr.shape, out) &&
+             bwpp_exec_broadcast(a, out, &check) && check.rank == out->rank &&
+             bwpp_exec_shape_elems(&check) == bwpp_exec_shape_elems(out);
+    }
+    case BWPP_GOP_ADD:
+    case BWPP_GOP_SUB:
+    case BWPP_GOP_MUL:
+    case BWPP_GOP_DIV:
+      return bwpp_exec_broadcast(a, bwpp_exec_in(exec, n, 1), out);
+    case BWPP_GOP_REDUCE_SUM:
+    case BWPP_GOP_REDUCE_MAX: {
+      uint32_t axis = bwpp_exec_axis(n, a);
+      if (a->rank && axis < a->rank) {
+        out->dims[axis] = 1;
+      }
+      return 1;
+    }
+    case BWPP_GOP_SOFTMAX:
+    case BWPP_GOP_SOFTMAX_GRAD:
+      /* rows along the last axis, the only layout the kernels take */
+      return !n->attr.has_axis || a->rank == 0 || (uint32_t)n->attr.axis == a->rank - 1;
+    case BWPP_GOP_RMSNORM:
+      return a->rank > 0 && bwpp_exec_shape_elems(bwpp_exec_in(exec, n, 1)) == a->dims[a->rank - 1];
+    case BWPP_GOP_RMSNORM_GRAD:
+    case BWPP_GOP_REDUCE_MAX_MASK:
+    case BWPP_GOP_REDUCE_MAX_GRAD:
+    case BWPP_GOP_SILU:
+    case BWPP_GOP_SILU_GRAD:
+      return 1;
+  }
+  return 0;
+}
+
+BwppCpuExec *bwpp_exec_cpu_create(const BwppGraph *graph,
+                                  const BwppMemPlan *plan,
+                                  uint32_t threads) {
+  if (!graph || !plan || plan->value_count != graph->value_count) {
+    return NULL;
+  }
+  BwppCpuExec *exec = (BwppCpuExec *)bwpp_xcalloc(1, sizeof(BwppCpuExec));
+  if (!exec) {
+    return NULL;
+  }
+  exec->graph = graph;
+  exec->plan = plan;
+  exec->buffer_count = plan->buffer_count;
+  exec->shapes = (BwppExecShape *)bwpp_xcalloc(graph->value_count ? graph->value_count : 1, sizeof(BwppExecShape));
+  exec->elems = (size_t *)bwpp_xcalloc(graph->value_count ? graph->value_count : 1, sizeof(size_t));
+  exec->data = (float **)bwpp_xcalloc(graph->value_count ? graph->value_count : 1, sizeof(float *));
+  exec->buffers = (float **)bwpp_xcalloc(plan->buffer_count ? plan->buffer_count : 1, sizeof(float *));
+  exec->node_secs = (double *)bwpp_xcalloc(graph->node_count ? graph->node_count : 1, sizeof(double));
+  size_t *buffer_elems = (size_t *)bwpp_xcalloc(plan->buffer_count ? plan->buffer_count : 1, sizeof(size_t));
+  if (!exec->shapes || !exec->elems || !exec->data || !exec->buffers || !exec->node_secs || !buffer_elems) {
+    free(buffer_elems);
+    bwpp_exec_cpu_destroy(exec);
+    return NULL;
+  }
+
+  /* concrete shapes: declared ones for inputs, inferred ones for node outputs */
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    if (graph->values[v].producer == BWPP_GRAPH_NO_NODE &&
+        !bwpp_exec_resolve(&graph->values[v].shape, &exec->shapes[v])) {
+      free(buffer_elems);
+      bwpp_exec_cpu_destroy(exec);
+      return NULL;
+    }
+  }
+  size_t max_out = 1;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    const BwppGraphNode *n = &graph->nodes[i];
+    if (n->output >= graph->value_count ||
+        !bwpp_exec_infer(exec, n, &exec->shapes[n->output])) {
+      fprintf(stderr, "exec: node n%u has inputs the CPU backend cannot run\n", i);
+      free(buffer_elems);
+      bwpp_exec_cpu_destroy(exec);
+      return NULL;
+    }
+    size_t e = bwpp_exec_shape_elems(&exec->shapes[n->output]);
+    max_out = e > max_out ? e : max_out;
+  }
+
+  /* a plan buffer can be shared by values of different shapes; size each for its largest value */
+  size_t total = bwpp_exec_align(sizeof(float) * max_out);
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    exec->elems[v] = bwpp_exec_shape_elems(&exec->shapes[v]);
+    uint32_t buf = plan->value_to_buffer[v];
+    if (buf < plan->buffer_count) {
+      buffer_elems[buf] = exec->elems[v] > buffer_elems[buf] ? exec->elems[v] : buffer_elems[buf];
+    } else if (!plan->value_offset || plan->value_offset[v] == BWPP_MEM_NO_OFFSET) {
+      exec->input_bytes += bwpp_exec_align(sizeof(float) * exec->elems[v]);
+    }
+  }
+  for (uint32_t b = 0; b < plan->buffer_count; ++b) {
+    exec->buffer_bytes += bwpp_exec_align(sizeof(float) * buffer_elems[b]);
+  }
+  if (plan->value_offset) {
+    /* slab plans must be built with 4-byte elements to match */
+    for (uint32_t v = 0; v < graph->value_count; ++v) {
+      uint64_t off = plan->value_offset[v];
+      if (off == BWPP_MEM_NO_OFFSET) {
+        continue;
+      }
+      if (off + sizeof(float) * exec->elems[v] > plan->slab_bytes) {
+        fprintf(stderr, "exec: v%u does not fit its slab slot\n", v);
+        free(buffer_elems);
+        bwpp_exec_cpu_destroy(exec);
+        return NULL;
+      }
+    }
+    exec->buffer_bytes += bwpp_exec_align(plan->slab_bytes);
+  }
+  total += exec->buffer_bytes + exec->input_bytes;
+  if (!bwpp_arena_init(&exec->arena, total)) {
+    fprintf(stderr, "exec: failed to allocate %zu bytes\n", total);
+    free(buffer_elems);
+    bwpp_exec_cpu_destroy(exec);
+    return NULL;
+  }
+  exec->scratch = (float *)bwpp_arena_alloc(&exec->arena, sizeof(float) * max_out, BWPP_EXEC_ALIGN);
+  for (uint32_t b = 0; b < plan->buffer_count; ++b) {
+    exec->buffers[b] = (float *)bwpp_arena_alloc(&exec->arena, sizeof(float) * buffer_elems[b], BWPP_EXEC_ALIGN);
+  }
+  free(buffer_elems);
+  char *slab = plan->value_offset ? (char *)bwpp_arena_alloc(&exec->arena, plan->slab_bytes, BWPP_EXEC_ALIGN) : NULL;
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    uint32_t buf = plan->value_to_buffer[v];
+    if (buf < plan->buffer_count) {
+      exec->data[v] = exec->buffers[buf];
+      continue;
+    }
+    if (slab && plan->value_offset[v] != BWPP_MEM_NO_OFFSET) {
+      exec->data[v] = (float *)(slab + plan->value_offset[v]);
+      continue;
+    }
+    exec->data[v] = (float *)bwpp_arena_alloc(&exec->arena, sizeof(float) * exec->elems[v], BWPP_EXEC_ALIGN);
+    if (graph->values[v].flags & BWPP_GRAPH_VALUE_CONST) {
+      /* literals keep their source text as the value name */
+      BwppStr name = graph->values[v].name;
+      char text[64] = { 0 };
+      memcpy(text, name.ptr ? name.ptr : "0", name.len && name.len < sizeof(text) ? name.len : 1);
+      float c = strtof(text, NULL);
+      for (size_t i = 0; i < exec->elems[v]; ++i) {
+        exec->data[v][i] = c;
+      }
+    }
+  }
+
+  exec->ctx = bwpp_cpu_context_create(threads);
+  if (!exec->ctx) {
+    bwpp_exec_cpu_destroy(exec);
+    return NULL;
+  }
+  return exec;
+}
+
+void bwpp_exec_cpu_destroy(BwppCpuExec *exec) {
+  if (!exec) {
+    return;
+  }
+  bwpp_cpu_context_destroy(exec->ctx);
+  if (exec->arena.buffer) {
+    bwpp_arena_destroy(&exec->arena);
+  }
+  free(exec->shapes);
+  free(exec->elems);
+  free(exec->data);
+  free(exec->buffers);
+  free(exec->node_secs);
+  free(exec);
+}
+
+float *bwpp_exec_cpu_value(BwppCpuExec *exec, uint32_t value, size_t *elems) {
+  if (!exec || value >= exec->graph->value_count) {
+    return NULL;
+  }
+  if (elems) {
+    *elems = exec->elems[value];
+  }
+  return exec->data[value];
+}
+
+/* Element strides of `in` read at the index space of `out` (0 on broadcast dims). */
+static void bwpp_exec_bcast_strides(const BwppExecShape *in, const BwppExecShape *out,
+                                    size_t strides[BWPP_GRAPH_MAX_DIMS]) {
+  size_t stride = 1;
+  for (uint32_t i = out->rank; i > 0; --i) {
+    uint32_t o = i - 1;
+    uint32_t back = out->rank - o;
+    strides[o] = 0;
+    if (back <= in->rank) {
+      uint32_t d = in->dims[in->rank - back];
+      strides[o] = d == 1 ? 0 : stride;
+      stride *= d;
+    }
+  }
+}
+
+/* y = a op b with numpy-style broadcasting of both operands to ys. */
+static void bwpp_exec_binary(const float *a, const BwppExecShape *as,
+                             const float *b, const BwppExecShape *bs,
+                             float *y, const BwppExecShape *ys, BwppGraphOpKind op) {
+  size_t total = bwpp_exec_shape_elems(ys);
+  size_t sa[BWPP_GRAPH_MAX_DIMS];
+  size_t sb[BWPP_GRAPH_MAX_DIMS];
+  bwpp_exec_bcast_strides(as, ys, sa);
+  bwpp_exec_bcast_strides(bs, ys, sb);
+  uint32_t idx[BWPP_GRAPH_MAX_DIMS] = { 0 };
+  size_t ia = 0;
+  size_t ib = 0;
+  for (size_t i = 0; i < total; ++i) {
+    float x = a[ia];
+    float z = b[ib];
+    switch (op) {
+      case BWPP_GOP_SUB: y[i] = x - z; break;
+      case BWPP_GOP_MUL: y[i] = x * z; break;
+      case BWPP_GOP_DIV: y[i] = x / z; break;
+      default: y[i] = x + z; break;
+    }
+    /* odometer step over out dims, last dim fastest */
+    for (uint32_t d = ys->rank; d > 0; --d) {
+      uint32_t k = d - 1;
+      ia += sa[k];
+      ib += sb[k];
+      if (++idx[k] < ys->dims[k]) {
+        break;
+      }
+      ia -= sa[k] * ys->dims[k];
+      ib -= sb[k] * ys->dims[k];
+      idx[k] = 0;
+    }
+  }
+}
+
+static void bwpp_exec_matmul(BwppCpuExec *exec, const BwppGraphNode *n, float *y) {
+  BwppExecShape a_op = bwpp_exec_operand(exec, n, 0);
+  BwppExecShape b_op = bwpp_exec_operand(exec, n, 1);
+  const BwppExecShape *as = &a_op;
+  const BwppExecShape *bs = &b_op;
+  const BwppExecShape *ys = &exec->shapes[n->output];
+  int trans_a = (n->flags & BWPP_GRAPH_OPF_TRANS_A) != 0;
+  int trans_b = (n->flags & BWPP_GRAPH_OPF_TRANS_B) != 0;
+  const float *a = exec->data[n->inputs[0]];
+  const float *b = exec->data[n->inputs[1]];
+  uint32_t M = as->dims[as->rank - 2];
+  uint32_t K = as->dims[as->rank - 1];
+  uint32_t N = bs->dims[bs->rank - 1];
+  size_t batches = bwpp_exec_shape_elems(ys) / ((size_t)M * N);
+  for (size_t t = 0; t < batches; ++t) {
+    /* map the output batch index onto each operand's (possibly smaller) batch dims */
+    size_t rem = t;
+    size_t off_a = 0;
+    size_t off_b = 0;
+    size_t stride_a = 1;
+    size_t stride_b = 1;
+    for (uint32_t i = ys->rank - 2; i > 0; --i) {
+      uint32_t d = i - 1;
+      uint32_t idx = (uint32_t)(rem % ys->dims[d]);
+      rem /= ys->dims[d];
+      uint32_t back = ys->rank - 2 - d;
+      if (back <= as->rank - 2) {
+        uint32_t ad = as->dims[as->rank - 2 - back];
+        off_a += (size_t)(idx / (ys->dims[d] / ad)) * stride_a;
+        stride_a *= ad;
+      }
+      if (back <= bs->rank - 2) {
+        uint32_t bd = bs->dims[bs->rank - 2 - back];
+        off_b += (size_t)(idx / (ys->dims[d] / bd)) * stride_b;
+        stride_b *= bd;
+      }
+    }
+    bwpp_cpu_matmul_trans_ctx_f32(exec->ctx, a + off_a * M * K, b + off_b * K * N, y + t * M * N,
+                                  M, N, K, trans_a ? M : K, trans_b ? K : N, N, trans_a, trans_b, NULL, 0, 0);
+  }
+}
+
+static void bwpp_exec_permute(const float *x, const BwppExecShape *xs, float *y,
+                              const uint32_t *perm, uint32_t rank) {
+  size_t in_strides[BWPP_GRAPH_MAX_DIMS];
+  size_t out_dims[BWPP_GRAPH_MAX_DIMS];
+  size_t s = 1;
+  for (uint32_t i = rank; i > 0; --i) {
+    in_strides[i - 1] = s;
+    s *= xs->dims[i - 1];
+  }
+  for (uint32_t i = 0; i < rank; ++i) {
+    out_dims[i] = xs->dims[perm[i]];
+  }
+  size_t total = s;
+  uint32_t idx[BWPP_GRAPH_MAX_DIMS] = { 0 };
+  size_t src = 0;
+  for (size_t i = 0; i < total; ++i) {
+    y[i] = x[src];
+    for (uint32_t d = rank; d > 0; --d) {
+      uint32_t k = d - 1;
+      src += in_strides[perm[k]];
+      if (++idx[k] < out_dims[k]) {
+        break;
+      }
+      src -= in_strides[perm[k]] * out_dims[k];
+      idx[k] = 0;
+    }
+  }
+}
+
+static void bwpp_exec_softmax(BwppCpuExec *exec, const BwppGraphNode *n, float *y) {
+  const BwppExecShape *xs = bwpp_exec_in(exec, n, 0);
+  const float *x = exec->data[n->inputs[0]];
+  uint32_t cols = xs->rank ? xs->dims[xs->rank - 1] : 1;
+  size_t rows = cols ? exec->elems[n->inputs[0]] / cols : 0;
+  if (n->attr.mask == 0) {
+    bwpp_cpu_softmax_ctx_f32(exec->ctx, x, y, (uint32_t)rows, cols, cols);
+    return;
+  }
+  /* scores are [..., M, N]; key lengths index the leading (batch) dim */
+  uint32_t M = xs->rank >= 2 ? xs->dims[xs->rank - 2] : 1;
+  size_t rows_per_batch = xs->rank >= 3 ? rows / xs->dims[0] : rows;
+  const float *kv_len = NULL;
+  if ((n->attr.mask & BWPP_GRAPH_MASK_KV_LEN) && n->input_count >= 2) {
+    kv_len = exec->data[n->inputs[1]];
+  }
+  for (size_t r = 0; r < rows; ++r) {
+    uint32_t len = cols;
+    if (kv_len && kv_len[r / rows_per_batch] >= 0.0f && kv_len[r / rows_per_batch] < (float)cols) {
+      len = (uint32_t)kv_len[r / rows_per_batch];
+    }
+    int64_t lim = len;
+    if (n->attr.mask & BWPP_GRAPH_MASK_CAUSAL) {
+      int64_t last = (int64_t)(r % M) + (int64_t)len - (int64_t)M + 1;
+      lim = last < 0 ? 0 : (last < lim ? last : lim);
+    }
+    if (lim > 0) {
+      bwpp_cpu_softmax_f32(x + r * cols, y + r * cols, 1, (uint32_t)lim, cols);
+    }
+    for (uint32_t c = (uint32_t)lim; c < cols; ++c) {
+      y[r * cols + c] = 0.0f;
+    }
+  }
+}
+
+static void bwpp_exec_rmsnorm_grad(BwppCpuExec *exec, const BwppGraphNode *n, float *dx) {
+  const BwppExecShape *xs = bwpp_exec_in(exec, n, 0);
+  const float *x = exec->data[n->inputs[0]];
+  const float *g = exec->data[n->inputs[1]];
+  const float *dy = exec->data[n->inputs[2]];
+  float eps = n->attr.has_epsilon ? n->attr.epsilon : 1e-5f;
+  uint32_t cols = xs->rank ? xs->dims[xs->rank - 1] : 1;
+  size_t rows = exec->elems[n->inputs[0]] / cols;
+  for (size_t r = 0; r < rows; ++r) {
+    const float *xr = x + r * cols;
+    const float *dyr = dy + r * cols;
+    float sumsq = 0.0f;
+    float dot = 0.0f;
+    for (uint32_t c = 0; c < cols; ++c) {
+      sumsq += xr[c] * xr[c];
+      dot += g[c] * dyr[c] * xr[c];
+    }
+    float inv = 1.0f / sqrtf(sumsq / (float)cols + eps);
+    /* d/dx of x * inv * g: inv * g * dy - x * inv^3 * dot(g * dy, x) / cols */
+    float k = inv * inv * inv * dot / (float)cols;
+    for (uint32_t c = 0; c < cols; ++c) {
+      dx[r * cols + c] = inv * g[c] * dyr[c] - xr[c] * k;
+    }
+  }
+}
+
+static void bwpp_exec_node(BwppCpuExec *exec, const BwppGraphNode *n, float *y) {
+  const BwppExecShape *xs = bwpp_exec_in(exec, n, 0);
+  const BwppExecShape *ys = &exec->shapes[n->output];
+  const float *x = exec->data[n->inputs[0]];
+  size_t count = exec->elems[n->output];
+  switch (n->op) {
+    case BWPP_GOP_MATMUL:
+    case BWPP_GOP_BATCH_MATMUL:
+      bwpp_exec_matmul(exec, n, y);
+      break;
+    case BWPP_GOP_TRANSPOSE: {
+      uint32_t perm[BWPP_GRAPH_MAX_DIMS] = { 0, 1, 2, 3 };
+      if (xs->rank >= 2) {
+        perm[xs->rank - 2] = xs->rank - 1;
+        perm[xs->rank - 1] = xs->rank - 2;
+      }
+      bwpp_exec_permute(x, xs, y, perm, xs->rank);
+      break;
+    }
+    case BWPP_GOP_PERMUTE:
+      bwpp_exec_permute(x, xs, y, n->attr.perm, xs->rank);
+      break;
+    case BWPP_GOP_RESHAPE:
+      memcpy(y, x, sizeof(float) * count);
+      break;
+    case BWPP_GOP_BROADCAST: {
+      BwppExecShape zero = { 0, { 0 } };
+      float z = 0.0f;
+      bwpp_exec_binary(x, xs, &z, &zero, y, ys, BWPP_GOP_ADD);
+      break;
+    }
+    case BWPP_GOP_ADD:
+    case BWPP_GOP_SUB:
+    case BWPP_GOP_MUL:
+    case BWPP_GOP_DIV:
+      bwpp_exec_binary(x, xs, exec->data[n->inputs[1]], bwpp_exec_in(exec, n, 1), y, ys, n->op);
+      break;
+    case BWPP_GOP_REDUCE_SUM:
+    case BWPP_GOP_REDUCE_MAX: {
+      size_t outer = 1;
+      size_t inner = 1;
+      uint32_t len = 1;
+      bwpp_exec_axis_split(xs, bwpp_exec_axis(n, xs), &outer, &len, &inner);
+      for (size_t o = 0; o < outer; ++o) {
+        for (size_t i = 0; i < inner; ++i) {
+          const float *src = x + o * len * inner + i;
+          float acc = n->op == BWPP_GOP_REDUCE_SUM ? 0.0f : -INFINITY;
+          for (uint32_t k = 0; k < len; ++k) {
+            float v = src[(size_t)k * inner];
+            acc = n->op == BWPP_GOP_REDUCE_SUM ? acc + v : (v > acc ? v : acc);
+          }
+          y[o * inner + i] = acc;
+        }
+      }
+      break;
+    }
+    case BWPP_GOP_REDUCE_MAX_MASK:
+    case BWPP_GOP_REDUCE_MAX_GRAD: {
+      size_t outer = 1;
+      size_t inner = 1;
+      uint32_t len = 1;
+      bwpp_exec_axis_split(xs, bwpp_exec_axis(n, xs), &outer, &len, &inner);
+      const float *dy = n->op == BWPP_GOP_REDUCE_MAX_GRAD ? exec->data[n->inputs[1]] : NULL;
+      if (dy && exec->elems[n->inputs[1]] == count) {
+        /* the autodiff graph broadcasts dy to the input shape first */
+        for (size_t i = 0; i < count; ++i) {
+          y[i] = x[i] * dy[i];
+        }
+        break;
+      }
+      /* each outer slice is a len x inner matrix reduced over axis 0 */
+      for (size_t o = 0; o < outer; ++o) {
+        if (dy) {
+          bwpp_cpu_reduce_max_grad_f32(x + o * len * inner, dy + o * inner, y + o * len * inner,
+                                       len, (uint32_t)inner, 0);
+        } else {
+          bwpp_cpu_reduce_max_mask_f32(x + o * len * inner, y + o * len * inner, len, (uint32_t)inner, 0);
+        }
+      }
+      break;
+    }
+    case BWPP_GOP_SOFTMAX:
+      bwpp_exec_softmax(exec, n, y);
+      break;
+    case BWPP_GOP_RMSNORM: {
+      uint32_t cols = xs->dims[xs->rank - 1];
+      const float *beta = n->input_count >= 3 ? exec->data[n->inputs[2]] : NULL;
+      float eps = n->attr.has_epsilon ? n->attr.epsilon : 1e-5f;
+      bwpp_cpu_rmsnorm_ctx_f32(exec->ctx, x, y, exec->data[n->inputs[1]], beta,
+                               (uint32_t)(count / cols), cols, cols, eps);
+      break;
+    }
+    case BWPP_GOP_SILU:
+      for (size_t i = 0; i < count; ++i) {
+        y[i] = x[i] / (1.0f + expf(-x[i]));
+      }
+      break;
+    case BWPP_GOP_SILU_GRAD: {
+      const float *dy = exec->data[n->inputs[1]];
+      for (size_t i = 0; i < count; ++i) {
+        float s = 1.0f / (1.0f + expf(-x[i]));
+        y[i] = dy[i] * s * (1.0f + x[i] * (1.0f - s));
+      }
+      break;
+    }
+    case BWPP_GOP_SOFTMAX_GRAD: {
+      /* dx = y * (dy - sum(dy * y)) per row */
+      const float *dy = exec->data[n->inputs[1]];
+      uint32_t cols = xs->rank ? xs->dims[xs->rank - 1] : 1;
+      for (size_t r = 0; r < count / cols; ++r) {
+        float dot = 0.0f;
+        for (uint32_t c = 0; c < cols; ++c) {
+          dot += dy[r * cols + c] * x[r * cols + c];
+        }
+        for (uint32_t c = 0; c < cols; ++c) {
+          y[r * cols + c] = x[r * cols + c] * (dy[r * cols + c] - dot);
+        }
+      }
+      break;
+    }
+    case BWPP_GOP_RMSNORM_GRAD:
+      bwpp_exec_rmsnorm_grad(exec, n, y);
+      break;
+  }
+}
+
+BwppStatus bwpp_exec_cpu_run(BwppCpuExec *exec) {
+  if (!exec) {
+    return BWPP_ERR;
+  }
+  const BwppGraph *graph = exec->graph;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    const BwppGraphNode *n = &graph->nodes[i];
+    float *y = exec->data[n->output];
+    /* elementwise ops run in place over a same-sized input; any other
+       overlap goes through scratch so no kernel reads what it already wrote */
+    int alias = 0;
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      uint32_t in = n->inputs[j];
+      alias |= exec->data[in] == y &&
+               !(bwpp_graph_op_inplace(n->op) && exec->elems[in] == exec->elems[n->output]);
+    }
+    double t0 = bwpp_exec_now();
+    bwpp_exec_node(exec, n, alias ? exec->scratch : y);
+    if (alias) {
+      memcpy(y, exec->scratch, sizeof(float) * exec->elems[n->output]);
+    }
+    exec->node_secs[i] = bwpp_exec_now() - t0;
+  }
+  return BWPP_OK;
+}
@@ -0,0 +1,487 @@
+#include "fusion.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const BwppGraph *g;
+  BwppFusionPlan *plan;
+  uint32_t *uses;   /* reading nodes per value; graph outputs count as one more */
+  uint32_t *reader; /* last reading node per value */
+  uint32_t *group;  /* per node: softmax node of its attention pattern, or NO_NODE */
+} BwppFusionCtx;
+
+const char *bwpp_fusion_kind_name(BwppFusionKind kind) {
+  switch (kind) {
+    case BWPP_FUSION_ELEMENTWISE: return "elementwise";
+    case BWPP_FUSION_MATMUL: return "matmul";
+    case BWPP_FUSION_REDUCTION: return "reduction";
+    case BWPP_FUSION_ATTENTION: return "attention";
+    case BWPP_FUSION_LAYOUT: return "layout";
+  }
+  return "unknown";
+}
+
+static BwppFusionKind bwpp_fusion_op_kind(BwppGraphOpKind op) {
+  switch (op) {
+    case BWPP_GOP_MATMUL:
+    case BWPP_GOP_BATCH_MATMUL:
+      return BWPP_FUSION_MATMUL;
+    case BWPP_GOP_TRANSPOSE:
+    case BWPP_GOP_PERMUTE:
+    case BWPP_GOP_RESHAPE:
+    case BWPP_GOP_BROADCAST:
+      return BWPP_FUSION_LAYOUT;
+    case BWPP_GOP_REDUCE_SUM:
+    case BWPP_GOP_REDUCE_MAX:
+    case BWPP_GOP_REDUCE_MAX_MASK:
+    case BWPP_GOP_REDUCE_MAX_GRAD:
+    case BWPP_GOP_SOFTMAX:
+    case BWPP_GOP_RMSNORM:
+    case BWPP_GOP_SOFTMAX_GRAD:
+    case BWPP_GOP_RMSNORM_GRAD:
+      return BWPP_FUSION_REDUCTION;
+    default:
+      return BWPP_FUSION_ELEMENTWISE;
+  }
+}
+
+static int bwpp_fusion_is_matmul(const BwppGraph *g, uint32_t node) {
+  return node < g->node_count &&
+         (g->nodes[node].op == BWPP_GOP_MATMUL || g->nodes[node].op == BWPP_GOP_BATCH_MATMUL) &&
+         g->nodes[node].input_count >= 2;
+}
+
+/* The value may live only in registers: read once, by the next op. */
+static int bwpp_fusion_single_use(const BwppFusionCtx *c, uint32_t v) {
+  return v < c->g->value_count && c->uses[v] == 1;
+}
+
+static int bwpp_fusion_same_shape(const BwppShape *a, const BwppShape *b) {
+  if (bwpp_shape_bound(a) && bwpp_shape_bound(b)) {
+    return bwpp_shape_elems(a) == bwpp_shape_elems(b);
+  }
+  if (a->rank != b->rank) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < a->rank; ++i) {
+    if (a->dims[i].len != b->dims[i].len || memcmp(a->dims[i].ptr, b->dims[i].ptr, a->dims[i].len) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static uint64_t bwpp_fusion_value_bytes(const BwppGraph *g, uint32_t v) {
+  return bwpp_shape_elems(&g->values[v].shape) * bwpp_dtype_bytes(g->values[v].dtype);
+}
+
+static uint32_t bwpp_fusion_new_region(BwppFusionPlan *plan, BwppFusionKind kind, uint32_t anchor) {
+  if (plan->region_count == plan->region_capacity) {
+    uint32_t new_cap = plan->region_capacity == 0 ? 16 : plan->region_capacity * 2;
+    BwppFusionRegion *nr = (BwppFusionRegion *)bwpp_xrealloc(plan->regions, new_cap * sizeof(BwppFusionRegion));
+    if (!nr) {
+      return UINT32_MAX;
+    }
+    plan->regions = nr;
+    plan->region_capacity = new_cap;
+  }
+  BwppFusionRegion *r = &plan->regions[plan->region_count];
+  memset(r, 0, sizeof(*r));
+  r->id = plan->region_count;
+  r->kind = kind;
+  r->anchor = anchor;
+  r->output = BWPP_GRAPH_NO_VALUE;
+  return plan->region_count++;
+}
+
+static int bwpp_fusion_add_node(BwppFusionCtx *c, uint32_t region, uint32_t node) {
+  BwppFusionRegion *r = &c->plan->regions[region];
+  if (r->node_count == r->node_capacity) {
+    uint32_t new_cap = r->node_capacity == 0 ? 4 : r->node_capacity * 2;
+    uint32_t *nn = (uint32_t *)bwpp_xrealloc(r->nodes, new_cap * sizeof(uint32_t));
+    if (!nn) {
+      return 0;
+    }
+    r->nodes = nn;
+    r->node_capacity = new_cap;
+  }
+  r->nodes[r->node_count++] = node;
+  r->output = c->g->nodes[node].output;
+  c->plan->node_region[node] = region;
+  return 1;
+}
+
+/* softmax(q @ [transpose](k)) @ v with the scores and probabilities read only
+   inside the pattern: one kernel keeps them on chip. Keys may also be read
+   transposed in place (TRANS_B). */
+static void bwpp_fusion_find_attention(BwppFusionCtx *c) {
+  const BwppGraph *g = c->g;
+  for (uint32_t s = 0; s < g->node_count; ++s) {
+    const BwppGraphNode *sm = &g->nodes[s];
+    if (sm->op != BWPP_GOP_SOFTMAX || sm->input_count < 1) {
+      continue;
+    }
+    uint32_t scores = sm->inputs[0];
+    if (!bwpp_fusion_single_use(c, scores) || !bwpp_fusion_single_use(c, sm->output)) {
+      continue;
+    }
+    uint32_t mm = g->values[scores].producer;
+    uint32_t mm2 = c->reader[sm->output];
+    if (!bwpp_fusion_is_matmul(g, mm) || !bwpp_fusion_is_matmul(g, mm2) ||
+        g->nodes[mm2].inputs[0] != sm->output || (g->nodes[mm2].flags & BWPP_GRAPH_OPF_TRANS_A) ||
+        c->group[mm] != BWPP_GRAPH_NO_NODE) {
+      continue;
+    }
+    c->group[mm] = s;
+    c->group[s] = s;
+    c->group[mm2] = s;
+    for (uint32_t j = 0; j < 2; ++j) {
+      uint32_t v = g->nodes[mm].inputs[j];
+      uint32_t t = g->values[v].producer;
+      if (bwpp_fusion_single_use(c, v) && t < g->node_count && g->nodes[t].op == BWPP_GOP_TRANSPOSE) {
+        c->group[t] = s;
+      }
+    }
+  }
+}
+
+/* Region of the producer of input `v` of `node` if `node` can extend it. */
+static uint32_t bwpp_fusion_join(const BwppFusionCtx *c, uint32_t node, uint32_t v, int reduction) {
+  const BwppGraph *g = c->g;
+  if (!bwpp_fusion_single_use(c, v) || g->values[v].producer >= g->node_count) {
+    return UINT32_MAX;
+  }
+  uint32_t r = c->plan->node_region[g->values[v].producer];
+  const BwppFusionRegion *region = &c->plan->regions[r];
+  if (region->output != v || region->kind == BWPP_FUSION_LAYOUT) {
+    return UINT32_MAX;
+  }
+  if (reduction) {
+    /* elementwise prologue: the reduction reads the chain's result */
+    return region->kind == BWPP_FUSION_ELEMENTWISE ? r : UINT32_MAX;
+  }
+  return bwpp_fusion_same_shape(&g->values[g->nodes[node].output].shape, &g->values[v].shape) ? r : UINT32_MAX;
+}
+
+static int bwpp_fusion_partition(BwppFusionCtx *c) {
+  const BwppGraph *g = c->g;
+  uint32_t *attention = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * (g->node_count ? g->node_count : 1));
+  if (!attention) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < g->node_count; ++i) {
+    attention[i] = UINT32_MAX;
+  }
+  for (uint32_t i = 0; i < g->node_count; ++i) {
+    const BwppGraphNode *n = &g->nodes[i];
+    uint32_t r = UINT32_MAX;
+    if (c->group[i] != BWPP_GRAPH_NO_NODE) {
+      uint32_t s = c->group[i];
+      if (attention[s] == UINT32_MAX) {
+        attention[s] = bwpp_fusion_new_region(c->plan, BWPP_FUSION_ATTENTION, s);
+      }
+      r = attention[s];
+    } else {
+      BwppFusionKind kind = bwpp_fusion_op_kind(n->op);
+      if (kind == BWPP_FUSION_ELEMENTWISE) {
+        for (uint32_t j = 0; j < n->input_count && r == UINT32_MAX; ++j) {
+          r = bwpp_fusion_join(c, i, n->inputs[j], 0);
+        }
+      } else if (n->op == BWPP_GOP_SOFTMAX || n->op == BWPP_GOP_RMSNORM || n->op == BWPP_GOP_REDUCE_SUM ||
+                 n->op == BWPP_GOP_REDUCE_MAX) {
+        r = n->input_count ? bwpp_fusion_join(c, i, n->inputs[0], 1) : UINT32_MAX;
+        if (r != UINT32_MAX) {
+          c->plan->regions[r].kind = BWPP_FUSION_REDUCTION;
+          c->plan->regions[r].anchor = i;
+        }
+      }
+      if (r == UINT32_MAX) {
+        r = bwpp_fusion_new_region(c->plan, kind, i);
+      }
+    }
+    if (r == UINT32_MAX || !bwpp_fusion_add_node(c, r, i)) {
+      free(attention);
+      return 0;
+    }
+  }
+  free(attention);
+  return 1;
+}
+
+static int bwpp_fusion_by_last_node(const void *pa, const void *pb) {
+  const BwppFusionRegion *a = (const BwppFusionRegion *)pa;
+  const BwppFusionRegion *b = (const BwppFusionRegion *)pb;
+  uint32_t la = a->nodes[a->node_count - 1];
+  uint32_t lb = b->nodes[b->node_count - 1];
+  return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static BwppTileEpilogue bwpp_fusion_epilogue(BwppGraphOpKind op) {
+  switch (op) {
+    case BWPP_GOP_ADD: return BWPP_TILE_EPILOGUE_ADD;
+    case BWPP_GOP_SUB: return BWPP_TILE_EPILOGUE_SUB;
+    case BWPP_GOP_MUL: return BWPP_TILE_EPILOGUE_MUL;
+    case BWPP_GOP_DIV: return BWPP_TILE_EPILOGUE_DIV;
+    case BWPP_GOP_SILU: return BWPP_TILE_EPILOGUE_SILU;
+    case BWPP_GOP_SILU_GRAD: return BWPP_TILE_EPILOGUE_SILU_GRAD;
+    default: return BWPP_TILE_EPILOGUE_NONE;
+  }
+}
+
+static BwppTileOp bwpp_fusion_tile_op(BwppTileOpKind kind, BwppTileMemory src, BwppTileMemory dst,
+                                      BwppTileRole role, uint32_t node) {
+  BwppTileOp op;
+  memset(&op, 0, sizeof(op));
+  op.kind = kind;
+  op.tile.m = 16;
+  op.tile.n = 16;
+  op.tile.k = 16;
+  op.src_mem = src;
+  op.dst_mem = dst;
+  op.a_mem = src;
+  op.b_mem = src;
+  op.c_mem = dst;
+  op.role = role;
+  op.epilogue = BWPP_TILE_EPILOGUE_NONE;
+  op.node = node;
+  return op;
+}
+
+/* load -> the region's ops in graph order -> store; matmuls load their B
+   operand first, and a transpose feeding attention folds into that load. */
+static BwppTileKernel *bwpp_fusion_lower(const BwppGraph *g, const BwppFusionRegion *r) {
+  BwppTileKernel *kernel = bwpp_tile_kernel_create();
+  if (!kernel) {
+    return NULL;
+  }
+  kernel->block.m = 128;
+  kernel->block.n = 128;
+  kernel->block.k = 32;
+  BwppTileOp load = bwpp_fusion_tile_op(BWPP_TILE_OP_LOAD, BWPP_TILE_MEM_GLOBAL, BWPP_TILE_MEM_THREADGROUP,
+                                        BWPP_TILE_ROLE_A, BWPP_GRAPH_NO_NODE);
+  BwppStatus status = bwpp_tile_kernel_add_op(kernel, &load);
+  for (uint32_t i = 0; i < r->node_count && status == BWPP_OK; ++i) {
+    uint32_t node = r->nodes[i];
+    const BwppGraphNode *n = &g->nodes[node];
+    BwppTileOp op;
+    switch (bwpp_fusion_op_kind(n->op)) {
+      case BWPP_FUSION_MATMUL:
+        op = bwpp_fusion_tile_op(BWPP_TILE_OP_LOAD, BWPP_TILE_MEM_GLOBAL, BWPP_TILE_MEM_THREADGROUP,
+                                 BWPP_TILE_ROLE_B, BWPP_GRAPH_NO_NODE);
+        status = bwpp_tile_kernel_add_op(kernel, &op);
+        op = bwpp_fusion_tile_op(BWPP_TILE_OP_MATMUL, BWPP_TILE_MEM_THREADGROUP, BWPP_TILE_MEM_REGISTER,
+                                 BWPP_TILE_ROLE_C, node);
+        break;
+      case BWPP_FUSION_LAYOUT:
+        if (r->kind == BWPP_FUSION_ATTENTION) {
+          continue;
+        }
+        op = bwpp_fusion_tile_op(BWPP_TILE_OP_LAYOUT, BWPP_TILE_MEM_THREADGROUP, BWPP_TILE_MEM_REGISTER,
+                                 BWPP_TILE_ROLE_C, node);
+        break;
+      case BWPP_FUSION_REDUCTION:
+        op = bwpp_fusion_tile_op(n->op == BWPP_GOP_SOFTMAX ? BWPP_TILE_OP_SOFTMAX : BWPP_TILE_OP_REDUCE,
+                                 BWPP_TILE_MEM_THREADGROUP, BWPP_TILE_MEM_REGISTER, BWPP_TILE_ROLE_C, node);
+        break;
+      default:
+        op = bwpp_fusion_tile_op(BWPP_TILE_OP_ELEMENTWISE, BWPP_TILE_MEM_REGISTER, BWPP_TILE_MEM_REGISTER,
+                                 BWPP_TILE_ROLE_C, node);
+        op.epilogue = bwpp_fusion_epilogue(n->op);
+        break;
+    }
+    if (status == BWPP_OK) {
+      status = bwpp_tile_kernel_add_op(kernel, &op);
+    }
+  }
+  BwppTileOp store = bwpp_fusion_tile_op(BWPP_TILE_OP_STORE, BWPP_TILE_MEM_REGISTER, BWPP_TILE_MEM_GLOBAL,
+                                         BWPP_TILE_ROLE_C, BWPP_GRAPH_NO_NODE);
+  if (status == BWPP_OK) {
+    status = bwpp_tile_kernel_add_op(kernel, &store);
+  }
+  if (status != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+  const BwppGraphNode *anchor = &g->nodes[r->anchor];
+  if (r->kind == BWPP_FUSION_ATTENTION) {
+    /* q @ k^T gives the attention problem: m/n query/key rows, k head dim */
+    bwpp_tile_bind_node(kernel, g, g->values[anchor->inputs[0]].producer, BWPP_GRAPH_NO_VALUE);
+  } else if (r->kind == BWPP_FUSION_REDUCTION && anchor->input_count) {
+    bwpp_tile_bind_node(kernel, g, r->anchor, anchor->inputs[0]);
+  } else {
+    bwpp_tile_bind_node(kernel, g, r->anchor, r->output);
+  }
+  return kernel;
+}
+
+static int bwpp_fusion_contains(const uint32_t *nodes, uint32_t count, uint32_t node) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (nodes[i] == node) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Bytes read and written: every distinct outside input plus the output of
+   each kernel. 0 if any dim is unbound. */
+static uint64_t bwpp_fusion_traffic(const BwppGraph *g, const uint32_t *nodes, uint32_t count, uint32_t output) {
+  uint64_t bytes = bwpp_fusion_value_bytes(g, output);
+  if (!bytes) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    const BwppGraphNode *n = &g->nodes[nodes[i]];
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      uint32_t v = n->inputs[j];
+      if (v >= g->value_count || bwpp_fusion_contains(nodes, count, g->values[v].producer)) {
+        continue;
+      }
+      int dup = 0;
+      for (uint32_t k = 0; k <= i && !dup; ++k) {
+        const BwppGraphNode *m = &g->nodes[nodes[k]];
+        for (uint32_t l = 0; l < (k == i ? j : m->input_count); ++l) {
+          dup |= m->inputs[l] == v;
+        }
+      }
+      if (dup) {
+        continue;
+      }
+      uint64_t b = bwpp_fusion_value_bytes(g, v);
+      if (!b) {
+        return 0;
+      }
+      bytes += b;
+    }
+  }
+  return bytes;
+}
+
+BwppFusionPlan *bwpp_fusion_plan_build(const BwppGraph *graph) {
+  if (!graph) {
+    return NULL;
+  }
+  BwppFusionPlan *plan = (BwppFusionPlan *)bwpp_xcalloc(1, sizeof(BwppFusionPlan));
+  uint32_t vcount = graph->value_count ? graph->value_count : 1;
+  uint32_t ncount = graph->node_count ? graph->node_count : 1;
+  BwppFusionCtx c = {0};
+  c.g = graph;
+  c.plan = plan;
+  c.uses = (uint32_t *)bwpp_xcalloc(vcount, sizeof(uint32_t));
+  c.reader = (uint32_t *)bwpp_xcalloc(vcount, sizeof(uint32_t));
+  c.group = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * ncount);
+  if (plan) {
+    plan->node_region = (uint32_t *)bwpp_xcalloc(ncount, sizeof(uint32_t));
+    plan->node_count = graph->node_count;
+  }
+  int ok = plan && plan->node_region && c.uses && c.reader && c.group;
+  if (ok) {
+    for (uint32_t i = 0; i < graph->node_count; ++i) {
+      const BwppGraphNode *n = &graph->nodes[i];
+      for (uint32_t j = 0; j < n->input_count; ++j) {
+        uint32_t v = n->inputs[j];
+        int dup = 0;
+        for (uint32_t k = 0; k < j; ++k) {
+          dup |= n->inputs[k] == v;
+        }
+        if (v < graph->value_count && !dup) {
+          c.uses[v]++;
+          c.reader[v] = i;
+        }
+      }
+      c.group[i] = BWPP_GRAPH_NO_NODE;
+    }
+    for (uint32_t v = 0; v < graph->value_count; ++v) {
+      if (graph->values[v].flags & BWPP_GRAPH_VALUE_OUTPUT) {
+        c.uses[v]++;
+      }
+    }
+    for (uint32_t k = 0; k < graph->output_count; ++k) {
+      if (graph->outputs[k] < graph->value_count && !(graph->values[graph->outputs[k]].flags & BWPP_GRAPH_VALUE_OUTPUT)) {
+        c.uses[graph->outputs[k]]++;
+      }
+    }
+    bwpp_fusion_find_attention(&c);
+    ok = bwpp_fusion_partition(&c);
+  }
+  free(c.uses);
+  free(c.reader);
+  free(c.group);
+  if (!ok) {
+    bwpp_fusion_plan_destroy(plan);
+    return NULL;
+  }
+
+  qsort(plan->regions, plan->region_count, sizeof(BwppFusionRegion), bwpp_fusion_by_last_node);
+  int bound = 1;
+  for (uint32_t r = 0; r < plan->region_count; ++r) {
+    BwppFusionRegion *region = &plan->regions[r];
+    region->id = r;
+    for (uint32_t i = 0; i < region->node_count; ++i) {
+      plan->node_region[region->nodes[i]] = r;
+    }
+    region->kernel = bwpp_fusion_lower(graph, region);
+    if (!region->kernel) {
+      bwpp_fusion_plan_destroy(plan);
+      return NULL;
+    }
+    uint64_t bytes = bwpp_fusion_traffic(graph, region->nodes, region->node_count, region->output);
+    bound &= bytes != 0;
+    plan->traffic_bytes += bytes;
+  }
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    uint64_t bytes = bwpp_fusion_traffic(graph, &i, 1, graph->nodes[i].output);
+    bound &= bytes != 0;
+    plan->unfused_traffic_bytes += bytes;
+  }
+  if (!bound) {
+    plan->traffic_bytes = 0;
+    plan->unfused_traffic_bytes = 0;
+  }
+  return plan;
+}
+
+void bwpp_fusion_plan_dump(const BwppFusionPlan *plan, const BwppGraph *graph, FILE *out) {
+  if (!plan || !graph || !out) {
+    return;
+  }
+  fprintf(out, "kernels=%u unfused_kernels=%u", plan->region_count, plan->node_count);
+  if (plan->traffic_bytes) {
+    fprintf(out, " traffic_bytes=%llu unfused_traffic_bytes=%llu", (unsigned long long)plan->traffic_bytes,
+            (unsigned long long)plan->unfused_traffic_bytes);
+  }
+  fprintf(out, "\n");
+  for (uint32_t r = 0; r < plan->region_count; ++r) {
+    const BwppFusionRegion *region = &plan->regions[r];
+    fprintf(out, "region%u %s nodes=", r, bwpp_fusion_kind_name(region->kind));
+    for (uint32_t i = 0; i < region->node_count; ++i) {
+      fprintf(out, "%s%u", i ? "," : "", region->nodes[i]);
+    }
+    fprintf(out, " out=v%u ops=", region->output);
+    const BwppTileKernel *k = region->kernel;
+    for (uint32_t i = 0; i < k->op_count; ++i) {
+      fprintf(out, "%s%s", i ? "," : "", bwpp_tile_op_name(k->ops[i].kind));
+      BwppTileOpKind kind = k->ops[i].kind;
+      if (kind == BWPP_TILE_OP_ELEMENTWISE || kind == BWPP_TILE_OP_REDUCE || kind == BWPP_TILE_OP_LAYOUT) {
+        fprintf(out, ":%s", bwpp_graph_op_name(graph->nodes[k->ops[i].node].op));
+      }
+    }
+    if (k->problem.m) {
+      fprintf(out, " problem=%u,%u,%u,%u", k->problem.batch, k->problem.m, k->problem.n, k->problem.k);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+void bwpp_fusion_plan_destroy(BwppFusionPlan *plan) {
+  if (!plan) {
+    return;
+  }
+  for (uint32_t r = 0; r < plan->region_count; ++r) {
+    free(plan->regions[r].nodes);
+    bwpp_tile_kernel_destroy(plan->regions[r].kernel);
+  }
+  free(plan->regions);
+  free(plan->node_region);
+  free(plan);
+}
@@ -1,81 +1,63 @@
 #include "graph_ir.h"
-#include "lexer.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* What a binding replaced, so leaving a scope can put it back. */
 typedef struct {
-  BwppLexer lx;
-  BwppToken lookahead;
-  int has_lookahead;
-} BwppGraphParser;
-
-typedef struct {
-  BwppStr name;
-  uint32_t value_id;
+  uint32_t sym;
+  uint32_t prev;
+  uint32_t prev_at;
 } BwppBinding;
 
+/* The nodes, values and regions one inlined call appended: the ranges
+   [*_start, *_end) of the graph itself. A later call of the same fn whose
+   arguments match `args` (dtype, layout, shape, aliasing, `bias` naming)
+   clones the ranges instead of lowering the body again. Not reusable once
+   the body read a caller binding or renamed a value it did not make. */
+typedef struct {
+  uint32_t fn;
+  uint32_t next;  /* older template of the same fn */
+  uint32_t outer; /* template being recorded around this one */
+  BwppGraphValue *args; /* the arguments as they were when recorded */
+  uint32_t arg_count;
+  uint32_t region; /* inherited region, BWPP_GRAPH_NO_REGION if none */
+  uint32_t binding_mark;
+  uint32_t value_start, value_end;
+  uint32_t node_start, node_end;
+  uint32_t region_start, region_end;
+  uint32_t ret;
+  BwppStr ret_name;
+  uint32_t ret_flags;
+  uint32_t *inputs; /* syms the body bound as implicit inputs; must be unbound to reuse */
+  uint32_t input_count;
+  uint32_t input_capacity;
+  int reusable;
+} BwppFnTemplate;
+
+enum { BWPP_NO_TEMPLATE = 0xffffffffu };
+
+/* Bindings are keyed by interned name: value_of_sym holds the innermost
+   binding of every symbol and `bindings` is the undo log a scope unwinds
+   to its mark, so a lookup is one load instead of a scan. */
 typedef struct {
+  uint32_t *value_of_sym; /* module->symbols.count entries */
   BwppBinding *bindings;
   uint32_t binding_count;
   uint32_t binding_capacity;
+  uint32_t *bound_at;     /* per symbol: log index of its innermost binding */
+  uint8_t *inlining; /* per module->fns entry: 1 while its body is being lowered */
+  BwppFnTemplate *templates;
+  uint32_t template_count;
+  uint32_t template_capacity;
+  uint32_t *template_of_fn; /* per module->fns entry: newest template, BWPP_NO_TEMPLATE if none */
+  uint32_t recording;       /* innermost template being recorded */
+  BwppChunkArena arena;     /* every table above; the graph has an arena of its own */
   BwppGraph *graph;
+  const BwppAstModule *module;
 } BwppGraphBuilder;
 
-typedef struct {
-  BwppStr *names;
-  uint32_t count;
-  uint32_t capacity;
-} BwppParamList;
-
-typedef struct {
-  BwppStr name;
-  BwppStr body;
-  const char *sig_start;
-  BwppStr *params;
-  uint32_t param_count;
-} BwppFnDef;
-
-typedef struct {
-  BwppFnDef *items;
-  uint32_t count;
-  uint32_t capacity;
-} BwppFnTable;
-
-typedef struct {
-  BwppStr *items;
-  uint32_t count;
-  uint32_t capacity;
-} BwppFnStack;
-
-static BwppToken bwpp_graph_next(BwppGraphParser *p) {
-  if (p->has_lookahead) {
-    p->has_lookahead = 0;
-    return p->lookahead;
-  }
-  return bwpp_lexer_next(&p->lx);
-}
-
-static void bwpp_graph_unread(BwppGraphParser *p, BwppToken tok) {
-  p->lookahead = tok;
-  p->has_lookahead = 1;
-}
-
-static BwppStr bwpp_tok_str(const BwppToken *tok) {
-  BwppStr out = { tok->lexeme, tok->length };
-  return out;
-}
-
-static int bwpp_str_eq(BwppStr s, const char *lit) {
-  size_t len = strlen(lit);
-  return s.len == len && strncmp(s.ptr, lit, len) == 0;
-}
-
-static int bwpp_str_eq_str(BwppStr a, BwppStr b) {
-  return a.len == b.len && strncmp(a.ptr, b.ptr, a.len) == 0;
-}
-
 static int bwpp_str_is_number(BwppStr s) {
   if (s.len == 0) {
     return 0;
@@ -104,7 +86,7 @@ static int bwpp_str_to_f32(BwppStr s, float *out) {
   if (s.len == 0) {
     return 0;
   }
-  char *tmp = (char *)malloc(s.len + 1);
+  char *tmp = (char *)bwpp_xmalloc(s.len + 1);
   if (!tmp) {
     return 0;
   }
@@ -120,116 +102,6 @@ static int bwpp_str_to_f32(BwppStr s, float *out) {
   return ok;
 }
 
-static int bwpp_param_list_add(BwppParamList *list, BwppStr name) {
-  if (!list) {
-    return 1;
-  }
-  if (list->count == list->capacity) {
-    uint32_t next = list->capacity == 0 ? 8 : list->capacity * 2;
-    BwppStr *names = (BwppStr *)realloc(list->names, next * sizeof(BwppStr));
-    if (!names) {
-      return 0;
-    }
-    list->names = names;
-    list->capacity = next;
-  }
-  list->names[list->count++] = name;
-  return 1;
-}
-
-static void bwpp_param_list_free(BwppParamList *list) {
-  if (!list) {
-    return;
-  }
-  free(list->names);
-  list->names = NULL;
-  list->count = 0;
-  list->capacity = 0;
-}
-
-static int bwpp_fn_table_add(BwppFnTable *table, BwppFnDef def) {
-  if (!table) {
-    return 0;
-  }
-  if (table->count == table->capacity) {
-    uint32_t next = table->capacity == 0 ? 8 : table->capacity * 2;
-    BwppFnDef *items = (BwppFnDef *)realloc(table->items, next * sizeof(BwppFnDef));
-    if (!items) {
-      return 0;
-    }
-    table->items = items;
-    table->capacity = next;
-  }
-  table->items[table->count++] = def;
-  return 1;
-}
-
-static void bwpp_fn_table_destroy(BwppFnTable *table) {
-  if (!table) {
-    return;
-  }
-  for (uint32_t i = 0; i < table->count; ++i) {
-    free(table->items[i].params);
-  }
-  free(table->items);
-  table->items = NULL;
-  table->count = 0;
-  table->capacity = 0;
-}
-
-static BwppFnDef *bwpp_fn_table_find(BwppFnTable *table, BwppStr name) {
-  if (!table) {
-    return NULL;
-  }
-  for (uint32_t i = 0; i < table->count; ++i) {
-    if (bwpp_str_eq_str(table->items[i].name, name)) {
-      return &table->items[i];
-    }
-  }
-  return NULL;
-}
-
-static int bwpp_fn_stack_push(BwppFnStack *stack, BwppStr name) {
-  if (!stack) {
-    return 0;
-  }
-  if (stack->count == stack->capacity) {
-    uint32_t next = stack->capacity == 0 ? 8 : stack->capacity * 2;
-    BwppStr *items = (BwppStr *)realloc(stack->items, next * sizeof(BwppStr));
-    if (!items) {
-      return 0;
-    }
-    stack->items = items;
-    stack->capacity = next;
-  }
-  stack->items[stack->count++] = name;
-  return 1;
-}
-
-static void bwpp_fn_stack_pop(BwppFnStack *stack) {
-  if (!stack || stack->count == 0) {
-    return;
-  }
-  stack->count--;
-}
-
-static int bwpp_fn_stack_contains(const BwppFnStack *stack, BwppStr name) {
-  if (!stack) {
-    return 0;
-  }
-  for (uint32_t i = 0; i < stack->count; ++i) {
-    if (bwpp_str_eq_str(stack->items[i], name)) {
-      return 1;
-    }
-  }
-  return 0;
-}
-
-static int bwpp_tok_is(const BwppToken *tok, const char *lit) {
-  size_t len = strlen(lit);
-  return tok->kind == BWPP_TOK_IDENT && tok->length == len && strncmp(tok->lexeme, lit, len) == 0;
-}
-
 static BwppDType bwpp_parse_dtype(BwppStr s) {
   if (bwpp_str_eq(s, "f16")) {
     return BWPP_DTYPE_F16;
@@ -240,6 +112,9 @@ static BwppDType bwpp_parse_dtype(BwppStr s) {
   if (bwpp_str_eq(s, "f32")) {
     return BWPP_DTYPE_F32;
   }
+  if (bwpp_str_eq(s, "u32")) {
+    return BWPP_DTYPE_U32;
+  }
   return BWPP_DTYPE_UNKNOWN;
 }
 
@@ -253,37 +128,11 @@ static BwppLayout bwpp_parse_layout(BwppStr s) {
   return BWPP_LAYOUT_UNKNOWN;
 }
 
-static int bwpp_parse_shape_list(BwppGraphParser *p, BwppShape *shape) {
-  BwppToken tok = bwpp_graph_next(p);
-  if (!(tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '[')) {
-    return 0;
-  }
-  shape->rank = 0;
-  for (;;) {
-    BwppToken t = bwpp_graph_next(p);
-    if (t.kind == BWPP_TOK_EOF) {
-      return 0;
-    }
-    if (t.kind == BWPP_TOK_SYMBOL && t.length == 1) {
-      if (t.lexeme[0] == ']') {
-        break;
-      }
-      if (t.lexeme[0] == ',') {
-        continue;
-      }
-    }
-    if (shape->rank < BWPP_GRAPH_MAX_DIMS &&
-        (t.kind == BWPP_TOK_IDENT || t.kind == BWPP_TOK_NUMBER)) {
-      shape->dims[shape->rank++] = bwpp_tok_str(&t);
-    }
-  }
-  return 1;
-}
-
 static void bwpp_shape_copy(BwppShape *dst, const BwppShape *src) {
   dst->rank = src->rank;
   for (uint32_t i = 0; i < src->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
     dst->dims[i] = src->dims[i];
+    dst->sizes[i] = src->sizes[i];
   }
 }
 
@@ -330,15 +179,63 @@ static int bwpp_shape_rank(const BwppShape *shape) {
   return (int)shape->rank;
 }
 
+/* Swaps the two innermost dims; leading (batch) dims pass through. */
+static BwppShape bwpp_shape_transpose(const BwppShape *shape) {
+  BwppShape out = *shape;
+  if (out.rank >= 2) {
+    BwppStr tmp = out.dims[out.rank - 2];
+    out.dims[out.rank - 2] = out.dims[out.rank - 1];
+    out.dims[out.rank - 1] = tmp;
+  }
+  return out;
+}
+
+/* [..., M, K] @ [..., K, N] -> [..., M, N]. Batch dims come from the
+   higher-rank operand (the lhs on a tie, so GQA keeps the Q head count). */
+static BwppShape bwpp_shape_matmul(const BwppShape *a, const BwppShape *b) {
+  BwppShape out = {0};
+  if (a->rank < 2 || b->rank < 2) {
+    return out;
+  }
+  const BwppShape *lead = b->rank > a->rank ? b : a;
+  bwpp_shape_copy(&out, lead);
+  out.dims[out.rank - 2] = a->dims[a->rank - 2];
+  out.dims[out.rank - 1] = b->dims[b->rank - 1];
+  return out;
+}
+
+BwppGraph *bwpp_graph_create(void) {
+  BwppChunkArena arena;
+  bwpp_chunk_arena_init(&arena, 64 * 1024);
+  BwppGraph *graph = (BwppGraph *)bwpp_chunk_arena_alloc(&arena, sizeof(BwppGraph), _Alignof(BwppGraph));
+  if (!graph) {
+    bwpp_chunk_arena_destroy(&arena);
+    return NULL;
+  }
+  memset(graph, 0, sizeof(*graph));
+  graph->arena = arena;
+  return graph;
+}
+
+int bwpp_graph_reserve(BwppGraph *graph, void **items, uint32_t count, uint32_t *capacity, size_t size,
+                       size_t align) {
+  if (count < *capacity) {
+    return 1;
+  }
+  uint32_t next = *capacity ? *capacity * 2u : 16u;
+  void *grown = bwpp_chunk_arena_grow(&graph->arena, *items, *capacity * size, next * size, align);
+  if (!grown) {
+    return 0;
+  }
+  *items = grown;
+  *capacity = next;
+  return 1;
+}
+
 static uint32_t bwpp_graph_add_value(BwppGraph *g, BwppGraphValue v) {
-  if (g->value_count == g->value_capacity) {
-    uint32_t new_cap = g->value_capacity == 0 ? 16 : g->value_capacity * 2;
-    BwppGraphValue *nv = (BwppGraphValue *)realloc(g->values, new_cap * sizeof(BwppGraphValue));
-    if (!nv) {
-      return BWPP_GRAPH_NO_VALUE;
-    }
-    g->values = nv;
-    g->value_capacity = new_cap;
+  if (!bwpp_graph_reserve(g, (void **)&g->values, g->value_count, &g->value_capacity, sizeof(BwppGraphValue),
+                          _Alignof(BwppGraphValue))) {
+    return BWPP_GRAPH_NO_VALUE;
   }
   v.id = g->value_count;
   g->values[g->value_count++] = v;
@@ -346,14 +243,9 @@ static uint32_t bwpp_graph_add_value(BwppGraph *g, BwppGraphValue v) {
 }
 
 static uint32_t bwpp_graph_add_node(BwppGraph *g, BwppGraphNode n) {
-  if (g->node_count == g->node_capacity) {
-    uint32_t new_cap = g->node_capacity == 0 ? 16 : g->node_capacity * 2;
-    BwppGraphNode *nn = (BwppGraphNode *)realloc(g->nodes, new_cap * sizeof(BwppGraphNode));
-    if (!nn) {
-      return BWPP_GRAPH_NO_NODE;
-    }
-    g->nodes = nn;
-    g->node_capacity = new_cap;
+  if (!bwpp_graph_reserve(g, (void **)&g->nodes, g->node_count, &g->node_capacity, sizeof(BwppGraphNode),
+                          _Alignof(BwppGraphNode))) {
+    return BWPP_GRAPH_NO_NODE;
   }
   n.id = g->node_count;
   g->nodes[g->node_count++] = n;
@@ -361,46 +253,89 @@ static uint32_t bwpp_graph_add_node(BwppGraph *g, BwppGraphNode n) {
 }
 
 static void bwpp_graph_add_output(BwppGraph *g, uint32_t value_id) {
-  if (g->output_count == g->output_capacity) {
-    uint32_t new_cap = g->output_capacity == 0 ? 4 : g->output_capacity * 2;
-    uint32_t *no = (uint32_t *)realloc(g->outputs, new_cap * sizeof(uint32_t));
-    if (!no) {
-      return;
-    }
-    g->outputs = no;
-    g->output_capacity = new_cap;
+  if (!bwpp_graph_reserve(g, (void **)&g->outputs, g->output_count, &g->output_capacity, sizeof(uint32_t),
+                          _Alignof(uint32_t))) {
+    return;
   }
   g->outputs[g->output_count++] = value_id;
 }
 
-static void bwpp_binding_set(BwppGraphBuilder *b, BwppStr name, uint32_t value_id) {
+static void bwpp_binding_set(BwppGraphBuilder *b, uint32_t sym, uint32_t value_id) {
+  if (sym >= b->module->symbols.count) {
+    return;
+  }
   if (b->binding_count == b->binding_capacity) {
     uint32_t new_cap = b->binding_capacity == 0 ? 16 : b->binding_capacity * 2;
-    BwppBinding *nb = (BwppBinding *)realloc(b->bindings, new_cap * sizeof(BwppBinding));
+    BwppBinding *nb = (BwppBinding *)bwpp_chunk_arena_grow(&b->arena, b->bindings,
+                                                           b->binding_capacity * sizeof(BwppBinding),
+                                                           new_cap * sizeof(BwppBinding), _Alignof(BwppBinding));
     if (!nb) {
       return;
     }
     b->bindings = nb;
     b->binding_capacity = new_cap;
   }
-  b->bindings[b->binding_count].name = name;
-  b->bindings[b->binding_count].value_id = value_id;
-  b->binding_count++;
+  b->bindings[b->binding_count].sym = sym;
+  b->bindings[b->binding_count].prev = b->value_of_sym[sym];
+  b->bindings[b->binding_count].prev_at = b->bound_at[sym];
+  b->bound_at[sym] = b->binding_count++;
+  b->value_of_sym[sym] = value_id;
+}
+
+static uint32_t bwpp_binding_get(const BwppGraphBuilder *b, uint32_t sym) {
+  return sym < b->module->symbols.count ? b->value_of_sym[sym] : BWPP_GRAPH_NO_VALUE;
+}
+
+/* Drops the bindings made since `mark`, restoring what they shadowed. */
+static void bwpp_binding_unwind(BwppGraphBuilder *b, uint32_t mark) {
+  while (b->binding_count > mark) {
+    const BwppBinding *undo = &b->bindings[--b->binding_count];
+    b->value_of_sym[undo->sym] = undo->prev;
+    b->bound_at[undo->sym] = undo->prev_at;
+  }
+}
+
+static void bwpp_template_add_input(BwppGraphBuilder *b, BwppFnTemplate *t, uint32_t sym) {
+  if (t->input_count == t->input_capacity) {
+    uint32_t new_cap = t->input_capacity == 0 ? 4 : t->input_capacity * 2;
+    uint32_t *ni = (uint32_t *)bwpp_chunk_arena_grow(&b->arena, t->inputs, t->input_capacity * sizeof(uint32_t),
+                                                     new_cap * sizeof(uint32_t), sizeof(uint32_t));
+    if (!ni) {
+      t->reusable = 0;
+      return;
+    }
+    t->inputs = ni;
+    t->input_capacity = new_cap;
+  }
+  t->inputs[t->input_count++] = sym;
 }
 
-static uint32_t bwpp_binding_get(BwppGraphBuilder *b, BwppStr name) {
-  for (uint32_t i = b->binding_count; i > 0; --i) {
-    uint32_t idx = i - 1;
-    if (bwpp_str_eq_str(b->bindings[idx].name, name)) {
-      return b->bindings[idx].value_id;
+/* A name lookup that found `sym` bound outside a template's call reads the
+   caller's scope, which the next call site may bind differently. */
+static void bwpp_template_note_lookup(BwppGraphBuilder *b, uint32_t sym) {
+  for (uint32_t r = b->recording; r != BWPP_NO_TEMPLATE; r = b->templates[r].outer) {
+    if (b->bound_at[sym] >= b->templates[r].binding_mark) {
+      break;
     }
+    b->templates[r].reusable = 0;
   }
-  return BWPP_GRAPH_NO_VALUE;
 }
 
-static uint32_t bwpp_graph_get_or_add_input(BwppGraphBuilder *b, BwppStr name) {
-  uint32_t existing = bwpp_binding_get(b, name);
+/* A `let` names the value it binds; renaming one made before the call
+   is a side effect a clone would not repeat. */
+static void bwpp_template_note_rename(BwppGraphBuilder *b, uint32_t value) {
+  for (uint32_t r = b->recording; r != BWPP_NO_TEMPLATE; r = b->templates[r].outer) {
+    if (value >= b->templates[r].value_start) {
+      break;
+    }
+    b->templates[r].reusable = 0;
+  }
+}
+
+static uint32_t bwpp_graph_get_or_add_input(BwppGraphBuilder *b, BwppStr name, uint32_t sym) {
+  uint32_t existing = bwpp_binding_get(b, sym);
   if (existing != BWPP_GRAPH_NO_VALUE) {
+    bwpp_template_note_lookup(b, sym);
     return existing;
   }
   BwppGraphValue v = {0};
@@ -412,7 +347,10 @@ static uint32_t bwpp_graph_get_or_add_input(BwppGraphBuilder *b, BwppStr name) {
   v.flags = BWPP_GRAPH_VALUE_INPUT;
   uint32_t id = bwpp_graph_add_value(b->graph, v);
   if (id != BWPP_GRAPH_NO_VALUE) {
-    bwpp_binding_set(b, name, id);
+    bwpp_binding_set(b, sym, id);
+    for (uint32_t r = b->recording; r != BWPP_NO_TEMPLATE; r = b->templates[r].outer) {
+      bwpp_template_add_input(b, &b->templates[r], sym);
+    }
   }
   return id;
 }
@@ -460,790 +398,690 @@ static uint32_t bwpp_graph_add_op_node(BwppGraph *g,
   return out_id;
 }
 
-static uint32_t bwpp_parse_expr(BwppGraphParser *p,
-                                BwppGraphBuilder *b,
-                                BwppFnTable *fns,
-                                BwppFnStack *stack,
-                                uint32_t current_region);
-static uint32_t bwpp_graph_parse_body(BwppGraphParser *parser,
-                                      BwppGraphBuilder *builder,
-                                      BwppFnTable *fns,
-                                      BwppFnStack *stack,
-                                      uint32_t inherited_region,
-                                      int mark_output);
-static uint32_t bwpp_graph_inline_call(const BwppFnDef *fn,
-                                       BwppGraphBuilder *builder,
-                                       BwppFnTable *fns,
-                                       BwppFnStack *stack,
-                                       const uint32_t *args,
-                                       uint32_t arg_count,
-                                       uint32_t inherited_region);
-
-static uint32_t bwpp_parse_primary(BwppGraphParser *p,
-                                   BwppGraphBuilder *b,
-                                   BwppFnTable *fns,
-                                   BwppFnStack *stack,
-                                   uint32_t current_region) {
-  BwppToken tok = bwpp_graph_next(p);
-  if (tok.kind == BWPP_TOK_IDENT) {
-    BwppStr name = bwpp_tok_str(&tok);
-    BwppToken next = bwpp_graph_next(p);
-    if (next.kind == BWPP_TOK_SYMBOL && next.length == 1 && next.lexeme[0] == '(') {
-      BwppGraphAttr attr = {0};
-      uint32_t args[BWPP_GRAPH_MAX_INPUTS] = {0};
-      uint32_t argc = 0;
-      int expect_more = 1;
-      if (bwpp_tok_is(&tok, "reshape") || bwpp_tok_is(&tok, "permute")) {
-        uint32_t input = bwpp_parse_expr(p, b, fns, stack, current_region);
-        args[argc++] = input;
-        BwppToken comma = bwpp_graph_next(p);
-        if (!(comma.kind == BWPP_TOK_SYMBOL && comma.length == 1 && comma.lexeme[0] == ',')) {
-          return BWPP_GRAPH_NO_VALUE;
-        }
-        if (bwpp_tok_is(&tok, "reshape")) {
-          if (!bwpp_parse_shape_list(p, &attr.shape)) {
-            return BWPP_GRAPH_NO_VALUE;
-          }
-        } else {
-          BwppShape perm = {0};
-          if (!bwpp_parse_shape_list(p, &perm)) {
-            return BWPP_GRAPH_NO_VALUE;
-          }
-          attr.perm_rank = perm.rank;
-          for (uint32_t i = 0; i < perm.rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
-            uint32_t axis = 0;
-            if (bwpp_str_to_u32(perm.dims[i], &axis)) {
-              attr.perm[i] = axis;
-            } else {
-              attr.perm[i] = i;
-            }
-          }
-        }
-        BwppToken close = bwpp_graph_next(p);
-        if (!(close.kind == BWPP_TOK_SYMBOL && close.length == 1 && close.lexeme[0] == ')')) {
-          return BWPP_GRAPH_NO_VALUE;
-        }
-        BwppShape out_shape = {0};
-        BwppShape in_shape = b->graph->values[input].shape;
-        if (bwpp_tok_is(&tok, "reshape")) {
-          out_shape = attr.shape;
-        } else {
-          out_shape.rank = in_shape.rank;
-          if (attr.perm_rank == in_shape.rank) {
-            for (uint32_t i = 0; i < in_shape.rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
-              uint32_t src = attr.perm[i];
-              if (src < in_shape.rank) {
-                out_shape.dims[i] = in_shape.dims[src];
-              }
-            }
-          } else {
-            bwpp_shape_copy(&out_shape, &in_shape);
-          }
-        }
-        BwppGraphOpKind op = bwpp_tok_is(&tok, "reshape") ? BWPP_GOP_RESHAPE : BWPP_GOP_PERMUTE;
-        return bwpp_graph_add_op_node(b->graph, op, args, argc, &attr, &out_shape,
-                                      b->graph->values[input].dtype,
-                                      b->graph->values[input].layout,
-                                      0);
-      }
-
-      if (bwpp_tok_is(&tok, "transpose")) {
-        uint32_t input = bwpp_parse_expr(p, b, fns, stack, current_region);
-        args[argc++] = input;
-        BwppToken close = bwpp_graph_next(p);
-        if (!(close.kind == BWPP_TOK_SYMBOL && close.length == 1 && close.lexeme[0] == ')')) {
-          return BWPP_GRAPH_NO_VALUE;
-        }
-        BwppShape out_shape = b->graph->values[input].shape;
-        if (out_shape.rank == 2) {
-          BwppStr tmp = out_shape.dims[0];
-          out_shape.dims[0] = out_shape.dims[1];
-          out_shape.dims[1] = tmp;
-        }
-        return bwpp_graph_add_op_node(b->graph, BWPP_GOP_TRANSPOSE, args, argc, NULL, &out_shape,
-                                      b->graph->values[input].dtype,
-                                      b->graph->values[input].layout,
-                                      0);
-      }
-
-      if (bwpp_tok_is(&tok, "softmax") || bwpp_tok_is(&tok, "silu")) {
-        uint32_t input = bwpp_parse_expr(p, b, fns, stack, current_region);
-        args[argc++] = input;
-        BwppToken maybe = bwpp_graph_next(p);
-        if (maybe.kind == BWPP_TOK_SYMBOL && maybe.length == 1 && maybe.lexeme[0] == ',') {
-          BwppToken axis_tok = bwpp_graph_next(p);
-          if (axis_tok.kind == BWPP_TOK_NUMBER) {
-            BwppStr axis_str = bwpp_tok_str(&axis_tok);
-            uint32_t axis = 0;
-            if (bwpp_str_to_u32(axis_str, &axis)) {
-              attr.has_axis = 1;
-              attr.axis = (int)axis;
-            }
-          }
-          BwppToken close2 = bwpp_graph_next(p);
-          if (!(close2.kind == BWPP_TOK_SYMBOL && close2.length == 1 && close2.lexeme[0] == ')')) {
-            return BWPP_GRAPH_NO_VALUE;
-          }
-        } else {
-          if (!(maybe.kind == BWPP_TOK_SYMBOL && maybe.length == 1 && maybe.lexeme[0] == ')')) {
-            return BWPP_GRAPH_NO_VALUE;
-          }
-        }
-        BwppGraphOpKind op = bwpp_tok_is(&tok, "softmax") ? BWPP_GOP_SOFTMAX : BWPP_GOP_SILU;
-        return bwpp_graph_add_op_node(b->graph, op, args, argc, &attr,
-                                      &b->graph->values[input].shape,
-                                      b->graph->values[input].dtype,
-                                      b->graph->values[input].layout,
-                                      0);
-      }
+static uint32_t bwpp_graph_add_region(BwppGraph *g, BwppRegionKind kind, BwppRegionPolicy policy) {
+  if (!bwpp_graph_reserve(g, (void **)&g->regions, g->region_count, &g->region_capacity, sizeof(BwppGraphRegion),
+                          _Alignof(BwppGraphRegion))) {
+    return BWPP_GRAPH_NO_REGION;
+  }
+  BwppGraphRegion reg = {0};
+  reg.id = g->region_count;
+  reg.kind = kind;
+  reg.policy = policy;
+  g->regions[g->region_count++] = reg;
+  return reg.id;
+}
 
-      if (bwpp_tok_is(&tok, "rmsnorm")) {
-        uint32_t input = bwpp_parse_expr(p, b, fns, stack, current_region);
-        args[argc++] = input;
-        BwppToken comma = bwpp_graph_next(p);
-        if (!(comma.kind == BWPP_TOK_SYMBOL && comma.length == 1 && comma.lexeme[0] == ',')) {
-          return BWPP_GRAPH_NO_VALUE;
-        }
-        uint32_t gamma = bwpp_parse_expr(p, b, fns, stack, current_region);
-        args[argc++] = gamma;
-        BwppToken next_tok = bwpp_graph_next(p);
-        if (next_tok.kind == BWPP_TOK_SYMBOL && next_tok.length == 1 && next_tok.lexeme[0] == ',') {
-          BwppToken peek = bwpp_graph_next(p);
-          if (peek.kind == BWPP_TOK_NUMBER) {
-            float eps = 1e-5f;
-            float parsed = 0.0f;
-            if (bwpp_str_to_f32(bwpp_tok_str(&peek), &parsed)) {
-              eps = parsed;
-            }
-            BwppToken close = bwpp_graph_next(p);
-            attr.has_epsilon = 1;
-            attr.epsilon = eps;
-            if (!(close.kind == BWPP_TOK_SYMBOL && close.length == 1 && close.lexeme[0] == ')')) {
-              return BWPP_GRAPH_NO_VALUE;
-            }
-          } else {
-            bwpp_graph_unread(p, peek);
-            uint32_t beta = bwpp_parse_expr(p, b, fns, stack, current_region);
-            args[argc++] = beta;
-            BwppToken next2 = bwpp_graph_next(p);
-            if (next2.kind == BWPP_TOK_SYMBOL && next2.length == 1 && next2.lexeme[0] == ',') {
-              BwppToken eps_tok = bwpp_graph_next(p);
-              float eps = 1e-5f;
-              float parsed = 0.0f;
-              if (eps_tok.kind == BWPP_TOK_NUMBER &&
-                  bwpp_str_to_f32(bwpp_tok_str(&eps_tok), &parsed)) {
-                eps = parsed;
-              }
-              BwppToken close = bwpp_graph_next(p);
-              attr.has_epsilon = 1;
-              attr.epsilon = eps;
-              if (!(close.kind == BWPP_TOK_SYMBOL && close.length == 1 && close.lexeme[0] == ')')) {
-                return BWPP_GRAPH_NO_VALUE;
-              }
-            } else if (next2.kind == BWPP_TOK_SYMBOL && next2.length == 1 && next2.lexeme[0] == ')') {
-              attr.has_epsilon = 1;
-              attr.epsilon = 1e-5f;
-            } else {
-              return BWPP_GRAPH_NO_VALUE;
-            }
-          }
-        } else if (next_tok.kind == BWPP_TOK_SYMBOL && next_tok.length == 1 && next_tok.lexeme[0] == ')') {
-          attr.has_epsilon = 1;
-          attr.epsilon = 1e-5f;
-        } else {
-          return BWPP_GRAPH_NO_VALUE;
-        }
-        return bwpp_graph_add_op_node(b->graph, BWPP_GOP_RMSNORM, args, argc, &attr,
-                                      &b->graph->values[input].shape,
-                                      b->graph->values[input].dtype,
-                                      b->graph->values[input].layout,
-                                      0);
-      }
+static uint32_t bwpp_graph_lower_expr(BwppGraphBuilder *b, uint32_t expr, uint32_t region);
+static int bwpp_graph_lower_body(BwppGraphBuilder *b,
+                                 uint32_t first,
+                                 uint32_t end,
+                                 uint32_t inherited_region,
+                                 int mark_output,
+                                 uint32_t *ret);
+
+static BwppRegionPolicy bwpp_graph_region_policy(const BwppAstModule *module, uint32_t region) {
+  if (region >= module->region_count) {
+    return BWPP_POLICY_AUTO;
+  }
+  switch (module->regions[region].policy) {
+    case BWPP_AST_POLICY_STORE:
+      return BWPP_POLICY_STORE;
+    case BWPP_AST_POLICY_RECOMPUTE:
+      return BWPP_POLICY_RECOMPUTE;
+    case BWPP_AST_POLICY_AUTO:
+    default:
+      return BWPP_POLICY_AUTO;
+  }
+}
 
-      if (bwpp_tok_is(&tok, "reduce_sum") || bwpp_tok_is(&tok, "reduce_max")) {
-        uint32_t input = bwpp_parse_expr(p, b, fns, stack, current_region);
-        args[argc++] = input;
-        BwppToken maybe = bwpp_graph_next(p);
-        if (maybe.kind == BWPP_TOK_SYMBOL && maybe.length == 1 && maybe.lexeme[0] == ',') {
-          BwppToken axis_tok = bwpp_graph_next(p);
-          if (axis_tok.kind == BWPP_TOK_NUMBER) {
-            BwppStr axis_str = bwpp_tok_str(&axis_tok);
-            uint32_t axis = 0;
-            if (bwpp_str_to_u32(axis_str, &axis)) {
-              attr.has_axis = 1;
-              attr.axis = (int)axis;
-            }
-          }
-          BwppToken close = bwpp_graph_next(p);
-          if (!(close.kind == BWPP_TOK_SYMBOL && close.length == 1 && close.lexeme[0] == ')')) {
-            return BWPP_GRAPH_NO_VALUE;
-          }
-        } else {
-          if (!(maybe.kind == BWPP_TOK_SYMBOL && maybe.length == 1 && maybe.lexeme[0] == ')')) {
-            return BWPP_GRAPH_NO_VALUE;
-          }
-        }
-        BwppGraphOpKind op = bwpp_tok_is(&tok, "reduce_sum") ? BWPP_GOP_REDUCE_SUM : BWPP_GOP_REDUCE_MAX;
-        BwppShape out_shape = b->graph->values[input].shape;
-        if (attr.has_axis && attr.axis >= 0 && (uint32_t)attr.axis < out_shape.rank) {
-          out_shape.dims[attr.axis] = bwpp_shape_one_dim();
-        }
-        return bwpp_graph_add_op_node(b->graph, op, args, argc, &attr, &out_shape,
-                                      b->graph->values[input].dtype,
-                                      b->graph->values[input].layout,
-                                      0);
-      }
+static BwppShape bwpp_graph_type_shape(const BwppAstType *type) {
+  BwppShape shape = {0};
+  shape.rank = type->rank;
+  for (uint32_t i = 0; i < type->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    shape.dims[i] = type->dims[i];
+  }
+  return shape;
+}
 
-      if (bwpp_tok_is(&tok, "matmul") || bwpp_tok_is(&tok, "batch_matmul") ||
-          bwpp_tok_is(&tok, "add") || bwpp_tok_is(&tok, "sub") ||
-          bwpp_tok_is(&tok, "mul") || bwpp_tok_is(&tok, "div")) {
-        while (expect_more) {
-          BwppToken peek = bwpp_graph_next(p);
-          if (peek.kind == BWPP_TOK_SYMBOL && peek.length == 1 && peek.lexeme[0] == ')') {
-            break;
-          }
-          bwpp_graph_unread(p, peek);
-          uint32_t arg = bwpp_parse_expr(p, b, fns, stack, current_region);
-          if (argc < BWPP_GRAPH_MAX_INPUTS) {
-            args[argc++] = arg;
-          }
-          BwppToken sep = bwpp_graph_next(p);
-          if (sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ',') {
-            continue;
-          }
-          if (sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ')') {
-            break;
-          }
-          return BWPP_GRAPH_NO_VALUE;
-        }
+/* `[a, b, ...]` as a shape: names and numbers only, capped at BWPP_GRAPH_MAX_DIMS. */
+static int bwpp_graph_list_shape(const BwppAstModule *module, uint32_t list, BwppShape *shape) {
+  if (list == BWPP_AST_NO_EXPR || module->exprs[list].kind != BWPP_AST_EXPR_LIST) {
+    return 0;
+  }
+  shape->rank = 0;
+  for (uint32_t a = module->exprs[list].first; a != BWPP_AST_NO_EXPR; a = module->exprs[a].next) {
+    const BwppAstExpr *e = &module->exprs[a];
+    if (shape->rank < BWPP_GRAPH_MAX_DIMS &&
+        (e->kind == BWPP_AST_EXPR_NAME || e->kind == BWPP_AST_EXPR_NUMBER)) {
+      shape->dims[shape->rank++] = e->text;
+    }
+  }
+  return 1;
+}
 
-        BwppGraphOpKind op = BWPP_GOP_ADD;
-        if (bwpp_tok_is(&tok, "matmul")) {
-          op = BWPP_GOP_MATMUL;
-        } else if (bwpp_tok_is(&tok, "batch_matmul")) {
-          op = BWPP_GOP_BATCH_MATMUL;
-        } else if (bwpp_tok_is(&tok, "add")) {
-          op = BWPP_GOP_ADD;
-        } else if (bwpp_tok_is(&tok, "sub")) {
-          op = BWPP_GOP_SUB;
-        } else if (bwpp_tok_is(&tok, "mul")) {
-          op = BWPP_GOP_MUL;
-        } else if (bwpp_tok_is(&tok, "div")) {
-          op = BWPP_GOP_DIV;
-        }
+static uint32_t bwpp_graph_lower_arg(BwppGraphBuilder *b, uint32_t call, uint32_t i, uint32_t region) {
+  uint32_t arg = bwpp_ast_arg(b->module, call, i);
+  return arg == BWPP_AST_NO_EXPR ? BWPP_GRAPH_NO_VALUE : bwpp_graph_lower_expr(b, arg, region);
+}
 
-        BwppShape out_shape = {0};
-        BwppDType dtype = BWPP_DTYPE_UNKNOWN;
-        BwppLayout layout = BWPP_LAYOUT_UNKNOWN;
-        if (argc >= 1) {
-          dtype = b->graph->values[args[0]].dtype;
-          layout = b->graph->values[args[0]].layout;
-          bwpp_shape_copy(&out_shape, &b->graph->values[args[0]].shape);
-        }
-        if (op == BWPP_GOP_MATMUL && argc >= 2) {
-          BwppShape a = b->graph->values[args[0]].shape;
-          BwppShape bshape = b->graph->values[args[1]].shape;
-          if (a.rank == 2 && bshape.rank == 2) {
-            out_shape.rank = 2;
-            out_shape.dims[0] = a.dims[0];
-            out_shape.dims[1] = bshape.dims[1];
-          }
-        } else if (op == BWPP_GOP_BATCH_MATMUL && argc >= 2) {
-          bwpp_shape_copy(&out_shape, &b->graph->values[args[0]].shape);
-        } else if ((op == BWPP_GOP_ADD || op == BWPP_GOP_SUB || op == BWPP_GOP_MUL || op == BWPP_GOP_DIV) &&
-                   argc >= 2) {
-          BwppShape a = b->graph->values[args[0]].shape;
-          BwppShape bshape = b->graph->values[args[1]].shape;
-          out_shape = bwpp_shape_broadcast(&a, &bshape);
-        }
+static int bwpp_graph_expr_is(const BwppAstModule *module, uint32_t expr, BwppAstExprKind kind) {
+  return expr != BWPP_AST_NO_EXPR && module->exprs[expr].kind == kind;
+}
 
-        uint32_t flags = 0;
-        if (op == BWPP_GOP_ADD) {
-          for (uint32_t i = 0; i < argc; ++i) {
-            BwppStr nm = b->graph->values[args[i]].name;
-            if (nm.ptr && bwpp_str_eq(nm, "bias")) {
-              flags |= BWPP_GRAPH_OPF_HAS_BIAS;
-            }
-          }
-        }
-        return bwpp_graph_add_op_node(b->graph, op, args, argc, &attr, &out_shape, dtype, layout, flags);
-      }
+static int bwpp_value_is_bias(const BwppGraphValue *v) {
+  return v->name.ptr && bwpp_str_eq(v->name, "bias");
+}
 
-      BwppFnDef *fn = fns ? bwpp_fn_table_find(fns, name) : NULL;
-      if (fn) {
-        uint32_t *call_args = NULL;
-        uint32_t call_count = 0;
-        uint32_t call_capacity = 0;
-        BwppToken peek = bwpp_graph_next(p);
-        if (!(peek.kind == BWPP_TOK_SYMBOL && peek.length == 1 && peek.lexeme[0] == ')')) {
-          bwpp_graph_unread(p, peek);
-          for (;;) {
-            uint32_t arg = bwpp_parse_expr(p, b, fns, stack, current_region);
-            if (arg == BWPP_GRAPH_NO_VALUE) {
-              free(call_args);
-              return BWPP_GRAPH_NO_VALUE;
-            }
-            if (call_count == call_capacity) {
-              uint32_t next_cap = call_capacity == 0 ? 4 : call_capacity * 2;
-              uint32_t *next = (uint32_t *)realloc(call_args, next_cap * sizeof(uint32_t));
-              if (!next) {
-                free(call_args);
-                return BWPP_GRAPH_NO_VALUE;
-              }
-              call_args = next;
-              call_capacity = next_cap;
-            }
-            call_args[call_count++] = arg;
-            BwppToken sep = bwpp_graph_next(p);
-            if (sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ',') {
-              continue;
-            }
-            if (sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ')') {
-              break;
-            }
-            free(call_args);
-            return BWPP_GRAPH_NO_VALUE;
-          }
-        }
-        uint32_t val = bwpp_graph_inline_call(fn, b, fns, stack, call_args, call_count, current_region);
-        free(call_args);
-        return val;
+/* Whether lowering the body again with `args` would append what `t` holds. */
+static int bwpp_template_matches(const BwppGraphBuilder *b,
+                                 const BwppFnTemplate *t,
+                                 const uint32_t *args,
+                                 uint32_t region) {
+  if (!t->reusable || (t->region == BWPP_GRAPH_NO_REGION) != (region == BWPP_GRAPH_NO_REGION)) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < t->arg_count; ++i) {
+    const BwppGraphValue *a = &b->graph->values[args[i]];
+    const BwppGraphValue *ta = &t->args[i];
+    if (a->dtype != ta->dtype || a->layout != ta->layout || !bwpp_shape_equal(&a->shape, &ta->shape) ||
+        bwpp_value_is_bias(a) != bwpp_value_is_bias(ta)) {
+      return 0;
+    }
+    for (uint32_t j = 0; j < i; ++j) {
+      if ((args[j] == args[i]) != (t->args[j].id == ta->id)) {
+        return 0;
       }
-      return BWPP_GRAPH_NO_VALUE;
     }
-    bwpp_graph_unread(p, next);
-    return bwpp_graph_get_or_add_input(b, name);
   }
-  if (tok.kind == BWPP_TOK_NUMBER) {
-    BwppGraphValue v = {0};
-    v.dtype = BWPP_DTYPE_F32;
-    v.layout = BWPP_LAYOUT_UNKNOWN;
-    v.shape.rank = 0;
-    v.producer = BWPP_GRAPH_NO_NODE;
-    v.flags = BWPP_GRAPH_VALUE_CONST;
-    return bwpp_graph_add_value(b->graph, v);
+  for (uint32_t i = 0; i < t->input_count; ++i) {
+    if (bwpp_binding_get(b, t->inputs[i]) != BWPP_GRAPH_NO_VALUE) {
+      return 0;
+    }
   }
-  if (tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '(') {
-    uint32_t val = bwpp_parse_expr(p, b, fns, stack, current_region);
-    BwppToken close = bwpp_graph_next(p);
-    if (!(close.kind == BWPP_TOK_SYMBOL && close.length == 1 && close.lexeme[0] == ')')) {
-      return BWPP_GRAPH_NO_VALUE;
+  return 1;
+}
+
+static uint32_t bwpp_template_find(const BwppGraphBuilder *b, uint32_t fn, const uint32_t *args, uint32_t region) {
+  for (uint32_t t = b->template_of_fn[fn]; t != BWPP_NO_TEMPLATE; t = b->templates[t].next) {
+    if (bwpp_template_matches(b, &b->templates[t], args, region)) {
+      return t;
     }
-    return val;
   }
-  return BWPP_GRAPH_NO_VALUE;
+  return BWPP_NO_TEMPLATE;
 }
 
-static uint32_t bwpp_parse_expr(BwppGraphParser *p,
-                                BwppGraphBuilder *b,
-                                BwppFnTable *fns,
-                                BwppFnStack *stack,
-                                uint32_t current_region) {
-  uint32_t lhs = bwpp_parse_primary(p, b, fns, stack, current_region);
-  if (lhs == BWPP_GRAPH_NO_VALUE) {
-    return lhs;
+/* Starts recording the call about to be lowered; BWPP_NO_TEMPLATE when out
+   of memory, and the call is simply not recorded. */
+static uint32_t bwpp_template_begin(BwppGraphBuilder *b,
+                                    uint32_t fn,
+                                    const uint32_t *args,
+                                    uint32_t arg_count,
+                                    uint32_t region) {
+  if (b->template_count == b->template_capacity) {
+    uint32_t new_cap = b->template_capacity == 0 ? 8 : b->template_capacity * 2;
+    BwppFnTemplate *nt = (BwppFnTemplate *)bwpp_chunk_arena_grow(&b->arena, b->templates,
+                                                                 b->template_capacity * sizeof(BwppFnTemplate),
+                                                                 new_cap * sizeof(BwppFnTemplate),
+                                                                 _Alignof(BwppFnTemplate));
+    if (!nt) {
+      return BWPP_NO_TEMPLATE;
+    }
+    b->templates = nt;
+    b->template_capacity = new_cap;
+  }
+  BwppFnTemplate t = {0};
+  if (arg_count > 0) {
+    t.args = (BwppGraphValue *)bwpp_chunk_arena_alloc(&b->arena, arg_count * sizeof(BwppGraphValue),
+                                                      _Alignof(BwppGraphValue));
+    if (!t.args) {
+      return BWPP_NO_TEMPLATE;
+    }
   }
-  for (;;) {
-    BwppToken tok = bwpp_graph_next(p);
-    if (tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '@') {
-      uint32_t rhs = bwpp_parse_primary(p, b, fns, stack, current_region);
-      uint32_t inputs[2] = { lhs, rhs };
-      BwppShape out_shape = {0};
-      BwppShape a = b->graph->values[lhs].shape;
-      BwppShape bshape = b->graph->values[rhs].shape;
-      if (a.rank == 2 && bshape.rank == 2) {
-        out_shape.rank = 2;
-        out_shape.dims[0] = a.dims[0];
-        out_shape.dims[1] = bshape.dims[1];
-      }
-      lhs = bwpp_graph_add_op_node(b->graph, BWPP_GOP_MATMUL, inputs, 2, NULL, &out_shape,
-                                   b->graph->values[lhs].dtype,
-                                   b->graph->values[lhs].layout,
-                                   0);
-      continue;
+  for (uint32_t i = 0; i < arg_count; ++i) {
+    t.args[i] = b->graph->values[args[i]];
+  }
+  t.fn = fn;
+  t.next = b->template_of_fn[fn];
+  t.outer = b->recording;
+  t.arg_count = arg_count;
+  t.region = region;
+  t.binding_mark = b->binding_count;
+  t.value_start = b->graph->value_count;
+  t.node_start = b->graph->node_count;
+  t.region_start = b->graph->region_count;
+  t.ret = BWPP_GRAPH_NO_VALUE;
+  t.reusable = 1;
+  uint32_t index = b->template_count++;
+  b->templates[index] = t;
+  b->template_of_fn[fn] = index;
+  b->recording = index;
+  return index;
+}
+
+static void bwpp_template_end(BwppGraphBuilder *b, uint32_t index, uint32_t ret) {
+  BwppFnTemplate *t = &b->templates[index];
+  t->value_end = b->graph->value_count;
+  t->node_end = b->graph->node_count;
+  t->region_end = b->graph->region_count;
+  t->ret = ret;
+  if (ret == BWPP_GRAPH_NO_VALUE) {
+    t->reusable = 0;
+  } else {
+    t->ret_name = b->graph->values[ret].name;
+    t->ret_flags = b->graph->values[ret].flags;
+  }
+  b->recording = t->outer;
+}
+
+static uint32_t bwpp_template_map(const BwppFnTemplate *t, uint32_t value, const uint32_t *args, uint32_t value_base) {
+  if (value >= t->value_start && value < t->value_end) {
+    return value - t->value_start + value_base;
+  }
+  for (uint32_t i = 0; i < t->arg_count; ++i) {
+    if (t->args[i].id == value) {
+      return args[i];
     }
-    bwpp_graph_unread(p, tok);
-    break;
   }
-  return lhs;
+  return value;
 }
 
-static int bwpp_parse_params(BwppGraphParser *p, BwppGraphBuilder *b, BwppParamList *params) {
-  int emit = b && b->graph;
-  BwppToken tok = bwpp_graph_next(p);
-  if (!(tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '(')) {
-    return 0;
+/* Appends a copy of template `index` reading `args`: the same values, nodes
+   and regions, in the same order, as lowering the body again would. */
+static uint32_t bwpp_template_instantiate(BwppGraphBuilder *b, uint32_t index, const uint32_t *args, uint32_t region) {
+  BwppGraph *g = b->graph;
+  const BwppFnTemplate *t = &b->templates[index];
+  uint32_t value_base = g->value_count;
+  uint32_t node_base = g->node_count;
+  uint32_t region_base = g->region_count;
+  for (uint32_t r = t->region_start; r < t->region_end; ++r) {
+    if (bwpp_graph_add_region(g, g->regions[r].kind, g->regions[r].policy) == BWPP_GRAPH_NO_REGION) {
+      return BWPP_GRAPH_NO_VALUE;
+    }
   }
-  for (;;) {
-    BwppToken name = bwpp_graph_next(p);
-    if (name.kind == BWPP_TOK_SYMBOL && name.length == 1 && name.lexeme[0] == ')') {
-      break;
+  for (uint32_t v = t->value_start; v < t->value_end; ++v) {
+    BwppGraphValue copy = g->values[v];
+    if (copy.producer != BWPP_GRAPH_NO_NODE) {
+      copy.producer = copy.producer - t->node_start + node_base;
     }
-    if (name.kind != BWPP_TOK_IDENT) {
-      return 0;
+    if (bwpp_graph_add_value(g, copy) == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
-    if (!bwpp_param_list_add(params, bwpp_tok_str(&name))) {
-      return 0;
+  }
+  for (uint32_t n = t->node_start; n < t->node_end; ++n) {
+    BwppGraphNode copy = g->nodes[n];
+    for (uint32_t i = 0; i < copy.input_count && i < BWPP_GRAPH_MAX_INPUTS; ++i) {
+      copy.inputs[i] = bwpp_template_map(t, copy.inputs[i], args, value_base);
     }
-    BwppToken colon = bwpp_graph_next(p);
-    if (!(colon.kind == BWPP_TOK_SYMBOL && colon.length == 1 && colon.lexeme[0] == ':')) {
-      return 0;
+    copy.output = bwpp_template_map(t, copy.output, args, value_base);
+    if (copy.region_id >= t->region_start && copy.region_id < t->region_end) {
+      copy.region_id = copy.region_id - t->region_start + region_base;
+    } else if (copy.region_id != BWPP_GRAPH_NO_REGION && copy.region_id == t->region) {
+      copy.region_id = region;
     }
-    BwppToken tensor = bwpp_graph_next(p);
-    if (!bwpp_tok_is(&tensor, "tensor")) {
-      return 0;
+    if (bwpp_graph_add_node(g, copy) == BWPP_GRAPH_NO_NODE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
-    BwppToken lt = bwpp_graph_next(p);
-    if (!(lt.kind == BWPP_TOK_SYMBOL && lt.length == 1 && lt.lexeme[0] == '<')) {
-      return 0;
+  }
+  for (uint32_t r = b->recording; r != BWPP_NO_TEMPLATE; r = b->templates[r].outer) {
+    for (uint32_t i = 0; i < t->input_count; ++i) {
+      bwpp_template_add_input(b, &b->templates[r], t->inputs[i]);
     }
-    BwppToken dtype_tok = bwpp_graph_next(p);
-    if (dtype_tok.kind != BWPP_TOK_IDENT) {
-      return 0;
+  }
+  uint32_t ret = bwpp_template_map(t, t->ret, args, value_base);
+  if (ret >= value_base) {
+    g->values[ret].name = t->ret_name;
+    g->values[ret].flags = t->ret_flags;
+  }
+  return ret;
+}
+
+static uint32_t bwpp_graph_inline_call(BwppGraphBuilder *b,
+                                       const BwppAstFn *fn,
+                                       uint32_t call,
+                                       uint32_t inherited_region) {
+  const BwppAstModule *m = b->module;
+  const BwppAstExpr *e = &m->exprs[call];
+  uint32_t *args = NULL;
+  if (e->arg_count > 0) {
+    args = (uint32_t *)bwpp_chunk_arena_alloc(&b->arena, e->arg_count * sizeof(uint32_t), sizeof(uint32_t));
+    if (!args) {
+      return BWPP_GRAPH_NO_VALUE;
+    }
+  }
+  uint32_t i = 0;
+  for (uint32_t a = e->first; a != BWPP_AST_NO_EXPR; a = m->exprs[a].next) {
+    args[i] = bwpp_graph_lower_expr(b, a, inherited_region);
+    if (args[i++] == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
-    BwppToken comma = bwpp_graph_next(p);
-    if (!(comma.kind == BWPP_TOK_SYMBOL && comma.length == 1 && comma.lexeme[0] == ',')) {
-      return 0;
+  }
+  if (fn->param_count != e->arg_count) {
+    fprintf(stderr, "graph: %.*s takes %u arguments, got %u\n",
+            (int)fn->name.len, fn->name.ptr, fn->param_count, e->arg_count);
+    return BWPP_GRAPH_NO_VALUE;
+  }
+  uint32_t fn_index = (uint32_t)(fn - m->fns);
+  if (b->inlining[fn_index]) {
+    fprintf(stderr, "graph: recursive call to %.*s is not supported\n", (int)fn->name.len, fn->name.ptr);
+    return BWPP_GRAPH_NO_VALUE;
+  }
+  uint32_t t = bwpp_template_find(b, fn_index, args, inherited_region);
+  if (t != BWPP_NO_TEMPLATE) {
+    return bwpp_template_instantiate(b, t, args, inherited_region);
+  }
+  t = bwpp_template_begin(b, fn_index, args, e->arg_count, inherited_region);
+  if (fn->region != BWPP_AST_NO_REGION && inherited_region == BWPP_GRAPH_NO_REGION) {
+    inherited_region = bwpp_graph_add_region(b->graph, BWPP_REGION_REVERSIBLE,
+                                             bwpp_graph_region_policy(m, fn->region));
+  }
+
+  uint32_t mark = b->binding_count;
+  for (i = 0; i < fn->param_count; ++i) {
+    bwpp_binding_set(b, m->params[fn->params + i].sym, args[i]);
+  }
+  uint32_t val = BWPP_GRAPH_NO_VALUE;
+  b->inlining[fn_index] = 1;
+  bwpp_graph_lower_body(b, fn->stmts, fn->stmt_end, inherited_region, 0, &val);
+  b->inlining[fn_index] = 0;
+  bwpp_binding_unwind(b, mark);
+  if (t != BWPP_NO_TEMPLATE) {
+    bwpp_template_end(b, t, val);
+  }
+  return val;
+}
+
+static uint32_t bwpp_graph_lower_call(BwppGraphBuilder *b, uint32_t call, uint32_t region) {
+  const BwppAstModule *m = b->module;
+  const BwppAstExpr *e = &m->exprs[call];
+  BwppStr name = e->text;
+  BwppGraph *g = b->graph;
+  BwppGraphAttr attr = {0};
+  uint32_t args[BWPP_GRAPH_MAX_INPUTS] = {0};
+  uint32_t argc = 0;
+
+  if (bwpp_str_eq(name, "reshape") || bwpp_str_eq(name, "permute")) {
+    int reshape = bwpp_str_eq(name, "reshape");
+    BwppShape list = {0};
+    if (e->arg_count != 2 || !bwpp_graph_list_shape(m, bwpp_ast_arg(m, call, 1), &list)) {
+      return BWPP_GRAPH_NO_VALUE;
     }
-    BwppShape shape = {0};
-    if (!bwpp_parse_shape_list(p, &shape)) {
-      return 0;
+    uint32_t input = bwpp_graph_lower_arg(b, call, 0, region);
+    if (input == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
-    BwppLayout layout = BWPP_LAYOUT_UNKNOWN;
-    BwppToken next = bwpp_graph_next(p);
-    if (next.kind == BWPP_TOK_SYMBOL && next.length == 1 && next.lexeme[0] == ',') {
-      BwppToken layout_tok = bwpp_graph_next(p);
-      if (layout_tok.kind == BWPP_TOK_IDENT) {
-        layout = bwpp_parse_layout(bwpp_tok_str(&layout_tok));
-      }
-      BwppToken gt = bwpp_graph_next(p);
-      if (!(gt.kind == BWPP_TOK_SYMBOL && gt.length == 1 && gt.lexeme[0] == '>')) {
-        return 0;
-      }
-    } else if (next.kind == BWPP_TOK_SYMBOL && next.length == 1 && next.lexeme[0] == '>') {
-      /* no layout */
+    args[argc++] = input;
+    if (reshape) {
+      attr.shape = list;
     } else {
-      return 0;
+      attr.perm_rank = list.rank;
+      for (uint32_t i = 0; i < list.rank; ++i) {
+        uint32_t axis = 0;
+        attr.perm[i] = bwpp_str_to_u32(list.dims[i], &axis) ? axis : i;
+      }
     }
-
-    if (emit) {
-      BwppGraphValue v = {0};
-      v.name = bwpp_tok_str(&name);
-      v.dtype = bwpp_parse_dtype(bwpp_tok_str(&dtype_tok));
-      v.layout = layout;
-      bwpp_shape_copy(&v.shape, &shape);
-      v.producer = BWPP_GRAPH_NO_NODE;
-      v.flags = BWPP_GRAPH_VALUE_INPUT;
-      uint32_t id = bwpp_graph_add_value(b->graph, v);
-      if (id != BWPP_GRAPH_NO_VALUE) {
-        bwpp_binding_set(b, v.name, id);
+    BwppShape out_shape = {0};
+    BwppShape in_shape = g->values[input].shape;
+    if (reshape) {
+      out_shape = attr.shape;
+    } else {
+      out_shape.rank = in_shape.rank;
+      if (attr.perm_rank == in_shape.rank) {
+        for (uint32_t i = 0; i < in_shape.rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+          uint32_t src = attr.perm[i];
+          if (src < in_shape.rank) {
+            out_shape.dims[i] = in_shape.dims[src];
+          }
+        }
+      } else {
+        bwpp_shape_copy(&out_shape, &in_shape);
       }
     }
+    return bwpp_graph_add_op_node(g, reshape ? BWPP_GOP_RESHAPE : BWPP_GOP_PERMUTE, args, argc, &attr,
+                                  &out_shape, g->values[input].dtype, g->values[input].layout, 0);
+  }
 
-    BwppToken sep = bwpp_graph_next(p);
-    if (sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ')') {
-      break;
-    }
-    if (!(sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ',')) {
-      return 0;
+  if (bwpp_str_eq(name, "transpose")) {
+    uint32_t input = e->arg_count == 1 ? bwpp_graph_lower_arg(b, call, 0, region) : BWPP_GRAPH_NO_VALUE;
+    if (input == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
+    args[argc++] = input;
+    BwppShape out_shape = bwpp_shape_transpose(&g->values[input].shape);
+    return bwpp_graph_add_op_node(g, BWPP_GOP_TRANSPOSE, args, argc, NULL, &out_shape,
+                                  g->values[input].dtype, g->values[input].layout, 0);
   }
-  return 1;
-}
 
-static uint32_t bwpp_graph_parse_body(BwppGraphParser *parser,
-                                      BwppGraphBuilder *builder,
-                                      BwppFnTable *fns,
-                                      BwppFnStack *stack,
-                                      uint32_t inherited_region,
-                                      int mark_output) {
-  int brace_depth = 0;
-  int pending_reversible = 0;
-  uint32_t current_region = inherited_region;
-  int reversible_brace_depth = -1;
-
-  for (;;) {
-    BwppToken tok = bwpp_graph_next(parser);
-    if (tok.kind == BWPP_TOK_EOF) {
-      break;
+  if (bwpp_str_eq(name, "softmax") || bwpp_str_eq(name, "silu")) {
+    int softmax = bwpp_str_eq(name, "softmax");
+    uint32_t input = bwpp_graph_lower_arg(b, call, 0, region);
+    if (input == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
-    if (tok.kind == BWPP_TOK_SYMBOL && tok.length == 1) {
-      char ch = tok.lexeme[0];
-      if (ch == '@') {
-        BwppToken next = bwpp_graph_next(parser);
-        if (bwpp_tok_is(&next, "reversible")) {
-          pending_reversible = 1;
+    args[argc++] = input;
+    /* trailing args: an axis number, `causal`, or a key-length tensor */
+    for (uint32_t a = m->exprs[e->first].next; a != BWPP_AST_NO_EXPR; a = m->exprs[a].next) {
+      const BwppAstExpr *arg = &m->exprs[a];
+      if (arg->kind == BWPP_AST_EXPR_NUMBER) {
+        uint32_t axis = 0;
+        if (bwpp_str_to_u32(arg->text, &axis)) {
+          attr.has_axis = 1;
+          attr.axis = (int)axis;
         }
-        continue;
-      }
-      if (ch == '{') {
-        brace_depth++;
-        if (pending_reversible && current_region == BWPP_GRAPH_NO_REGION) {
-          BwppGraphRegion reg = {0};
-          reg.id = builder->graph->region_count;
-          reg.kind = BWPP_REGION_REVERSIBLE;
-          reg.policy = BWPP_POLICY_AUTO;
-          if (builder->graph->region_count == builder->graph->region_capacity) {
-            uint32_t new_cap = builder->graph->region_capacity == 0 ? 4 : builder->graph->region_capacity * 2;
-            BwppGraphRegion *nr = (BwppGraphRegion *)realloc(builder->graph->regions, new_cap * sizeof(BwppGraphRegion));
-            if (!nr) {
-              return BWPP_GRAPH_NO_VALUE;
-            }
-            builder->graph->regions = nr;
-            builder->graph->region_capacity = new_cap;
-          }
-          builder->graph->regions[builder->graph->region_count++] = reg;
-          current_region = reg.id;
-          reversible_brace_depth = brace_depth;
-          pending_reversible = 0;
-        }
-        continue;
-      }
-      if (ch == '}') {
-        if (current_region != BWPP_GRAPH_NO_REGION && reversible_brace_depth == brace_depth) {
-          current_region = inherited_region;
-          reversible_brace_depth = -1;
+      } else if (arg->kind == BWPP_AST_EXPR_NAME && bwpp_str_eq(arg->text, "causal")) {
+        attr.mask |= BWPP_GRAPH_MASK_CAUSAL;
+      } else if (softmax && !(attr.mask & BWPP_GRAPH_MASK_KV_LEN)) {
+        uint32_t kv_len = bwpp_graph_lower_expr(b, a, region);
+        if (kv_len == BWPP_GRAPH_NO_VALUE) {
+          return BWPP_GRAPH_NO_VALUE;
         }
-        brace_depth--;
-        continue;
+        args[argc++] = kv_len;
+        attr.mask |= BWPP_GRAPH_MASK_KV_LEN;
+      } else {
+        return BWPP_GRAPH_NO_VALUE;
       }
     }
+    return bwpp_graph_add_op_node(g, softmax ? BWPP_GOP_SOFTMAX : BWPP_GOP_SILU, args, argc, &attr,
+                                  &g->values[input].shape, g->values[input].dtype, g->values[input].layout, 0);
+  }
 
-    if (tok.kind == BWPP_TOK_IDENT && bwpp_tok_is(&tok, "let")) {
-      BwppToken name = bwpp_graph_next(parser);
-      if (name.kind != BWPP_TOK_IDENT) {
-        continue;
-      }
-      BwppToken eq = bwpp_graph_next(parser);
-      if (!(eq.kind == BWPP_TOK_SYMBOL && eq.length == 1 && eq.lexeme[0] == '=')) {
-        continue;
-      }
-      uint32_t val = bwpp_parse_expr(parser, builder, fns, stack, current_region);
-      if (val != BWPP_GRAPH_NO_VALUE) {
-        builder->graph->values[val].name = bwpp_tok_str(&name);
-        bwpp_binding_set(builder, builder->graph->values[val].name, val);
-        if (current_region != BWPP_GRAPH_NO_REGION &&
-            builder->graph->values[val].producer != BWPP_GRAPH_NO_NODE) {
-          builder->graph->nodes[builder->graph->values[val].producer].region_id = current_region;
-        }
+  if (bwpp_str_eq(name, "rmsnorm")) {
+    /* rmsnorm(x, gamma[, beta][, epsilon]) */
+    uint32_t third = bwpp_ast_arg(m, call, 2);
+    uint32_t eps_expr = bwpp_graph_expr_is(m, third, BWPP_AST_EXPR_NUMBER) ? third : bwpp_ast_arg(m, call, 3);
+    uint32_t max_args = eps_expr == third ? 3u : 4u;
+    if (e->arg_count < 2 || e->arg_count > max_args) {
+      return BWPP_GRAPH_NO_VALUE;
+    }
+    uint32_t input = bwpp_graph_lower_arg(b, call, 0, region);
+    uint32_t gamma = input == BWPP_GRAPH_NO_VALUE ? input : bwpp_graph_lower_arg(b, call, 1, region);
+    if (gamma == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
+    }
+    args[argc++] = input;
+    args[argc++] = gamma;
+    if (third != BWPP_AST_NO_EXPR && third != eps_expr) {
+      uint32_t beta = bwpp_graph_lower_expr(b, third, region);
+      if (beta == BWPP_GRAPH_NO_VALUE) {
+        return BWPP_GRAPH_NO_VALUE;
       }
-      continue;
+      args[argc++] = beta;
     }
+    float parsed = 0.0f;
+    attr.has_epsilon = 1;
+    attr.epsilon = 1e-5f;
+    if (bwpp_graph_expr_is(m, eps_expr, BWPP_AST_EXPR_NUMBER) && bwpp_str_to_f32(m->exprs[eps_expr].text, &parsed)) {
+      attr.epsilon = parsed;
+    }
+    return bwpp_graph_add_op_node(g, BWPP_GOP_RMSNORM, args, argc, &attr,
+                                  &g->values[input].shape, g->values[input].dtype, g->values[input].layout, 0);
+  }
 
-    if (tok.kind == BWPP_TOK_IDENT && bwpp_tok_is(&tok, "return")) {
-      uint32_t val = bwpp_parse_expr(parser, builder, fns, stack, current_region);
-      if (val != BWPP_GRAPH_NO_VALUE && mark_output) {
-        builder->graph->values[val].flags |= BWPP_GRAPH_VALUE_OUTPUT;
-        bwpp_graph_add_output(builder->graph, val);
-      }
-      return val;
+  if (bwpp_str_eq(name, "reduce_sum") || bwpp_str_eq(name, "reduce_max")) {
+    uint32_t input = e->arg_count <= 2 ? bwpp_graph_lower_arg(b, call, 0, region) : BWPP_GRAPH_NO_VALUE;
+    if (input == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
     }
+    args[argc++] = input;
+    uint32_t axis_expr = bwpp_ast_arg(m, call, 1);
+    uint32_t axis = 0;
+    if (bwpp_graph_expr_is(m, axis_expr, BWPP_AST_EXPR_NUMBER) && bwpp_str_to_u32(m->exprs[axis_expr].text, &axis)) {
+      attr.has_axis = 1;
+      attr.axis = (int)axis;
+    }
+    BwppGraphOpKind op = bwpp_str_eq(name, "reduce_sum") ? BWPP_GOP_REDUCE_SUM : BWPP_GOP_REDUCE_MAX;
+    BwppShape out_shape = g->values[input].shape;
+    if (attr.has_axis && attr.axis >= 0 && (uint32_t)attr.axis < out_shape.rank) {
+      out_shape.dims[attr.axis] = bwpp_shape_one_dim();
+    }
+    return bwpp_graph_add_op_node(g, op, args, argc, &attr, &out_shape,
+                                  g->values[input].dtype, g->values[input].layout, 0);
+  }
+
+  BwppGraphOpKind op = BWPP_GOP_ADD;
+  if (bwpp_str_eq(name, "matmul")) {
+    op = BWPP_GOP_MATMUL;
+  } else if (bwpp_str_eq(name, "batch_matmul")) {
+    op = BWPP_GOP_BATCH_MATMUL;
+  } else if (bwpp_str_eq(name, "add")) {
+    op = BWPP_GOP_ADD;
+  } else if (bwpp_str_eq(name, "sub")) {
+    op = BWPP_GOP_SUB;
+  } else if (bwpp_str_eq(name, "mul")) {
+    op = BWPP_GOP_MUL;
+  } else if (bwpp_str_eq(name, "div")) {
+    op = BWPP_GOP_DIV;
+  } else {
+    const BwppAstFn *fn = bwpp_ast_fn_of(m, e->sym);
+    if (!fn) {
+      fprintf(stderr, "graph: unknown function %.*s\n", (int)name.len, name.ptr);
+      return BWPP_GRAPH_NO_VALUE;
+    }
+    return bwpp_graph_inline_call(b, fn, call, region);
   }
-  return BWPP_GRAPH_NO_VALUE;
-}
 
-static uint32_t bwpp_graph_inline_call(const BwppFnDef *fn,
-                                       BwppGraphBuilder *builder,
-                                       BwppFnTable *fns,
-                                       BwppFnStack *stack,
-                                       const uint32_t *args,
-                                       uint32_t arg_count,
-                                       uint32_t inherited_region) {
-  if (!fn || !builder) {
-    return BWPP_GRAPH_NO_VALUE;
+  for (uint32_t a = e->first; a != BWPP_AST_NO_EXPR; a = m->exprs[a].next) {
+    uint32_t arg = bwpp_graph_lower_expr(b, a, region);
+    if (arg == BWPP_GRAPH_NO_VALUE) {
+      return BWPP_GRAPH_NO_VALUE;
+    }
+    if (argc < BWPP_GRAPH_MAX_INPUTS) {
+      args[argc++] = arg;
+    }
   }
-  if (fn->param_count != arg_count) {
-    return BWPP_GRAPH_NO_VALUE;
+
+  BwppShape out_shape = {0};
+  BwppDType dtype = BWPP_DTYPE_UNKNOWN;
+  BwppLayout layout = BWPP_LAYOUT_UNKNOWN;
+  if (argc >= 1) {
+    dtype = g->values[args[0]].dtype;
+    layout = g->values[args[0]].layout;
+    bwpp_shape_copy(&out_shape, &g->values[args[0]].shape);
   }
-  if (bwpp_fn_stack_contains(stack, fn->name)) {
-    return BWPP_GRAPH_NO_VALUE;
+  if (op == BWPP_GOP_MATMUL && argc >= 2) {
+    BwppShape a = g->values[args[0]].shape;
+    BwppShape bshape = g->values[args[1]].shape;
+    if (a.rank >= 2 && bshape.rank >= 2) {
+      out_shape = bwpp_shape_matmul(&a, &bshape);
+    }
+  } else if (op == BWPP_GOP_BATCH_MATMUL && argc >= 2) {
+    bwpp_shape_copy(&out_shape, &g->values[args[0]].shape);
+  } else if ((op == BWPP_GOP_ADD || op == BWPP_GOP_SUB || op == BWPP_GOP_MUL || op == BWPP_GOP_DIV) &&
+             argc >= 2) {
+    BwppShape a = g->values[args[0]].shape;
+    BwppShape bshape = g->values[args[1]].shape;
+    out_shape = bwpp_shape_broadcast(&a, &bshape);
   }
 
-  uint32_t mark = builder->binding_count;
-  for (uint32_t i = 0; i < arg_count; ++i) {
-    bwpp_binding_set(builder, fn->params[i], args[i]);
+  uint32_t flags = 0;
+  if (op == BWPP_GOP_ADD) {
+    for (uint32_t i = 0; i < argc; ++i) {
+      BwppStr nm = g->values[args[i]].name;
+      if (nm.ptr && bwpp_str_eq(nm, "bias")) {
+        flags |= BWPP_GRAPH_OPF_HAS_BIAS;
+      }
+    }
   }
+  return bwpp_graph_add_op_node(g, op, args, argc, &attr, &out_shape, dtype, layout, flags);
+}
 
-  BwppGraphParser parser;
-  bwpp_lexer_init(&parser.lx, fn->body.ptr, fn->body.len);
-  parser.has_lookahead = 0;
-
-  if (!bwpp_fn_stack_push(stack, fn->name)) {
-    builder->binding_count = mark;
-    return BWPP_GRAPH_NO_VALUE;
+static uint32_t bwpp_graph_lower_expr(BwppGraphBuilder *b, uint32_t expr, uint32_t region) {
+  const BwppAstExpr *e = &b->module->exprs[expr];
+  switch (e->kind) {
+    case BWPP_AST_EXPR_NAME:
+      return bwpp_graph_get_or_add_input(b, e->text, e->sym);
+    case BWPP_AST_EXPR_NUMBER: {
+      BwppGraphValue v = {0};
+      v.name = e->text;
+      v.dtype = BWPP_DTYPE_F32;
+      v.layout = BWPP_LAYOUT_UNKNOWN;
+      v.shape.rank = 0;
+      v.producer = BWPP_GRAPH_NO_NODE;
+      v.flags = BWPP_GRAPH_VALUE_CONST;
+      return bwpp_graph_add_value(b->graph, v);
+    }
+    case BWPP_AST_EXPR_CALL:
+      return bwpp_graph_lower_call(b, expr, region);
+    case BWPP_AST_EXPR_MATMUL: {
+      uint32_t lhs = bwpp_graph_lower_arg(b, expr, 0, region);
+      uint32_t rhs = lhs == BWPP_GRAPH_NO_VALUE ? lhs : bwpp_graph_lower_arg(b, expr, 1, region);
+      if (rhs == BWPP_GRAPH_NO_VALUE) {
+        return BWPP_GRAPH_NO_VALUE;
+      }
+      uint32_t inputs[2] = { lhs, rhs };
+      BwppShape out_shape = bwpp_shape_matmul(&b->graph->values[lhs].shape, &b->graph->values[rhs].shape);
+      return bwpp_graph_add_op_node(b->graph, BWPP_GOP_MATMUL, inputs, 2, NULL, &out_shape,
+                                    b->graph->values[lhs].dtype, b->graph->values[lhs].layout, 0);
+    }
+    case BWPP_AST_EXPR_LIST:
+    default:
+      return BWPP_GRAPH_NO_VALUE;
   }
-  uint32_t val = bwpp_graph_parse_body(&parser, builder, fns, stack, inherited_region, 0);
-  bwpp_fn_stack_pop(stack);
-  builder->binding_count = mark;
-  return val;
 }
 
-static int bwpp_collect_functions(const BwppAstModule *module, BwppFnTable *table) {
-  if (!module || !module->source || !table) {
-    return 0;
+/* Nodes from `first` on that no inner region claimed join `region`. */
+static void bwpp_graph_mark_region(BwppGraph *g, uint32_t first, uint32_t region) {
+  for (uint32_t i = first; region != BWPP_GRAPH_NO_REGION && i < g->node_count; ++i) {
+    if (g->nodes[i].region_id == BWPP_GRAPH_NO_REGION) {
+      g->nodes[i].region_id = region;
+    }
   }
-  BwppGraphParser parser;
-  bwpp_lexer_init(&parser.lx, module->source, module->length);
-  parser.has_lookahead = 0;
+}
 
-  for (;;) {
-    BwppToken tok = bwpp_graph_next(&parser);
-    if (tok.kind == BWPP_TOK_EOF) {
-      break;
-    }
-    if (!(tok.kind == BWPP_TOK_IDENT && bwpp_tok_is(&tok, "fn"))) {
-      continue;
-    }
-    BwppToken name = bwpp_graph_next(&parser);
-    if (name.kind != BWPP_TOK_IDENT) {
-      return 0;
-    }
-    BwppParamList params = {0};
-    if (!bwpp_parse_params(&parser, NULL, &params)) {
-      bwpp_param_list_free(&params);
-      return 0;
-    }
-    BwppToken open = bwpp_graph_next(&parser);
-    while (open.kind != BWPP_TOK_EOF &&
-           !(open.kind == BWPP_TOK_SYMBOL && open.length == 1 && open.lexeme[0] == '{')) {
-      open = bwpp_graph_next(&parser);
-    }
-    if (open.kind == BWPP_TOK_EOF) {
-      bwpp_param_list_free(&params);
-      return 0;
-    }
-    const char *body_start = open.lexeme + 1;
-    int depth = 1;
-    const char *body_end = body_start;
-    for (;;) {
-      BwppToken t = bwpp_graph_next(&parser);
-      if (t.kind == BWPP_TOK_EOF) {
-        bwpp_param_list_free(&params);
+/* Statements [first, end) of a body. `*ret` gets the value of the first
+   `return` reached; 0 if a statement failed to lower. */
+static int bwpp_graph_lower_body(BwppGraphBuilder *b,
+                                 uint32_t first,
+                                 uint32_t end,
+                                 uint32_t inherited_region,
+                                 int mark_output,
+                                 uint32_t *ret) {
+  const BwppAstModule *m = b->module;
+  uint32_t i = first;
+  while (i < end) {
+    const BwppAstStmt *s = &m->stmts[i];
+    if (s->kind == BWPP_AST_STMT_BLOCK) {
+      uint32_t region = inherited_region;
+      if (s->region != BWPP_AST_NO_REGION && region == BWPP_GRAPH_NO_REGION) {
+        region = bwpp_graph_add_region(b->graph, BWPP_REGION_REVERSIBLE, bwpp_graph_region_policy(m, s->region));
+        if (region == BWPP_GRAPH_NO_REGION) {
+          return 0;
+        }
+      }
+      if (!bwpp_graph_lower_body(b, i + 1, s->end, region, mark_output, ret)) {
         return 0;
       }
-      if (t.kind == BWPP_TOK_SYMBOL && t.length == 1) {
-        if (t.lexeme[0] == '{') {
-          depth++;
-        } else if (t.lexeme[0] == '}') {
-          depth--;
-          if (depth == 0) {
-            body_end = t.lexeme;
-            break;
-          }
-        }
+      if (*ret != BWPP_GRAPH_NO_VALUE) {
+        return 1;
       }
+      i = s->end;
+      continue;
     }
-
-    BwppFnDef def = {0};
-    def.name = bwpp_tok_str(&name);
-    def.sig_start = tok.lexeme;
-    def.body.ptr = body_start;
-    def.body.len = (size_t)(body_end - body_start);
-    def.params = params.names;
-    def.param_count = params.count;
-    if (!bwpp_fn_table_add(table, def)) {
-      bwpp_param_list_free(&params);
+    uint32_t first_node = b->graph->node_count;
+    uint32_t val = bwpp_graph_lower_expr(b, s->expr, inherited_region);
+    if (val == BWPP_GRAPH_NO_VALUE) {
       return 0;
     }
-  }
-  return 1;
-}
-
-static int bwpp_emit_inputs_for_fn(BwppGraphBuilder *builder, const BwppFnDef *fn) {
-  if (!builder || !builder->graph || !fn || !fn->sig_start || !fn->body.ptr) {
-    return 0;
-  }
-  size_t len = (size_t)(fn->body.ptr - fn->sig_start);
-  BwppGraphParser parser;
-  bwpp_lexer_init(&parser.lx, fn->sig_start, len);
-  parser.has_lookahead = 0;
-  BwppToken tok = bwpp_graph_next(&parser);
-  if (!(tok.kind == BWPP_TOK_IDENT && bwpp_tok_is(&tok, "fn"))) {
-    return 0;
-  }
-  BwppToken name = bwpp_graph_next(&parser);
-  if (name.kind != BWPP_TOK_IDENT) {
-    return 0;
-  }
-  if (!bwpp_parse_params(&parser, builder, NULL)) {
-    return 0;
+    bwpp_graph_mark_region(b->graph, first_node, inherited_region);
+    if (s->kind == BWPP_AST_STMT_LET) {
+      bwpp_template_note_rename(b, val);
+      b->graph->values[val].name = s->name;
+      bwpp_binding_set(b, s->sym, val);
+    } else {
+      if (mark_output) {
+        b->graph->values[val].flags |= BWPP_GRAPH_VALUE_OUTPUT;
+        bwpp_graph_add_output(b->graph, val);
+      }
+      *ret = val;
+      return 1;
+    }
+    i++;
   }
   return 1;
 }
 
 BwppGraph *bwpp_graph_build(const BwppAstModule *module, const char *entry) {
-  if (!module || !module->source) {
+  if (!module || module->fn_count == 0) {
     return NULL;
   }
-  BwppGraph *graph = (BwppGraph *)calloc(1, sizeof(BwppGraph));
+  const BwppAstFn *target = &module->fns[0];
+  if (entry && entry[0] != '\0') {
+    BwppStr name = { entry, strlen(entry) };
+    target = bwpp_ast_find_fn(module, name);
+    if (!target) {
+      return NULL;
+    }
+  }
+  BwppGraph *graph = bwpp_graph_create();
   if (!graph) {
     return NULL;
   }
 
   BwppGraphBuilder builder = {0};
   builder.graph = graph;
-
-  BwppFnTable fns = {0};
-  if (!bwpp_collect_functions(module, &fns) || fns.count == 0) {
-    bwpp_fn_table_destroy(&fns);
+  builder.module = module;
+  bwpp_chunk_arena_init(&builder.arena, 64 * 1024);
+  size_t sym_bytes = (module->symbols.count + 1) * sizeof(uint32_t);
+  builder.value_of_sym = (uint32_t *)bwpp_chunk_arena_alloc(&builder.arena, sym_bytes, sizeof(uint32_t));
+  builder.bound_at = (uint32_t *)bwpp_chunk_arena_alloc(&builder.arena, sym_bytes, sizeof(uint32_t));
+  builder.inlining = (uint8_t *)bwpp_chunk_arena_alloc(&builder.arena, module->fn_count, 1);
+  builder.template_of_fn = (uint32_t *)bwpp_chunk_arena_alloc(&builder.arena, module->fn_count * sizeof(uint32_t),
+                                                              sizeof(uint32_t));
+  builder.recording = BWPP_NO_TEMPLATE;
+  if (!builder.value_of_sym || !builder.bound_at || !builder.inlining || !builder.template_of_fn) {
+    bwpp_chunk_arena_destroy(&builder.arena);
     bwpp_graph_destroy(graph);
     return NULL;
   }
-
-  BwppFnDef *target = NULL;
-  if (entry && entry[0] != '\0') {
-    size_t len = strlen(entry);
-    for (uint32_t i = 0; i < fns.count; ++i) {
-      if (fns.items[i].name.len == len &&
-          strncmp(fns.items[i].name.ptr, entry, len) == 0) {
-        target = &fns.items[i];
-        break;
-      }
+  for (uint32_t i = 0; i < module->symbols.count; ++i) {
+    builder.value_of_sym[i] = BWPP_GRAPH_NO_VALUE;
+    builder.bound_at[i] = 0;
+  }
+  memset(builder.inlining, 0, module->fn_count);
+  for (uint32_t i = 0; i < module->fn_count; ++i) {
+    builder.template_of_fn[i] = BWPP_NO_TEMPLATE;
+  }
+  for (uint32_t i = 0; i < target->param_count; ++i) {
+    const BwppAstParam *p = &module->params[target->params + i];
+    BwppGraphValue v = {0};
+    v.name = p->name;
+    v.dtype = bwpp_parse_dtype(p->type.dtype);
+    v.layout = bwpp_parse_layout(p->type.layout);
+    v.shape = bwpp_graph_type_shape(&p->type);
+    v.producer = BWPP_GRAPH_NO_NODE;
+    v.flags = BWPP_GRAPH_VALUE_INPUT;
+    uint32_t id = bwpp_graph_add_value(graph, v);
+    if (id != BWPP_GRAPH_NO_VALUE) {
+      bwpp_binding_set(&builder, p->sym, id);
     }
-  } else {
-    target = &fns.items[0];
   }
 
-  if (!target) {
-    bwpp_fn_table_destroy(&fns);
-    bwpp_graph_destroy(graph);
-    return NULL;
+  uint32_t ret = BWPP_GRAPH_NO_VALUE;
+  uint32_t entry_region = BWPP_GRAPH_NO_REGION;
+  if (target->region != BWPP_AST_NO_REGION) {
+    entry_region = bwpp_graph_add_region(graph, BWPP_REGION_REVERSIBLE,
+                                         bwpp_graph_region_policy(module, target->region));
   }
-
-  if (!bwpp_emit_inputs_for_fn(&builder, target)) {
-    bwpp_fn_table_destroy(&fns);
-    free(builder.bindings);
-    bwpp_graph_destroy(graph);
-    return NULL;
+  builder.inlining[target - module->fns] = 1;
+  int ok = bwpp_graph_lower_body(&builder, target->stmts, target->stmt_end, entry_region, 1, &ret);
+  bwpp_chunk_arena_destroy(&builder.arena);
+  if (ok && ret == BWPP_GRAPH_NO_VALUE) {
+    fprintf(stderr, "graph: %.*s does not return a value\n", (int)target->name.len, target->name.ptr);
   }
 
-  BwppGraphParser parser;
-  bwpp_lexer_init(&parser.lx, target->body.ptr, target->body.len);
-  parser.has_lookahead = 0;
-
-  BwppFnStack stack = {0};
-  if (!bwpp_fn_stack_push(&stack, target->name)) {
-    bwpp_fn_table_destroy(&fns);
-    free(builder.bindings);
-    bwpp_graph_destroy(graph);
-    return NULL;
+  for (uint32_t i = 0; ok && i < module->dim_count; ++i) {
+    BwppDimBinding dim;
+    dim.name = module->dims[i].name;
+    dim.value = module->dims[i].value;
+    ok = bwpp_graph_bind_dims(graph, &dim, 1) == BWPP_OK;
   }
-  uint32_t ret = bwpp_graph_parse_body(&parser, &builder, &fns, &stack,
-                                       BWPP_GRAPH_NO_REGION, 1);
-  bwpp_fn_stack_pop(&stack);
-
-  free(stack.items);
-  free(builder.bindings);
-  bwpp_fn_table_destroy(&fns);
-
-  if (ret == BWPP_GRAPH_NO_VALUE) {
+  if (!ok || ret == BWPP_GRAPH_NO_VALUE || bwpp_graph_bind_dims(graph, NULL, 0) != BWPP_OK) {
     bwpp_graph_destroy(graph);
     return NULL;
   }
   return graph;
 }
 
-static const char *bwpp_op_name(BwppGraphOpKind op) {
+const char *bwpp_graph_op_name(BwppGraphOpKind op) {
   switch (op) {
     case BWPP_GOP_MATMUL: return "matmul";
     case BWPP_GOP_BATCH_MATMUL: return "batch_matmul";
@@ -1269,11 +1107,38 @@ static const char *bwpp_op_name(BwppGraphOpKind op) {
   }
 }
 
+int bwpp_graph_op_inplace(BwppGraphOpKind op) {
+  switch (op) {
+    case BWPP_GOP_ADD:
+    case BWPP_GOP_SUB:
+    case BWPP_GOP_MUL:
+    case BWPP_GOP_DIV:
+    case BWPP_GOP_SILU:
+    case BWPP_GOP_SILU_GRAD:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+BwppShape bwpp_graph_operand_shape(const BwppGraph *graph, const BwppGraphNode *n, uint32_t i) {
+  BwppShape out = graph->values[n->inputs[i]].shape;
+  uint32_t trans = i == 0 ? BWPP_GRAPH_OPF_TRANS_A : (i == 1 ? BWPP_GRAPH_OPF_TRANS_B : 0);
+  if ((n->op == BWPP_GOP_MATMUL || n->op == BWPP_GOP_BATCH_MATMUL) && (n->flags & trans) && out.rank >= 2) {
+    out = bwpp_shape_transpose(&out);
+    uint32_t tmp = out.sizes[out.rank - 2];
+    out.sizes[out.rank - 2] = out.sizes[out.rank - 1];
+    out.sizes[out.rank - 1] = tmp;
+  }
+  return out;
+}
+
 static const char *bwpp_dtype_name(BwppDType dt) {
   switch (dt) {
     case BWPP_DTYPE_F16: return "f16";
     case BWPP_DTYPE_BF16: return "bf16";
     case BWPP_DTYPE_F32: return "f32";
+    case BWPP_DTYPE_U32: return "u32";
     default: return "unknown";
   }
 }
@@ -1290,6 +1155,9 @@ static void bwpp_print_shape(FILE *out, const BwppShape *shape) {
     if (shape->dims[i].ptr) {
       fprintf(out, "%.*s", (int)shape->dims[i].len, shape->dims[i].ptr);
     }
+    if (shape->sizes[i] && !bwpp_str_is_number(shape->dims[i])) {
+      fprintf(out, "=%u", shape->sizes[i]);
+    }
   }
   fprintf(out, "]");
 }
@@ -1312,14 +1180,15 @@ void bwpp_graph_dump(const BwppGraph *graph, FILE *out) {
   }
   for (uint32_t i = 0; i < graph->node_count; ++i) {
     const BwppGraphNode *n = &graph->nodes[i];
-    fprintf(out, "  n%u %s (", n->id, bwpp_op_name(n->op));
+    fprintf(out, "  n%u %s (", n->id, bwpp_graph_op_name(n->op));
     for (uint32_t j = 0; j < n->input_count; ++j) {
       if (j) {
         fprintf(out, ",");
       }
       fprintf(out, "v%u", n->inputs[j]);
     }
-    fprintf(out, ") -> v%u\n", n->output);
+    fprintf(out, ") -> v%u%s%s\n", n->output, (n->flags & BWPP_GRAPH_OPF_TRANS_A) ? " trans_a" : "",
+            (n->flags & BWPP_GRAPH_OPF_TRANS_B) ? " trans_b" : "");
   }
 }
 
@@ -1348,9 +1217,10 @@ void bwpp_graph_dump_dot(const BwppGraph *graph, FILE *out) {
   }
   for (uint32_t i = 0; i < graph->node_count; ++i) {
     const BwppGraphNode *n = &graph->nodes[i];
-    fprintf(out, "  n%u [shape=box, label=\"%s\"];\n", n->id, bwpp_op_name(n->op));
+    fprintf(out, "  n%u [shape=box, label=\"%s\"];\n", n->id, bwpp_graph_op_name(n->op));
     for (uint32_t j = 0; j < n->input_count; ++j) {
-      fprintf(out, "  v%u -> n%u;\n", n->inputs[j], n->id);
+      uint32_t trans = j == 0 ? BWPP_GRAPH_OPF_TRANS_A : (j == 1 ? BWPP_GRAPH_OPF_TRANS_B : 0);
+      fprintf(out, "  v%u -> n%u%s;\n", n->inputs[j], n->id, (n->flags & trans) ? " [label=\"T\"]" : "");
     }
     fprintf(out, "  n%u -> v%u;\n", n->id, n->output);
   }
@@ -1469,6 +1339,23 @@ static uint32_t bwpp_graph_broadcast_to_shape(BwppGraph *g,
                                 0);
 }
 
+/* a @ b with the operands read transposed as `flags` say; dtype and layout
+   of `like`. */
+static uint32_t bwpp_graph_add_matmul(BwppGraph *g, uint32_t a, uint32_t b, uint32_t flags, uint32_t like) {
+  BwppShape sa = g->values[a].shape;
+  BwppShape sb = g->values[b].shape;
+  if (flags & BWPP_GRAPH_OPF_TRANS_A) {
+    sa = bwpp_shape_transpose(&sa);
+  }
+  if (flags & BWPP_GRAPH_OPF_TRANS_B) {
+    sb = bwpp_shape_transpose(&sb);
+  }
+  uint32_t inputs[2] = { a, b };
+  BwppShape out = bwpp_shape_matmul(&sa, &sb);
+  return bwpp_graph_add_op_node(g, BWPP_GOP_MATMUL, inputs, 2, NULL, &out, g->values[like].dtype,
+                                g->values[like].layout, flags);
+}
+
 static uint32_t bwpp_graph_accum_grad(BwppGraph *g, uint32_t existing, uint32_t add_val) {
   if (existing == BWPP_GRAPH_NO_VALUE) {
     return add_val;
@@ -1482,17 +1369,66 @@ static uint32_t bwpp_graph_accum_grad(BwppGraph *g, uint32_t existing, uint32_t
                                 0);
 }
 
-BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
+static void *bwpp_graph_dup_array(BwppGraph *g, const void *src, uint32_t count, size_t size, size_t align,
+                                  uint32_t *capacity) {
+  *capacity = count;
+  if (count == 0) {
+    return NULL;
+  }
+  void *dst = bwpp_chunk_arena_alloc(&g->arena, count * size, align);
+  if (dst) {
+    memcpy(dst, src, count * size);
+  }
+  return dst;
+}
+
+BwppGraph *bwpp_graph_clone(const BwppGraph *src) {
+  BwppGraph *g = bwpp_graph_create();
+  if (!g) {
+    return NULL;
+  }
+  g->nodes = (BwppGraphNode *)bwpp_graph_dup_array(g, src->nodes, src->node_count, sizeof(BwppGraphNode),
+                                                   _Alignof(BwppGraphNode), &g->node_capacity);
+  g->values = (BwppGraphValue *)bwpp_graph_dup_array(g, src->values, src->value_count, sizeof(BwppGraphValue),
+                                                     _Alignof(BwppGraphValue), &g->value_capacity);
+  g->regions = (BwppGraphRegion *)bwpp_graph_dup_array(g, src->regions, src->region_count, sizeof(BwppGraphRegion),
+                                                       _Alignof(BwppGraphRegion), &g->region_capacity);
+  g->outputs = (uint32_t *)bwpp_graph_dup_array(g, src->outputs, src->output_count, sizeof(uint32_t),
+                                                _Alignof(uint32_t), &g->output_capacity);
+  g->dims = (BwppDimBinding *)bwpp_graph_dup_array(g, src->dims, src->dim_count, sizeof(BwppDimBinding),
+                                                   _Alignof(BwppDimBinding), &g->dim_capacity);
+  g->node_count = src->node_count;
+  g->value_count = src->value_count;
+  g->region_count = src->region_count;
+  g->output_count = src->output_count;
+  g->dim_count = src->dim_count;
+  g->forward_nodes = src->forward_nodes;
+  if ((src->node_count && !g->nodes) || (src->value_count && !g->values) ||
+      (src->region_count && !g->regions) || (src->output_count && !g->outputs) ||
+      (src->dim_count && !g->dims)) {
+    bwpp_graph_destroy(g);
+    return NULL;
+  }
+  return g;
+}
+
+/* With `joint`, backward nodes are appended to a copy of the forward graph and
+   read forward values directly; otherwise they go into a graph of their own
+   that imports the activations it needs as inputs. */
+static BwppGraph *bwpp_graph_backward(const BwppGraph *graph, int joint) {
   if (!graph) {
     return NULL;
   }
-  BwppGraph *grad = (BwppGraph *)calloc(1, sizeof(BwppGraph));
+  BwppGraph *grad = joint ? bwpp_graph_clone(graph) : bwpp_graph_create();
   if (!grad) {
     return NULL;
   }
+  if (joint) {
+    grad->forward_nodes = graph->node_count;
+  }
 
-  uint32_t *act_map = (uint32_t *)malloc(sizeof(uint32_t) * graph->value_count);
-  uint32_t *grad_map = (uint32_t *)malloc(sizeof(uint32_t) * graph->value_count);
+  uint32_t *act_map = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * graph->value_count);
+  uint32_t *grad_map = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * graph->value_count);
   if (!act_map || !grad_map) {
     free(act_map);
     free(grad_map);
@@ -1500,11 +1436,11 @@ BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
     return NULL;
   }
   for (uint32_t i = 0; i < graph->value_count; ++i) {
-    act_map[i] = BWPP_GRAPH_NO_VALUE;
+    act_map[i] = joint ? i : BWPP_GRAPH_NO_VALUE;
     grad_map[i] = BWPP_GRAPH_NO_VALUE;
   }
 
-  for (uint32_t i = 0; i < graph->value_count; ++i) {
+  for (uint32_t i = 0; i < graph->value_count && !joint; ++i) {
     if (graph->values[i].flags & BWPP_GRAPH_VALUE_INPUT) {
       act_map[i] = bwpp_graph_clone_value(grad, graph, i, BWPP_GRAPH_VALUE_INPUT);
     }
@@ -1532,52 +1468,18 @@ BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
       uint32_t actA = bwpp_graph_import_activation(grad, graph, act_map, a);
       uint32_t actB = bwpp_graph_import_activation(grad, graph, act_map, b);
 
-      uint32_t tB_inputs[1] = { actB };
-      BwppShape tB_shape = grad->values[actB].shape;
-      if (tB_shape.rank == 2) {
-        BwppStr tmp = tB_shape.dims[0];
-        tB_shape.dims[0] = tB_shape.dims[1];
-        tB_shape.dims[1] = tmp;
-      }
-      uint32_t tB = bwpp_graph_add_op_node(grad, BWPP_GOP_TRANSPOSE, tB_inputs, 1, NULL, &tB_shape,
-                                           grad->values[actB].dtype,
-                                           grad->values[actB].layout,
-                                           0);
-      uint32_t dA_inputs[2] = { dY, tB };
-      BwppShape dA_shape = {0};
-      if (grad->values[dY].shape.rank == 2 && tB_shape.rank == 2) {
-        dA_shape.rank = 2;
-        dA_shape.dims[0] = grad->values[dY].shape.dims[0];
-        dA_shape.dims[1] = tB_shape.dims[1];
-      }
-      uint32_t dA = bwpp_graph_add_op_node(grad, BWPP_GOP_MATMUL, dA_inputs, 2, NULL, &dA_shape,
-                                           grad->values[dY].dtype,
-                                           grad->values[dY].layout,
-                                           0);
+      /* C = op(A) op(B): the gradients read A, B and dY transposed in place
+         rather than through transpose nodes; a stored-transposed operand
+         gets its gradient in the stored layout */
+      int ta = (n->flags & BWPP_GRAPH_OPF_TRANS_A) != 0;
+      int tb = (n->flags & BWPP_GRAPH_OPF_TRANS_B) != 0;
+      uint32_t dA = ta ? bwpp_graph_add_matmul(grad, actB, dY,
+                                               (tb ? BWPP_GRAPH_OPF_TRANS_A : 0) | BWPP_GRAPH_OPF_TRANS_B, dY)
+                       : bwpp_graph_add_matmul(grad, dY, actB, tb ? 0 : BWPP_GRAPH_OPF_TRANS_B, dY);
       grad_map[a] = bwpp_graph_accum_grad(grad, grad_map[a], dA);
-
-      uint32_t tA_inputs[1] = { actA };
-      BwppShape tA_shape = grad->values[actA].shape;
-      if (tA_shape.rank == 2) {
-        BwppStr tmp = tA_shape.dims[0];
-        tA_shape.dims[0] = tA_shape.dims[1];
-        tA_shape.dims[1] = tmp;
-      }
-      uint32_t tA = bwpp_graph_add_op_node(grad, BWPP_GOP_TRANSPOSE, tA_inputs, 1, NULL, &tA_shape,
-                                           grad->values[actA].dtype,
-                                           grad->values[actA].layout,
-                                           0);
-      uint32_t dB_inputs[2] = { tA, dY };
-      BwppShape dB_shape = {0};
-      if (tA_shape.rank == 2 && grad->values[dY].shape.rank == 2) {
-        dB_shape.rank = 2;
-        dB_shape.dims[0] = tA_shape.dims[0];
-        dB_shape.dims[1] = grad->values[dY].shape.dims[1];
-      }
-      uint32_t dB = bwpp_graph_add_op_node(grad, BWPP_GOP_MATMUL, dB_inputs, 2, NULL, &dB_shape,
-                                           grad->values[dY].dtype,
-                                           grad->values[dY].layout,
-                                           0);
+      uint32_t dB = tb ? bwpp_graph_add_matmul(grad, dY, actA,
+                                               BWPP_GRAPH_OPF_TRANS_A | (ta ? BWPP_GRAPH_OPF_TRANS_B : 0), dY)
+                       : bwpp_graph_add_matmul(grad, actA, dY, ta ? 0 : BWPP_GRAPH_OPF_TRANS_A, dY);
       grad_map[b] = bwpp_graph_accum_grad(grad, grad_map[b], dB);
       continue;
     }
@@ -1655,12 +1557,7 @@ BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
 
     if (n->op == BWPP_GOP_TRANSPOSE && n->input_count >= 1) {
       uint32_t inputs[1] = { dY };
-      BwppShape out_shape = grad->values[dY].shape;
-      if (out_shape.rank == 2) {
-        BwppStr tmp = out_shape.dims[0];
-        out_shape.dims[0] = out_shape.dims[1];
-        out_shape.dims[1] = tmp;
-      }
+      BwppShape out_shape = bwpp_shape_transpose(&grad->values[dY].shape);
       uint32_t dX = bwpp_graph_add_op_node(grad, BWPP_GOP_TRANSPOSE, inputs, 1, NULL, &out_shape,
                                            grad->values[dY].dtype,
                                            grad->values[dY].layout,
@@ -1820,7 +1717,7 @@ BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
       continue;
     }
 
-    fprintf(stderr, "autodiff: op %s not supported yet\n", bwpp_op_name(n->op));
+    fprintf(stderr, "autodiff: op %s not supported yet\n", bwpp_graph_op_name(n->op));
   }
 
   for (uint32_t i = 0; i < graph->value_count; ++i) {
@@ -1835,21 +1732,40 @@ BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
 
   free(act_map);
   free(grad_map);
+  /* the copy already carries the bindings; this refreshes the new values */
+  if (bwpp_graph_bind_dims(grad, joint ? NULL : graph->dims, joint ? 0 : graph->dim_count) != BWPP_OK) {
+    bwpp_graph_destroy(grad);
+    return NULL;
+  }
   return grad;
 }
 
+BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph) {
+  return bwpp_graph_backward(graph, 0);
+}
+
+BwppGraph *bwpp_graph_training_step(const BwppGraph *graph) {
+  return bwpp_graph_backward(graph, 1);
+}
+
 void bwpp_graph_destroy(BwppGraph *graph) {
   if (!graph) {
     return;
   }
-  free(graph->nodes);
-  free(graph->values);
-  free(graph->regions);
-  free(graph->outputs);
-  free(graph);
+  /* the graph lives in its own arena, so copy the arena out first */
+  BwppChunkArena arena = graph->arena;
+  bwpp_chunk_arena_destroy(&arena);
 }
 
-int bwpp_graph_detect_attention(const BwppGraph *graph) {
+static int bwpp_graph_producer_is(const BwppGraph *graph, uint32_t value, BwppGraphOpKind op) {
+  if (value >= graph->value_count) {
+    return 0;
+  }
+  uint32_t prod = graph->values[value].producer;
+  return prod != BWPP_GRAPH_NO_NODE && prod < graph->node_count && graph->nodes[prod].op == op;
+}
+
+int bwpp_graph_attention_info(const BwppGraph *graph, BwppGraphAttentionInfo *info) {
   if (!graph) {
     return 0;
   }
@@ -1858,19 +1774,20 @@ int bwpp_graph_detect_attention(const BwppGraph *graph) {
     if (mm->op != BWPP_GOP_MATMUL || mm->input_count < 2) {
       continue;
     }
-    int has_transpose = 0;
-    for (uint32_t j = 0; j < mm->input_count; ++j) {
-      uint32_t v = mm->inputs[j];
-      if (v < graph->value_count) {
-        uint32_t prod = graph->values[v].producer;
-        if (prod != BWPP_GRAPH_NO_NODE && prod < graph->node_count &&
-            graph->nodes[prod].op == BWPP_GOP_TRANSPOSE) {
-          has_transpose = 1;
-          break;
-        }
+    /* keys come transposed: through a transpose node, or read so in place */
+    uint32_t k_side = mm->input_count;
+    int k_folded = 0;
+    if (mm->flags & (BWPP_GRAPH_OPF_TRANS_A | BWPP_GRAPH_OPF_TRANS_B)) {
+      k_side = (mm->flags & BWPP_GRAPH_OPF_TRANS_B) ? 1 : 0;
+      k_folded = 1;
+    }
+    for (uint32_t j = 0; j < mm->input_count && !k_folded; ++j) {
+      if (bwpp_graph_producer_is(graph, mm->inputs[j], BWPP_GOP_TRANSPOSE)) {
+        k_side = j;
+        break;
       }
     }
-    if (!has_transpose) {
+    if (k_side > 1) {
       continue;
     }
     uint32_t scores = mm->output;
@@ -1888,12 +1805,109 @@ int bwpp_graph_detect_attention(const BwppGraph *graph) {
     uint32_t probs = graph->nodes[softmax_node].output;
     for (uint32_t j = 0; j < graph->node_count; ++j) {
       const BwppGraphNode *mm2 = &graph->nodes[j];
-      if (mm2->op == BWPP_GOP_MATMUL && mm2->input_count >= 2) {
-        if (mm2->inputs[0] == probs || mm2->inputs[1] == probs) {
-          return 1;
+      if (mm2->op != BWPP_GOP_MATMUL || mm2->input_count < 2 ||
+          (mm2->inputs[0] != probs && mm2->inputs[1] != probs)) {
+        continue;
+      }
+      if (info) {
+        memset(info, 0, sizeof(*info));
+        info->mask = graph->nodes[softmax_node].attr.mask;
+        info->q = mm->inputs[1 - k_side];
+        info->k = k_folded ? mm->inputs[k_side] : graph->nodes[graph->values[mm->inputs[k_side]].producer].inputs[0];
+        info->v = mm2->inputs[0] == probs ? mm2->inputs[1] : mm2->inputs[0];
+        info->kv_len = BWPP_GRAPH_NO_VALUE;
+        if ((info->mask & BWPP_GRAPH_MASK_KV_LEN) && graph->nodes[softmax_node].input_count >= 2) {
+          info->kv_len = graph->nodes[softmax_node].inputs[1];
+        }
+        /* heads sit at axis 1 of [B,H,T,D]; fewer K heads than Q heads is GQA/MQA */
+        const BwppShape *qs = &graph->values[mm->inputs[1 - k_side]].shape;
+        const BwppShape *ks = &graph->values[info->k].shape;
+        if (qs->rank == 4 && ks->rank == 4) {
+          info->q_heads = qs->dims[1];
+          info->kv_heads = ks->dims[1];
+          info->gqa = !bwpp_str_eq_str(qs->dims[1], ks->dims[1]);
         }
       }
+      return 1;
     }
   }
   return 0;
 }
+
+static uint32_t bwpp_graph_dim_size(const BwppGraph *graph, BwppStr dim) {
+  if (bwpp_str_is_number(dim)) {
+    return (uint32_t)strtoul(dim.ptr, NULL, 10);
+  }
+  /* the latest binding of a name wins */
+  for (uint32_t i = graph->dim_count; i > 0; --i) {
+    if (bwpp_str_eq_str(graph->dims[i - 1].name, dim)) {
+      return graph->dims[i - 1].value;
+    }
+  }
+  return 0;
+}
+
+static void bwpp_graph_bind_shape(const BwppGraph *graph, BwppShape *shape) {
+  for (uint32_t i = 0; i < shape->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    shape->sizes[i] = bwpp_graph_dim_size(graph, shape->dims[i]);
+  }
+}
+
+BwppStatus bwpp_graph_bind_dims(BwppGraph *graph, const BwppDimBinding *dims, uint32_t count) {
+  if (!graph || (count && !dims)) {
+    return BWPP_ERR;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!bwpp_graph_reserve(graph, (void **)&graph->dims, graph->dim_count, &graph->dim_capacity,
+                            sizeof(BwppDimBinding), _Alignof(BwppDimBinding))) {
+      return BWPP_ERR;
+    }
+    graph->dims[graph->dim_count++] = dims[i];
+  }
+  for (uint32_t i = 0; i < graph->value_count; ++i) {
+    bwpp_graph_bind_shape(graph, &graph->values[i].shape);
+  }
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    bwpp_graph_bind_shape(graph, &graph->nodes[i].attr.shape);
+  }
+  return BWPP_OK;
+}
+
+int bwpp_shape_bound(const BwppShape *shape) {
+  for (uint32_t i = 0; i < shape->rank; ++i) {
+    if (shape->sizes[i] == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+uint64_t bwpp_shape_elems(const BwppShape *shape) {
+  uint64_t n = 1;
+  for (uint32_t i = 0; i < shape->rank; ++i) {
+    n *= shape->sizes[i];
+  }
+  return n;
+}
+
+BwppStr bwpp_shape_unbound_dim(const BwppShape *shape) {
+  for (uint32_t i = 0; i < shape->rank; ++i) {
+    if (shape->sizes[i] == 0) {
+      return shape->dims[i];
+    }
+  }
+  BwppStr none = { "", 0 };
+  return none;
+}
+
+uint32_t bwpp_dtype_bytes(BwppDType dtype) {
+  switch (dtype) {
+    case BWPP_DTYPE_F16: return 2;
+    case BWPP_DTYPE_BF16: return 2;
+    default: return 4; /* f32, and the u32 key-length inputs */
+  }
+}
+
+int bwpp_graph_detect_attention(const BwppGraph *graph) {
+  return bwpp_graph_attention_info(graph, NULL);
+}
@@ -0,0 +1,383 @@
+#include "graph_opt.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t bwpp_opt_mix(uint32_t h, uint32_t x) {
+  return (h ^ x) * 16777619u;
+}
+
+static uint32_t bwpp_opt_mix_str(uint32_t h, BwppStr s) {
+  for (size_t i = 0; i < s.len; ++i) {
+    h = bwpp_opt_mix(h, (unsigned char)s.ptr[i]);
+  }
+  return bwpp_opt_mix(h, (uint32_t)s.len);
+}
+
+static int bwpp_opt_str_eq(BwppStr a, BwppStr b) {
+  return a.len == b.len && (a.len == 0 || memcmp(a.ptr, b.ptr, a.len) == 0);
+}
+
+static uint32_t bwpp_opt_float_bits(float f) {
+  uint32_t bits = 0;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+static int bwpp_opt_shape_eq(const BwppShape *a, const BwppShape *b) {
+  if (a->rank != b->rank) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < a->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    if (!bwpp_opt_str_eq(a->dims[i], b->dims[i]) || a->sizes[i] != b->sizes[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static uint32_t bwpp_opt_hash_shape(uint32_t h, const BwppShape *s) {
+  h = bwpp_opt_mix(h, s->rank);
+  for (uint32_t i = 0; i < s->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    h = bwpp_opt_mix_str(h, s->dims[i]);
+    h = bwpp_opt_mix(h, s->sizes[i]);
+  }
+  return h;
+}
+
+/* Inputs in canonical order: sorted for add/mul, as given otherwise. */
+static void bwpp_opt_inputs(const BwppGraphNode *n, uint32_t *out) {
+  for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+    out[j] = n->inputs[j];
+  }
+  if ((n->op == BWPP_GOP_ADD || n->op == BWPP_GOP_MUL) && n->input_count == 2 && !n->flags &&
+      out[0] > out[1]) {
+    uint32_t t = out[0];
+    out[0] = out[1];
+    out[1] = t;
+  }
+}
+
+static uint32_t bwpp_opt_hash_node(const BwppGraph *g, const BwppGraphNode *n) {
+  uint32_t in[BWPP_GRAPH_MAX_INPUTS];
+  bwpp_opt_inputs(n, in);
+  uint32_t h = 2166136261u;
+  h = bwpp_opt_mix(h, (uint32_t)n->op);
+  h = bwpp_opt_mix(h, n->input_count);
+  for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+    h = bwpp_opt_mix(h, in[j]);
+  }
+  h = bwpp_opt_mix(h, n->flags);
+  h = bwpp_opt_mix(h, n->region_id);
+  const BwppGraphAttr *a = &n->attr;
+  h = bwpp_opt_mix(h, a->has_axis ? (uint32_t)a->axis + 1u : 0u);
+  h = bwpp_opt_mix(h, a->has_epsilon ? bwpp_opt_float_bits(a->epsilon) : 0u);
+  h = bwpp_opt_hash_shape(h, &a->shape);
+  h = bwpp_opt_mix(h, a->perm_rank);
+  for (uint32_t i = 0; i < a->perm_rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    h = bwpp_opt_mix(h, a->perm[i]);
+  }
+  h = bwpp_opt_mix(h, a->mask);
+  if (n->output < g->value_count) {
+    const BwppGraphValue *v = &g->values[n->output];
+    h = bwpp_opt_mix(h, (uint32_t)v->dtype);
+    h = bwpp_opt_mix(h, (uint32_t)v->layout);
+    h = bwpp_opt_hash_shape(h, &v->shape);
+  }
+  return h;
+}
+
+static int bwpp_opt_node_eq(const BwppGraph *g, const BwppGraphNode *a, const BwppGraphNode *b) {
+  if (a->op != b->op || a->input_count != b->input_count || a->flags != b->flags ||
+      a->region_id != b->region_id) {
+    return 0;
+  }
+  uint32_t ia[BWPP_GRAPH_MAX_INPUTS];
+  uint32_t ib[BWPP_GRAPH_MAX_INPUTS];
+  bwpp_opt_inputs(a, ia);
+  bwpp_opt_inputs(b, ib);
+  for (uint32_t j = 0; j < a->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+    if (ia[j] != ib[j]) {
+      return 0;
+    }
+  }
+  const BwppGraphAttr *x = &a->attr;
+  const BwppGraphAttr *y = &b->attr;
+  if (x->has_axis != y->has_axis || (x->has_axis && x->axis != y->axis) ||
+      x->has_epsilon != y->has_epsilon ||
+      (x->has_epsilon && bwpp_opt_float_bits(x->epsilon) != bwpp_opt_float_bits(y->epsilon)) ||
+      !bwpp_opt_shape_eq(&x->shape, &y->shape) || x->perm_rank != y->perm_rank || x->mask != y->mask) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < x->perm_rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
+    if (x->perm[i] != y->perm[i]) {
+      return 0;
+    }
+  }
+  if (a->output >= g->value_count || b->output >= g->value_count) {
+    return 0;
+  }
+  const BwppGraphValue *va = &g->values[a->output];
+  const BwppGraphValue *vb = &g->values[b->output];
+  return va->dtype == vb->dtype && va->layout == vb->layout && bwpp_opt_shape_eq(&va->shape, &vb->shape);
+}
+
+uint32_t bwpp_graph_cse(BwppGraph *graph) {
+  if (!graph || !graph->node_count) {
+    return 0;
+  }
+  uint32_t cap = 16;
+  while (cap < graph->node_count * 2) {
+    cap *= 2;
+  }
+  uint32_t *table = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * cap);
+  uint32_t *repl = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * (graph->value_count ? graph->value_count : 1));
+  if (!table || !repl) {
+    free(table);
+    free(repl);
+    return 0;
+  }
+  for (uint32_t i = 0; i < cap; ++i) {
+    table[i] = BWPP_GRAPH_NO_NODE;
+  }
+  for (uint32_t i = 0; i < graph->value_count; ++i) {
+    repl[i] = i;
+  }
+
+  uint32_t merged = 0;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    BwppGraphNode *n = &graph->nodes[i];
+    for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+      if (n->inputs[j] < graph->value_count) {
+        n->inputs[j] = repl[n->inputs[j]];
+      }
+    }
+    uint32_t slot = bwpp_opt_hash_node(graph, n) & (cap - 1);
+    while (table[slot] != BWPP_GRAPH_NO_NODE && !bwpp_opt_node_eq(graph, &graph->nodes[table[slot]], n)) {
+      slot = (slot + 1) & (cap - 1);
+    }
+    if (table[slot] == BWPP_GRAPH_NO_NODE) {
+      table[slot] = i;
+      continue;
+    }
+    if (n->output < graph->value_count && !(graph->values[n->output].flags & BWPP_GRAPH_VALUE_OUTPUT)) {
+      repl[n->output] = graph->nodes[table[slot]].output;
+      merged++;
+    }
+  }
+  free(table);
+  free(repl);
+  return merged;
+}
+
+uint32_t bwpp_graph_dce(BwppGraph *graph) {
+  if (!graph || !graph->node_count) {
+    return 0;
+  }
+  uint8_t *live = (uint8_t *)bwpp_xcalloc(graph->value_count ? graph->value_count : 1, 1);
+  uint32_t *node_map = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * graph->node_count);
+  uint32_t *value_map = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * (graph->value_count ? graph->value_count : 1));
+  if (!live || !node_map || !value_map) {
+    free(live);
+    free(node_map);
+    free(value_map);
+    return 0;
+  }
+  for (uint32_t i = 0; i < graph->output_count; ++i) {
+    if (graph->outputs[i] < graph->value_count) {
+      live[graph->outputs[i]] = 1;
+    }
+  }
+  /* nodes are in topological order, so one backward sweep marks everything */
+  uint32_t kept = 0;
+  for (uint32_t i = graph->node_count; i-- > 0;) {
+    const BwppGraphNode *n = &graph->nodes[i];
+    node_map[i] = BWPP_GRAPH_NO_NODE;
+    if (n->output >= graph->value_count || !live[n->output]) {
+      continue;
+    }
+    node_map[i] = 0;
+    kept++;
+    for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+      if (n->inputs[j] < graph->value_count) {
+        live[n->inputs[j]] = 1;
+      }
+    }
+  }
+  uint32_t removed = graph->node_count - kept;
+  if (!removed) {
+    free(live);
+    free(node_map);
+    free(value_map);
+    return 0;
+  }
+
+  uint32_t old_nodes = graph->node_count;
+  uint32_t old_values = graph->value_count;
+  uint32_t value_count = 0;
+  for (uint32_t i = 0; i < graph->value_count; ++i) {
+    if (live[i] || (graph->values[i].flags & BWPP_GRAPH_VALUE_INPUT)) {
+      value_map[i] = value_count;
+      graph->values[value_count] = graph->values[i];
+      graph->values[value_count].id = value_count;
+      value_count++;
+    } else {
+      value_map[i] = BWPP_GRAPH_NO_VALUE;
+    }
+  }
+  graph->value_count = value_count;
+
+  uint32_t node_count = 0;
+  uint32_t forward_nodes = 0;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    if (node_map[i] == BWPP_GRAPH_NO_NODE) {
+      continue;
+    }
+    if (i < graph->forward_nodes) {
+      forward_nodes++;
+    }
+    node_map[i] = node_count;
+    BwppGraphNode *n = &graph->nodes[node_count];
+    *n = graph->nodes[i];
+    n->id = node_count;
+    for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+      n->inputs[j] = value_map[n->inputs[j]];
+    }
+    n->output = value_map[n->output];
+    node_count++;
+  }
+  graph->node_count = node_count;
+  graph->forward_nodes = forward_nodes;
+
+  for (uint32_t i = 0; i < graph->value_count; ++i) {
+    BwppGraphValue *v = &graph->values[i];
+    if (v->producer != BWPP_GRAPH_NO_NODE) {
+      v->producer = v->producer < old_nodes ? node_map[v->producer] : BWPP_GRAPH_NO_NODE;
+    }
+  }
+  for (uint32_t i = 0; i < graph->output_count; ++i) {
+    if (graph->outputs[i] < old_values) {
+      graph->outputs[i] = value_map[graph->outputs[i]];
+    }
+  }
+  free(live);
+  free(node_map);
+  free(value_map);
+  return removed;
+}
+
+/* Permutation a transpose or permute applies (out dim i = in dim perm[i]). */
+static int bwpp_opt_perm(const BwppGraph *g, const BwppGraphNode *n, uint32_t *perm, uint32_t *rank) {
+  if (n->input_count < 1 || n->inputs[0] >= g->value_count) {
+    return 0;
+  }
+  if (n->op == BWPP_GOP_TRANSPOSE) {
+    *rank = g->values[n->inputs[0]].shape.rank;
+    if (*rank < 2 || *rank > BWPP_GRAPH_MAX_DIMS) {
+      return 0;
+    }
+    for (uint32_t i = 0; i < *rank; ++i) {
+      perm[i] = i;
+    }
+    perm[*rank - 2] = *rank - 1;
+    perm[*rank - 1] = *rank - 2;
+    return 1;
+  }
+  if (n->op == BWPP_GOP_PERMUTE && n->attr.perm_rank && n->attr.perm_rank <= BWPP_GRAPH_MAX_DIMS) {
+    *rank = n->attr.perm_rank;
+    for (uint32_t i = 0; i < *rank; ++i) {
+      perm[i] = n->attr.perm[i];
+      if (perm[i] >= *rank) {
+        return 0;
+      }
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/* The node producing `v` when it only swaps the last two dims. */
+static const BwppGraphNode *bwpp_opt_swap_producer(const BwppGraph *g, uint32_t v) {
+  uint32_t p = v < g->value_count ? g->values[v].producer : BWPP_GRAPH_NO_NODE;
+  uint32_t perm[BWPP_GRAPH_MAX_DIMS];
+  uint32_t rank = 0;
+  if (p >= g->node_count || !bwpp_opt_perm(g, &g->nodes[p], perm, &rank)) {
+    return NULL;
+  }
+  for (uint32_t i = 0; i + 2 < rank; ++i) {
+    if (perm[i] != i) {
+      return NULL;
+    }
+  }
+  return perm[rank - 2] == rank - 1 ? &g->nodes[p] : NULL;
+}
+
+uint32_t bwpp_graph_fold_layout(BwppGraph *graph) {
+  if (!graph || !graph->node_count) {
+    return 0;
+  }
+  uint32_t *repl = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * (graph->value_count ? graph->value_count : 1));
+  if (!repl) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < graph->value_count; ++i) {
+    repl[i] = i;
+  }
+  uint32_t folded = 0;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    BwppGraphNode *n = &graph->nodes[i];
+    for (uint32_t j = 0; j < n->input_count && j < BWPP_GRAPH_MAX_INPUTS; ++j) {
+      if (n->inputs[j] < graph->value_count) {
+        n->inputs[j] = repl[n->inputs[j]];
+      }
+    }
+    if (n->input_count < 1 || n->inputs[0] >= graph->value_count || n->output >= graph->value_count) {
+      continue;
+    }
+    int pinned = (graph->values[n->output].flags & BWPP_GRAPH_VALUE_OUTPUT) != 0;
+    uint32_t in = n->inputs[0];
+    uint32_t src = graph->values[in].producer;
+    uint32_t perm[BWPP_GRAPH_MAX_DIMS];
+    uint32_t rank = 0;
+
+    if (n->op == BWPP_GOP_MATMUL || n->op == BWPP_GOP_BATCH_MATMUL) {
+      /* read a transposed operand in place */
+      for (uint32_t j = 0; j < 2 && j < n->input_count; ++j) {
+        const BwppGraphNode *t = bwpp_opt_swap_producer(graph, n->inputs[j]);
+        if (t) {
+          n->inputs[j] = t->inputs[0];
+          n->flags ^= j == 0 ? BWPP_GRAPH_OPF_TRANS_A : BWPP_GRAPH_OPF_TRANS_B;
+          folded++;
+        }
+      }
+    } else if (!pinned && bwpp_opt_perm(graph, n, perm, &rank)) {
+      /* identity, or undone by the permutation feeding it */
+      uint32_t inner[BWPP_GRAPH_MAX_DIMS] = { 0 };
+      uint32_t inner_rank = 0;
+      int cancel_src = src < graph->node_count && bwpp_opt_perm(graph, &graph->nodes[src], inner, &inner_rank) &&
+                       inner_rank == rank;
+      int identity = 1;
+      for (uint32_t k = 0; k < rank; ++k) {
+        identity &= perm[k] == k;
+        cancel_src &= inner[perm[k]] == k;
+      }
+      if (identity) {
+        repl[n->output] = in;
+        folded++;
+      } else if (cancel_src) {
+        repl[n->output] = graph->nodes[src].inputs[0];
+        folded++;
+      }
+    } else if (!pinned && n->op == BWPP_GOP_RESHAPE) {
+      if (src < graph->node_count && graph->nodes[src].op == BWPP_GOP_RESHAPE && graph->nodes[src].input_count) {
+        n->inputs[0] = in = graph->nodes[src].inputs[0];
+        folded++;
+      }
+      if (bwpp_opt_shape_eq(&graph->values[in].shape, &graph->values[n->output].shape)) {
+        repl[n->output] = in;
+        folded++;
+      }
+    }
+  }
+  free(repl);
+  return folded;
+}
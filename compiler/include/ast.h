@@ -2,9 +2,12 @@
 #define BWPP_AST_H
 
 #include "bwpp.h"
+#include "intern.h"
 #include <stddef.h>
 #include <stdint.h>
 
+#define BWPP_AST_MAX_DIMS 4
+
 typedef enum {
   BWPP_AST_MODULE = 0,
   BWPP_AST_FN,
@@ -56,6 +59,75 @@ typedef struct {
   BwppAstRegionPolicy policy;
 } BwppAstRegion;
 
+typedef enum {
+  BWPP_AST_EXPR_NAME = 0, /* a param, a let, or a keyword argument such as `causal` */
+  BWPP_AST_EXPR_NUMBER,
+  BWPP_AST_EXPR_CALL,     /* text(args): a built-in op or a user fn */
+  BWPP_AST_EXPR_MATMUL,   /* args[0] @ args[1] */
+  BWPP_AST_EXPR_LIST      /* [args]: shapes and permutations */
+} BwppAstExprKind;
+
+/* Arguments are a sibling list: `first` is the first child, `next` the
+   following sibling (BWPP_AST_NO_EXPR ends both), `last` the tail. */
+typedef struct {
+  BwppAstExprKind kind;
+  BwppStr text;
+  uint32_t sym; /* interned `text` for names and calls, else BWPP_SYM_NONE */
+  uint32_t first;
+  uint32_t last;
+  uint32_t next;
+  uint32_t arg_count;
+} BwppAstExpr;
+
+/* `tensor<dtype, [dims], layout>`; `layout` is empty when omitted. */
+typedef struct {
+  BwppStr dtype;
+  uint32_t rank;
+  BwppStr dims[BWPP_AST_MAX_DIMS];
+  BwppStr layout;
+} BwppAstType;
+
+typedef struct {
+  BwppStr name;
+  uint32_t sym;
+  BwppAstType type;
+} BwppAstParam;
+
+typedef enum {
+  BWPP_AST_STMT_LET = 0,
+  BWPP_AST_STMT_RETURN,
+  BWPP_AST_STMT_BLOCK /* `{ ... }`, or `@reversible { ... }` with a region */
+} BwppAstStmtKind;
+
+/* A block's statements follow it; `end` is one past its last (nested
+   blocks included), so the next statement at its level is at `end`. */
+typedef struct {
+  BwppAstStmtKind kind;
+  BwppStr name;  /* let */
+  uint32_t sym;  /* interned `name` */
+  uint32_t expr; /* let, return */
+  uint32_t region;
+  uint32_t end;
+} BwppAstStmt;
+
+typedef struct {
+  BwppStr name;
+  uint32_t sym;
+  uint32_t params; /* first index into module->params */
+  uint32_t param_count;
+  int has_result;
+  BwppAstType result;
+  uint32_t stmts;    /* body: statements [stmts, stmt_end) */
+  uint32_t stmt_end;
+  uint32_t region;   /* reversible region of an `@reversible fn`, else BWPP_AST_NO_REGION */
+} BwppAstFn;
+
+/* One `NAME = N` of an `@dims` block. */
+typedef struct {
+  BwppStr name;
+  uint32_t value;
+} BwppAstDim;
+
 typedef struct {
   BwppAstNode *root;
   BwppAstOp *ops;
@@ -64,16 +136,52 @@ typedef struct {
   BwppAstRegion *regions;
   uint32_t region_count;
   uint32_t region_capacity;
+  BwppAstFn *fns;
+  uint32_t fn_count;
+  uint32_t fn_capacity;
+  BwppAstParam *params;
+  uint32_t param_count;
+  uint32_t param_capacity;
+  BwppAstStmt *stmts;
+  uint32_t stmt_count;
+  uint32_t stmt_capacity;
+  BwppAstExpr *exprs;
+  uint32_t expr_count;
+  uint32_t expr_capacity;
+  BwppAstDim *dims; /* every @dims binding, source order */
+  uint32_t dim_count;
+  uint32_t dim_capacity;
+  BwppInterner symbols; /* every fn, param, let and referenced name */
+  uint32_t *fn_of_sym;  /* sym -> index into fns (the first definition), BWPP_AST_NONE if none */
+  uint32_t fn_of_sym_count;
   const char *source;
   size_t length;
+  BwppChunkArena arena; /* every table above; freed in one call with the module */
 } BwppAstModule;
 
 BwppAstModule *bwpp_ast_module_create(const char *source, size_t length);
 void bwpp_ast_module_destroy(BwppAstModule *module);
 BwppStatus bwpp_ast_add_op(BwppAstModule *module, BwppAstOpKind op, uint32_t region_id, uint32_t flags);
 uint32_t bwpp_ast_add_region(BwppAstModule *module, BwppAstRegionKind kind, BwppAstRegionPolicy policy);
+/* Each returns the new entry's index, or BWPP_AST_NONE when out of memory.
+   Names are interned on the way in, filling the entry's `sym`. */
+uint32_t bwpp_ast_add_fn(BwppAstModule *module, const BwppAstFn *fn);
+uint32_t bwpp_ast_add_param(BwppAstModule *module, const BwppAstParam *param);
+uint32_t bwpp_ast_add_stmt(BwppAstModule *module, const BwppAstStmt *stmt);
+uint32_t bwpp_ast_add_expr(BwppAstModule *module, BwppAstExprKind kind, BwppStr text);
+uint32_t bwpp_ast_add_dim(BwppAstModule *module, BwppStr name, uint32_t value);
+
+/* Appends `child` to the argument list of `parent`. */
+void bwpp_ast_append_arg(BwppAstModule *module, uint32_t parent, uint32_t child);
+/* Argument `i` of `expr`, or BWPP_AST_NO_EXPR. */
+uint32_t bwpp_ast_arg(const BwppAstModule *module, uint32_t expr, uint32_t i);
+/* Hashed: through the interner, then fn_of_sym. NULL if not defined. */
+const BwppAstFn *bwpp_ast_find_fn(const BwppAstModule *module, BwppStr name);
+const BwppAstFn *bwpp_ast_fn_of(const BwppAstModule *module, uint32_t sym);
 
 enum { BWPP_AST_NO_REGION = 0xffffffffu };
+enum { BWPP_AST_NO_EXPR = 0xffffffffu };
+enum { BWPP_AST_NONE = 0xffffffffu };
 enum { BWPP_AST_OPF_HAS_BIAS = 1u << 0 };
 
 #endif
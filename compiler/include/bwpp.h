@@ -10,4 +10,10 @@ typedef enum {
   BWPP_ERR = 1
 } BwppStatus;
 
+/* malloc, calloc and realloc for compiler data. Each call is counted in
+   the allocs column of `bwppc --time-passes` (pass_timer.c). */
+void *bwpp_xmalloc(size_t size);
+void *bwpp_xcalloc(size_t count, size_t size);
+void *bwpp_xrealloc(void *ptr, size_t size);
+
 #endif
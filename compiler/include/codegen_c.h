@@ -0,0 +1,13 @@
+#ifndef BWPP_CODEGEN_C_H
+#define BWPP_CODEGEN_C_H
+
+#include "bwpp.h"
+#include "graph_ir.h"
+#include "ir.h"
+
+/* Lowers the same tile plans as bwpp_codegen_metal to portable C11 with SIMD
+   intrinsics. Shapes come from the bound dims of `graph` and are baked in as
+   constants; the output builds on its own as a shared object. */
+BwppStatus bwpp_codegen_c(const BwppIrModule *ir, const BwppGraph *graph, const char *out_path);
+
+#endif
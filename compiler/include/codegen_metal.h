@@ -2,8 +2,9 @@
 #define BWPP_CODEGEN_METAL_H
 
 #include "bwpp.h"
+#include "graph_ir.h"
 #include "ir.h"
 
-BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const char *out_path);
+BwppStatus bwpp_codegen_metal(const BwppIrModule *ir, const BwppGraph *graph, const char *out_path);
 
 #endif
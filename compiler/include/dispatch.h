@@ -0,0 +1,64 @@
+#ifndef BWPP_DISPATCH_H
+#define BWPP_DISPATCH_H
+
+#include "bwpp.h"
+#include "fusion.h"
+#include "graph_ir.h"
+#include "mem_plan.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define BWPP_DISPATCH_KERNEL_MAX 48
+
+typedef struct {
+  uint32_t value;
+  uint64_t offset; /* byte offset in the slab; BWPP_MEM_NO_OFFSET for graph inputs and constants */
+} BwppDispatchBinding;
+
+/* One kernel launch: a fused region. Launches whose regions would compile
+   to the same code share one kernel: the same `kernel_id` and name. */
+typedef struct {
+  char kernel[BWPP_DISPATCH_KERNEL_MAX];
+  uint32_t kernel_id; /* unique kernels in order of first launch */
+  uint32_t *nodes; /* the region's nodes, graph order */
+  uint32_t node_count;
+  BwppDispatchBinding *bindings; /* buffer(i): inputs in first-read order, the output last */
+  uint32_t binding_count;
+  uint32_t grid[3];        /* threadgroups */
+  uint32_t threadgroup[3]; /* threads per threadgroup */
+} BwppDispatch;
+
+typedef struct {
+  BwppDispatch *dispatches; /* launch order */
+  uint32_t dispatch_count;
+  uint32_t dispatch_capacity;
+  uint32_t kernel_count;
+  uint64_t slab_bytes;
+} BwppDispatchSchedule;
+
+/* One dispatch per region of `fusion`, with every region output placed in a
+   slab planned over the launches (bwpp_mem_plan_build_slab_steps);
+   `elem_bytes` as there. Regions with the same signature (node ops, flags
+   and attributes, which buffer or node feeds each input, and the dtype,
+   layout and bound sizes of every buffer and node output) share a kernel.
+   NULL while a dim is unbound. */
+BwppDispatchSchedule *bwpp_dispatch_schedule_build(const BwppGraph *graph,
+                                                   const BwppFusionPlan *fusion,
+                                                   uint32_t elem_bytes);
+/* `// bwpp.schedule:` lines; _read picks them out of any text (e.g. an MSL file). */
+void bwpp_dispatch_schedule_write(const BwppDispatchSchedule *sched, FILE *out);
+BwppDispatchSchedule *bwpp_dispatch_schedule_read(FILE *in);
+void bwpp_dispatch_schedule_destroy(BwppDispatchSchedule *sched);
+
+/* What a replay of `sched` on the CPU executor runs: a copy of `graph` with
+   its nodes in launch order, and a slab plan holding every bound value at
+   its scheduled offset, scaled so each element fits an f32 (slots that do
+   not overlap on the device do not overlap here either). Values the
+   schedule keeps inside a kernel get private storage. NULL, with a message,
+   if the schedule does not cover the graph or a kernel reads a value it is
+   not bound to. */
+BwppGraph *bwpp_dispatch_replay_graph(const BwppGraph *graph,
+                                      const BwppDispatchSchedule *sched,
+                                      BwppMemPlan **plan);
+
+#endif
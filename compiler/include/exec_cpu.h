@@ -0,0 +1,51 @@
+#ifndef BWPP_EXEC_CPU_H
+#define BWPP_EXEC_CPU_H
+
+#include "arena.h"
+#include "bwpp.h"
+#include "bwpp_cpu_context.h"
+#include "graph_ir.h"
+#include "mem_plan.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint32_t rank;
+  uint32_t dims[BWPP_GRAPH_MAX_DIMS];
+} BwppExecShape;
+
+/* Runs a BwppGraph on the CPU backend. Every value is computed in f32 whatever
+   its declared dtype. Node outputs live in the buffers (or the slab) of the
+   mem plan; graph inputs and constants get their own storage. Everything comes from one
+   arena, so its size is the peak memory of a run. */
+typedef struct {
+  const BwppGraph *graph;
+  const BwppMemPlan *plan;
+  BwppCpuContext *ctx;
+  BwppArena arena;
+  BwppExecShape *shapes;
+  size_t *elems;
+  float **data;
+  float **buffers;
+  uint32_t buffer_count;
+  size_t buffer_bytes;
+  size_t input_bytes;
+  float *scratch;
+  double *node_secs;
+} BwppCpuExec;
+
+/* Takes every value's concrete shape from the graph's bound dims and
+   allocates storage; NULL (with a message on stderr) if a dim is unbound or
+   shapes do not line up. */
+BwppCpuExec *bwpp_exec_cpu_create(const BwppGraph *graph,
+                                  const BwppMemPlan *plan,
+                                  uint32_t threads);
+void bwpp_exec_cpu_destroy(BwppCpuExec *exec);
+
+/* Storage of value `value` (inputs are written here, outputs read back). */
+float *bwpp_exec_cpu_value(BwppCpuExec *exec, uint32_t value, size_t *elems);
+
+/* Executes the nodes in order; node_secs[i] holds node i's time afterwards. */
+BwppStatus bwpp_exec_cpu_run(BwppCpuExec *exec);
+
+#endif
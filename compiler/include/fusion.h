@@ -0,0 +1,48 @@
+#ifndef BWPP_FUSION_H
+#define BWPP_FUSION_H
+
+#include "graph_ir.h"
+#include "tile_ir.h"
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+  BWPP_FUSION_ELEMENTWISE = 0, /* producer-consumer chain of elementwise ops */
+  BWPP_FUSION_MATMUL,          /* matmul + elementwise epilogue */
+  BWPP_FUSION_REDUCTION,       /* elementwise prologue + row reduction + epilogue */
+  BWPP_FUSION_ATTENTION,       /* [transpose] + matmul + softmax + matmul + epilogue */
+  BWPP_FUSION_LAYOUT           /* transpose/permute/reshape/broadcast on its own */
+} BwppFusionKind;
+
+typedef struct {
+  uint32_t id;
+  BwppFusionKind kind;
+  uint32_t *nodes; /* graph order */
+  uint32_t node_count;
+  uint32_t node_capacity;
+  uint32_t anchor; /* the matmul/reduction/attention softmax node, else the first node */
+  uint32_t output; /* the one value the region writes */
+  BwppTileKernel *kernel;
+} BwppFusionRegion;
+
+typedef struct {
+  BwppFusionRegion *regions; /* in launch order: by last node */
+  uint32_t region_count;
+  uint32_t region_capacity;
+  uint32_t *node_region; /* per graph node */
+  uint32_t node_count;
+  /* one kernel per region vs one per node; bytes read + written by them
+     (0 while a dim is unbound) */
+  uint64_t traffic_bytes;
+  uint64_t unfused_traffic_bytes;
+} BwppFusionPlan;
+
+/* Partitions `graph` into fused regions. A value is only fused away when the
+   next op of the region is its one reader and it is not a graph output, so
+   each region writes a single value. */
+BwppFusionPlan *bwpp_fusion_plan_build(const BwppGraph *graph);
+void bwpp_fusion_plan_dump(const BwppFusionPlan *plan, const BwppGraph *graph, FILE *out);
+void bwpp_fusion_plan_destroy(BwppFusionPlan *plan);
+const char *bwpp_fusion_kind_name(BwppFusionKind kind);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "bwpp.h"
 #include "ir.h"
+#include "arena.h"
 #include "ast.h"
 #include <stdint.h>
 #include <stdio.h>
@@ -10,16 +11,12 @@
 #define BWPP_GRAPH_MAX_DIMS 4
 #define BWPP_GRAPH_MAX_INPUTS 4
 
-typedef struct {
-  const char *ptr;
-  size_t len;
-} BwppStr;
-
 typedef enum {
   BWPP_DTYPE_UNKNOWN = 0,
   BWPP_DTYPE_F16,
   BWPP_DTYPE_BF16,
-  BWPP_DTYPE_F32
+  BWPP_DTYPE_F32,
+  BWPP_DTYPE_U32 /* key lengths */
 } BwppDType;
 
 typedef enum {
@@ -31,8 +28,15 @@ typedef enum {
 typedef struct {
   uint32_t rank;
   BwppStr dims[BWPP_GRAPH_MAX_DIMS];
+  uint32_t sizes[BWPP_GRAPH_MAX_DIMS]; /* bound sizes; 0 until the dim is bound */
 } BwppShape;
 
+/* Binds a symbolic dim ("T", "D") to a concrete size. */
+typedef struct {
+  BwppStr name;
+  uint32_t value;
+} BwppDimBinding;
+
 typedef enum {
   BWPP_GOP_MATMUL = 0,
   BWPP_GOP_BATCH_MATMUL,
@@ -64,6 +68,7 @@ typedef struct {
   BwppShape shape;
   uint32_t perm[BWPP_GRAPH_MAX_DIMS];
   uint32_t perm_rank;
+  uint32_t mask;
 } BwppGraphAttr;
 
 typedef struct {
@@ -106,6 +111,11 @@ typedef struct BwppGraph {
   uint32_t *outputs;
   uint32_t output_count;
   uint32_t output_capacity;
+  BwppDimBinding *dims;
+  uint32_t dim_count;
+  uint32_t dim_capacity;
+  uint32_t forward_nodes; /* training-step graphs: nodes [0, forward_nodes) are the forward pass */
+  BwppChunkArena arena;   /* the graph and every array above; freed in one call */
 } BwppGraph;
 
 enum { BWPP_GRAPH_NO_NODE = 0xffffffffu };
@@ -118,13 +128,72 @@ enum {
   BWPP_GRAPH_VALUE_CONST = 1u << 2
 };
 
-enum { BWPP_GRAPH_OPF_HAS_BIAS = 1u << 0 };
+/* TRANS_A/TRANS_B: a matmul operand stored transposed, i.e. the input value
+   is the BWPP_LAYOUT_COL_MAJOR view of the [.., M, K] / [.., K, N] operand
+   the op multiplies (see bwpp_graph_operand_shape). */
+enum {
+  BWPP_GRAPH_OPF_HAS_BIAS = 1u << 0,
+  BWPP_GRAPH_OPF_TRANS_A = 1u << 1,
+  BWPP_GRAPH_OPF_TRANS_B = 1u << 2
+};
+
+/* softmax masks: `causal` keyword and a per-sequence key-length input */
+enum {
+  BWPP_GRAPH_MASK_CAUSAL = 1u << 0,
+  BWPP_GRAPH_MASK_KV_LEN = 1u << 1
+};
+
+typedef struct {
+  uint32_t mask;
+  int gqa;
+  BwppStr q_heads;
+  BwppStr kv_heads;
+  uint32_t q;      /* value ids of the attention operands */
+  uint32_t k;
+  uint32_t v;
+  uint32_t kv_len; /* BWPP_GRAPH_NO_VALUE without a key-length mask */
+} BwppGraphAttentionInfo;
 
 BwppGraph *bwpp_graph_build(const BwppAstModule *module, const char *entry);
 BwppGraph *bwpp_graph_autodiff(const BwppGraph *graph);
+/* Forward and backward in one graph: the forward nodes, then the nodes of
+   bwpp_graph_autodiff reading forward values in place of imported
+   activations. Outputs are the forward outputs followed by the input
+   gradients, and the output gradient seeds are extra inputs. */
+BwppGraph *bwpp_graph_training_step(const BwppGraph *graph);
+/* An empty graph in a fresh arena. */
+BwppGraph *bwpp_graph_create(void);
+/* Doubles `*items` (of `size`-byte entries) in the graph's arena when `count`
+   has reached `*capacity`; 0 when out of memory. Growing moves the array, and
+   the old block stays until the graph is destroyed. */
+int bwpp_graph_reserve(BwppGraph *graph, void **items, uint32_t count, uint32_t *capacity, size_t size,
+                       size_t align);
+BwppGraph *bwpp_graph_clone(const BwppGraph *graph);
 void bwpp_graph_destroy(BwppGraph *graph);
 void bwpp_graph_dump(const BwppGraph *graph, FILE *out);
+const char *bwpp_graph_op_name(BwppGraphOpKind op);
+/* 1 for elementwise ops: element i of the output depends only on element i
+   of its same-shaped inputs, so it may overwrite one of them. */
+int bwpp_graph_op_inplace(BwppGraphOpKind op);
 void bwpp_graph_dump_dot(const BwppGraph *graph, FILE *out);
 int bwpp_graph_detect_attention(const BwppGraph *graph);
+int bwpp_graph_attention_info(const BwppGraph *graph, BwppGraphAttentionInfo *info);
+
+/* Adds `dims` to the graph's bindings (a later binding of a name wins over
+   an earlier one, so --dim overrides @dims) and refreshes the bound sizes of
+   every value and shape attribute. Numeric dims are always bound. */
+BwppStatus bwpp_graph_bind_dims(BwppGraph *graph, const BwppDimBinding *dims, uint32_t count);
+
+/* Shape of input `i` of `n` as the op reads it: for a matmul operand under
+   TRANS_A/TRANS_B the last two dims (and sizes) of the stored value swap. */
+BwppShape bwpp_graph_operand_shape(const BwppGraph *graph, const BwppGraphNode *n, uint32_t i);
+
+/* 1 if every dim of `shape` has a bound size. */
+int bwpp_shape_bound(const BwppShape *shape);
+/* Element count of a bound shape; 0 if any dim is unbound. */
+uint64_t bwpp_shape_elems(const BwppShape *shape);
+/* First unbound dim of `shape`, for diagnostics; empty if all are bound. */
+BwppStr bwpp_shape_unbound_dim(const BwppShape *shape);
+uint32_t bwpp_dtype_bytes(BwppDType dtype);
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef BWPP_GRAPH_OPT_H
+#define BWPP_GRAPH_OPT_H
+
+#include "graph_ir.h"
+#include <stdint.h>
+
+/* Layout folding: a transpose (or a permute swapping the last two dims)
+   feeding a matmul becomes a TRANS_A/TRANS_B read of its source, a
+   transpose/permute undone by the one feeding it or that permutes nothing
+   is bypassed, and so is a reshape to the shape it already has (a chain of
+   reshapes collapses to the last). Nodes left unread stay for
+   bwpp_graph_dce. Returns the rewrites made. */
+uint32_t bwpp_graph_fold_layout(BwppGraph *graph);
+
+/* Common-subexpression elimination by hash-consing: a node with the same op,
+   inputs (in either order for add/mul), attributes, flags, region and output
+   type as an earlier one has its readers moved to the earlier output. The
+   duplicate stays in place for bwpp_graph_dce to drop; graph outputs are
+   never merged away, so their names survive. Returns the nodes merged. */
+uint32_t bwpp_graph_cse(BwppGraph *graph);
+
+/* Dead-code elimination: drops nodes no graph output depends on and the
+   values only they touched (graph inputs are always kept, so signatures do
+   not change). Ids are compacted in order. Returns the nodes removed. */
+uint32_t bwpp_graph_dce(BwppGraph *graph);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef BWPP_INTERN_H
+#define BWPP_INTERN_H
+
+#include "arena.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* A slice of the source text; never NUL-terminated. */
+typedef struct {
+  const char *ptr;
+  size_t len;
+} BwppStr;
+
+/* Maps each distinct string to a dense id (0, 1, ... in first-seen order)
+   so later phases key tables by id instead of comparing text. The strings
+   are not copied; they must outlive the interner. Its tables live in
+   `arena` and go away with it. */
+typedef struct {
+  BwppStr *strs;   /* id -> text */
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *slots; /* open addressing: id + 1, 0 when empty */
+  uint32_t slot_count;
+  BwppChunkArena *arena;
+} BwppInterner;
+
+enum { BWPP_SYM_NONE = 0xffffffffu };
+
+void bwpp_interner_init(BwppInterner *in, BwppChunkArena *arena);
+/* Id of `s`, adding it if new; BWPP_SYM_NONE when out of memory. */
+uint32_t bwpp_intern(BwppInterner *in, BwppStr s);
+/* Id of `s`, or BWPP_SYM_NONE if it was never interned. */
+uint32_t bwpp_intern_find(const BwppInterner *in, BwppStr s);
+
+int bwpp_str_eq(BwppStr s, const char *lit);
+int bwpp_str_eq_str(BwppStr a, BwppStr b);
+
+#endif
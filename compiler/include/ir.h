@@ -60,7 +60,12 @@ typedef struct {
 
 enum { BWPP_IR_NO_REGION = 0xffffffffu };
 enum { BWPP_IR_OPF_HAS_BIAS = 1u << 0 };
-enum { BWPP_IRF_HAS_ATTENTION = 1u << 0 };
+enum {
+  BWPP_IRF_HAS_ATTENTION = 1u << 0,
+  BWPP_IRF_ATT_CAUSAL = 1u << 1,
+  BWPP_IRF_ATT_KV_LEN = 1u << 2,
+  BWPP_IRF_ATT_GQA = 1u << 3
+};
 
 BwppIrModule *bwpp_ir_create(void);
 BwppIrModule *bwpp_ir_from_ast(const BwppAstModule *module);
@@ -1,6 +1,7 @@
 #ifndef BWPP_MEM_PLAN_H
 #define BWPP_MEM_PLAN_H
 
+#include "arena.h"
 #include "graph_ir.h"
 #include <stdint.h>
 #include <stdio.h>
@@ -9,17 +10,48 @@ typedef struct {
   BwppShape shape;
   BwppDType dtype;
   BwppLayout layout;
+  uint64_t bytes; /* 0 while the shape has unbound dims */
 } BwppBufferDesc;
 
+#define BWPP_MEM_NO_OFFSET UINT64_MAX
+
 typedef struct {
   BwppBufferDesc *buffers;
   uint32_t buffer_count;
   uint32_t buffer_capacity;
   uint32_t *value_to_buffer;
+  uint32_t *inplace_of; /* input whose storage the value overwrites in place, or UINT32_MAX */
   uint32_t value_count;
+  uint64_t total_bytes; /* sum over buffers; 0 unless every buffer is bound */
+  uint64_t input_bytes; /* graph inputs and constants, held for the whole run */
+  /* training-step graphs (see bwpp_graph_training_step): */
+  uint32_t forward_nodes;
+  uint64_t saved_bytes; /* forward values the backward nodes still read */
+  /* slab plans only (NULL / 0 otherwise): */
+  uint64_t *value_offset;   /* byte offset in the slab, BWPP_MEM_NO_OFFSET if not planned */
+  uint64_t slab_bytes;      /* slab size, i.e. the plan's peak */
+  uint64_t live_peak_bytes; /* most bytes live at any node, a lower bound on slab_bytes */
+  uint64_t unshared_bytes;  /* every planned value in its own allocation */
+  BwppChunkArena arena;     /* the plan and every array above; freed in one call */
 } BwppMemPlan;
 
+/* An empty plan for `value_count` values in a fresh arena: every value
+   unassigned and not in place, and with `slab` a value_offset array of
+   BWPP_MEM_NO_OFFSET. */
+BwppMemPlan *bwpp_mem_plan_create(uint32_t value_count, int slab);
+
+/* Buffer plan: a freed buffer is reused by a value of the same shape (or the
+   same byte size once dims are bound). */
 BwppMemPlan *bwpp_mem_plan_build(const BwppGraph *graph);
+/* Slab plan: every node output gets an offset in one slab, placed best-fit
+   by decreasing size among the values whose lifetimes overlap. Needs every
+   dim bound. `elem_bytes` overrides the dtype sizes (0 keeps them). */
+BwppMemPlan *bwpp_mem_plan_build_slab(const BwppGraph *graph, uint32_t elem_bytes);
+/* Same, with node i running in step node_step[i] (steps in topological
+   order, several nodes each, e.g. one fused kernel): values live from the
+   step that makes them to the last step that reads them, values read only
+   inside their own step get no offset, and nothing is done in place. */
+BwppMemPlan *bwpp_mem_plan_build_slab_steps(const BwppGraph *graph, uint32_t elem_bytes, const uint32_t *node_step);
 void bwpp_mem_plan_dump(const BwppMemPlan *plan, FILE *out);
 void bwpp_mem_plan_destroy(BwppMemPlan *plan);
 
@@ -10,9 +10,16 @@ typedef struct {
   size_t length;
   int has_lookahead;
   BwppToken lookahead;
+  BwppAstModule *module; /* being built */
+  uint32_t region;       /* enclosing reversible region, for module->ops */
+  int failed;
 } BwppParser;
 
 void bwpp_parser_init(BwppParser *parser, const char *input, size_t length);
+/* The one pass over the source: functions (params, result type, statements,
+   expressions), @dims and @reversible all land in the returned module, which
+   typecheck and the graph builder walk instead of re-lexing. NULL, with a
+   `parse: line N: ...` message, on a syntax error. */
 BwppAstModule *bwpp_parse_module(BwppParser *parser);
 
 #endif
@@ -0,0 +1,37 @@
+#ifndef BWPP_PASS_TIMER_H
+#define BWPP_PASS_TIMER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* One compiler phase as `bwppc --time-passes` reports it. */
+typedef struct {
+  const char *name;
+  double seconds;        /* wall time */
+  uint64_t peak_rss_kb;  /* process peak resident set at the end of the phase */
+  uint64_t allocs;       /* bwpp_xmalloc family calls and arena chunks */
+  uint64_t alloc_bytes;  /* bytes those asked for */
+} BwppPass;
+
+typedef struct {
+  BwppPass *passes;
+  uint32_t pass_count;
+  uint32_t pass_capacity;
+  int enabled;
+  int open; /* a phase has begun and not ended */
+  double start;
+  uint64_t allocs_at_start;
+  uint64_t bytes_at_start;
+} BwppPassTimer;
+
+/* A disabled timer records nothing; every call below is then a no-op. */
+void bwpp_pass_timer_init(BwppPassTimer *timer, int enabled);
+void bwpp_pass_timer_destroy(BwppPassTimer *timer);
+/* Starts phase `name` (a string that outlives the timer), ending any open one. */
+void bwpp_pass_begin(BwppPassTimer *timer, const char *name);
+void bwpp_pass_end(BwppPassTimer *timer);
+/* A table, or with `json` one JSON object on one line:
+   {"passes":[{"name":..,"ms":..,"peak_rss_kb":..,"allocs":..,"alloc_bytes":..}],"total_ms":..} */
+void bwpp_pass_timer_report(const BwppPassTimer *timer, FILE *out, int json);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef BWPP_REMAT_H
+#define BWPP_REMAT_H
+
+#include "bwpp.h"
+#include "graph_ir.h"
+#include <stdint.h>
+
+typedef struct {
+  uint64_t peak_before;      /* planned + input bytes of the training step as given */
+  uint64_t peak_after;
+  uint32_t candidates;       /* saved activations produced in reversible regions */
+  uint32_t dropped;          /* of those, recomputed in the backward pass */
+  uint32_t recompute_nodes;
+  uint64_t recompute_flops;
+} BwppRematReport;
+
+/* Rematerialization for a training-step graph (bwpp_graph_training_step).
+   Saved activations produced in `@reversible(recompute)` regions are always
+   recomputed before their first backward reader. Under `auto`, the ones
+   freeing the most bytes per FLOP of recompute are dropped greedily until
+   the planned peak fits `budget` (0: no auto drops); a drop that does not
+   lower the peak is undone. `store` regions keep everything. Returns a new
+   graph, or NULL if dims are unbound. */
+BwppGraph *bwpp_remat(const BwppGraph *train, uint64_t budget, int slab, BwppRematReport *report);
+
+#endif
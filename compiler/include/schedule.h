@@ -0,0 +1,26 @@
+#ifndef BWPP_SCHEDULE_H
+#define BWPP_SCHEDULE_H
+
+#include "bwpp.h"
+#include "graph_ir.h"
+#include <stdint.h>
+
+/* Segments of up to this many nodes are scheduled exactly (DP over the
+   scheduled-node sets); longer ones greedily. */
+#define BWPP_SCHEDULE_EXACT_MAX 16
+
+typedef struct {
+  uint64_t peak_before; /* most node-output bytes live at once, in graph order */
+  uint64_t peak_after;
+  int exact;            /* 1 if every segment was small enough for the DP */
+} BwppScheduleReport;
+
+/* Memory-aware schedule: a copy of `graph` with its nodes in a topological
+   order that lowers the peak of live node outputs, counted the way the slab
+   planner does (inputs and outputs of a node overlap, elementwise ops may
+   overwrite a dying input). The greedy pick runs the node that allocates the
+   least net of what it frees. Training-step graphs keep their forward nodes
+   first. Needs every dim bound; returns NULL otherwise. */
+BwppGraph *bwpp_schedule_mem(const BwppGraph *graph, BwppScheduleReport *report);
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef BWPP_TILE_IR_H
 #define BWPP_TILE_IR_H
 
+#include "arena.h"
 #include "bwpp.h"
+#include "graph_ir.h"
+#include "ir.h"
 #include <stdint.h>
 
 typedef enum {
@@ -22,7 +25,9 @@ typedef enum {
   BWPP_TILE_OP_STORE,
   BWPP_TILE_OP_ELEMENTWISE,
   BWPP_TILE_OP_SOFTMAX,
-  BWPP_TILE_OP_ATTENTION
+  BWPP_TILE_OP_ATTENTION,
+  BWPP_TILE_OP_REDUCE, /* row reductions: rmsnorm, reduce_sum/max and the norm grads */
+  BWPP_TILE_OP_LAYOUT  /* transpose/permute/reshape/broadcast copies */
 } BwppTileOpKind;
 
 typedef enum {
@@ -36,7 +41,11 @@ typedef enum {
   BWPP_TILE_EPILOGUE_NONE = 0,
   BWPP_TILE_EPILOGUE_ADD,
   BWPP_TILE_EPILOGUE_SILU,
-  BWPP_TILE_EPILOGUE_ADD_SILU
+  BWPP_TILE_EPILOGUE_ADD_SILU,
+  BWPP_TILE_EPILOGUE_SUB,
+  BWPP_TILE_EPILOGUE_MUL,
+  BWPP_TILE_EPILOGUE_DIV,
+  BWPP_TILE_EPILOGUE_SILU_GRAD
 } BwppTileEpilogue;
 
 typedef struct {
@@ -55,17 +64,42 @@ typedef struct {
   BwppTileMemory src_mem;
   BwppTileMemory dst_mem;
   BwppTileRole role;
+  uint32_t node; /* graph node the op computes; BWPP_GRAPH_NO_NODE for loads/stores */
 } BwppTileOp;
 
+/* Concrete problem size of a kernel; all zero while any dim is unbound.
+   For attention, m/n are query/key rows and k the head dim. */
+typedef struct {
+  uint32_t batch;
+  uint32_t m;
+  uint32_t n;
+  uint32_t k;
+} BwppTileProblem;
+
 typedef struct {
   BwppTileOp *ops;
   uint32_t op_count;
   uint32_t op_capacity;
   BwppTileShape block;
+  BwppTileProblem problem;
+  BwppChunkArena arena; /* the kernel and its ops; freed in one call */
 } BwppTileKernel;
 
 BwppTileKernel *bwpp_tile_kernel_create(void);
 void bwpp_tile_kernel_destroy(BwppTileKernel *kernel);
 BwppStatus bwpp_tile_kernel_add_op(BwppTileKernel *kernel, const BwppTileOp *op);
+const char *bwpp_tile_op_name(BwppTileOpKind kind);
+
+/* Tile plans shared by the backends: a blocked matmul with the module's fused
+   epilogue (NULL without a matmul), and the fused attention pipeline. */
+BwppTileKernel *bwpp_tile_lower_matmul(const BwppIrModule *ir);
+BwppTileKernel *bwpp_tile_lower_attention(void);
+
+/* Fills kernel->problem from the bound dims of `graph` (the first matmul, or
+   the attention operands); leaves it zero if a dim is unbound. */
+void bwpp_tile_bind_problem(BwppTileKernel *kernel, const BwppGraph *graph, int attention);
+/* Same for one node: a matmul's operands, otherwise m = rows and n = last dim
+   of `value` (k = 0). */
+void bwpp_tile_bind_node(BwppTileKernel *kernel, const BwppGraph *graph, uint32_t node, uint32_t value);
 
 #endif
@@ -0,0 +1,84 @@
+#include "intern.h"
+#include <string.h>
+
+static uint32_t bwpp_intern_hash(BwppStr s) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < s.len; ++i) {
+    h = (h ^ (uint8_t)s.ptr[i]) * 16777619u;
+  }
+  return h;
+}
+
+/* Slot holding `s`, or the empty slot where it would go. */
+static uint32_t bwpp_intern_slot(const BwppInterner *in, BwppStr s) {
+  uint32_t mask = in->slot_count - 1;
+  uint32_t i = bwpp_intern_hash(s) & mask;
+  while (in->slots[i] != 0 && !bwpp_str_eq_str(in->strs[in->slots[i] - 1], s)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/* Keeps the table at most half full. */
+static int bwpp_intern_rehash(BwppInterner *in) {
+  uint32_t next = in->slot_count ? in->slot_count * 2u : 64u;
+  uint32_t *slots = (uint32_t *)bwpp_chunk_arena_alloc(in->arena, next * sizeof(uint32_t), sizeof(uint32_t));
+  if (!slots) {
+    return 0;
+  }
+  memset(slots, 0, next * sizeof(uint32_t));
+  in->slots = slots;
+  in->slot_count = next;
+  for (uint32_t id = 0; id < in->count; ++id) {
+    in->slots[bwpp_intern_slot(in, in->strs[id])] = id + 1;
+  }
+  return 1;
+}
+
+void bwpp_interner_init(BwppInterner *in, BwppChunkArena *arena) {
+  memset(in, 0, sizeof(*in));
+  in->arena = arena;
+}
+
+uint32_t bwpp_intern(BwppInterner *in, BwppStr s) {
+  if (!in) {
+    return BWPP_SYM_NONE;
+  }
+  if ((in->count + 1) * 2 > in->slot_count && !bwpp_intern_rehash(in)) {
+    return BWPP_SYM_NONE;
+  }
+  uint32_t slot = bwpp_intern_slot(in, s);
+  if (in->slots[slot] != 0) {
+    return in->slots[slot] - 1;
+  }
+  if (in->count == in->capacity) {
+    uint32_t next = in->capacity ? in->capacity * 2u : 32u;
+    BwppStr *strs = (BwppStr *)bwpp_chunk_arena_grow(in->arena, in->strs, in->capacity * sizeof(BwppStr),
+                                                     next * sizeof(BwppStr), sizeof(void *));
+    if (!strs) {
+      return BWPP_SYM_NONE;
+    }
+    in->strs = strs;
+    in->capacity = next;
+  }
+  in->strs[in->count] = s;
+  in->slots[slot] = in->count + 1;
+  return in->count++;
+}
+
+uint32_t bwpp_intern_find(const BwppInterner *in, BwppStr s) {
+  if (!in || in->slot_count == 0) {
+    return BWPP_SYM_NONE;
+  }
+  uint32_t slot = bwpp_intern_slot(in, s);
+  return in->slots[slot] ? in->slots[slot] - 1 : BWPP_SYM_NONE;
+}
+
+int bwpp_str_eq(BwppStr s, const char *lit) {
+  size_t len = strlen(lit);
+  return s.len == len && strncmp(s.ptr, lit, len) == 0;
+}
+
+int bwpp_str_eq_str(BwppStr a, BwppStr b) {
+  return a.len == b.len && (a.len == 0 || strncmp(a.ptr, b.ptr, a.len) == 0);
+}
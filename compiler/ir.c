@@ -4,13 +4,13 @@
 #include <string.h>
 
 BwppIrModule *bwpp_ir_create(void) {
-  BwppIrModule *ir = (BwppIrModule *)calloc(1, sizeof(BwppIrModule));
+  BwppIrModule *ir = (BwppIrModule *)bwpp_xcalloc(1, sizeof(BwppIrModule));
   return ir;
 }
 
 static int bwpp_ir_grow_nodes(BwppIrModule *ir) {
   uint32_t next = ir->node_capacity ? ir->node_capacity * 2u : 8u;
-  BwppIrNode *nodes = (BwppIrNode *)realloc(ir->nodes, next * sizeof(BwppIrNode));
+  BwppIrNode *nodes = (BwppIrNode *)bwpp_xrealloc(ir->nodes, next * sizeof(BwppIrNode));
   if (!nodes) {
     return 0;
   }
@@ -21,7 +21,7 @@ static int bwpp_ir_grow_nodes(BwppIrModule *ir) {
 
 static int bwpp_ir_grow_regions(BwppIrModule *ir) {
   uint32_t next = ir->region_capacity ? ir->region_capacity * 2u : 4u;
-  BwppIrRegion *regions = (BwppIrRegion *)realloc(ir->regions, next * sizeof(BwppIrRegion));
+  BwppIrRegion *regions = (BwppIrRegion *)bwpp_xrealloc(ir->regions, next * sizeof(BwppIrRegion));
   if (!regions) {
     return 0;
   }
@@ -184,7 +184,7 @@ BwppIrModule *bwpp_ir_from_ast(const BwppAstModule *module) {
 
   uint32_t *region_map = NULL;
   if (module->region_count > 0) {
-    region_map = (uint32_t *)calloc(module->region_count, sizeof(uint32_t));
+    region_map = (uint32_t *)bwpp_xcalloc(module->region_count, sizeof(uint32_t));
   }
 
   for (uint32_t i = 0; i < module->region_count; ++i) {
@@ -216,7 +216,7 @@ BwppIrModule *bwpp_ir_from_graph(const BwppGraph *graph) {
 
   uint32_t *region_map = NULL;
   if (graph->region_count > 0) {
-    region_map = (uint32_t *)calloc(graph->region_count, sizeof(uint32_t));
+    region_map = (uint32_t *)bwpp_xcalloc(graph->region_count, sizeof(uint32_t));
   }
 
   for (uint32_t i = 0; i < graph->region_count; ++i) {
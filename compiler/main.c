@@ -1,9 +1,18 @@
+#include "codegen_c.h"
 #include "codegen_metal.h"
+#include "dispatch.h"
+#include "exec_cpu.h"
+#include "fusion.h"
 #include "graph_ir.h"
+#include "graph_opt.h"
 #include "ir.h"
 #include "mem_plan.h"
 #include "parser.h"
+#include "pass_timer.h"
+#include "remat.h"
+#include "schedule.h"
 #include "typecheck.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +32,7 @@ static char *bwpp_read_file(const char *path, size_t *out_len) {
     return NULL;
   }
   rewind(f);
-  char *buf = (char *)malloc((size_t)size + 1);
+  char *buf = (char *)bwpp_xmalloc((size_t)size + 1);
   if (!buf) {
     fclose(f);
     return NULL;
@@ -37,14 +46,242 @@ static char *bwpp_read_file(const char *path, size_t *out_len) {
   return buf;
 }
 
+typedef struct {
+  BwppDimBinding *items;
+  uint32_t count;
+  uint32_t capacity;
+} BwppDimList;
+
+/* "NAME=N" from --dim; the name points into argv */
+static int bwpp_dim_list_add(BwppDimList *list, const char *arg) {
+  const char *eq = strchr(arg, '=');
+  if (!eq || eq == arg || eq[1] < '0' || eq[1] > '9') {
+    return 0;
+  }
+  if (list->count == list->capacity) {
+    uint32_t next = list->capacity == 0 ? 8 : list->capacity * 2;
+    BwppDimBinding *items = (BwppDimBinding *)bwpp_xrealloc(list->items, next * sizeof(BwppDimBinding));
+    if (!items) {
+      return 0;
+    }
+    list->items = items;
+    list->capacity = next;
+  }
+  list->items[list->count].name.ptr = arg;
+  list->items[list->count].name.len = (size_t)(eq - arg);
+  list->items[list->count].value = (uint32_t)strtoul(eq + 1, NULL, 10);
+  list->count++;
+  return 1;
+}
+
+static void bwpp_write_fusion_plan(const BwppGraph *graph, const char *path) {
+  BwppFusionPlan *plan = bwpp_fusion_plan_build(graph);
+  if (!plan) {
+    fprintf(stderr, "failed to build fusion plan\n");
+    return;
+  }
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "failed to open fusion plan output: %s\n", path);
+  } else {
+    bwpp_fusion_plan_dump(plan, graph, out);
+    fclose(out);
+  }
+  bwpp_fusion_plan_destroy(plan);
+}
+
+static void bwpp_write_mem_plan(const BwppGraph *graph, int slab, const char *path) {
+  BwppMemPlan *plan = slab ? bwpp_mem_plan_build_slab(graph, 0) : bwpp_mem_plan_build(graph);
+  if (!plan) {
+    fprintf(stderr, "failed to build mem plan\n");
+    return;
+  }
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "failed to open mem plan output: %s\n", path);
+  } else {
+    bwpp_mem_plan_dump(plan, out);
+    fclose(out);
+  }
+  bwpp_mem_plan_destroy(plan);
+}
+
+/* Synthetic inputs shared by --run and --replay. */
+static void bwpp_fill_inputs(const BwppGraph *graph, BwppCpuExec *exec) {
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    if (!(graph->values[v].flags & BWPP_GRAPH_VALUE_INPUT)) {
+      continue;
+    }
+    size_t count = 0;
+    float *x = bwpp_exec_cpu_value(exec, v, &count);
+    for (size_t i = 0; i < count; ++i) {
+      /* key lengths (and untyped inputs) are left unmasked */
+      BwppDType dt = graph->values[v].dtype;
+      x[i] = dt == BWPP_DTYPE_U32 || dt == BWPP_DTYPE_UNKNOWN ? 1e9f
+                                                          : (float)((i * 7 + v * 13) % 23) * 0.01f - 0.1f;
+    }
+  }
+}
+
+/* Runs graph on the CPU backend with synthetic inputs and reports latency,
+   memory and an output checksum. */
+static int bwpp_run_cpu(const BwppGraph *graph,
+                        const char *label,
+                        int slab,
+                        uint32_t threads,
+                        uint32_t iters,
+                        int profile) {
+  /* the executor keeps every value in f32 */
+  BwppMemPlan *plan = slab ? bwpp_mem_plan_build_slab(graph, sizeof(float)) : bwpp_mem_plan_build(graph);
+  if (!plan) {
+    fprintf(stderr, "failed to build mem plan\n");
+    return 0;
+  }
+  BwppCpuExec *exec = bwpp_exec_cpu_create(graph, plan, threads);
+  if (!exec) {
+    fprintf(stderr, "run %s: executor setup failed\n", label);
+    bwpp_mem_plan_destroy(plan);
+    return 0;
+  }
+  bwpp_fill_inputs(graph, exec);
+  int ok = bwpp_exec_cpu_run(exec) == BWPP_OK;
+  double secs = 0.0;
+  double *node_total = (double *)bwpp_xcalloc(graph->node_count ? graph->node_count : 1, sizeof(double));
+  for (uint32_t it = 0; it < iters && ok && node_total; ++it) {
+    ok = bwpp_exec_cpu_run(exec) == BWPP_OK;
+    for (uint32_t i = 0; i < graph->node_count; ++i) {
+      node_total[i] += exec->node_secs[i];
+      secs += exec->node_secs[i];
+    }
+  }
+  if (ok && node_total) {
+    printf("run %s: nodes=%u threads=%u iters=%u time=%.6fs\n",
+           label, graph->node_count, exec->ctx->threads, iters, iters ? secs / iters : 0.0);
+    printf("run %s: buffers=%u buffer_bytes=%zu input_bytes=%zu peak_bytes=%zu\n",
+           label, exec->buffer_count, exec->buffer_bytes, exec->input_bytes, exec->arena.offset);
+    for (uint32_t i = 0; i < graph->output_count; ++i) {
+      size_t count = 0;
+      const float *y = bwpp_exec_cpu_value(exec, graph->outputs[i], &count);
+      double sum = 0.0;
+      for (size_t j = 0; j < count; ++j) {
+        sum += y[j];
+      }
+      if (!isfinite(sum)) {
+        fprintf(stderr, "run %s: output v%u is not finite\n", label, graph->outputs[i]);
+        ok = 0;
+      }
+      printf("run %s: output v%u elems=%zu sum=%.6f\n", label, graph->outputs[i], count, sum);
+    }
+    for (uint32_t i = 0; profile && i < graph->node_count; ++i) {
+      printf("  n%u %s %.6fs\n", i, bwpp_graph_op_name(graph->nodes[i].op),
+             iters ? node_total[i] / iters : 0.0);
+    }
+  }
+  free(node_total);
+  bwpp_exec_cpu_destroy(exec);
+  bwpp_mem_plan_destroy(plan);
+  return ok;
+}
+
+/* Replays the dispatch schedule written into `metal_path`: each kernel's
+   nodes run on the CPU in launch order with their buffers at the scheduled
+   slab offsets, and the outputs must match a run in graph order. */
+static int bwpp_replay_schedule(const BwppGraph *graph, const char *metal_path, uint32_t threads) {
+  FILE *in = fopen(metal_path, "r");
+  BwppDispatchSchedule *sched = in ? bwpp_dispatch_schedule_read(in) : NULL;
+  if (in) {
+    fclose(in);
+  }
+  if (!sched) {
+    fprintf(stderr, "replay: no bwpp.schedule in %s (every dim must be bound)\n", metal_path);
+    return 0;
+  }
+  BwppMemPlan *replay_plan = NULL;
+  BwppGraph *replay = bwpp_dispatch_replay_graph(graph, sched, &replay_plan);
+  BwppMemPlan *plan = bwpp_mem_plan_build(graph);
+  BwppCpuExec *exec = replay && plan ? bwpp_exec_cpu_create(graph, plan, threads) : NULL;
+  BwppCpuExec *replay_exec = exec ? bwpp_exec_cpu_create(replay, replay_plan, threads) : NULL;
+  int ok = replay_exec != NULL;
+  if (ok) {
+    bwpp_fill_inputs(graph, exec);
+    bwpp_fill_inputs(replay, replay_exec);
+    ok = bwpp_exec_cpu_run(exec) == BWPP_OK && bwpp_exec_cpu_run(replay_exec) == BWPP_OK;
+  }
+  double max_diff = 0.0;
+  for (uint32_t i = 0; ok && i < graph->output_count; ++i) {
+    size_t count = 0;
+    const float *want = bwpp_exec_cpu_value(exec, graph->outputs[i], &count);
+    const float *got = bwpp_exec_cpu_value(replay_exec, graph->outputs[i], NULL);
+    for (size_t j = 0; j < count; ++j) {
+      double diff = fabs((double)want[j] - (double)got[j]);
+      max_diff = diff > max_diff ? diff : max_diff;
+      ok &= diff <= 1e-5 * (1.0 + fabs((double)want[j]));
+    }
+  }
+  if (replay_exec) {
+    printf("replay: dispatches=%u slab_bytes=%llu outputs=%u max_abs_diff=%g %s\n", sched->dispatch_count,
+           (unsigned long long)sched->slab_bytes, graph->output_count, max_diff, ok ? "match" : "MISMATCH");
+  } else {
+    fprintf(stderr, "replay: setup failed\n");
+  }
+  bwpp_exec_cpu_destroy(replay_exec);
+  bwpp_exec_cpu_destroy(exec);
+  bwpp_mem_plan_destroy(plan);
+  bwpp_mem_plan_destroy(replay_plan);
+  bwpp_graph_destroy(replay);
+  bwpp_dispatch_schedule_destroy(sched);
+  return ok;
+}
+
+/* Swaps `graph` for its memory-aware schedule; keeps it if that fails. */
+static BwppGraph *bwpp_schedule_graph(BwppGraph *graph, const char *label) {
+  BwppScheduleReport report = {0};
+  BwppGraph *scheduled = bwpp_schedule_mem(graph, &report);
+  if (!scheduled) {
+    return graph;
+  }
+  fprintf(stderr, "schedule %s: live_peak_bytes=%llu -> %llu (%s)\n", label,
+          (unsigned long long)report.peak_before, (unsigned long long)report.peak_after,
+          report.exact ? "exact" : "greedy");
+  bwpp_graph_destroy(graph);
+  return scheduled;
+}
+
+/* Layout folding, CSE, then DCE, in place; says so only when something changed. */
+static void bwpp_simplify_graph(BwppGraph *graph, const char *label) {
+  uint32_t before = graph->node_count;
+  uint32_t folded = bwpp_graph_fold_layout(graph);
+  uint32_t merged = bwpp_graph_cse(graph);
+  uint32_t removed = bwpp_graph_dce(graph);
+  if (folded || removed) {
+    fprintf(stderr, "simplify %s: nodes=%u -> %u folded=%u cse_merged=%u dead=%u\n", label, before,
+            graph->node_count, folded, merged, removed - merged);
+  }
+}
+
 int main(int argc, char **argv) {
   const char *input_path = NULL;
   const char *output_path = NULL;
   const char *dot_path = NULL;
   const char *grad_dot_path = NULL;
   const char *mem_plan_path = NULL;
+  const char *train_plan_path = NULL;
+  const char *fusion_plan_path = NULL;
+  int mem_slab = 0;
+  uint64_t mem_budget = 0;
+  int schedule_mem = 0;
+  const char *c_path = NULL;
   int attn_report = 0;
   const char *entry = NULL;
+  int run = 0;
+  int run_grad = 0;
+  int run_train = 0;
+  int run_profile = 0;
+  int replay = 0;
+  uint32_t run_threads = 1;
+  uint32_t run_iters = 1;
+  int time_passes = 0; /* 1: table, 2: JSON */
+  BwppDimList dims = {0};
 
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--dot") == 0 && i + 1 < argc) {
@@ -59,6 +296,35 @@ int main(int argc, char **argv) {
       mem_plan_path = argv[++i];
       continue;
     }
+    if (strcmp(argv[i], "--train-plan") == 0 && i + 1 < argc) {
+      train_plan_path = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "--fusion-plan") == 0 && i + 1 < argc) {
+      fusion_plan_path = argv[++i];
+      continue;
+    }
+    if (strcmp(argv[i], "--mem-slab") == 0) {
+      mem_slab = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+      mem_budget = strtoull(argv[++i], NULL, 10);
+      continue;
+    }
+    if (strncmp(argv[i], "--schedule=", 11) == 0) {
+      if (strcmp(argv[i] + 11, "mem") != 0) {
+        fprintf(stderr, "unknown schedule %s (expected mem)\n", argv[i] + 11);
+        free(dims.items);
+        return 1;
+      }
+      schedule_mem = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc) {
+      c_path = argv[++i];
+      continue;
+    }
     if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc) {
       entry = argv[++i];
       continue;
@@ -67,12 +333,53 @@ int main(int argc, char **argv) {
       attn_report = 1;
       continue;
     }
+    if (strcmp(argv[i], "--run") == 0) {
+      run = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--run-grad") == 0) {
+      run_grad = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--run-train") == 0) {
+      run_train = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--replay") == 0) {
+      replay = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--time-passes") == 0 || strcmp(argv[i], "--time-passes=json") == 0) {
+      time_passes = argv[i][13] == '=' ? 2 : 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--profile") == 0) {
+      run_profile = 1;
+      continue;
+    }
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      run_threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+      continue;
+    }
+    if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+      run_iters = (uint32_t)strtoul(argv[++i], NULL, 10);
+      continue;
+    }
+    if (strcmp(argv[i], "--dim") == 0 && i + 1 < argc) {
+      if (!bwpp_dim_list_add(&dims, argv[++i])) {
+        fprintf(stderr, "bad --dim %s (expected NAME=N)\n", argv[i]);
+        free(dims.items);
+        return 1;
+      }
+      continue;
+    }
     if (!input_path) {
       input_path = argv[i];
     } else if (!output_path) {
       output_path = argv[i];
     } else {
       fprintf(stderr, "unexpected arg: %s\n", argv[i]);
+      free(dims.items);
       return 1;
     }
   }
@@ -80,35 +387,47 @@ int main(int argc, char **argv) {
   if (!input_path || !output_path) {
     fprintf(stderr,
             "usage: %s <input.bwpp> <output.metal> [--dot <graph.dot>] [--grad-dot <grad.dot>]\n"
-            "       [--mem-plan <plan.txt>] [--attn-report] [--entry <fn>]\n",
+            "       [--mem-plan <plan.txt>] [--train-plan <plan.txt>] [--fusion-plan <plan.txt>] [--mem-slab] [--mem-budget <bytes>] [--schedule=mem] [--attn-report] [--entry <fn>] [--emit-c <out.c>]\n"
+            "       [--run] [--run-grad] [--run-train] [--replay] [--dim NAME=N]... [--threads N] [--iters N] [--profile]\n"
+            "       [--time-passes[=json]]\n",
             argv[0]);
+    free(dims.items);
     return 1;
   }
 
+  /* from here on every exit goes through `done` */
+  int status = 1;
+  char *src = NULL;
+  BwppAstModule *module = NULL;
+  BwppGraph *graph = NULL;
+  BwppIrModule *ir = NULL;
+  BwppPassTimer timer;
+  bwpp_pass_timer_init(&timer, time_passes != 0);
+  bwpp_pass_begin(&timer, "read");
   size_t len = 0;
-  char *src = bwpp_read_file(input_path, &len);
+  src = bwpp_read_file(input_path, &len);
   if (!src) {
     fprintf(stderr, "failed to read input: %s\n", input_path);
-    return 1;
+    goto done;
   }
 
+  bwpp_pass_begin(&timer, "parse");
   BwppParser parser;
   bwpp_parser_init(&parser, src, len);
-  BwppAstModule *module = bwpp_parse_module(&parser);
+  module = bwpp_parse_module(&parser);
   if (!module) {
     fprintf(stderr, "parse failed\n");
-    free(src);
-    return 1;
+    goto done;
   }
 
+  bwpp_pass_begin(&timer, "typecheck");
   if (bwpp_typecheck_module(module) != BWPP_OK) {
     fprintf(stderr, "typecheck failed\n");
-    bwpp_ast_module_destroy(module);
-    free(src);
-    return 1;
+    goto done;
   }
 
-  BwppGraph *graph = bwpp_graph_build(module, entry);
+  bwpp_pass_begin(&timer, "graph_build");
+  graph = bwpp_graph_build(module, entry);
   if (!graph) {
     fprintf(stderr, "graph build failed");
     if (entry && entry[0] != '\0') {
@@ -116,21 +435,27 @@ int main(int argc, char **argv) {
     } else {
       fprintf(stderr, "\n");
     }
-    bwpp_ast_module_destroy(module);
-    free(src);
-    return 1;
+    goto done;
   }
+  /* --dim bindings land after the source's @dims, so they win */
+  if (bwpp_graph_bind_dims(graph, dims.items, dims.count) != BWPP_OK) {
+    fprintf(stderr, "failed to bind dims\n");
+    goto done;
+  }
+  /* before anything reads the graph: IR, autodiff and every plan see the simplified one */
+  bwpp_pass_begin(&timer, "simplify");
+  bwpp_simplify_graph(graph, "forward");
 
-  BwppIrModule *ir = bwpp_ir_from_graph(graph);
+  bwpp_pass_begin(&timer, "ir_lower");
+  ir = bwpp_ir_from_graph(graph);
   if (!ir) {
     fprintf(stderr, "ir failed\n");
-    bwpp_graph_destroy(graph);
-    bwpp_ast_module_destroy(module);
-    free(src);
-    return 1;
+    goto done;
   }
 
+  bwpp_pass_end(&timer);
   if (dot_path && graph) {
+    bwpp_pass_begin(&timer, "dot");
     FILE *dot = fopen(dot_path, "w");
     if (!dot) {
       fprintf(stderr, "failed to open dot output: %s\n", dot_path);
@@ -141,10 +466,12 @@ int main(int argc, char **argv) {
   }
 
   if (grad_dot_path && graph) {
+    bwpp_pass_begin(&timer, "autodiff");
     BwppGraph *grad = bwpp_graph_autodiff(graph);
     if (!grad) {
       fprintf(stderr, "failed to build autodiff graph\n");
     } else {
+      bwpp_simplify_graph(grad, "grad");
       FILE *dot = fopen(grad_dot_path, "w");
       if (!dot) {
         fprintf(stderr, "failed to open grad dot output: %s\n", grad_dot_path);
@@ -157,44 +484,149 @@ int main(int argc, char **argv) {
   }
 
   int has_attention = 0;
+  bwpp_pass_begin(&timer, "attention");
   if (graph) {
-    has_attention = bwpp_graph_detect_attention(graph);
+    BwppGraphAttentionInfo attn = {0};
+    has_attention = bwpp_graph_attention_info(graph, &attn);
     if (has_attention) {
       ir->flags |= BWPP_IRF_HAS_ATTENTION;
+      if (attn.mask & BWPP_GRAPH_MASK_CAUSAL) {
+        ir->flags |= BWPP_IRF_ATT_CAUSAL;
+      }
+      if (attn.mask & BWPP_GRAPH_MASK_KV_LEN) {
+        ir->flags |= BWPP_IRF_ATT_KV_LEN;
+      }
+      if (attn.gqa) {
+        ir->flags |= BWPP_IRF_ATT_GQA;
+      }
     }
     if (attn_report) {
       fprintf(stderr, "attention_candidate=%d\n", has_attention);
+      if (has_attention) {
+        fprintf(stderr, "attention_causal=%d attention_kv_len=%d attention_gqa=%d\n",
+                (attn.mask & BWPP_GRAPH_MASK_CAUSAL) ? 1 : 0,
+                (attn.mask & BWPP_GRAPH_MASK_KV_LEN) ? 1 : 0,
+                attn.gqa);
+        if (attn.gqa) {
+          fprintf(stderr, "attention_heads=%.*s kv_heads=%.*s\n",
+                  (int)attn.q_heads.len, attn.q_heads.ptr,
+                  (int)attn.kv_heads.len, attn.kv_heads.ptr);
+        }
+      }
     }
   }
 
+  /* the IR above (and so codegen) keeps the source order; planning and --run use the schedule */
+  bwpp_pass_end(&timer);
+  if (schedule_mem && graph) {
+    bwpp_pass_begin(&timer, "schedule");
+    graph = bwpp_schedule_graph(graph, "forward");
+  }
+  if (fusion_plan_path && graph) {
+    bwpp_pass_begin(&timer, "fusion_plan");
+    bwpp_write_fusion_plan(graph, fusion_plan_path);
+  }
   if (mem_plan_path && graph) {
-    BwppMemPlan *plan = bwpp_mem_plan_build(graph);
-    if (!plan) {
-      fprintf(stderr, "failed to build mem plan\n");
+    bwpp_pass_begin(&timer, "mem_plan");
+    bwpp_write_mem_plan(graph, mem_slab, mem_plan_path);
+  }
+
+  BwppGraph *train = NULL;
+  if ((train_plan_path || run_train) && graph) {
+    bwpp_pass_begin(&timer, "train_step");
+    train = bwpp_graph_training_step(graph);
+    if (!train) {
+      fprintf(stderr, "failed to build training-step graph\n");
     } else {
-      FILE *out = fopen(mem_plan_path, "w");
-      if (!out) {
-        fprintf(stderr, "failed to open mem plan output: %s\n", mem_plan_path);
-      } else {
-        bwpp_mem_plan_dump(plan, out);
-        fclose(out);
-      }
-      bwpp_mem_plan_destroy(plan);
+      bwpp_simplify_graph(train, "train");
     }
   }
+  int recompute = 0;
+  for (uint32_t r = 0; train && r < train->region_count; ++r) {
+    recompute |= train->regions[r].kind == BWPP_REGION_REVERSIBLE && train->regions[r].policy == BWPP_POLICY_RECOMPUTE;
+  }
+  if (train && (mem_budget || recompute)) {
+    bwpp_pass_begin(&timer, "remat");
+    BwppRematReport report = {0};
+    BwppGraph *remat = bwpp_remat(train, mem_budget, mem_slab, &report);
+    if (remat) {
+      fprintf(stderr,
+              "remat: peak_bytes=%llu -> %llu dropped=%u/%u recompute_nodes=%u recompute_flops=%llu\n",
+              (unsigned long long)report.peak_before, (unsigned long long)report.peak_after, report.dropped,
+              report.candidates, report.recompute_nodes, (unsigned long long)report.recompute_flops);
+      bwpp_graph_destroy(train);
+      train = remat;
+    }
+  }
+  if (schedule_mem && train) {
+    bwpp_pass_begin(&timer, "schedule_train");
+    train = bwpp_schedule_graph(train, "train");
+  }
+  if (train_plan_path && train) {
+    bwpp_pass_begin(&timer, "train_plan");
+    bwpp_write_mem_plan(train, mem_slab, train_plan_path);
+  }
 
-  if (bwpp_codegen_metal(ir, output_path) != BWPP_OK) {
+  int run_ok = 1;
+  if ((run || run_grad || run_train) && !graph) {
+    fprintf(stderr, "--run needs a graph (see --entry)\n");
+    run_ok = 0;
+  }
+  if (run && graph) {
+    bwpp_pass_begin(&timer, "run");
+    run_ok &= bwpp_run_cpu(graph, "forward", mem_slab, run_threads, run_iters, run_profile);
+  }
+  if (run_grad && graph) {
+    bwpp_pass_begin(&timer, "run_grad");
+    BwppGraph *grad = bwpp_graph_autodiff(graph);
+    if (!grad) {
+      fprintf(stderr, "failed to build autodiff graph\n");
+      run_ok = 0;
+    } else {
+      bwpp_simplify_graph(grad, "grad");
+      run_ok &= bwpp_run_cpu(grad, "grad", mem_slab, run_threads, run_iters, run_profile);
+      bwpp_graph_destroy(grad);
+    }
+  }
+  if (run_train) {
+    bwpp_pass_begin(&timer, "run_train");
+    run_ok &= train && bwpp_run_cpu(train, "train", mem_slab, run_threads, run_iters, run_profile);
+  }
+  bwpp_pass_end(&timer);
+  bwpp_graph_destroy(train);
+  if (c_path) {
+    bwpp_pass_begin(&timer, "codegen_c");
+    if (bwpp_codegen_c(ir, graph, c_path) != BWPP_OK) {
+      fprintf(stderr, "C codegen failed\n");
+      run_ok = 0;
+    }
+    bwpp_pass_end(&timer);
+  }
+  if (!run_ok) {
+    goto done;
+  }
+
+  bwpp_pass_begin(&timer, "codegen_metal");
+  if (bwpp_codegen_metal(ir, graph, output_path) != BWPP_OK) {
     fprintf(stderr, "codegen failed\n");
-    bwpp_graph_destroy(graph);
-    bwpp_ir_destroy(ir);
-    bwpp_ast_module_destroy(module);
-    free(src);
-    return 1;
+    goto done;
+  }
+  if (replay) {
+    bwpp_pass_begin(&timer, "replay");
+    if (!graph || !bwpp_replay_schedule(graph, output_path, run_threads)) {
+      goto done;
+    }
   }
+  status = 0;
 
+done:
+  bwpp_pass_end(&timer);
+  bwpp_pass_timer_report(&timer, stderr, time_passes == 2);
+  bwpp_pass_timer_destroy(&timer);
   bwpp_graph_destroy(graph);
   bwpp_ir_destroy(ir);
   bwpp_ast_module_destroy(module);
   free(src);
-  return 0;
+  free(dims.items);
+  return status;
 }
@@ -15,14 +15,55 @@ static int bwpp_shape_equal(const BwppShape *a, const BwppShape *b) {
   return 1;
 }
 
+/* With both sizes bound, any buffer of the same byte size will do;
+   otherwise fall back to an exact symbolic shape match. */
 static int bwpp_buffer_match(const BwppBufferDesc *a, const BwppBufferDesc *b) {
+  if (a->bytes && b->bytes) {
+    return a->bytes == b->bytes;
+  }
   return a->dtype == b->dtype && a->layout == b->layout && bwpp_shape_equal(&a->shape, &b->shape);
 }
 
+BwppMemPlan *bwpp_mem_plan_create(uint32_t value_count, int slab) {
+  BwppChunkArena arena;
+  bwpp_chunk_arena_init(&arena, 16 * 1024);
+  BwppMemPlan *plan = (BwppMemPlan *)bwpp_chunk_arena_alloc(&arena, sizeof(BwppMemPlan), _Alignof(BwppMemPlan));
+  if (!plan) {
+    bwpp_chunk_arena_destroy(&arena);
+    return NULL;
+  }
+  memset(plan, 0, sizeof(*plan));
+  plan->arena = arena;
+  uint32_t count = value_count ? value_count : 1;
+  plan->value_count = value_count;
+  plan->value_to_buffer = (uint32_t *)bwpp_chunk_arena_alloc(&plan->arena, sizeof(uint32_t) * count,
+                                                             _Alignof(uint32_t));
+  plan->inplace_of = (uint32_t *)bwpp_chunk_arena_alloc(&plan->arena, sizeof(uint32_t) * count, _Alignof(uint32_t));
+  if (slab) {
+    plan->value_offset = (uint64_t *)bwpp_chunk_arena_alloc(&plan->arena, sizeof(uint64_t) * count,
+                                                            _Alignof(uint64_t));
+  }
+  if (!plan->value_to_buffer || !plan->inplace_of || (slab && !plan->value_offset)) {
+    bwpp_mem_plan_destroy(plan);
+    return NULL;
+  }
+  for (uint32_t v = 0; v < value_count; ++v) {
+    plan->value_to_buffer[v] = UINT32_MAX;
+    plan->inplace_of[v] = UINT32_MAX;
+    if (slab) {
+      plan->value_offset[v] = BWPP_MEM_NO_OFFSET;
+    }
+  }
+  return plan;
+}
+
 static uint32_t bwpp_add_buffer(BwppMemPlan *plan, BwppBufferDesc desc) {
   if (plan->buffer_count == plan->buffer_capacity) {
     uint32_t new_cap = plan->buffer_capacity == 0 ? 8 : plan->buffer_capacity * 2;
-    BwppBufferDesc *nb = (BwppBufferDesc *)realloc(plan->buffers, new_cap * sizeof(BwppBufferDesc));
+    BwppBufferDesc *nb = (BwppBufferDesc *)bwpp_chunk_arena_grow(&plan->arena, plan->buffers,
+                                                                 plan->buffer_capacity * sizeof(BwppBufferDesc),
+                                                                 new_cap * sizeof(BwppBufferDesc),
+                                                                 _Alignof(BwppBufferDesc));
     if (!nb) {
       return UINT32_MAX;
     }
@@ -37,35 +78,19 @@ static void bwpp_shape_copy(BwppShape *dst, const BwppShape *src) {
   dst->rank = src->rank;
   for (uint32_t i = 0; i < src->rank && i < BWPP_GRAPH_MAX_DIMS; ++i) {
     dst->dims[i] = src->dims[i];
+    dst->sizes[i] = src->sizes[i];
   }
 }
 
-BwppMemPlan *bwpp_mem_plan_build(const BwppGraph *graph) {
-  if (!graph) {
-    return NULL;
-  }
-  BwppMemPlan *plan = (BwppMemPlan *)calloc(1, sizeof(BwppMemPlan));
-  if (!plan) {
-    return NULL;
-  }
-  plan->value_count = graph->value_count;
-  plan->value_to_buffer = (uint32_t *)malloc(sizeof(uint32_t) * graph->value_count);
-  if (!plan->value_to_buffer) {
-    bwpp_mem_plan_destroy(plan);
-    return NULL;
-  }
-  for (uint32_t i = 0; i < graph->value_count; ++i) {
-    plan->value_to_buffer[i] = UINT32_MAX;
-  }
-
-  uint32_t *last_use = (uint32_t *)malloc(sizeof(uint32_t) * graph->value_count);
+/* Index of the last node reading each value; graph outputs live to the end.
+   Allocated in `scratch`. */
+static uint32_t *bwpp_mem_last_use(const BwppGraph *graph, BwppChunkArena *scratch) {
+  uint32_t count = graph->value_count ? graph->value_count : 1;
+  uint32_t *last_use = (uint32_t *)bwpp_chunk_arena_alloc(scratch, sizeof(uint32_t) * count, _Alignof(uint32_t));
   if (!last_use) {
-    bwpp_mem_plan_destroy(plan);
     return NULL;
   }
-  for (uint32_t i = 0; i < graph->value_count; ++i) {
-    last_use[i] = 0;
-  }
+  memset(last_use, 0, sizeof(uint32_t) * count);
   for (uint32_t i = 0; i < graph->node_count; ++i) {
     const BwppGraphNode *n = &graph->nodes[i];
     for (uint32_t j = 0; j < n->input_count; ++j) {
@@ -81,6 +106,103 @@ BwppMemPlan *bwpp_mem_plan_build(const BwppGraph *graph) {
       last_use[v] = graph->node_count;
     }
   }
+  return last_use;
+}
+
+static uint64_t bwpp_value_bytes(const BwppGraphValue *v) {
+  return bwpp_shape_elems(&v->shape) * bwpp_dtype_bytes(v->dtype);
+}
+
+/* Bytes outside the planned buffers: graph inputs, and the activations a
+   training step saves for its backward half. */
+static void bwpp_mem_plan_totals(BwppMemPlan *plan, const BwppGraph *graph, BwppChunkArena *scratch) {
+  plan->forward_nodes = graph->forward_nodes;
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    if (graph->values[v].producer == BWPP_GRAPH_NO_NODE) {
+      plan->input_bytes += bwpp_value_bytes(&graph->values[v]);
+    }
+  }
+  if (!graph->forward_nodes) {
+    return;
+  }
+  uint8_t *saved = (uint8_t *)bwpp_chunk_arena_alloc(scratch, graph->value_count, 1);
+  if (!saved) {
+    return;
+  }
+  memset(saved, 0, graph->value_count);
+  for (uint32_t i = graph->forward_nodes; i < graph->node_count; ++i) {
+    const BwppGraphNode *n = &graph->nodes[i];
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      uint32_t v = n->inputs[j];
+      if (v < graph->value_count && !saved[v] && graph->values[v].producer < graph->forward_nodes) {
+        saved[v] = 1;
+        plan->saved_bytes += bwpp_value_bytes(&graph->values[v]);
+      }
+    }
+  }
+}
+
+/* 1 if input j of n repeats an earlier input, e.g. add(x, x) */
+static int bwpp_input_seen(const BwppGraphNode *n, uint32_t j) {
+  for (uint32_t k = 0; k < j; ++k) {
+    if (n->inputs[k] == n->inputs[j]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* An input whose storage node `i` may write its output over: the op is
+   elementwise, the input dies here and has the output's dtype and shape. */
+static uint32_t bwpp_inplace_donor(const BwppGraph *graph,
+                                   const BwppGraphNode *n,
+                                   uint32_t i,
+                                   const uint32_t *last_use) {
+  if (!bwpp_graph_op_inplace(n->op) || n->output >= graph->value_count) {
+    return UINT32_MAX;
+  }
+  const BwppGraphValue *out = &graph->values[n->output];
+  for (uint32_t j = 0; j < n->input_count; ++j) {
+    uint32_t v = n->inputs[j];
+    if (v >= graph->value_count || last_use[v] != i) {
+      continue;
+    }
+    const BwppGraphValue *in = &graph->values[v];
+    if (in->flags & (BWPP_GRAPH_VALUE_INPUT | BWPP_GRAPH_VALUE_CONST)) {
+      continue;
+    }
+    if (in->dtype != out->dtype || in->layout != out->layout) {
+      continue;
+    }
+    int fits = bwpp_shape_equal(&in->shape, &out->shape);
+    if (!fits && bwpp_shape_bound(&in->shape) && bwpp_shape_bound(&out->shape) &&
+        in->shape.rank == out->shape.rank) {
+      fits = memcmp(in->shape.sizes, out->shape.sizes, sizeof(uint32_t) * in->shape.rank) == 0;
+    }
+    if (fits) {
+      return v;
+    }
+  }
+  return UINT32_MAX;
+}
+
+BwppMemPlan *bwpp_mem_plan_build(const BwppGraph *graph) {
+  if (!graph) {
+    return NULL;
+  }
+  BwppMemPlan *plan = bwpp_mem_plan_create(graph->value_count, 0);
+  if (!plan) {
+    return NULL;
+  }
+  /* liveness and the free list die with the build */
+  BwppChunkArena scratch;
+  bwpp_chunk_arena_init(&scratch, 16 * 1024);
+  uint32_t *last_use = bwpp_mem_last_use(graph, &scratch);
+  if (!last_use) {
+    bwpp_chunk_arena_destroy(&scratch);
+    bwpp_mem_plan_destroy(plan);
+    return NULL;
+  }
 
   uint32_t *free_list = NULL;
   uint32_t free_count = 0;
@@ -90,24 +212,21 @@ BwppMemPlan *bwpp_mem_plan_build(const BwppGraph *graph) {
     const BwppGraphNode *n = &graph->nodes[i];
     for (uint32_t j = 0; j < n->input_count; ++j) {
       uint32_t v = n->inputs[j];
-      if (v >= graph->value_count) {
+      if (v >= graph->value_count || last_use[v] != i || plan->value_to_buffer[v] == UINT32_MAX ||
+          bwpp_input_seen(n, j)) {
         continue;
       }
-      if (last_use[v] == i && plan->value_to_buffer[v] != UINT32_MAX) {
-        if (free_count == free_capacity) {
-          uint32_t new_cap = free_capacity == 0 ? 8 : free_capacity * 2;
-          uint32_t *nf = (uint32_t *)realloc(free_list, new_cap * sizeof(uint32_t));
-          if (!nf) {
-            free_list = NULL;
-            free_capacity = 0;
-            free_count = 0;
-            break;
-          }
-          free_list = nf;
-          free_capacity = new_cap;
+      if (free_count == free_capacity) {
+        uint32_t new_cap = free_capacity == 0 ? 8 : free_capacity * 2;
+        uint32_t *nf = (uint32_t *)bwpp_chunk_arena_grow(&scratch, free_list, free_capacity * sizeof(uint32_t),
+                                                         new_cap * sizeof(uint32_t), _Alignof(uint32_t));
+        if (!nf) {
+          break;
         }
-        free_list[free_count++] = plan->value_to_buffer[v];
+        free_list = nf;
+        free_capacity = new_cap;
       }
+      free_list[free_count++] = plan->value_to_buffer[v];
     }
 
     uint32_t out = n->output;
@@ -123,25 +242,240 @@ BwppMemPlan *bwpp_mem_plan_build(const BwppGraph *graph) {
     desc.dtype = v->dtype;
     desc.layout = v->layout;
     bwpp_shape_copy(&desc.shape, &v->shape);
+    desc.bytes = bwpp_value_bytes(v);
 
+    /* an elementwise op takes its donor's buffer; anything else may land on
+       a dying input too, but then the executor computes through scratch */
+    uint32_t donor = bwpp_inplace_donor(graph, n, i, last_use);
     uint32_t chosen = UINT32_MAX;
     for (uint32_t f = 0; f < free_count; ++f) {
       uint32_t buf_id = free_list[f];
-      if (buf_id < plan->buffer_count && bwpp_buffer_match(&plan->buffers[buf_id], &desc)) {
+      int take = donor != UINT32_MAX ? buf_id == plan->value_to_buffer[donor]
+                                     : buf_id < plan->buffer_count &&
+                                           bwpp_buffer_match(&plan->buffers[buf_id], &desc);
+      if (take) {
         chosen = buf_id;
         free_list[f] = free_list[free_count - 1];
         free_count--;
         break;
       }
     }
+    if (chosen != UINT32_MAX && donor != UINT32_MAX) {
+      plan->inplace_of[out] = donor;
+    }
     if (chosen == UINT32_MAX) {
       chosen = bwpp_add_buffer(plan, desc);
     }
     plan->value_to_buffer[out] = chosen;
   }
 
-  free(last_use);
-  free(free_list);
+  plan->total_bytes = 0;
+  for (uint32_t i = 0; i < plan->buffer_count; ++i) {
+    if (!plan->buffers[i].bytes) {
+      plan->total_bytes = 0;
+      break;
+    }
+    plan->total_bytes += plan->buffers[i].bytes;
+  }
+  bwpp_mem_plan_totals(plan, graph, &scratch);
+
+  bwpp_chunk_arena_destroy(&scratch);
+  return plan;
+}
+
+#define BWPP_MEM_SLAB_ALIGN 64u
+
+typedef struct {
+  uint32_t value;
+  uint32_t root; /* value whose slot this one shares in place (itself if none) */
+  uint32_t def;
+  uint32_t last;
+  uint64_t bytes;
+  uint64_t offset;
+} BwppSlabItem;
+
+static int bwpp_slab_by_size(const void *pa, const void *pb) {
+  const BwppSlabItem *a = (const BwppSlabItem *)pa;
+  const BwppSlabItem *b = (const BwppSlabItem *)pb;
+  if (a->bytes != b->bytes) {
+    return a->bytes > b->bytes ? -1 : 1;
+  }
+  return a->def < b->def ? -1 : (a->def > b->def ? 1 : 0);
+}
+
+static int bwpp_slab_by_offset(const void *pa, const void *pb) {
+  const BwppSlabItem *a = *(const BwppSlabItem *const *)pa;
+  const BwppSlabItem *b = *(const BwppSlabItem *const *)pb;
+  return a->offset < b->offset ? -1 : (a->offset > b->offset ? 1 : 0);
+}
+
+/* Lifetimes are inclusive, so a node's output never shares bytes with an
+   input that dies at the same node. */
+static int bwpp_slab_overlap(const BwppSlabItem *a, const BwppSlabItem *b) {
+  return a->def <= b->last && b->def <= a->last;
+}
+
+/* Last step reading each value (the end step for graph outputs), or
+   UINT32_MAX if nothing reads it; *end is one past the last step. */
+static uint32_t *bwpp_mem_last_step(const BwppGraph *graph, const uint32_t *node_step, uint32_t *end,
+                                    BwppChunkArena *scratch) {
+  uint32_t count = graph->value_count ? graph->value_count : 1;
+  uint32_t *last = (uint32_t *)bwpp_chunk_arena_alloc(scratch, sizeof(uint32_t) * count, _Alignof(uint32_t));
+  if (!last) {
+    return NULL;
+  }
+  *end = 0;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    *end = node_step[i] + 1 > *end ? node_step[i] + 1 : *end;
+  }
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    last[v] = UINT32_MAX;
+  }
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    const BwppGraphNode *n = &graph->nodes[i];
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      uint32_t v = n->inputs[j];
+      if (v < graph->value_count && (last[v] == UINT32_MAX || node_step[i] > last[v])) {
+        last[v] = node_step[i];
+      }
+    }
+  }
+  for (uint32_t i = 0; i < graph->output_count; ++i) {
+    if (graph->outputs[i] < graph->value_count) {
+      last[graph->outputs[i]] = *end;
+    }
+  }
+  return last;
+}
+
+BwppMemPlan *bwpp_mem_plan_build_slab(const BwppGraph *graph, uint32_t elem_bytes) {
+  return bwpp_mem_plan_build_slab_steps(graph, elem_bytes, NULL);
+}
+
+BwppMemPlan *bwpp_mem_plan_build_slab_steps(const BwppGraph *graph, uint32_t elem_bytes, const uint32_t *node_step) {
+  if (!graph) {
+    return NULL;
+  }
+  BwppMemPlan *plan = bwpp_mem_plan_create(graph->value_count, 1);
+  if (!plan) {
+    return NULL;
+  }
+  uint32_t count = graph->value_count ? graph->value_count : 1;
+  BwppChunkArena scratch;
+  bwpp_chunk_arena_init(&scratch, 64 * 1024);
+  uint32_t steps = graph->node_count;
+  uint32_t *last_use = node_step ? bwpp_mem_last_step(graph, node_step, &steps, &scratch)
+                                 : bwpp_mem_last_use(graph, &scratch);
+  uint32_t *item_of = (uint32_t *)bwpp_chunk_arena_alloc(&scratch, sizeof(uint32_t) * count, _Alignof(uint32_t));
+  size_t slots = (size_t)graph->node_count + 1;
+  BwppSlabItem *items = (BwppSlabItem *)bwpp_chunk_arena_alloc(&scratch, sizeof(BwppSlabItem) * slots,
+                                                               _Alignof(BwppSlabItem));
+  BwppSlabItem **live = (BwppSlabItem **)bwpp_chunk_arena_alloc(&scratch, sizeof(BwppSlabItem *) * slots,
+                                                                _Alignof(BwppSlabItem *));
+  if (!last_use || !item_of || !items || !live) {
+    bwpp_chunk_arena_destroy(&scratch);
+    bwpp_mem_plan_destroy(plan);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < graph->value_count; ++i) {
+    item_of[i] = UINT32_MAX;
+  }
+
+  uint32_t item_count = 0;
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    uint32_t out = graph->nodes[i].output;
+    if (out >= graph->value_count) {
+      continue;
+    }
+    const BwppGraphValue *v = &graph->values[out];
+    if (v->flags & (BWPP_GRAPH_VALUE_INPUT | BWPP_GRAPH_VALUE_CONST)) {
+      continue;
+    }
+    if (!bwpp_shape_bound(&v->shape)) {
+      BwppStr dim = bwpp_shape_unbound_dim(&v->shape);
+      fprintf(stderr, "mem plan: slab planning needs bound dims (v%u has %.*s)\n",
+              out, (int)dim.len, dim.ptr);
+      bwpp_chunk_arena_destroy(&scratch);
+      bwpp_mem_plan_destroy(plan);
+      return NULL;
+    }
+    uint32_t def = node_step ? node_step[i] : i;
+    if (node_step && last_use[out] == def) {
+      /* read only inside its own step: never leaves the kernel */
+      continue;
+    }
+    item_of[out] = item_count;
+    BwppSlabItem *it = &items[item_count++];
+    it->value = out;
+    it->root = out;
+    it->def = def;
+    it->last = last_use[out] != UINT32_MAX && last_use[out] > def ? last_use[out] : def;
+    uint64_t bytes = bwpp_shape_elems(&v->shape) * (elem_bytes ? elem_bytes : bwpp_dtype_bytes(v->dtype));
+    it->bytes = (bytes + BWPP_MEM_SLAB_ALIGN - 1) / BWPP_MEM_SLAB_ALIGN * BWPP_MEM_SLAB_ALIGN;
+    it->offset = 0;
+    plan->unshared_bytes += it->bytes;
+
+    /* in place: the output continues its donor's slot, which then lives on;
+       a step may read its inputs after writing, so steps never do this */
+    uint32_t donor = node_step ? UINT32_MAX : bwpp_inplace_donor(graph, &graph->nodes[i], i, last_use);
+    if (donor != UINT32_MAX && item_of[donor] != UINT32_MAX) {
+      BwppSlabItem *root = &items[item_of[items[item_of[donor]].root]];
+      it->root = root->value;
+      root->last = it->last > root->last ? it->last : root->last;
+      plan->inplace_of[out] = donor;
+    }
+  }
+
+  /* largest first; each goes into the smallest gap among the already placed
+     values it is live with, or on top of them */
+  qsort(items, item_count, sizeof(BwppSlabItem), bwpp_slab_by_size);
+  for (uint32_t k = 0; k < item_count; ++k) {
+    if (items[k].root != items[k].value) {
+      continue;
+    }
+    uint32_t live_count = 0;
+    for (uint32_t j = 0; j < k; ++j) {
+      if (items[j].root == items[j].value && bwpp_slab_overlap(&items[j], &items[k])) {
+        live[live_count++] = &items[j];
+      }
+    }
+    qsort(live, live_count, sizeof(BwppSlabItem *), bwpp_slab_by_offset);
+    uint64_t end = 0;
+    uint64_t best = BWPP_MEM_NO_OFFSET;
+    uint64_t best_gap = BWPP_MEM_NO_OFFSET;
+    for (uint32_t j = 0; j < live_count; ++j) {
+      if (live[j]->offset > end) {
+        uint64_t gap = live[j]->offset - end;
+        if (gap >= items[k].bytes && gap < best_gap) {
+          best = end;
+          best_gap = gap;
+        }
+      }
+      uint64_t top = live[j]->offset + live[j]->bytes;
+      end = top > end ? top : end;
+    }
+    items[k].offset = best != BWPP_MEM_NO_OFFSET ? best : end;
+    uint64_t top = items[k].offset + items[k].bytes;
+    plan->slab_bytes = top > plan->slab_bytes ? top : plan->slab_bytes;
+    plan->value_offset[items[k].value] = items[k].offset;
+  }
+  for (uint32_t k = 0; k < item_count; ++k) {
+    plan->value_offset[items[k].value] = plan->value_offset[items[k].root];
+  }
+
+  for (uint32_t i = 0; i < steps; ++i) {
+    uint64_t bytes = 0;
+    for (uint32_t k = 0; k < item_count; ++k) {
+      if (items[k].root == items[k].value && items[k].def <= i && i <= items[k].last) {
+        bytes += items[k].bytes;
+      }
+    }
+    plan->live_peak_bytes = bytes > plan->live_peak_bytes ? bytes : plan->live_peak_bytes;
+  }
+  plan->total_bytes = plan->slab_bytes;
+  bwpp_mem_plan_totals(plan, graph, &scratch);
+
+  bwpp_chunk_arena_destroy(&scratch);
   return plan;
 }
 
@@ -150,6 +484,7 @@ static const char *bwpp_dtype_name(BwppDType dt) {
     case BWPP_DTYPE_F16: return "f16";
     case BWPP_DTYPE_BF16: return "bf16";
     case BWPP_DTYPE_F32: return "f32";
+    case BWPP_DTYPE_U32: return "u32";
     default: return "unknown";
   }
 }
@@ -169,6 +504,9 @@ static void bwpp_print_shape(FILE *out, const BwppShape *shape) {
       fprintf(out, ",");
     }
     fprintf(out, "%.*s", (int)shape->dims[i].len, shape->dims[i].ptr);
+    if (shape->sizes[i] && (shape->dims[i].len == 0 || shape->dims[i].ptr[0] < '0' || shape->dims[i].ptr[0] > '9')) {
+      fprintf(out, "=%u", shape->sizes[i]);
+    }
   }
   fprintf(out, "]");
 }
@@ -177,18 +515,44 @@ void bwpp_mem_plan_dump(const BwppMemPlan *plan, FILE *out) {
   if (!plan || !out) {
     return;
   }
-  fprintf(out, "buffers=%u values=%u\n", plan->buffer_count, plan->value_count);
+  fprintf(out, "buffers=%u values=%u", plan->buffer_count, plan->value_count);
+  if (plan->total_bytes) {
+    fprintf(out, " total_bytes=%llu input_bytes=%llu peak_bytes=%llu",
+            (unsigned long long)plan->total_bytes, (unsigned long long)plan->input_bytes,
+            (unsigned long long)(plan->total_bytes + plan->input_bytes));
+  }
+  fprintf(out, "\n");
+  if (plan->forward_nodes) {
+    fprintf(out, "training forward_nodes=%u saved_activation_bytes=%llu\n",
+            plan->forward_nodes, (unsigned long long)plan->saved_bytes);
+  }
   for (uint32_t i = 0; i < plan->buffer_count; ++i) {
     const BwppBufferDesc *b = &plan->buffers[i];
     fprintf(out, "buffer%u %s ", i, bwpp_dtype_name(b->dtype));
     bwpp_print_shape(out, &b->shape);
-    fprintf(out, " %s\n", bwpp_layout_name(b->layout));
+    fprintf(out, " %s", bwpp_layout_name(b->layout));
+    if (b->bytes) {
+      fprintf(out, " bytes=%llu", (unsigned long long)b->bytes);
+    }
+    fprintf(out, "\n");
+  }
+  if (plan->value_offset) {
+    fprintf(out, "slab_bytes=%llu live_peak_bytes=%llu unshared_bytes=%llu\n",
+            (unsigned long long)plan->slab_bytes, (unsigned long long)plan->live_peak_bytes,
+            (unsigned long long)plan->unshared_bytes);
   }
   for (uint32_t i = 0; i < plan->value_count; ++i) {
-    if (plan->value_to_buffer[i] == UINT32_MAX) {
+    if (plan->value_offset && plan->value_offset[i] != BWPP_MEM_NO_OFFSET) {
+      fprintf(out, "v%u -> slab+%llu", i, (unsigned long long)plan->value_offset[i]);
+    } else if (plan->value_to_buffer[i] != UINT32_MAX) {
+      fprintf(out, "v%u -> buffer%u", i, plan->value_to_buffer[i]);
+    } else {
       continue;
     }
-    fprintf(out, "v%u -> buffer%u\n", i, plan->value_to_buffer[i]);
+    if (plan->inplace_of[i] != UINT32_MAX) {
+      fprintf(out, " inplace=v%u", plan->inplace_of[i]);
+    }
+    fprintf(out, "\n");
   }
 }
 
@@ -196,7 +560,7 @@ void bwpp_mem_plan_destroy(BwppMemPlan *plan) {
   if (!plan) {
     return;
   }
-  free(plan->buffers);
-  free(plan->value_to_buffer);
-  free(plan);
+  /* the plan lives in its own arena, so copy the arena out first */
+  BwppChunkArena arena = plan->arena;
+  bwpp_chunk_arena_destroy(&arena);
 }
@@ -1,15 +1,20 @@
 #include "parser.h"
-#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static BwppToken bwpp_parser_next(BwppParser *parser);
 static void bwpp_parser_unread(BwppParser *parser, BwppToken tok);
+static uint32_t bwpp_parse_expr(BwppParser *parser);
 
 void bwpp_parser_init(BwppParser *parser, const char *input, size_t length) {
   bwpp_lexer_init(&parser->lexer, input, length);
   parser->source = input;
   parser->length = length;
   parser->has_lookahead = 0;
+  parser->module = NULL;
+  parser->region = BWPP_AST_NO_REGION;
+  parser->failed = 0;
 }
 
 static BwppToken bwpp_parser_next(BwppParser *parser) {
@@ -30,138 +35,446 @@ static int bwpp_token_is(const BwppToken *tok, const char *lit) {
   return tok->kind == BWPP_TOK_IDENT && tok->length == len && strncmp(tok->lexeme, lit, len) == 0;
 }
 
-BwppAstModule *bwpp_parse_module(BwppParser *parser) {
-  BwppAstModule *module = bwpp_ast_module_create(parser->source, parser->length);
-  if (!module) {
-    return NULL;
+static int bwpp_token_sym(const BwppToken *tok, char ch) {
+  return tok->kind == BWPP_TOK_SYMBOL && tok->length == 1 && tok->lexeme[0] == ch;
+}
+
+static BwppStr bwpp_token_str(const BwppToken *tok) {
+  BwppStr out = { tok->lexeme, tok->length };
+  return out;
+}
+
+/* Reports the first error only; everything after it is noise. */
+static void bwpp_parser_error(BwppParser *parser, const BwppToken *tok, const char *expected) {
+  if (parser->failed) {
+    return;
   }
+  parser->failed = 1;
+  unsigned line = 1;
+  const char *at = tok->lexeme ? tok->lexeme : parser->source + parser->length;
+  for (const char *c = parser->source; c < at; ++c) {
+    if (*c == '\n') {
+      line++;
+    }
+  }
+  if (tok->kind == BWPP_TOK_EOF) {
+    fprintf(stderr, "parse: line %u: expected %s, got end of input\n", line, expected);
+  } else {
+    fprintf(stderr, "parse: line %u: expected %s, got '%.*s'\n", line, expected, (int)tok->length, tok->lexeme);
+  }
+}
 
-  int brace_depth = 0;
-  int reversible_brace_depth = -1;
-  uint32_t current_region = BWPP_AST_NO_REGION;
-  int pending_reversible = 0;
-  int pending_reversible_fn = 0;
-  int expect_fn_name = 0;
+static int bwpp_parser_expect(BwppParser *parser, char ch, const char *expected) {
+  BwppToken tok = bwpp_parser_next(parser);
+  if (!bwpp_token_sym(&tok, ch)) {
+    bwpp_parser_error(parser, &tok, expected);
+    return 0;
+  }
+  return 1;
+}
 
+static int bwpp_parser_ident(BwppParser *parser, BwppStr *out, const char *expected) {
+  BwppToken tok = bwpp_parser_next(parser);
+  if (tok.kind != BWPP_TOK_IDENT) {
+    bwpp_parser_error(parser, &tok, expected);
+    return 0;
+  }
+  *out = bwpp_token_str(&tok);
+  return 1;
+}
+
+/* 1 if `name` appears anywhere in the expression tree under `expr`. */
+static int bwpp_parser_mentions(const BwppAstModule *module, uint32_t expr, const char *name) {
+  const BwppAstExpr *e = &module->exprs[expr];
+  if (e->kind == BWPP_AST_EXPR_NAME && bwpp_str_eq(e->text, name)) {
+    return 1;
+  }
+  for (uint32_t a = e->first; a != BWPP_AST_NO_EXPR; a = module->exprs[a].next) {
+    if (bwpp_parser_mentions(module, a, name)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Built-in calls also go to module->ops, the flat op list bwpp_ir_from_ast reads. */
+static void bwpp_parser_record_op(BwppParser *parser, uint32_t call) {
+  static const struct {
+    const char *name;
+    BwppAstOpKind op;
+  } builtins[] = {
+    { "matmul", BWPP_AST_OP_MATMUL },         { "batch_matmul", BWPP_AST_OP_BATCH_MATMUL },
+    { "transpose", BWPP_AST_OP_TRANSPOSE },   { "permute", BWPP_AST_OP_PERMUTE },
+    { "reshape", BWPP_AST_OP_RESHAPE },       { "add", BWPP_AST_OP_ADD },
+    { "sub", BWPP_AST_OP_SUB },               { "mul", BWPP_AST_OP_MUL },
+    { "div", BWPP_AST_OP_DIV },               { "reduce_sum", BWPP_AST_OP_REDUCE_SUM },
+    { "reduce_max", BWPP_AST_OP_REDUCE_MAX }, { "softmax", BWPP_AST_OP_SOFTMAX },
+    { "rmsnorm", BWPP_AST_OP_RMSNORM },       { "silu", BWPP_AST_OP_SILU }
+  };
+  const BwppAstExpr *e = &parser->module->exprs[call];
+  for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i) {
+    if (bwpp_str_eq(e->text, builtins[i].name)) {
+      uint32_t flags = 0;
+      if (builtins[i].op == BWPP_AST_OP_ADD && bwpp_parser_mentions(parser->module, call, "bias")) {
+        flags |= BWPP_AST_OPF_HAS_BIAS;
+      }
+      bwpp_ast_add_op(parser->module, builtins[i].op, parser->region, flags);
+      return;
+    }
+  }
+}
+
+/* `(` or `[` already read: comma-separated expressions up to `close`. */
+static int bwpp_parse_args(BwppParser *parser, uint32_t parent, char close) {
+  BwppToken tok = bwpp_parser_next(parser);
+  if (bwpp_token_sym(&tok, close)) {
+    return 1;
+  }
+  bwpp_parser_unread(parser, tok);
   for (;;) {
+    uint32_t arg = bwpp_parse_expr(parser);
+    if (arg == BWPP_AST_NONE) {
+      return 0;
+    }
+    bwpp_ast_append_arg(parser->module, parent, arg);
+    BwppToken sep = bwpp_parser_next(parser);
+    if (bwpp_token_sym(&sep, close)) {
+      return 1;
+    }
+    if (!bwpp_token_sym(&sep, ',')) {
+      bwpp_parser_error(parser, &sep, close == ')' ? "',' or ')'" : "',' or ']'");
+      return 0;
+    }
+  }
+}
+
+static uint32_t bwpp_parse_primary(BwppParser *parser) {
+  BwppAstModule *module = parser->module;
+  BwppToken tok = bwpp_parser_next(parser);
+  if (tok.kind == BWPP_TOK_IDENT) {
+    BwppToken next = bwpp_parser_next(parser);
+    if (!bwpp_token_sym(&next, '(')) {
+      bwpp_parser_unread(parser, next);
+      return bwpp_ast_add_expr(module, BWPP_AST_EXPR_NAME, bwpp_token_str(&tok));
+    }
+    uint32_t call = bwpp_ast_add_expr(module, BWPP_AST_EXPR_CALL, bwpp_token_str(&tok));
+    if (call == BWPP_AST_NONE || !bwpp_parse_args(parser, call, ')')) {
+      return BWPP_AST_NONE;
+    }
+    bwpp_parser_record_op(parser, call);
+    return call;
+  }
+  if (tok.kind == BWPP_TOK_NUMBER) {
+    return bwpp_ast_add_expr(module, BWPP_AST_EXPR_NUMBER, bwpp_token_str(&tok));
+  }
+  if (bwpp_token_sym(&tok, '(')) {
+    uint32_t inner = bwpp_parse_expr(parser);
+    if (inner == BWPP_AST_NONE || !bwpp_parser_expect(parser, ')', "')'")) {
+      return BWPP_AST_NONE;
+    }
+    return inner;
+  }
+  if (bwpp_token_sym(&tok, '[')) {
+    uint32_t list = bwpp_ast_add_expr(module, BWPP_AST_EXPR_LIST, bwpp_token_str(&tok));
+    if (list == BWPP_AST_NONE || !bwpp_parse_args(parser, list, ']')) {
+      return BWPP_AST_NONE;
+    }
+    return list;
+  }
+  bwpp_parser_error(parser, &tok, "an expression");
+  return BWPP_AST_NONE;
+}
+
+/* primary { '@' primary }, left to right */
+static uint32_t bwpp_parse_expr(BwppParser *parser) {
+  uint32_t lhs = bwpp_parse_primary(parser);
+  while (lhs != BWPP_AST_NONE) {
     BwppToken tok = bwpp_parser_next(parser);
-    if (tok.kind == BWPP_TOK_EOF) {
+    if (!bwpp_token_sym(&tok, '@')) {
+      bwpp_parser_unread(parser, tok);
       break;
     }
-    if (tok.kind == BWPP_TOK_SYMBOL && tok.length == 1) {
-      char ch = tok.lexeme[0];
-      if (ch == '{') {
-        brace_depth++;
-        if (pending_reversible_fn && current_region == BWPP_AST_NO_REGION) {
-          current_region = bwpp_ast_add_region(module, BWPP_AST_REGION_REVERSIBLE, BWPP_AST_POLICY_AUTO);
-          reversible_brace_depth = brace_depth;
-          pending_reversible_fn = 0;
-          pending_reversible = 0;
-        }
-        continue;
-      }
-      if (ch == '}') {
-        if (current_region != BWPP_AST_NO_REGION && reversible_brace_depth == brace_depth) {
-          current_region = BWPP_AST_NO_REGION;
-          reversible_brace_depth = -1;
-        }
-        brace_depth--;
-        continue;
+    uint32_t rhs = bwpp_parse_primary(parser);
+    if (rhs == BWPP_AST_NONE) {
+      return BWPP_AST_NONE;
+    }
+    uint32_t mm = bwpp_ast_add_expr(parser->module, BWPP_AST_EXPR_MATMUL, bwpp_token_str(&tok));
+    if (mm == BWPP_AST_NONE) {
+      return BWPP_AST_NONE;
+    }
+    bwpp_ast_append_arg(parser->module, mm, lhs);
+    bwpp_ast_append_arg(parser->module, mm, rhs);
+    bwpp_ast_add_op(parser->module, BWPP_AST_OP_MATMUL, parser->region, 0);
+    lhs = mm;
+  }
+  return lhs;
+}
+
+/* tensor<dtype, [dims], layout> with the layout optional */
+static int bwpp_parse_type(BwppParser *parser, BwppAstType *type) {
+  memset(type, 0, sizeof(*type));
+  BwppToken tensor = bwpp_parser_next(parser);
+  if (!bwpp_token_is(&tensor, "tensor")) {
+    bwpp_parser_error(parser, &tensor, "'tensor'");
+    return 0;
+  }
+  if (!bwpp_parser_expect(parser, '<', "'<'") || !bwpp_parser_ident(parser, &type->dtype, "a dtype") ||
+      !bwpp_parser_expect(parser, ',', "','") || !bwpp_parser_expect(parser, '[', "'['")) {
+    return 0;
+  }
+  BwppToken dim = bwpp_parser_next(parser);
+  while (!bwpp_token_sym(&dim, ']')) {
+    if (dim.kind != BWPP_TOK_IDENT && dim.kind != BWPP_TOK_NUMBER) {
+      bwpp_parser_error(parser, &dim, "a dim");
+      return 0;
+    }
+    if (type->rank == BWPP_AST_MAX_DIMS) {
+      bwpp_parser_error(parser, &dim, "at most 4 dims");
+      return 0;
+    }
+    type->dims[type->rank++] = bwpp_token_str(&dim);
+    dim = bwpp_parser_next(parser);
+    if (bwpp_token_sym(&dim, ',')) {
+      dim = bwpp_parser_next(parser);
+    } else if (!bwpp_token_sym(&dim, ']')) {
+      bwpp_parser_error(parser, &dim, "',' or ']'");
+      return 0;
+    }
+  }
+  BwppToken next = bwpp_parser_next(parser);
+  if (bwpp_token_sym(&next, ',')) {
+    if (!bwpp_parser_ident(parser, &type->layout, "a layout")) {
+      return 0;
+    }
+    next = bwpp_parser_next(parser);
+  }
+  if (!bwpp_token_sym(&next, '>')) {
+    bwpp_parser_error(parser, &next, "'>'");
+    return 0;
+  }
+  return 1;
+}
+
+static int bwpp_parse_params(BwppParser *parser, BwppAstFn *fn) {
+  if (!bwpp_parser_expect(parser, '(', "'('")) {
+    return 0;
+  }
+  fn->params = parser->module->param_count;
+  BwppToken tok = bwpp_parser_next(parser);
+  if (bwpp_token_sym(&tok, ')')) {
+    return 1;
+  }
+  bwpp_parser_unread(parser, tok);
+  for (;;) {
+    BwppAstParam param;
+    if (!bwpp_parser_ident(parser, &param.name, "a parameter name") ||
+        !bwpp_parser_expect(parser, ':', "':'") || !bwpp_parse_type(parser, &param.type)) {
+      return 0;
+    }
+    if (bwpp_ast_add_param(parser->module, &param) == BWPP_AST_NONE) {
+      return 0;
+    }
+    fn->param_count++;
+    BwppToken sep = bwpp_parser_next(parser);
+    if (bwpp_token_sym(&sep, ')')) {
+      return 1;
+    }
+    if (!bwpp_token_sym(&sep, ',')) {
+      bwpp_parser_error(parser, &sep, "',' or ')'");
+      return 0;
+    }
+  }
+}
+
+/* Optional `(store|recompute|auto)` after `@reversible`; auto if absent. */
+static int bwpp_parse_policy(BwppParser *parser, BwppAstRegionPolicy *policy) {
+  *policy = BWPP_AST_POLICY_AUTO;
+  BwppToken open = bwpp_parser_next(parser);
+  if (!bwpp_token_sym(&open, '(')) {
+    bwpp_parser_unread(parser, open);
+    return 1;
+  }
+  BwppToken name = bwpp_parser_next(parser);
+  if (bwpp_token_is(&name, "store")) {
+    *policy = BWPP_AST_POLICY_STORE;
+  } else if (bwpp_token_is(&name, "recompute")) {
+    *policy = BWPP_AST_POLICY_RECOMPUTE;
+  } else if (!bwpp_token_is(&name, "auto")) {
+    fprintf(stderr, "@reversible: unknown policy %.*s (store, recompute or auto)\n",
+            (int)name.length, name.lexeme);
+  }
+  return bwpp_parser_expect(parser, ')', "')'");
+}
+
+/* `{` already read: statements up to the matching `}`. */
+static int bwpp_parse_block(BwppParser *parser) {
+  BwppAstModule *module = parser->module;
+  for (;;) {
+    BwppToken tok = bwpp_parser_next(parser);
+    if (bwpp_token_sym(&tok, '}')) {
+      return 1;
+    }
+    BwppAstStmt stmt = { BWPP_AST_STMT_LET, { NULL, 0 }, BWPP_SYM_NONE, BWPP_AST_NO_EXPR, BWPP_AST_NO_REGION, 0 };
+    if (bwpp_token_is(&tok, "let")) {
+      if (!bwpp_parser_ident(parser, &stmt.name, "a name after 'let'") ||
+          !bwpp_parser_expect(parser, '=', "'='")) {
+        return 0;
       }
-      if (ch == '@') {
-        BwppToken next = bwpp_parser_next(parser);
-        if (bwpp_token_is(&next, "reversible")) {
-          pending_reversible = 1;
-          continue;
+      stmt.expr = bwpp_parse_expr(parser);
+    } else if (bwpp_token_is(&tok, "return")) {
+      stmt.kind = BWPP_AST_STMT_RETURN;
+      stmt.expr = bwpp_parse_expr(parser);
+    } else if (bwpp_token_sym(&tok, '@') || bwpp_token_sym(&tok, '{')) {
+      stmt.kind = BWPP_AST_STMT_BLOCK;
+      uint32_t outer = parser->region;
+      if (bwpp_token_sym(&tok, '@')) {
+        BwppToken kw = bwpp_parser_next(parser);
+        BwppAstRegionPolicy policy;
+        if (!bwpp_token_is(&kw, "reversible")) {
+          bwpp_parser_error(parser, &kw, "'reversible'");
+          return 0;
         }
-        if (bwpp_token_is(&next, "meta") || bwpp_token_is(&next, "impure")) {
-          continue;
+        if (!bwpp_parse_policy(parser, &policy) || !bwpp_parser_expect(parser, '{', "'{'")) {
+          return 0;
         }
-        if (brace_depth > 0) {
-          bwpp_ast_add_op(module, BWPP_AST_OP_MATMUL, current_region, 0);
-        }
-        bwpp_parser_unread(parser, next);
-        continue;
+        stmt.region = bwpp_ast_add_region(module, BWPP_AST_REGION_REVERSIBLE, policy);
+        parser->region = stmt.region;
+      }
+      uint32_t at = bwpp_ast_add_stmt(module, &stmt);
+      if (at == BWPP_AST_NONE || !bwpp_parse_block(parser)) {
+        return 0;
       }
+      module->stmts[at].end = module->stmt_count;
+      parser->region = outer;
       continue;
+    } else {
+      bwpp_parser_error(parser, &tok, "'let', 'return' or '}'");
+      return 0;
+    }
+    if (stmt.expr == BWPP_AST_NONE) {
+      return 0;
+    }
+    stmt.end = module->stmt_count + 1;
+    if (bwpp_ast_add_stmt(module, &stmt) == BWPP_AST_NONE) {
+      return 0;
     }
+  }
+}
 
-    if (tok.kind == BWPP_TOK_IDENT) {
-      if (bwpp_token_is(&tok, "fn")) {
-        expect_fn_name = 1;
-        if (pending_reversible) {
-          pending_reversible_fn = 1;
-        }
-        continue;
+/* `fn` already read. */
+static int bwpp_parse_fn(BwppParser *parser, uint32_t region) {
+  BwppAstFn fn;
+  memset(&fn, 0, sizeof(fn));
+  fn.region = region;
+  if (!bwpp_parser_ident(parser, &fn.name, "a function name") || !bwpp_parse_params(parser, &fn)) {
+    return 0;
+  }
+  BwppToken tok = bwpp_parser_next(parser);
+  if (bwpp_token_sym(&tok, '-')) {
+    if (!bwpp_parser_expect(parser, '>', "'->'") || !bwpp_parse_type(parser, &fn.result)) {
+      return 0;
+    }
+    fn.has_result = 1;
+    tok = bwpp_parser_next(parser);
+  }
+  if (!bwpp_token_sym(&tok, '{')) {
+    bwpp_parser_error(parser, &tok, "'{'");
+    return 0;
+  }
+  uint32_t outer = parser->region;
+  parser->region = region;
+  fn.stmts = parser->module->stmt_count;
+  int ok = bwpp_parse_block(parser);
+  fn.stmt_end = parser->module->stmt_count;
+  parser->region = outer;
+  return ok && bwpp_ast_add_fn(parser->module, &fn) != BWPP_AST_NONE;
+}
+
+/* `@dims` already read: `{ T = 2048, D = 4096 }`. */
+static int bwpp_parse_dims(BwppParser *parser) {
+  if (!bwpp_parser_expect(parser, '{', "'{' after @dims")) {
+    return 0;
+  }
+  for (;;) {
+    BwppToken name = bwpp_parser_next(parser);
+    if (bwpp_token_sym(&name, ',')) {
+      continue;
+    }
+    if (bwpp_token_sym(&name, '}')) {
+      return 1;
+    }
+    BwppToken eq = bwpp_parser_next(parser);
+    BwppToken value = bwpp_parser_next(parser);
+    int digits = value.kind == BWPP_TOK_NUMBER;
+    for (size_t i = 0; digits && i < value.length; ++i) {
+      digits = value.lexeme[i] >= '0' && value.lexeme[i] <= '9';
+    }
+    if (name.kind != BWPP_TOK_IDENT || !bwpp_token_sym(&eq, '=') || !digits) {
+      bwpp_parser_error(parser, &name, "NAME = N in @dims");
+      return 0;
+    }
+    if (bwpp_ast_add_dim(parser->module, bwpp_token_str(&name),
+                         (uint32_t)strtoul(value.lexeme, NULL, 10)) == BWPP_AST_NONE) {
+      return 0;
+    }
+  }
+}
+
+static int bwpp_parse_top_level(BwppParser *parser) {
+  int reversible = 0;
+  BwppAstRegionPolicy policy = BWPP_AST_POLICY_AUTO;
+  for (;;) {
+    BwppToken tok = bwpp_parser_next(parser);
+    if (tok.kind == BWPP_TOK_EOF) {
+      return 1;
+    }
+    if (bwpp_token_is(&tok, "fn")) {
+      uint32_t region = BWPP_AST_NO_REGION;
+      if (reversible) {
+        region = bwpp_ast_add_region(parser->module, BWPP_AST_REGION_REVERSIBLE, policy);
       }
-      if (expect_fn_name) {
-        expect_fn_name = 0;
-        continue;
+      reversible = 0;
+      if (!bwpp_parse_fn(parser, region)) {
+        return 0;
       }
-      if (brace_depth <= 0) {
-        continue;
+      continue;
+    }
+    if (!bwpp_token_sym(&tok, '@')) {
+      bwpp_parser_error(parser, &tok, "'fn' or an '@' annotation");
+      return 0;
+    }
+    BwppToken kw = bwpp_parser_next(parser);
+    if (bwpp_token_is(&kw, "dims")) {
+      if (!bwpp_parse_dims(parser)) {
+        return 0;
       }
-      if (bwpp_token_is(&tok, "matmul")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_MATMUL, current_region, 0);
-      } else if (bwpp_token_is(&tok, "batch_matmul")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_BATCH_MATMUL, current_region, 0);
-      } else if (bwpp_token_is(&tok, "transpose")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_TRANSPOSE, current_region, 0);
-      } else if (bwpp_token_is(&tok, "permute")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_PERMUTE, current_region, 0);
-      } else if (bwpp_token_is(&tok, "reshape")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_RESHAPE, current_region, 0);
-      } else if (bwpp_token_is(&tok, "add")) {
-        uint32_t flags = 0;
-        BwppToken next = bwpp_parser_next(parser);
-        if (next.kind == BWPP_TOK_SYMBOL && next.length == 1 && next.lexeme[0] == '(') {
-          int depth = 1;
-          while (depth > 0) {
-            BwppToken arg = bwpp_parser_next(parser);
-            if (arg.kind == BWPP_TOK_EOF) {
-              break;
-            }
-            if (arg.kind == BWPP_TOK_SYMBOL && arg.length == 1) {
-              if (arg.lexeme[0] == '@') {
-                bwpp_ast_add_op(module, BWPP_AST_OP_MATMUL, current_region, 0);
-              }
-              if (arg.lexeme[0] == '(') {
-                depth++;
-              } else if (arg.lexeme[0] == ')') {
-                depth--;
-              }
-              continue;
-            }
-            if (arg.kind == BWPP_TOK_IDENT && bwpp_token_is(&arg, "matmul")) {
-              bwpp_ast_add_op(module, BWPP_AST_OP_MATMUL, current_region, 0);
-            }
-            if (arg.kind == BWPP_TOK_IDENT && bwpp_token_is(&arg, "bias")) {
-              flags |= BWPP_AST_OPF_HAS_BIAS;
-            }
-          }
-        } else {
-          bwpp_parser_unread(parser, next);
-        }
-        bwpp_ast_add_op(module, BWPP_AST_OP_ADD, current_region, flags);
-      } else if (bwpp_token_is(&tok, "sub")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_SUB, current_region, 0);
-      } else if (bwpp_token_is(&tok, "mul")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_MUL, current_region, 0);
-      } else if (bwpp_token_is(&tok, "div")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_DIV, current_region, 0);
-      } else if (bwpp_token_is(&tok, "reduce_sum")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_REDUCE_SUM, current_region, 0);
-      } else if (bwpp_token_is(&tok, "reduce_max")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_REDUCE_MAX, current_region, 0);
-      } else if (bwpp_token_is(&tok, "softmax")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_SOFTMAX, current_region, 0);
-      } else if (bwpp_token_is(&tok, "rmsnorm")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_RMSNORM, current_region, 0);
-      } else if (bwpp_token_is(&tok, "silu")) {
-        bwpp_ast_add_op(module, BWPP_AST_OP_SILU, current_region, 0);
+    } else if (bwpp_token_is(&kw, "reversible")) {
+      reversible = 1;
+      if (!bwpp_parse_policy(parser, &policy)) {
+        return 0;
       }
+    } else if (!bwpp_token_is(&kw, "meta") && !bwpp_token_is(&kw, "impure")) {
+      bwpp_parser_error(parser, &kw, "dims, reversible, meta or impure after '@'");
+      return 0;
     }
   }
+}
 
+BwppAstModule *bwpp_parse_module(BwppParser *parser) {
+  BwppAstModule *module = bwpp_ast_module_create(parser->source, parser->length);
+  if (!module) {
+    return NULL;
+  }
+  parser->module = module;
+  parser->region = BWPP_AST_NO_REGION;
+  int ok = bwpp_parse_top_level(parser);
+  parser->module = NULL;
+  if (!ok || parser->failed) {
+    if (!parser->failed) {
+      fprintf(stderr, "parse: out of memory\n");
+    }
+    bwpp_ast_module_destroy(module);
+    return NULL;
+  }
   return module;
 }
@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 200809L
+#define _XOPEN_SOURCE 700
+#include "pass_timer.h"
+#include "arena.h"
+#include "bwpp.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static atomic_int bwpp_alloc_counting;
+static atomic_ullong bwpp_alloc_calls;
+static atomic_ullong bwpp_alloc_bytes;
+
+static void bwpp_alloc_note(size_t bytes) {
+  if (atomic_load_explicit(&bwpp_alloc_counting, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&bwpp_alloc_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bwpp_alloc_bytes, bytes, memory_order_relaxed);
+  }
+}
+
+void *bwpp_xmalloc(size_t size) {
+  bwpp_alloc_note(size);
+  return malloc(size);
+}
+
+void *bwpp_xcalloc(size_t count, size_t size) {
+  bwpp_alloc_note(count * size);
+  return calloc(count, size);
+}
+
+void *bwpp_xrealloc(void *ptr, size_t size) {
+  bwpp_alloc_note(size);
+  return realloc(ptr, size);
+}
+
+static double bwpp_pass_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t bwpp_pass_peak_rss_kb(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return (uint64_t)usage.ru_maxrss / 1024; /* bytes there, KiB on Linux */
+#else
+  return (uint64_t)usage.ru_maxrss;
+#endif
+}
+
+void bwpp_pass_timer_init(BwppPassTimer *timer, int enabled) {
+  memset(timer, 0, sizeof(*timer));
+  timer->enabled = enabled;
+  if (enabled) {
+    atomic_store(&bwpp_alloc_counting, 1);
+    bwpp_chunk_arena_chunk_hook = bwpp_alloc_note;
+  }
+}
+
+void bwpp_pass_timer_destroy(BwppPassTimer *timer) {
+  if (timer->enabled) {
+    atomic_store(&bwpp_alloc_counting, 0);
+    bwpp_chunk_arena_chunk_hook = NULL;
+  }
+  free(timer->passes);
+  timer->passes = NULL;
+  timer->pass_count = 0;
+  timer->pass_capacity = 0;
+}
+
+void bwpp_pass_begin(BwppPassTimer *timer, const char *name) {
+  if (!timer->enabled) {
+    return;
+  }
+  bwpp_pass_end(timer);
+  if (timer->pass_count == timer->pass_capacity) {
+    uint32_t new_cap = timer->pass_capacity == 0 ? 16 : timer->pass_capacity * 2;
+    BwppPass *np = (BwppPass *)realloc(timer->passes, new_cap * sizeof(BwppPass));
+    if (!np) {
+      return;
+    }
+    timer->passes = np;
+    timer->pass_capacity = new_cap;
+  }
+  BwppPass *p = &timer->passes[timer->pass_count++];
+  memset(p, 0, sizeof(*p));
+  p->name = name;
+  timer->open = 1;
+  timer->allocs_at_start = atomic_load(&bwpp_alloc_calls);
+  timer->bytes_at_start = atomic_load(&bwpp_alloc_bytes);
+  timer->start = bwpp_pass_now();
+}
+
+void bwpp_pass_end(BwppPassTimer *timer) {
+  if (!timer->enabled || !timer->open) {
+    return;
+  }
+  BwppPass *p = &timer->passes[timer->pass_count - 1];
+  p->seconds = bwpp_pass_now() - timer->start;
+  p->allocs = atomic_load(&bwpp_alloc_calls) - timer->allocs_at_start;
+  p->alloc_bytes = atomic_load(&bwpp_alloc_bytes) - timer->bytes_at_start;
+  p->peak_rss_kb = bwpp_pass_peak_rss_kb();
+  timer->open = 0;
+}
+
+void bwpp_pass_timer_report(const BwppPassTimer *timer, FILE *out, int json) {
+  if (!timer->enabled) {
+    return;
+  }
+  double total = 0.0;
+  uint64_t allocs = 0;
+  uint64_t bytes = 0;
+  for (uint32_t i = 0; i < timer->pass_count; ++i) {
+    total += timer->passes[i].seconds;
+    allocs += timer->passes[i].allocs;
+    bytes += timer->passes[i].alloc_bytes;
+  }
+  if (json) {
+    fputs("{\"passes\":[", out);
+    for (uint32_t i = 0; i < timer->pass_count; ++i) {
+      const BwppPass *p = &timer->passes[i];
+      fprintf(out, "%s{\"name\":\"%s\",\"ms\":%.3f,\"peak_rss_kb\":%llu,\"allocs\":%llu,\"alloc_bytes\":%llu}",
+              i ? "," : "", p->name, p->seconds * 1e3, (unsigned long long)p->peak_rss_kb,
+              (unsigned long long)p->allocs, (unsigned long long)p->alloc_bytes);
+    }
+    fprintf(out, "],\"total_ms\":%.3f}\n", total * 1e3);
+    return;
+  }
+  fprintf(out, "%-18s %10s %6s %12s %10s %14s\n", "pass", "ms", "%", "peak_rss_kb", "allocs", "alloc_bytes");
+  for (uint32_t i = 0; i <= timer->pass_count; ++i) {
+    int sum = i == timer->pass_count;
+    const BwppPass *p = sum ? NULL : &timer->passes[i];
+    double secs = sum ? total : p->seconds;
+    fprintf(out, "%-18s %10.3f %6.1f %12llu %10llu %14llu\n", sum ? "total" : p->name, secs * 1e3,
+            total > 0.0 ? 100.0 * secs / total : 0.0,
+            (unsigned long long)(sum ? (i ? timer->passes[i - 1].peak_rss_kb : 0) : p->peak_rss_kb),
+            (unsigned long long)(sum ? allocs : p->allocs),
+            (unsigned long long)(sum ? bytes : p->alloc_bytes));
+  }
+}
@@ -0,0 +1,241 @@
+#include "remat.h"
+#include "mem_plan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t value;
+  uint64_t bytes;
+  uint64_t flops;
+} BwppRematCandidate;
+
+typedef struct {
+  const BwppGraph *src;
+  BwppGraph *dst;
+  const uint8_t *drop;
+  uint32_t *copy; /* dropped value -> its recomputed copy */
+  uint32_t nodes;
+  uint64_t flops;
+} BwppRematBuild;
+
+static uint64_t bwpp_remat_flops(const BwppGraph *g, const BwppGraphNode *n) {
+  uint64_t out = bwpp_shape_elems(&g->values[n->output].shape);
+  switch (n->op) {
+    case BWPP_GOP_MATMUL:
+    case BWPP_GOP_BATCH_MATMUL: {
+      BwppShape a = bwpp_graph_operand_shape(g, n, 0);
+      return 2 * out * (a.rank ? a.sizes[a.rank - 1] : 1);
+    }
+    case BWPP_GOP_SOFTMAX:
+    case BWPP_GOP_RMSNORM:
+      return 5 * out;
+    default:
+      return out ? out : 1;
+  }
+}
+
+/* most bytes freed per FLOP of recompute first */
+static int bwpp_remat_by_gain(const void *pa, const void *pb) {
+  const BwppRematCandidate *a = (const BwppRematCandidate *)pa;
+  const BwppRematCandidate *b = (const BwppRematCandidate *)pb;
+  double ga = (double)a->bytes / (double)(a->flops ? a->flops : 1);
+  double gb = (double)b->bytes / (double)(b->flops ? b->flops : 1);
+  return ga > gb ? -1 : (ga < gb ? 1 : 0);
+}
+
+static int bwpp_remat_push(BwppGraph *g, BwppGraphNode node) {
+  if (!bwpp_graph_reserve(g, (void **)&g->nodes, g->node_count, &g->node_capacity, sizeof(BwppGraphNode),
+                          _Alignof(BwppGraphNode))) {
+    return 0;
+  }
+  node.id = g->node_count;
+  g->values[node.output].producer = node.id;
+  g->nodes[g->node_count++] = node;
+  return 1;
+}
+
+static uint32_t bwpp_remat_value(BwppGraph *g, const BwppGraphValue *v) {
+  if (!bwpp_graph_reserve(g, (void **)&g->values, g->value_count, &g->value_capacity, sizeof(BwppGraphValue),
+                          _Alignof(BwppGraphValue))) {
+    return BWPP_GRAPH_NO_VALUE;
+  }
+  BwppGraphValue out = *v;
+  out.id = g->value_count;
+  out.producer = BWPP_GRAPH_NO_NODE;
+  out.flags = 0;
+  g->values[g->value_count++] = out;
+  return out.id;
+}
+
+/* Clones the producer of dropped value `v` (and of its dropped inputs). */
+static uint32_t bwpp_remat_recompute(BwppRematBuild *b, uint32_t v) {
+  if (b->copy[v] != BWPP_GRAPH_NO_VALUE) {
+    return b->copy[v];
+  }
+  const BwppGraphNode *p = &b->src->nodes[b->src->values[v].producer];
+  BwppGraphNode node = *p;
+  for (uint32_t j = 0; j < p->input_count; ++j) {
+    uint32_t u = p->inputs[j];
+    if (u < b->src->value_count && b->drop[u]) {
+      node.inputs[j] = bwpp_remat_recompute(b, u);
+      if (node.inputs[j] == BWPP_GRAPH_NO_VALUE) {
+        return BWPP_GRAPH_NO_VALUE;
+      }
+    }
+  }
+  node.output = bwpp_remat_value(b->dst, &b->src->values[v]);
+  if (node.output == BWPP_GRAPH_NO_VALUE || !bwpp_remat_push(b->dst, node)) {
+    return BWPP_GRAPH_NO_VALUE;
+  }
+  b->copy[v] = node.output;
+  b->nodes++;
+  b->flops += bwpp_remat_flops(b->src, p);
+  return node.output;
+}
+
+/* `src` with every dropped activation recomputed right before its first
+   backward reader; all backward readers take the copy. */
+static BwppGraph *bwpp_remat_rebuild(const BwppGraph *src, const uint8_t *drop, uint32_t *nodes, uint64_t *flops) {
+  BwppRematBuild b = {0};
+  b.src = src;
+  b.drop = drop;
+  b.dst = bwpp_graph_clone(src);
+  b.copy = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * (src->value_count ? src->value_count : 1));
+  if (!b.dst || !b.copy) {
+    bwpp_graph_destroy(b.dst);
+    free(b.copy);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < src->value_count; ++i) {
+    b.copy[i] = BWPP_GRAPH_NO_VALUE;
+  }
+  b.dst->node_count = 0;
+  for (uint32_t i = 0; i < src->node_count; ++i) {
+    BwppGraphNode node = src->nodes[i];
+    for (uint32_t j = 0; i >= src->forward_nodes && j < node.input_count; ++j) {
+      uint32_t u = node.inputs[j];
+      if (u < src->value_count && drop[u]) {
+        node.inputs[j] = bwpp_remat_recompute(&b, u);
+      }
+    }
+    int ok = bwpp_remat_push(b.dst, node);
+    for (uint32_t j = 0; ok && j < node.input_count; ++j) {
+      ok = node.inputs[j] != BWPP_GRAPH_NO_VALUE;
+    }
+    if (!ok) {
+      bwpp_graph_destroy(b.dst);
+      free(b.copy);
+      return NULL;
+    }
+  }
+  free(b.copy);
+  *nodes = b.nodes;
+  *flops = b.flops;
+  return b.dst;
+}
+
+/* planned + input bytes; 0 if the plan cannot size every value */
+static uint64_t bwpp_remat_peak(const BwppGraph *g, int slab) {
+  BwppMemPlan *plan = slab ? bwpp_mem_plan_build_slab(g, 0) : bwpp_mem_plan_build(g);
+  if (!plan) {
+    return 0;
+  }
+  uint64_t peak = plan->total_bytes ? plan->total_bytes + plan->input_bytes : 0;
+  bwpp_mem_plan_destroy(plan);
+  return peak;
+}
+
+BwppGraph *bwpp_remat(const BwppGraph *train, uint64_t budget, int slab, BwppRematReport *report) {
+  if (!train || !train->forward_nodes) {
+    fprintf(stderr, "remat: needs a training-step graph\n");
+    return NULL;
+  }
+  BwppRematReport r = {0};
+  r.peak_before = bwpp_remat_peak(train, slab);
+  if (!r.peak_before) {
+    fprintf(stderr, "remat: every dim must be bound to measure memory\n");
+    return NULL;
+  }
+  uint32_t count = train->value_count ? train->value_count : 1;
+  uint8_t *drop = (uint8_t *)bwpp_xcalloc(count, 1);
+  uint8_t *seen = (uint8_t *)bwpp_xcalloc(count, 1);
+  BwppRematCandidate *cands = (BwppRematCandidate *)bwpp_xmalloc(sizeof(BwppRematCandidate) * count);
+  if (!drop || !seen || !cands) {
+    free(drop);
+    free(seen);
+    free(cands);
+    return NULL;
+  }
+
+  /* saved activations from reversible regions that do not insist on store */
+  uint32_t auto_count = 0;
+  for (uint32_t i = train->forward_nodes; i < train->node_count; ++i) {
+    const BwppGraphNode *n = &train->nodes[i];
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      uint32_t v = n->inputs[j];
+      if (v >= train->value_count || seen[v]) {
+        continue;
+      }
+      seen[v] = 1;
+      uint32_t p = train->values[v].producer;
+      if (p >= train->forward_nodes || (train->values[v].flags & BWPP_GRAPH_VALUE_OUTPUT)) {
+        continue;
+      }
+      uint32_t region = train->nodes[p].region_id;
+      if (region >= train->region_count || train->regions[region].kind != BWPP_REGION_REVERSIBLE ||
+          train->regions[region].policy == BWPP_POLICY_STORE) {
+        continue;
+      }
+      r.candidates++;
+      if (train->regions[region].policy == BWPP_POLICY_RECOMPUTE) {
+        drop[v] = 1;
+        continue;
+      }
+      BwppRematCandidate *c = &cands[auto_count++];
+      c->value = v;
+      c->bytes = bwpp_shape_elems(&train->values[v].shape) * bwpp_dtype_bytes(train->values[v].dtype);
+      c->flops = bwpp_remat_flops(train, &train->nodes[p]);
+    }
+  }
+  free(seen);
+
+  BwppGraph *g = bwpp_remat_rebuild(train, drop, &r.recompute_nodes, &r.recompute_flops);
+  uint64_t peak = g ? bwpp_remat_peak(g, slab) : 0;
+  qsort(cands, auto_count, sizeof(BwppRematCandidate), bwpp_remat_by_gain);
+  for (uint32_t k = 0; g && budget && peak > budget && k < auto_count; ++k) {
+    drop[cands[k].value] = 1;
+    uint32_t nodes = 0;
+    uint64_t flops = 0;
+    BwppGraph *next = bwpp_remat_rebuild(train, drop, &nodes, &flops);
+    uint64_t next_peak = next ? bwpp_remat_peak(next, slab) : 0;
+    if (next_peak && next_peak < peak) {
+      bwpp_graph_destroy(g);
+      g = next;
+      peak = next_peak;
+      r.recompute_nodes = nodes;
+      r.recompute_flops = flops;
+    } else {
+      /* recomputing it keeps its inputs alive for longer than it saves */
+      drop[cands[k].value] = 0;
+      bwpp_graph_destroy(next);
+    }
+  }
+  for (uint32_t v = 0; v < train->value_count; ++v) {
+    r.dropped += drop[v];
+  }
+  free(drop);
+  free(cands);
+  if (!g) {
+    return NULL;
+  }
+  r.peak_after = peak;
+  if (budget && peak > budget) {
+    fprintf(stderr, "remat: peak %llu bytes still exceeds the budget of %llu\n",
+            (unsigned long long)peak, (unsigned long long)budget);
+  }
+  if (report) {
+    *report = r;
+  }
+  return g;
+}
@@ -0,0 +1,320 @@
+#include "schedule.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const BwppGraph *g;
+  uint64_t *bytes;  /* per value; 0 for graph inputs and constants */
+  uint8_t *pinned;  /* graph outputs, live to the end */
+  uint32_t *left;   /* consumers not yet scheduled */
+  uint64_t *cmask;  /* consumers inside the current DP segment, by local index */
+  uint32_t lo;      /* first node of the current segment */
+} BwppScheduleCtx;
+
+static uint32_t bwpp_schedule_popcount(uint64_t x) {
+  uint32_t n = 0;
+  for (; x; x &= x - 1) {
+    ++n;
+  }
+  return n;
+}
+
+static int bwpp_schedule_dup_input(const BwppGraphNode *n, uint32_t j) {
+  for (uint32_t k = 0; k < j; ++k) {
+    if (n->inputs[k] == n->inputs[j]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Bytes node `i` allocates and frees once the nodes in `mask` (of the DP
+   segment, 0 outside it) have run: its output lands on a dying same-sized
+   input when the op is elementwise, and an output nobody reads dies at once. */
+static void bwpp_schedule_cost(const BwppScheduleCtx *c, uint32_t i, uint64_t mask, int64_t *alloc, int64_t *freed) {
+  const BwppGraphNode *n = &c->g->nodes[i];
+  uint64_t out = n->output < c->g->value_count ? c->bytes[n->output] : 0;
+  int donated = 0;
+  *alloc = (int64_t)out;
+  *freed = 0;
+  for (uint32_t j = 0; j < n->input_count; ++j) {
+    uint32_t v = n->inputs[j];
+    if (v >= c->g->value_count || !c->bytes[v] || c->pinned[v] || bwpp_schedule_dup_input(n, j)) {
+      continue;
+    }
+    uint32_t left = c->left[v] - (c->cmask ? bwpp_schedule_popcount(c->cmask[v] & mask) : 0);
+    if (left != 1) {
+      continue;
+    }
+    if (!donated && bwpp_graph_op_inplace(n->op) && c->bytes[v] == out) {
+      donated = 1;
+      *alloc = 0;
+    } else {
+      *freed += (int64_t)c->bytes[v];
+    }
+  }
+  if (n->output < c->g->value_count && !c->pinned[n->output] && !c->left[n->output]) {
+    *freed += (int64_t)out;
+  }
+}
+
+static void bwpp_schedule_run(BwppScheduleCtx *c, uint32_t i) {
+  const BwppGraphNode *n = &c->g->nodes[i];
+  for (uint32_t j = 0; j < n->input_count; ++j) {
+    uint32_t v = n->inputs[j];
+    if (v < c->g->value_count && !bwpp_schedule_dup_input(n, j)) {
+      c->left[v]--;
+    }
+  }
+}
+
+/* Most node-output bytes live at once when the nodes run in `order`. */
+static uint64_t bwpp_schedule_peak(BwppScheduleCtx *c, const uint32_t *uses, const uint32_t *order) {
+  memcpy(c->left, uses, sizeof(uint32_t) * c->g->value_count);
+  c->cmask = NULL;
+  int64_t live = 0;
+  int64_t peak = 0;
+  for (uint32_t k = 0; k < c->g->node_count; ++k) {
+    int64_t alloc = 0;
+    int64_t freed = 0;
+    bwpp_schedule_cost(c, order[k], 0, &alloc, &freed);
+    if (live + alloc > peak) {
+      peak = live + alloc;
+    }
+    live += alloc - freed;
+    bwpp_schedule_run(c, order[k]);
+  }
+  return (uint64_t)peak;
+}
+
+static int bwpp_schedule_ready(const BwppScheduleCtx *c, uint32_t i, const uint8_t *done, uint32_t hi) {
+  const BwppGraphNode *n = &c->g->nodes[i];
+  for (uint32_t j = 0; j < n->input_count; ++j) {
+    uint32_t v = n->inputs[j];
+    uint32_t p = v < c->g->value_count ? c->g->values[v].producer : BWPP_GRAPH_NO_NODE;
+    if (p >= c->lo && p < hi && !done[p]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int bwpp_schedule_greedy(BwppScheduleCtx *c, uint32_t hi, uint32_t *order, uint8_t *done) {
+  c->cmask = NULL;
+  for (uint32_t k = c->lo; k < hi; ++k) {
+    uint32_t best = BWPP_GRAPH_NO_NODE;
+    int64_t best_delta = 0;
+    int64_t best_alloc = 0;
+    for (uint32_t i = c->lo; i < hi; ++i) {
+      if (done[i] || !bwpp_schedule_ready(c, i, done, hi)) {
+        continue;
+      }
+      int64_t alloc = 0;
+      int64_t freed = 0;
+      bwpp_schedule_cost(c, i, 0, &alloc, &freed);
+      if (best == BWPP_GRAPH_NO_NODE || alloc - freed < best_delta ||
+          (alloc - freed == best_delta && alloc < best_alloc)) {
+        best = i;
+        best_delta = alloc - freed;
+        best_alloc = alloc;
+      }
+    }
+    if (best == BWPP_GRAPH_NO_NODE) {
+      return 0;
+    }
+    order[k] = best;
+    done[best] = 1;
+    bwpp_schedule_run(c, best);
+  }
+  return 1;
+}
+
+/* Exact: the live bytes after a set of nodes has run depend only on the
+   set, so the lowest peak reaching each set is a DP over subsets. */
+static int bwpp_schedule_exact(BwppScheduleCtx *c, uint32_t hi, uint32_t *order, uint8_t *done) {
+  uint32_t count = hi - c->lo;
+  uint64_t states = 1ull << count;
+  uint64_t *pred = (uint64_t *)bwpp_xcalloc(count, sizeof(uint64_t));
+  int64_t *best = (int64_t *)bwpp_xmalloc(sizeof(int64_t) * states);
+  int64_t *live = (int64_t *)bwpp_xmalloc(sizeof(int64_t) * states);
+  uint8_t *last = (uint8_t *)bwpp_xmalloc(states);
+  if (!pred || !best || !live || !last) {
+    free(pred);
+    free(best);
+    free(live);
+    free(last);
+    return 0;
+  }
+  for (uint32_t k = 0; k < count; ++k) {
+    const BwppGraphNode *n = &c->g->nodes[c->lo + k];
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      uint32_t v = n->inputs[j];
+      uint32_t p = v < c->g->value_count ? c->g->values[v].producer : BWPP_GRAPH_NO_NODE;
+      if (p >= c->lo && p < hi) {
+        pred[k] |= 1ull << (p - c->lo);
+      }
+      if (v < c->g->value_count) {
+        c->cmask[v] |= 1ull << k;
+      }
+    }
+  }
+  for (uint64_t s = 0; s < states; ++s) {
+    best[s] = INT64_MAX;
+  }
+  best[0] = 0;
+  live[0] = 0;
+  for (uint64_t s = 0; s < states; ++s) {
+    if (best[s] == INT64_MAX) {
+      continue;
+    }
+    for (uint32_t k = 0; k < count; ++k) {
+      uint64_t bit = 1ull << k;
+      if ((s & bit) || (pred[k] & s) != pred[k]) {
+        continue;
+      }
+      int64_t alloc = 0;
+      int64_t freed = 0;
+      bwpp_schedule_cost(c, c->lo + k, s, &alloc, &freed);
+      int64_t peak = live[s] + alloc > best[s] ? live[s] + alloc : best[s];
+      if (peak < best[s | bit]) {
+        best[s | bit] = peak;
+        live[s | bit] = live[s] + alloc - freed;
+        last[s | bit] = (uint8_t)k;
+      }
+    }
+  }
+  uint64_t s = states - 1;
+  for (uint32_t k = hi; k > c->lo; --k) {
+    order[k - 1] = c->lo + last[s];
+    s &= ~(1ull << last[s]);
+  }
+  for (uint32_t k = c->lo; k < hi; ++k) {
+    done[order[k]] = 1;
+    bwpp_schedule_run(c, order[k]);
+  }
+  free(pred);
+  free(best);
+  free(live);
+  free(last);
+  return 1;
+}
+
+static BwppGraph *bwpp_schedule_apply(const BwppGraph *graph, const uint32_t *order) {
+  BwppGraph *g = bwpp_graph_clone(graph);
+  if (!g) {
+    return NULL;
+  }
+  for (uint32_t k = 0; k < graph->node_count; ++k) {
+    BwppGraphNode node = graph->nodes[order[k]];
+    node.id = k;
+    g->nodes[k] = node;
+    if (node.output < g->value_count) {
+      g->values[node.output].producer = k;
+    }
+  }
+  return g;
+}
+
+/* Fills the per-value tables and `order`; 0 on unbound dims. */
+static int bwpp_schedule_order(BwppScheduleCtx *c, uint32_t *uses, uint64_t *cmask, uint32_t *order, uint8_t *done,
+                               BwppScheduleReport *r) {
+  const BwppGraph *graph = c->g;
+  for (uint32_t v = 0; v < graph->value_count; ++v) {
+    const BwppGraphValue *val = &graph->values[v];
+    if (val->producer == BWPP_GRAPH_NO_NODE) {
+      continue;
+    }
+    if (!bwpp_shape_bound(&val->shape)) {
+      BwppStr dim = bwpp_shape_unbound_dim(&val->shape);
+      fprintf(stderr, "schedule: dim %.*s is unbound (see @dims / --dim)\n", (int)dim.len, dim.ptr);
+      return 0;
+    }
+    c->bytes[v] = bwpp_shape_elems(&val->shape) * bwpp_dtype_bytes(val->dtype);
+    c->pinned[v] = (val->flags & BWPP_GRAPH_VALUE_OUTPUT) != 0;
+  }
+  for (uint32_t k = 0; k < graph->output_count; ++k) {
+    if (graph->outputs[k] < graph->value_count) {
+      c->pinned[graph->outputs[k]] = 1;
+    }
+  }
+  for (uint32_t i = 0; i < graph->node_count; ++i) {
+    const BwppGraphNode *n = &graph->nodes[i];
+    for (uint32_t j = 0; j < n->input_count; ++j) {
+      if (n->inputs[j] < graph->value_count && !bwpp_schedule_dup_input(n, j)) {
+        uses[n->inputs[j]]++;
+      }
+    }
+  }
+
+  /* forward and backward halves are scheduled one after the other */
+  memcpy(c->left, uses, sizeof(uint32_t) * graph->value_count);
+  uint32_t split[2] = {graph->forward_nodes, graph->node_count};
+  r->exact = 1;
+  for (uint32_t s = graph->forward_nodes ? 0 : 1; s < 2; ++s) {
+    uint32_t hi = split[s];
+    int ok;
+    if (hi - c->lo <= BWPP_SCHEDULE_EXACT_MAX) {
+      memset(cmask, 0, sizeof(uint64_t) * graph->value_count);
+      c->cmask = cmask;
+      ok = bwpp_schedule_exact(c, hi, order, done);
+    } else {
+      r->exact = 0;
+      ok = bwpp_schedule_greedy(c, hi, order, done);
+    }
+    if (!ok) {
+      fprintf(stderr, "schedule: failed to order nodes %u..%u\n", c->lo, hi);
+      return 0;
+    }
+    c->lo = hi;
+  }
+  return 1;
+}
+
+BwppGraph *bwpp_schedule_mem(const BwppGraph *graph, BwppScheduleReport *report) {
+  if (!graph) {
+    return NULL;
+  }
+  uint32_t vcount = graph->value_count ? graph->value_count : 1;
+  uint32_t ncount = graph->node_count ? graph->node_count : 1;
+  BwppScheduleCtx c = {0};
+  c.g = graph;
+  c.bytes = (uint64_t *)bwpp_xcalloc(vcount, sizeof(uint64_t));
+  c.pinned = (uint8_t *)bwpp_xcalloc(vcount, 1);
+  c.left = (uint32_t *)bwpp_xcalloc(vcount, sizeof(uint32_t));
+  uint64_t *cmask = (uint64_t *)bwpp_xcalloc(vcount, sizeof(uint64_t));
+  uint32_t *uses = (uint32_t *)bwpp_xcalloc(vcount, sizeof(uint32_t));
+  uint32_t *order = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * ncount);
+  uint32_t *identity = (uint32_t *)bwpp_xmalloc(sizeof(uint32_t) * ncount);
+  uint8_t *done = (uint8_t *)bwpp_xcalloc(ncount, 1);
+  BwppGraph *out = NULL;
+  BwppScheduleReport r = {0};
+  if (c.bytes && c.pinned && c.left && cmask && uses && order && identity && done &&
+      bwpp_schedule_order(&c, uses, cmask, order, done, &r)) {
+    for (uint32_t i = 0; i < graph->node_count; ++i) {
+      identity[i] = i;
+    }
+    r.peak_before = bwpp_schedule_peak(&c, uses, identity);
+    r.peak_after = bwpp_schedule_peak(&c, uses, order);
+    /* the DP is exact for the model, the greedy pick is not: keep the
+       original order unless it is beaten */
+    if (r.peak_after >= r.peak_before) {
+      r.peak_after = r.peak_before;
+      out = bwpp_graph_clone(graph);
+    } else {
+      out = bwpp_schedule_apply(graph, order);
+    }
+    if (out && report) {
+      *report = r;
+    }
+  }
+  free(c.bytes);
+  free(c.pinned);
+  free(c.left);
+  free(cmask);
+  free(uses);
+  free(order);
+  free(identity);
+  free(done);
+  return out;
+}
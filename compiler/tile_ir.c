@@ -1,14 +1,26 @@
 #include "tile_ir.h"
 #include <stdlib.h>
+#include <string.h>
 
 BwppTileKernel *bwpp_tile_kernel_create(void) {
-  BwppTileKernel *kernel = (BwppTileKernel *)calloc(1, sizeof(BwppTileKernel));
+  BwppChunkArena arena;
+  bwpp_chunk_arena_init(&arena, 4096);
+  BwppTileKernel *kernel = (BwppTileKernel *)bwpp_chunk_arena_alloc(&arena, sizeof(BwppTileKernel),
+                                                                    _Alignof(BwppTileKernel));
+  if (!kernel) {
+    bwpp_chunk_arena_destroy(&arena);
+    return NULL;
+  }
+  memset(kernel, 0, sizeof(*kernel));
+  kernel->arena = arena;
   return kernel;
 }
 
 static int bwpp_tile_kernel_grow(BwppTileKernel *kernel) {
   uint32_t next = kernel->op_capacity ? kernel->op_capacity * 2u : 4u;
-  BwppTileOp *ops = (BwppTileOp *)realloc(kernel->ops, next * sizeof(BwppTileOp));
+  BwppTileOp *ops = (BwppTileOp *)bwpp_chunk_arena_grow(&kernel->arena, kernel->ops,
+                                                        kernel->op_capacity * sizeof(BwppTileOp),
+                                                        next * sizeof(BwppTileOp), _Alignof(BwppTileOp));
   if (!ops) {
     return 0;
   }
@@ -32,6 +44,309 @@ void bwpp_tile_kernel_destroy(BwppTileKernel *kernel) {
   if (!kernel) {
     return;
   }
-  free(kernel->ops);
-  free(kernel);
+  /* the kernel lives in its own arena, so copy the arena out first */
+  BwppChunkArena arena = kernel->arena;
+  bwpp_chunk_arena_destroy(&arena);
+}
+
+const char *bwpp_tile_op_name(BwppTileOpKind kind) {
+  switch (kind) {
+    case BWPP_TILE_OP_MATMUL: return "matmul";
+    case BWPP_TILE_OP_LOAD: return "load";
+    case BWPP_TILE_OP_STORE: return "store";
+    case BWPP_TILE_OP_ELEMENTWISE: return "elementwise";
+    case BWPP_TILE_OP_SOFTMAX: return "softmax";
+    case BWPP_TILE_OP_ATTENTION: return "attention";
+    case BWPP_TILE_OP_REDUCE: return "reduce";
+    case BWPP_TILE_OP_LAYOUT: return "layout";
+  }
+  return "unknown";
+}
+
+BwppTileKernel *bwpp_tile_lower_matmul(const BwppIrModule *ir) {
+  if (!ir) {
+    return NULL;
+  }
+  int has_matmul = 0;
+  int has_add = 0;
+  int has_silu = 0;
+  for (uint32_t i = 0; i < ir->node_count; ++i) {
+    if (ir->nodes[i].op == BWPP_OP_MATMUL) {
+      has_matmul = 1;
+    } else if (ir->nodes[i].op == BWPP_OP_ADD) {
+      if (ir->nodes[i].flags & BWPP_IR_OPF_HAS_BIAS) {
+        has_add = 1;
+      }
+    } else if (ir->nodes[i].op == BWPP_OP_SILU) {
+      has_silu = 1;
+    }
+  }
+  if (!has_matmul) {
+    return NULL;
+  }
+  BwppTileKernel *kernel = bwpp_tile_kernel_create();
+  if (!kernel) {
+    return NULL;
+  }
+  kernel->block.m = 128;
+  kernel->block.n = 128;
+  kernel->block.k = 32;
+  BwppTileOp load_a;
+  load_a.kind = BWPP_TILE_OP_LOAD;
+  load_a.tile.m = 16;
+  load_a.tile.n = 16;
+  load_a.tile.k = 16;
+  load_a.src_mem = BWPP_TILE_MEM_GLOBAL;
+  load_a.dst_mem = BWPP_TILE_MEM_THREADGROUP;
+  load_a.role = BWPP_TILE_ROLE_A;
+  load_a.epilogue = BWPP_TILE_EPILOGUE_NONE;
+  load_a.a_mem = BWPP_TILE_MEM_GLOBAL;
+  load_a.b_mem = BWPP_TILE_MEM_GLOBAL;
+  load_a.c_mem = BWPP_TILE_MEM_GLOBAL;
+  load_a.node = BWPP_GRAPH_NO_NODE;
+  if (bwpp_tile_kernel_add_op(kernel, &load_a) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  BwppTileOp load_b = load_a;
+  load_b.role = BWPP_TILE_ROLE_B;
+  if (bwpp_tile_kernel_add_op(kernel, &load_b) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  BwppTileOp op;
+  op.kind = BWPP_TILE_OP_MATMUL;
+  op.tile.m = 16;
+  op.tile.n = 16;
+  op.tile.k = 16;
+  op.a_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.b_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.c_mem = BWPP_TILE_MEM_REGISTER;
+  op.src_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.dst_mem = BWPP_TILE_MEM_REGISTER;
+  op.role = BWPP_TILE_ROLE_C;
+  op.epilogue = BWPP_TILE_EPILOGUE_NONE;
+  op.node = BWPP_GRAPH_NO_NODE;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+  if (has_add || has_silu) {
+    BwppTileOp epi;
+    epi.kind = BWPP_TILE_OP_ELEMENTWISE;
+    epi.tile = op.tile;
+    epi.a_mem = BWPP_TILE_MEM_REGISTER;
+    epi.b_mem = BWPP_TILE_MEM_REGISTER;
+    epi.c_mem = BWPP_TILE_MEM_REGISTER;
+    epi.src_mem = BWPP_TILE_MEM_REGISTER;
+    epi.dst_mem = BWPP_TILE_MEM_REGISTER;
+    epi.role = BWPP_TILE_ROLE_C;
+    epi.node = BWPP_GRAPH_NO_NODE;
+    if (has_add && has_silu) {
+      epi.epilogue = BWPP_TILE_EPILOGUE_ADD_SILU;
+    } else if (has_add) {
+      epi.epilogue = BWPP_TILE_EPILOGUE_ADD;
+    } else {
+      epi.epilogue = BWPP_TILE_EPILOGUE_SILU;
+    }
+    if (bwpp_tile_kernel_add_op(kernel, &epi) != BWPP_OK) {
+      bwpp_tile_kernel_destroy(kernel);
+      return NULL;
+    }
+  }
+
+  BwppTileOp store_c;
+  store_c.kind = BWPP_TILE_OP_STORE;
+  store_c.tile = op.tile;
+  store_c.src_mem = BWPP_TILE_MEM_REGISTER;
+  store_c.dst_mem = BWPP_TILE_MEM_GLOBAL;
+  store_c.role = BWPP_TILE_ROLE_C;
+  store_c.epilogue = BWPP_TILE_EPILOGUE_NONE;
+  store_c.a_mem = BWPP_TILE_MEM_REGISTER;
+  store_c.b_mem = BWPP_TILE_MEM_REGISTER;
+  store_c.c_mem = BWPP_TILE_MEM_GLOBAL;
+  store_c.node = BWPP_GRAPH_NO_NODE;
+  if (bwpp_tile_kernel_add_op(kernel, &store_c) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+  return kernel;
+}
+
+BwppTileKernel *bwpp_tile_lower_attention(void) {
+  BwppTileKernel *kernel = bwpp_tile_kernel_create();
+  if (!kernel) {
+    return NULL;
+  }
+  kernel->block.m = 128;
+  kernel->block.n = 128;
+  kernel->block.k = 32;
+  BwppTileOp op;
+  op.tile.m = 16;
+  op.tile.n = 16;
+  op.tile.k = 16;
+  op.epilogue = BWPP_TILE_EPILOGUE_NONE;
+  op.node = BWPP_GRAPH_NO_NODE;
+
+  op.kind = BWPP_TILE_OP_LOAD;
+  op.role = BWPP_TILE_ROLE_A; /* Q */
+  op.src_mem = BWPP_TILE_MEM_GLOBAL;
+  op.dst_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.a_mem = BWPP_TILE_MEM_GLOBAL;
+  op.b_mem = BWPP_TILE_MEM_GLOBAL;
+  op.c_mem = BWPP_TILE_MEM_GLOBAL;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  op.kind = BWPP_TILE_OP_LOAD;
+  op.role = BWPP_TILE_ROLE_B; /* K */
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  op.kind = BWPP_TILE_OP_MATMUL; /* QK^T */
+  op.role = BWPP_TILE_ROLE_C;
+  op.a_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.b_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.c_mem = BWPP_TILE_MEM_REGISTER;
+  op.src_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.dst_mem = BWPP_TILE_MEM_REGISTER;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  op.kind = BWPP_TILE_OP_SOFTMAX; /* softmax(scores) */
+  op.role = BWPP_TILE_ROLE_C;
+  op.src_mem = BWPP_TILE_MEM_REGISTER;
+  op.dst_mem = BWPP_TILE_MEM_REGISTER;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  op.kind = BWPP_TILE_OP_LOAD;
+  op.role = BWPP_TILE_ROLE_B; /* V */
+  op.src_mem = BWPP_TILE_MEM_GLOBAL;
+  op.dst_mem = BWPP_TILE_MEM_THREADGROUP;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  op.kind = BWPP_TILE_OP_MATMUL; /* softmax(QK^T) * V */
+  op.role = BWPP_TILE_ROLE_C;
+  op.a_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.b_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.c_mem = BWPP_TILE_MEM_REGISTER;
+  op.src_mem = BWPP_TILE_MEM_THREADGROUP;
+  op.dst_mem = BWPP_TILE_MEM_REGISTER;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+
+  op.kind = BWPP_TILE_OP_STORE;
+  op.role = BWPP_TILE_ROLE_C;
+  op.src_mem = BWPP_TILE_MEM_REGISTER;
+  op.dst_mem = BWPP_TILE_MEM_GLOBAL;
+  op.a_mem = BWPP_TILE_MEM_REGISTER;
+  op.b_mem = BWPP_TILE_MEM_REGISTER;
+  op.c_mem = BWPP_TILE_MEM_GLOBAL;
+  if (bwpp_tile_kernel_add_op(kernel, &op) != BWPP_OK) {
+    bwpp_tile_kernel_destroy(kernel);
+    return NULL;
+  }
+  return kernel;
+}
+
+static uint32_t bwpp_tile_outer(const BwppShape *s, uint32_t keep) {
+  uint32_t n = 1;
+  for (uint32_t i = 0; i + keep < s->rank; ++i) {
+    n *= s->sizes[i];
+  }
+  return n;
+}
+
+/* a is [.., M, K] and b [.., K, N], each stored transposed if flagged. */
+static void bwpp_tile_bind_operands(BwppTileKernel *kernel, const BwppGraph *graph, uint32_t lhs, uint32_t rhs,
+                                    int trans_a, int trans_b) {
+  if (lhs >= graph->value_count || rhs >= graph->value_count) {
+    return;
+  }
+  const BwppShape *a = &graph->values[lhs].shape;
+  const BwppShape *b = &graph->values[rhs].shape;
+  if (a->rank < 2 || b->rank < 2 || !bwpp_shape_bound(a) || !bwpp_shape_bound(b)) {
+    return;
+  }
+  uint32_t a_batch = bwpp_tile_outer(a, 2);
+  uint32_t b_batch = bwpp_tile_outer(b, 2);
+  kernel->problem.batch = a_batch > b_batch ? a_batch : b_batch;
+  kernel->problem.m = a->sizes[a->rank - (trans_a ? 1 : 2)];
+  kernel->problem.k = a->sizes[a->rank - (trans_a ? 2 : 1)];
+  kernel->problem.n = b->sizes[b->rank - (trans_b ? 2 : 1)];
+}
+
+void bwpp_tile_bind_problem(BwppTileKernel *kernel, const BwppGraph *graph, int attention) {
+  if (!kernel) {
+    return;
+  }
+  memset(&kernel->problem, 0, sizeof(kernel->problem));
+  if (!graph) {
+    return;
+  }
+  uint32_t lhs = BWPP_GRAPH_NO_VALUE;
+  uint32_t rhs = BWPP_GRAPH_NO_VALUE;
+  uint32_t flags = 0;
+  if (attention) {
+    BwppGraphAttentionInfo info;
+    if (bwpp_graph_attention_info(graph, &info)) {
+      lhs = info.q;
+      rhs = info.k;
+    }
+    /* attention keys are stored [.., N, K] */
+    flags = BWPP_GRAPH_OPF_TRANS_B;
+  } else {
+    for (uint32_t i = 0; i < graph->node_count; ++i) {
+      if (graph->nodes[i].op == BWPP_GOP_MATMUL && graph->nodes[i].input_count >= 2) {
+        lhs = graph->nodes[i].inputs[0];
+        rhs = graph->nodes[i].inputs[1];
+        flags = graph->nodes[i].flags;
+        break;
+      }
+    }
+  }
+  bwpp_tile_bind_operands(kernel, graph, lhs, rhs, (flags & BWPP_GRAPH_OPF_TRANS_A) != 0,
+                          (flags & BWPP_GRAPH_OPF_TRANS_B) != 0);
+}
+
+void bwpp_tile_bind_node(BwppTileKernel *kernel, const BwppGraph *graph, uint32_t node, uint32_t value) {
+  if (!kernel) {
+    return;
+  }
+  memset(&kernel->problem, 0, sizeof(kernel->problem));
+  if (!graph || node >= graph->node_count) {
+    return;
+  }
+  const BwppGraphNode *n = &graph->nodes[node];
+  if ((n->op == BWPP_GOP_MATMUL || n->op == BWPP_GOP_BATCH_MATMUL) && n->input_count >= 2) {
+    bwpp_tile_bind_operands(kernel, graph, n->inputs[0], n->inputs[1], (n->flags & BWPP_GRAPH_OPF_TRANS_A) != 0,
+                            (n->flags & BWPP_GRAPH_OPF_TRANS_B) != 0);
+    return;
+  }
+  if (value >= graph->value_count) {
+    return;
+  }
+  const BwppShape *s = &graph->values[value].shape;
+  if (s->rank == 0 || !bwpp_shape_bound(s)) {
+    return;
+  }
+  kernel->problem.batch = 1;
+  kernel->problem.m = bwpp_tile_outer(s, 1);
+  kernel->problem.n = s->sizes[s->rank - 1];
 }
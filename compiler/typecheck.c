@@ -1,45 +1,23 @@
 #include "typecheck.h"
-#include "lexer.h"
 #include <stdio.h>
 #include <string.h>
 
-#define BWPP_MAX_PARAMS 32
-#define BWPP_MAX_DIMS 4
-
-typedef struct {
-  const char *ptr;
-  size_t len;
-} BwppStr;
-
 typedef struct {
-  BwppStr name;
   uint32_t rank;
-  BwppStr dims[BWPP_MAX_DIMS];
-} BwppParam;
-
-typedef struct {
-  uint32_t rank;
-  BwppStr dims[BWPP_MAX_DIMS];
+  BwppStr dims[BWPP_AST_MAX_DIMS];
 } BwppShape;
 
-static int bwpp_str_eq(BwppStr s, const char *lit) {
-  size_t len = strlen(lit);
-  return s.len == len && strncmp(s.ptr, lit, len) == 0;
-}
-
-static int bwpp_str_eq_str(BwppStr a, BwppStr b) {
-  return a.len == b.len && strncmp(a.ptr, b.ptr, a.len) == 0;
-}
-
-static int bwpp_tok_is(const BwppToken *tok, const char *lit) {
-  size_t len = strlen(lit);
-  return tok->kind == BWPP_TOK_IDENT && tok->length == len && strncmp(tok->lexeme, lit, len) == 0;
-}
-
-static BwppStr bwpp_tok_str(const BwppToken *tok) {
-  BwppStr out = { tok->lexeme, tok->length };
-  return out;
-}
+/* What one function has shown so far: the last matmul of two declared
+   rank-2 params and the bias added to it. */
+typedef struct {
+  const BwppAstModule *module;
+  const BwppAstFn *fn;
+  BwppStr matmul_out1;
+  int saw_matmul;
+  int saw_bias_add;
+  BwppShape bias_shape;
+  int bias_shape_known;
+} BwppTypecheck;
 
 static int bwpp_str_is_number(BwppStr s) {
   if (s.len == 0) {
@@ -65,140 +43,158 @@ static int bwpp_str_to_u32(BwppStr s, uint32_t *out) {
   return 1;
 }
 
-static int bwpp_parse_shape_list(BwppLexer *lx, BwppShape *shape) {
-  BwppToken tok = bwpp_lexer_next(lx);
-  if (!(tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '[')) {
-    return 0;
+static const BwppAstType *bwpp_find_param(const BwppTypecheck *tc, uint32_t expr) {
+  const BwppAstExpr *e = &tc->module->exprs[expr];
+  if (e->kind != BWPP_AST_EXPR_NAME) {
+    return NULL;
   }
-  shape->rank = 0;
-  while (1) {
-    BwppToken t = bwpp_lexer_next(lx);
-    if (t.kind == BWPP_TOK_SYMBOL && t.length == 1 && t.lexeme[0] == ']') {
-      break;
-    }
-    if (t.kind == BWPP_TOK_SYMBOL && t.length == 1 && t.lexeme[0] == ',') {
-      continue;
-    }
-    if (shape->rank < BWPP_MAX_DIMS &&
-        (t.kind == BWPP_TOK_IDENT || t.kind == BWPP_TOK_NUMBER)) {
-      shape->dims[shape->rank++] = bwpp_tok_str(&t);
+  for (uint32_t i = 0; i < tc->fn->param_count; ++i) {
+    const BwppAstParam *p = &tc->module->params[tc->fn->params + i];
+    if (p->sym == e->sym) {
+      return &p->type;
     }
   }
-  return 1;
+  return NULL;
 }
 
-static int bwpp_parse_params(BwppLexer *lx, BwppParam *params, uint32_t *param_count) {
-  BwppToken tok = bwpp_lexer_next(lx);
-  if (!(tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '(')) {
-    return 0;
+static BwppStatus bwpp_check_matmul(BwppTypecheck *tc, uint32_t lhs, uint32_t rhs) {
+  if (lhs == BWPP_AST_NO_EXPR || rhs == BWPP_AST_NO_EXPR) {
+    return BWPP_OK;
   }
-  while (1) {
-    BwppToken name = bwpp_lexer_next(lx);
-    if (name.kind == BWPP_TOK_SYMBOL && name.length == 1 && name.lexeme[0] == ')') {
-      break;
-    }
-    if (name.kind != BWPP_TOK_IDENT) {
-      return 0;
-    }
-    BwppToken colon = bwpp_lexer_next(lx);
-    if (!(colon.kind == BWPP_TOK_SYMBOL && colon.length == 1 && colon.lexeme[0] == ':')) {
-      return 0;
-    }
-    BwppToken tensor = bwpp_lexer_next(lx);
-    if (!bwpp_tok_is(&tensor, "tensor")) {
-      return 0;
-    }
-    BwppToken lt = bwpp_lexer_next(lx);
-    if (!(lt.kind == BWPP_TOK_SYMBOL && lt.length == 1 && lt.lexeme[0] == '<')) {
-      return 0;
-    }
-    BwppToken dtype = bwpp_lexer_next(lx);
-    if (dtype.kind != BWPP_TOK_IDENT) {
-      return 0;
-    }
-    BwppToken comma = bwpp_lexer_next(lx);
-    if (!(comma.kind == BWPP_TOK_SYMBOL && comma.length == 1 && comma.lexeme[0] == ',')) {
-      return 0;
-    }
-    BwppToken lbr = bwpp_lexer_next(lx);
-    if (!(lbr.kind == BWPP_TOK_SYMBOL && lbr.length == 1 && lbr.lexeme[0] == '[')) {
-      return 0;
-    }
+  const BwppAstType *pa = bwpp_find_param(tc, lhs);
+  const BwppAstType *pb = bwpp_find_param(tc, rhs);
+  if (!pa || !pb || pa->rank != 2 || pb->rank != 2) {
+    return BWPP_OK;
+  }
+  if (!bwpp_str_eq_str(pa->dims[1], pb->dims[0])) {
+    fprintf(stderr, "typecheck: matmul K mismatch\n");
+    return BWPP_ERR;
+  }
+  tc->matmul_out1 = pb->dims[1];
+  tc->saw_matmul = 1;
+  return BWPP_OK;
+}
 
-    if (*param_count >= BWPP_MAX_PARAMS) {
-      return 0;
+/* reshape(bias, [dims]) / permute(bias, [axes]) inside an add. */
+static BwppStatus bwpp_check_bias_view(BwppTypecheck *tc, uint32_t call) {
+  const BwppAstModule *m = tc->module;
+  uint32_t src = bwpp_ast_arg(m, call, 0);
+  uint32_t list = bwpp_ast_arg(m, call, 1);
+  const BwppAstType *bias = bwpp_find_param(tc, src);
+  if (!bias) {
+    fprintf(stderr, "typecheck: bias used but not declared\n");
+    return BWPP_ERR;
+  }
+  tc->saw_bias_add = 1;
+  if (list == BWPP_AST_NO_EXPR) {
+    return BWPP_OK;
+  }
+  if (m->exprs[list].kind != BWPP_AST_EXPR_LIST) {
+    fprintf(stderr, "typecheck: reshape/permute missing shape list\n");
+    return BWPP_ERR;
+  }
+  BwppShape temp = { 0 };
+  for (uint32_t a = m->exprs[list].first; a != BWPP_AST_NO_EXPR; a = m->exprs[a].next) {
+    if (temp.rank < BWPP_AST_MAX_DIMS &&
+        (m->exprs[a].kind == BWPP_AST_EXPR_NAME || m->exprs[a].kind == BWPP_AST_EXPR_NUMBER)) {
+      temp.dims[temp.rank++] = m->exprs[a].text;
     }
-    BwppParam *p = &params[*param_count];
-    p->name = bwpp_tok_str(&name);
-    p->rank = 0;
-
-    while (1) {
-      BwppToken dim = bwpp_lexer_next(lx);
-      if (dim.kind == BWPP_TOK_SYMBOL && dim.length == 1 && dim.lexeme[0] == ']') {
-        break;
-      }
-      if (dim.kind == BWPP_TOK_SYMBOL && dim.length == 1 && dim.lexeme[0] == ',') {
-        continue;
+  }
+  if (bwpp_str_eq(m->exprs[call].text, "permute")) {
+    if (temp.rank != bias->rank) {
+      fprintf(stderr, "typecheck: permute rank mismatch for bias\n");
+      return BWPP_ERR;
+    }
+    int used[BWPP_AST_MAX_DIMS] = { 0 };
+    tc->bias_shape.rank = bias->rank;
+    for (uint32_t i = 0; i < temp.rank; ++i) {
+      uint32_t axis = 0;
+      if (!bwpp_str_to_u32(temp.dims[i], &axis)) {
+        fprintf(stderr, "typecheck: permute axes must be numeric\n");
+        return BWPP_ERR;
       }
-      if (p->rank < BWPP_MAX_DIMS && (dim.kind == BWPP_TOK_IDENT || dim.kind == BWPP_TOK_NUMBER)) {
-        p->dims[p->rank++] = bwpp_tok_str(&dim);
+      if (axis >= bias->rank) {
+        fprintf(stderr, "typecheck: permute axis out of range\n");
+        return BWPP_ERR;
       }
-    }
-
-    BwppToken comma2 = bwpp_lexer_next(lx);
-    if (comma2.kind == BWPP_TOK_SYMBOL && comma2.length == 1 && comma2.lexeme[0] == ',') {
-      BwppToken layout = bwpp_lexer_next(lx);
-      (void)layout;
-      BwppToken gt = bwpp_lexer_next(lx);
-      if (!(gt.kind == BWPP_TOK_SYMBOL && gt.length == 1 && gt.lexeme[0] == '>')) {
-        return 0;
+      if (used[axis]) {
+        fprintf(stderr, "typecheck: permute axis repeated\n");
+        return BWPP_ERR;
       }
-    } else if (comma2.kind == BWPP_TOK_SYMBOL && comma2.length == 1 && comma2.lexeme[0] == '>') {
-      /* no layout */
-    } else {
-      return 0;
+      used[axis] = 1;
+      tc->bias_shape.dims[i] = bias->dims[axis];
     }
+  } else {
+    tc->bias_shape = temp;
+  }
+  tc->bias_shape_known = 1;
+  return BWPP_OK;
+}
 
-    BwppToken sep = bwpp_lexer_next(lx);
-    if (sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ')') {
-      (*param_count)++;
-      break;
-    }
-    if (!(sep.kind == BWPP_TOK_SYMBOL && sep.length == 1 && sep.lexeme[0] == ',')) {
-      return 0;
-    }
-    (*param_count)++;
+static BwppStatus bwpp_check_bias(BwppTypecheck *tc, uint32_t expr) {
+  const BwppAstType *bias = bwpp_find_param(tc, expr);
+  tc->saw_bias_add = 1;
+  if (!bias) {
+    fprintf(stderr, "typecheck: bias used but not declared\n");
+    return BWPP_ERR;
   }
-  return 1;
+  if (bias->rank != 1) {
+    fprintf(stderr, "typecheck: bias must be rank-1 tensor\n");
+    return BWPP_ERR;
+  }
+  tc->bias_shape.rank = 1;
+  tc->bias_shape.dims[0] = bias->dims[0];
+  tc->bias_shape_known = 1;
+  if (tc->saw_matmul && tc->matmul_out1.ptr && !bwpp_str_eq_str(bias->dims[0], tc->matmul_out1)) {
+    fprintf(stderr, "typecheck: bias shape does not match matmul N dimension\n");
+    return BWPP_ERR;
+  }
+  return BWPP_OK;
 }
 
-static const BwppParam *bwpp_find_param(const BwppParam *params, uint32_t count, BwppStr name) {
-  for (uint32_t i = 0; i < count; ++i) {
-    if (params[i].name.len == name.len && strncmp(params[i].name.ptr, name.ptr, name.len) == 0) {
-      return &params[i];
+/* Source order; `in_add` once under an add(...), where `bias` is checked. */
+static BwppStatus bwpp_check_expr(BwppTypecheck *tc, uint32_t expr, int in_add) {
+  const BwppAstExpr *e = &tc->module->exprs[expr];
+  if (e->kind == BWPP_AST_EXPR_NAME) {
+    return in_add && bwpp_str_eq(e->text, "bias") ? bwpp_check_bias(tc, expr) : BWPP_OK;
+  }
+  if (e->kind == BWPP_AST_EXPR_CALL) {
+    if (in_add && (bwpp_str_eq(e->text, "reshape") || bwpp_str_eq(e->text, "permute"))) {
+      uint32_t src = bwpp_ast_arg(tc->module, expr, 0);
+      if (src != BWPP_AST_NO_EXPR && tc->module->exprs[src].kind == BWPP_AST_EXPR_NAME &&
+          bwpp_str_eq(tc->module->exprs[src].text, "bias")) {
+        return bwpp_check_bias_view(tc, expr);
+      }
     }
+    in_add = in_add || bwpp_str_eq(e->text, "add");
   }
-  return NULL;
+  for (uint32_t a = e->first; a != BWPP_AST_NO_EXPR; a = tc->module->exprs[a].next) {
+    if (bwpp_check_expr(tc, a, in_add) != BWPP_OK) {
+      return BWPP_ERR;
+    }
+  }
+  if (e->kind == BWPP_AST_EXPR_MATMUL ||
+      (e->kind == BWPP_AST_EXPR_CALL && bwpp_str_eq(e->text, "matmul"))) {
+    return bwpp_check_matmul(tc, bwpp_ast_arg(tc->module, expr, 0), bwpp_ast_arg(tc->module, expr, 1));
+  }
+  return BWPP_OK;
 }
 
-static BwppStatus bwpp_finalize_fn(int saw_bias_add,
-                                   int saw_matmul,
-                                   int bias_shape_known,
-                                   BwppShape bias_shape,
-                                   BwppStr matmul_out1) {
-  if (saw_bias_add && !saw_matmul) {
+static BwppStatus bwpp_finalize_fn(const BwppTypecheck *tc) {
+  if (tc->saw_bias_add && !tc->saw_matmul) {
     fprintf(stderr, "typecheck: add(bias) without matmul context\n");
     return BWPP_ERR;
   }
-  if (saw_bias_add && saw_matmul && bias_shape_known && matmul_out1.ptr) {
+  if (tc->saw_bias_add && tc->saw_matmul && tc->bias_shape_known && tc->matmul_out1.ptr) {
+    const BwppShape *bias = &tc->bias_shape;
     int ok = 0;
-    if (bias_shape.rank == 1) {
-      ok = bwpp_str_eq_str(bias_shape.dims[0], matmul_out1);
-    } else if (bias_shape.rank == 2) {
-      int d0_is_one = bwpp_str_eq(bias_shape.dims[0], "1");
-      int d1_is_one = bwpp_str_eq(bias_shape.dims[1], "1");
-      if ((d0_is_one && bwpp_str_eq_str(bias_shape.dims[1], matmul_out1)) ||
-          (d1_is_one && bwpp_str_eq_str(bias_shape.dims[0], matmul_out1))) {
+    if (bias->rank == 1) {
+      ok = bwpp_str_eq_str(bias->dims[0], tc->matmul_out1);
+    } else if (bias->rank == 2) {
+      int d0_is_one = bwpp_str_eq(bias->dims[0], "1");
+      int d1_is_one = bwpp_str_eq(bias->dims[1], "1");
+      if ((d0_is_one && bwpp_str_eq_str(bias->dims[1], tc->matmul_out1)) ||
+          (d1_is_one && bwpp_str_eq_str(bias->dims[0], tc->matmul_out1))) {
         ok = 1;
       }
     }
@@ -211,259 +207,21 @@ static BwppStatus bwpp_finalize_fn(int saw_bias_add,
 }
 
 BwppStatus bwpp_typecheck_module(const BwppAstModule *module) {
-  if (!module || !module->source) {
+  if (!module) {
     return BWPP_OK;
   }
-
-  BwppLexer lx;
-  bwpp_lexer_init(&lx, module->source, module->length);
-
-  BwppParam params[BWPP_MAX_PARAMS];
-  uint32_t param_count = 0;
-  BwppStr matmul_out0 = {0};
-  BwppStr matmul_out1 = {0};
-  int saw_matmul = 0;
-  int saw_bias_add = 0;
-  BwppShape bias_shape = {0};
-  int bias_shape_known = 0;
-
-  BwppStr last_ident = (BwppStr){0};
-  int brace_depth = 0;
-  int fn_body_depth = 0;
-  int pending_fn_body = 0;
-  int in_fn = 0;
-
-  for (;;) {
-    BwppToken tok = bwpp_lexer_next(&lx);
-    if (tok.kind == BWPP_TOK_EOF) {
-      break;
-    }
-    if (tok.kind == BWPP_TOK_SYMBOL && tok.length == 1) {
-      char ch = tok.lexeme[0];
-      if (ch == '{') {
-        brace_depth++;
-        if (pending_fn_body) {
-          fn_body_depth = brace_depth;
-          pending_fn_body = 0;
-        }
-        continue;
-      }
-      if (ch == '}') {
-        if (in_fn && brace_depth == fn_body_depth) {
-          if (bwpp_finalize_fn(saw_bias_add, saw_matmul, bias_shape_known, bias_shape, matmul_out1) != BWPP_OK) {
-            return BWPP_ERR;
-          }
-          in_fn = 0;
-          fn_body_depth = 0;
-        }
-        if (brace_depth > 0) {
-          brace_depth--;
-        }
-        continue;
-      }
-    }
-    if (bwpp_tok_is(&tok, "fn")) {
-      if (in_fn) {
-        if (bwpp_finalize_fn(saw_bias_add, saw_matmul, bias_shape_known, bias_shape, matmul_out1) != BWPP_OK) {
-          return BWPP_ERR;
-        }
-      }
-      BwppToken name = bwpp_lexer_next(&lx);
-      (void)name;
-      param_count = 0;
-      matmul_out0 = (BwppStr){0};
-      matmul_out1 = (BwppStr){0};
-      saw_matmul = 0;
-      saw_bias_add = 0;
-      bias_shape = (BwppShape){0};
-      bias_shape_known = 0;
-      last_ident = (BwppStr){0};
-      in_fn = 1;
-      pending_fn_body = 1;
-      if (!bwpp_parse_params(&lx, params, &param_count)) {
-        fprintf(stderr, "typecheck: failed to parse params\n");
+  for (uint32_t f = 0; f < module->fn_count; ++f) {
+    BwppTypecheck tc;
+    memset(&tc, 0, sizeof(tc));
+    tc.module = module;
+    tc.fn = &module->fns[f];
+    for (uint32_t s = tc.fn->stmts; s < tc.fn->stmt_end; ++s) {
+      const BwppAstStmt *stmt = &module->stmts[s];
+      if (stmt->kind != BWPP_AST_STMT_BLOCK && bwpp_check_expr(&tc, stmt->expr, 0) != BWPP_OK) {
         return BWPP_ERR;
       }
-      continue;
-    }
-    if (tok.kind == BWPP_TOK_IDENT && tok.length > 0) {
-      last_ident = bwpp_tok_str(&tok);
-      if (bwpp_tok_is(&tok, "add")) {
-        BwppToken next = bwpp_lexer_next(&lx);
-        if (next.kind == BWPP_TOK_SYMBOL && next.length == 1 && next.lexeme[0] == '(') {
-          int depth = 1;
-          BwppStr last = (BwppStr){0};
-          while (depth > 0) {
-            BwppToken arg = bwpp_lexer_next(&lx);
-            if (arg.kind == BWPP_TOK_EOF) {
-              break;
-            }
-            if (arg.kind == BWPP_TOK_SYMBOL && arg.length == 1) {
-              if (arg.lexeme[0] == '@') {
-                BwppToken rhs = bwpp_lexer_next(&lx);
-                if (rhs.kind == BWPP_TOK_IDENT && last.ptr) {
-                  const BwppParam *pa = bwpp_find_param(params, param_count, last);
-                  const BwppParam *pb = bwpp_find_param(params, param_count, bwpp_tok_str(&rhs));
-                  if (pa && pb && pa->rank == 2 && pb->rank == 2) {
-                    if (!(pa->dims[1].len == pb->dims[0].len &&
-                          strncmp(pa->dims[1].ptr, pb->dims[0].ptr, pb->dims[0].len) == 0)) {
-                      fprintf(stderr, "typecheck: matmul K mismatch\n");
-                      return BWPP_ERR;
-                    }
-                    matmul_out0 = pa->dims[0];
-                    matmul_out1 = pb->dims[1];
-                    saw_matmul = 1;
-                  }
-                }
-              }
-              if (arg.lexeme[0] == '(') {
-                depth++;
-              } else if (arg.lexeme[0] == ')') {
-                depth--;
-              }
-              continue;
-            }
-            if (arg.kind == BWPP_TOK_IDENT) {
-              last = bwpp_tok_str(&arg);
-              BwppStr name = bwpp_tok_str(&arg);
-              if (bwpp_str_eq(name, "reshape") || bwpp_str_eq(name, "permute")) {
-                BwppToken open = bwpp_lexer_next(&lx);
-                if (open.kind == BWPP_TOK_SYMBOL && open.length == 1 && open.lexeme[0] == '(') {
-                  BwppToken inner = bwpp_lexer_next(&lx);
-                  if (inner.kind == BWPP_TOK_IDENT && bwpp_tok_is(&inner, "bias")) {
-                    const BwppParam *bias = bwpp_find_param(params, param_count, bwpp_tok_str(&inner));
-                    if (!bias) {
-                      fprintf(stderr, "typecheck: bias used but not declared\n");
-                      return BWPP_ERR;
-                    }
-                    saw_bias_add = 1;
-                    BwppToken comma = bwpp_lexer_next(&lx);
-                    if (comma.kind == BWPP_TOK_SYMBOL && comma.length == 1 && comma.lexeme[0] == ',') {
-                      BwppShape temp = {0};
-                      if (!bwpp_parse_shape_list(&lx, &temp)) {
-                        fprintf(stderr, "typecheck: reshape/permute missing shape list\n");
-                        return BWPP_ERR;
-                      }
-                      if (bwpp_str_eq(name, "permute")) {
-                        if (temp.rank != bias->rank) {
-                          fprintf(stderr, "typecheck: permute rank mismatch for bias\n");
-                          return BWPP_ERR;
-                        }
-                        int used[BWPP_MAX_DIMS] = {0};
-                        bias_shape.rank = bias->rank;
-                        for (uint32_t i = 0; i < temp.rank && i < BWPP_MAX_DIMS; ++i) {
-                          uint32_t axis = 0;
-                          if (!bwpp_str_to_u32(temp.dims[i], &axis)) {
-                            fprintf(stderr, "typecheck: permute axes must be numeric\n");
-                            return BWPP_ERR;
-                          }
-                          if (axis >= bias->rank) {
-                            fprintf(stderr, "typecheck: permute axis out of range\n");
-                            return BWPP_ERR;
-                          }
-                          if (used[axis]) {
-                            fprintf(stderr, "typecheck: permute axis repeated\n");
-                            return BWPP_ERR;
-                          }
-                          used[axis] = 1;
-                          bias_shape.dims[i] = bias->dims[axis];
-                        }
-                      } else {
-                        bias_shape = temp;
-                      }
-                      bias_shape_known = 1;
-                    }
-                  }
-                }
-              }
-              if (bwpp_str_eq(name, "bias")) {
-                saw_bias_add = 1;
-                const BwppParam *bias = bwpp_find_param(params, param_count, name);
-                if (!bias) {
-                  fprintf(stderr, "typecheck: bias used but not declared\n");
-                  return BWPP_ERR;
-                }
-                if (bias->rank != 1) {
-                  fprintf(stderr, "typecheck: bias must be rank-1 tensor\n");
-                  return BWPP_ERR;
-                }
-                bias_shape.rank = bias->rank;
-                bias_shape.dims[0] = bias->dims[0];
-                bias_shape_known = 1;
-                if (saw_matmul && matmul_out1.ptr) {
-                  if (!(bias->dims[0].len == matmul_out1.len &&
-                        strncmp(bias->dims[0].ptr, matmul_out1.ptr, matmul_out1.len) == 0)) {
-                    fprintf(stderr, "typecheck: bias shape does not match matmul N dimension\n");
-                    return BWPP_ERR;
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-      if (bwpp_tok_is(&tok, "matmul")) {
-        /* matmul(a, b) form */
-        BwppToken next = bwpp_lexer_next(&lx);
-        if (next.kind == BWPP_TOK_SYMBOL && next.length == 1 && next.lexeme[0] == '(') {
-          BwppToken a = bwpp_lexer_next(&lx);
-          BwppToken comma = bwpp_lexer_next(&lx);
-          BwppToken b = bwpp_lexer_next(&lx);
-          (void)comma;
-          if (a.kind == BWPP_TOK_IDENT && b.kind == BWPP_TOK_IDENT) {
-            const BwppParam *pa = bwpp_find_param(params, param_count, bwpp_tok_str(&a));
-            const BwppParam *pb = bwpp_find_param(params, param_count, bwpp_tok_str(&b));
-            if (pa && pb && pa->rank == 2 && pb->rank == 2) {
-              if (!(pa->dims[1].len == pb->dims[0].len &&
-                    strncmp(pa->dims[1].ptr, pb->dims[0].ptr, pb->dims[0].len) == 0)) {
-                fprintf(stderr, "typecheck: matmul K mismatch\n");
-                return BWPP_ERR;
-              }
-              matmul_out0 = pa->dims[0];
-              matmul_out1 = pb->dims[1];
-              saw_matmul = 1;
-            }
-          }
-        }
-      }
     }
-    if (tok.kind == BWPP_TOK_SYMBOL && tok.length == 1 && tok.lexeme[0] == '@') {
-      BwppToken rhs = bwpp_lexer_next(&lx);
-      if (rhs.kind == BWPP_TOK_IDENT && last_ident.ptr) {
-        const BwppParam *pa = bwpp_find_param(params, param_count, last_ident);
-        const BwppParam *pb = bwpp_find_param(params, param_count, bwpp_tok_str(&rhs));
-        if (pa && pb && pa->rank == 2 && pb->rank == 2) {
-          if (!(pa->dims[1].len == pb->dims[0].len &&
-                strncmp(pa->dims[1].ptr, pb->dims[0].ptr, pb->dims[0].len) == 0)) {
-            fprintf(stderr, "typecheck: matmul K mismatch\n");
-            return BWPP_ERR;
-          }
-          matmul_out0 = pa->dims[0];
-          matmul_out1 = pb->dims[1];
-          saw_matmul = 1;
-        }
-      }
-    }
-  }
-
-  if (saw_bias_add && !saw_matmul) {
-    fprintf(stderr, "typecheck: add(bias) without matmul context\n");
-    return BWPP_ERR;
-  }
-  if (saw_bias_add && saw_matmul && bias_shape_known && matmul_out1.ptr) {
-    int ok = 0;
-    if (bias_shape.rank == 1) {
-      ok = bwpp_str_eq_str(bias_shape.dims[0], matmul_out1);
-    } else if (bias_shape.rank == 2) {
-      int d0_is_one = bwpp_str_eq(bias_shape.dims[0], "1");
-      int d1_is_one = bwpp_str_eq(bias_shape.dims[1], "1");
-      if ((d0_is_one && bwpp_str_eq_str(bias_shape.dims[1], matmul_out1)) ||
-          (d1_is_one && bwpp_str_eq_str(bias_shape.dims[0], matmul_out1))) {
-        ok = 1;
-      }
-    }
-    if (!ok) {
-      fprintf(stderr, "typecheck: bias shape does not match matmul N dimension\n");
+    if (bwpp_finalize_fn(&tc) != BWPP_OK) {
       return BWPP_ERR;
     }
   }
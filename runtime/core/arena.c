@@ -1,5 +1,7 @@
 #include "arena.h"
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 static size_t bwpp_align_up(size_t v, size_t align) {
   size_t mask = align - 1;
@@ -36,3 +38,80 @@ void bwpp_arena_destroy(BwppArena *arena) {
   arena->capacity = 0;
   arena->offset = 0;
 }
+
+struct BwppArenaChunk {
+  BwppArenaChunk *next;
+  size_t capacity;
+  size_t offset;
+  unsigned char data[];
+};
+
+/* Offset in `chunk` where an `align`-aligned block can start. */
+static size_t bwpp_chunk_align(const BwppArenaChunk *chunk, size_t align) {
+  uintptr_t at = (uintptr_t)(chunk->data + chunk->offset);
+  return chunk->offset + (bwpp_align_up(at, align) - at);
+}
+
+void (*bwpp_chunk_arena_chunk_hook)(size_t bytes) = NULL;
+
+void bwpp_chunk_arena_init(BwppChunkArena *arena, size_t chunk_size) {
+  arena->head = NULL;
+  arena->chunk_size = chunk_size ? chunk_size : 4096;
+  arena->last = NULL;
+}
+
+void *bwpp_chunk_arena_alloc(BwppChunkArena *arena, size_t size, size_t align) {
+  align = align ? align : 1;
+  BwppArenaChunk *chunk = arena->head;
+  size_t start = chunk ? bwpp_chunk_align(chunk, align) : 0;
+  if (!chunk || start + size > chunk->capacity) {
+    size_t capacity = size + align > arena->chunk_size ? size + align : arena->chunk_size;
+    chunk = (BwppArenaChunk *)malloc(sizeof(BwppArenaChunk) + capacity);
+    if (!chunk) {
+      return NULL;
+    }
+    if (bwpp_chunk_arena_chunk_hook) {
+      bwpp_chunk_arena_chunk_hook(sizeof(BwppArenaChunk) + capacity);
+    }
+    chunk->next = arena->head;
+    chunk->capacity = capacity;
+    chunk->offset = 0;
+    arena->head = chunk;
+    start = bwpp_chunk_align(chunk, align);
+  }
+  chunk->offset = start + size;
+  arena->last = chunk->data + start;
+  return arena->last;
+}
+
+void *bwpp_chunk_arena_grow(BwppChunkArena *arena, void *ptr, size_t old_size, size_t new_size, size_t align) {
+  if (!ptr) {
+    return bwpp_chunk_arena_alloc(arena, new_size, align);
+  }
+  if (new_size <= old_size) {
+    return ptr;
+  }
+  if (ptr == arena->last) {
+    size_t start = (size_t)((unsigned char *)ptr - arena->head->data);
+    if (start + new_size <= arena->head->capacity) {
+      arena->head->offset = start + new_size;
+      return ptr;
+    }
+  }
+  void *grown = bwpp_chunk_arena_alloc(arena, new_size, align);
+  if (grown) {
+    memcpy(grown, ptr, old_size);
+  }
+  return grown;
+}
+
+void bwpp_chunk_arena_destroy(BwppChunkArena *arena) {
+  BwppArenaChunk *chunk = arena->head;
+  while (chunk) {
+    BwppArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = NULL;
+  arena->last = NULL;
+}
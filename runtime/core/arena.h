@@ -14,4 +14,28 @@ void bwpp_arena_reset(BwppArena *arena);
 void *bwpp_arena_alloc(BwppArena *arena, size_t size, size_t align);
 void bwpp_arena_destroy(BwppArena *arena);
 
+typedef struct BwppArenaChunk BwppArenaChunk;
+
+/* An arena that adds a chunk when full instead of failing, for data that
+   is built up and then freed all at once. Nothing is freed before
+   bwpp_chunk_arena_destroy. */
+typedef struct {
+  BwppArenaChunk *head; /* chunk being filled; older ones follow */
+  size_t chunk_size;
+  void *last;           /* newest allocation, which grow can extend in place */
+} BwppChunkArena;
+
+void bwpp_chunk_arena_init(BwppChunkArena *arena, size_t chunk_size);
+/* NULL when out of memory. */
+void *bwpp_chunk_arena_alloc(BwppChunkArena *arena, size_t size, size_t align);
+/* Resizes `ptr` (`old_size` bytes from this arena, or NULL) to `new_size`:
+   in place when it is the newest allocation and its chunk has room, else
+   by copying to a new block (the old one stays until destroy). */
+void *bwpp_chunk_arena_grow(BwppChunkArena *arena, void *ptr, size_t old_size, size_t new_size, size_t align);
+void bwpp_chunk_arena_destroy(BwppChunkArena *arena);
+
+/* When set, called with the size of every chunk a chunk arena mallocs so
+   the host can count them. */
+extern void (*bwpp_chunk_arena_chunk_hook)(size_t bytes);
+
 #endif
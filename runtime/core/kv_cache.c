@@ -0,0 +1,80 @@
+#include "kv_cache.h"
+#include <string.h>
+
+int bwpp_kv_cache_init(BwppKvCache *cache,
+                       BwppArena *arena,
+                       uint32_t kv_heads,
+                       uint32_t head_dim,
+                       uint32_t capacity) {
+  size_t bytes = sizeof(float) * (size_t)kv_heads * capacity * head_dim;
+  memset(cache, 0, sizeof(*cache));
+  cache->k = (float *)bwpp_arena_alloc(arena, bytes, 64);
+  cache->v = (float *)bwpp_arena_alloc(arena, bytes, 64);
+  if (!cache->k || !cache->v) {
+    cache->k = NULL;
+    cache->v = NULL;
+    return 0;
+  }
+  cache->kv_heads = kv_heads;
+  cache->head_dim = head_dim;
+  cache->capacity = capacity;
+  return 1;
+}
+
+void bwpp_kv_cache_reset(BwppKvCache *cache) {
+  cache->length = 0;
+}
+
+int bwpp_kv_cache_append(BwppKvCache *cache,
+                         const float *k,
+                         const float *v,
+                         uint32_t tokens,
+                         uint32_t ld) {
+  if (!cache->k || tokens > cache->capacity - cache->length) {
+    return 0;
+  }
+  if (ld == 0) {
+    ld = cache->head_dim;
+  }
+  size_t row_bytes = sizeof(float) * cache->head_dim;
+  for (uint32_t h = 0; h < cache->kv_heads; ++h) {
+    size_t dst = ((size_t)h * cache->capacity + cache->length) * cache->head_dim;
+    size_t src = (size_t)h * tokens * ld;
+    for (uint32_t t = 0; t < tokens; ++t) {
+      memcpy(cache->k + dst + (size_t)t * cache->head_dim, k + src + (size_t)t * ld, row_bytes);
+      memcpy(cache->v + dst + (size_t)t * cache->head_dim, v + src + (size_t)t * ld, row_bytes);
+    }
+  }
+  cache->length += tokens;
+  return 1;
+}
+
+void bwpp_kv_cache_truncate(BwppKvCache *cache, uint32_t length) {
+  if (length < cache->length) {
+    cache->length = length;
+  }
+}
+
+static BwppTensor bwpp_kv_cache_view(const BwppKvCache *cache, float *data) {
+  BwppTensor t;
+  memset(&t, 0, sizeof(t));
+  t.dtype = BWPP_DTYPE_F32;
+  t.layout = BWPP_LAYOUT_ROW_MAJOR;
+  t.rank = 3;
+  t.shape[0] = cache->kv_heads;
+  t.shape[1] = cache->length;
+  t.shape[2] = cache->head_dim;
+  t.stride[0] = (uint64_t)cache->capacity * cache->head_dim;
+  t.stride[1] = cache->head_dim;
+  t.stride[2] = 1;
+  t.buffer = data;
+  return t;
+}
+
+BwppTensor bwpp_kv_cache_k_view(const BwppKvCache *cache) {
+  return bwpp_kv_cache_view(cache, cache->k);
+}
+
+BwppTensor bwpp_kv_cache_v_view(const BwppKvCache *cache) {
+  return bwpp_kv_cache_view(cache, cache->v);
+}
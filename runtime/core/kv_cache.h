@@ -0,0 +1,44 @@
+#ifndef BWPP_KV_CACHE_H
+#define BWPP_KV_CACHE_H
+
+#include "arena.h"
+#include "tensor.h"
+#include <stdint.h>
+
+/* Per-sequence K/V cache for decoding. K and V are f32, laid out
+   [kv_heads, capacity, head_dim] in arena memory, so a head's rows stay
+   contiguous as tokens are appended and attention reads them in place with
+   kv_rows = capacity. */
+typedef struct {
+  uint32_t kv_heads;
+  uint32_t head_dim;
+  uint32_t capacity;
+  uint32_t length;
+  float *k;
+  float *v;
+} BwppKvCache;
+
+int bwpp_kv_cache_init(BwppKvCache *cache,
+                       BwppArena *arena,
+                       uint32_t kv_heads,
+                       uint32_t head_dim,
+                       uint32_t capacity);
+void bwpp_kv_cache_reset(BwppKvCache *cache);
+
+/* Appends `tokens` rows per head; k/v are [kv_heads, tokens, head_dim] with
+   row stride ld (0 means head_dim). Returns 0, appending nothing, when the
+   cache would overflow. */
+int bwpp_kv_cache_append(BwppKvCache *cache,
+                         const float *k,
+                         const float *v,
+                         uint32_t tokens,
+                         uint32_t ld);
+
+/* Drops tokens past `length`, e.g. rejected speculative tokens. */
+void bwpp_kv_cache_truncate(BwppKvCache *cache, uint32_t length);
+
+/* [kv_heads, length, head_dim] views over the live rows. */
+BwppTensor bwpp_kv_cache_k_view(const BwppKvCache *cache);
+BwppTensor bwpp_kv_cache_v_view(const BwppKvCache *cache);
+
+#endif
@@ -0,0 +1,168 @@
+#include "kv_pages.h"
+#include <stdlib.h>
+#include <string.h>
+
+int bwpp_kv_pool_init(BwppKvPagePool *pool,
+                      BwppArena *arena,
+                      uint32_t kv_heads,
+                      uint32_t head_dim,
+                      uint32_t page_tokens,
+                      uint32_t page_count) {
+  size_t page_floats = (size_t)kv_heads * page_tokens * head_dim;
+  memset(pool, 0, sizeof(*pool));
+  if (page_tokens == 0) {
+    return 0;
+  }
+  pool->k = (float *)bwpp_arena_alloc(arena, sizeof(float) * page_floats * page_count, 64);
+  pool->v = (float *)bwpp_arena_alloc(arena, sizeof(float) * page_floats * page_count, 64);
+  pool->refs = (uint32_t *)bwpp_arena_alloc(arena, sizeof(uint32_t) * page_count, sizeof(uint32_t));
+  pool->free_pages = (uint32_t *)bwpp_arena_alloc(arena, sizeof(uint32_t) * page_count, sizeof(uint32_t));
+  if (!pool->k || !pool->v || !pool->refs || !pool->free_pages) {
+    memset(pool, 0, sizeof(*pool));
+    return 0;
+  }
+  pool->kv_heads = kv_heads;
+  pool->head_dim = head_dim;
+  pool->page_tokens = page_tokens;
+  pool->page_count = page_count;
+  /* hand out low page ids first */
+  for (uint32_t i = 0; i < page_count; ++i) {
+    pool->refs[i] = 0;
+    pool->free_pages[i] = page_count - 1 - i;
+  }
+  pool->free_count = page_count;
+  return 1;
+}
+
+static uint32_t bwpp_kv_page_take(BwppKvPagePool *pool) {
+  uint32_t page = pool->free_pages[--pool->free_count];
+  pool->refs[page] = 1;
+  return page;
+}
+
+static void bwpp_kv_page_drop(BwppKvPagePool *pool, uint32_t page) {
+  if (--pool->refs[page] == 0) {
+    pool->free_pages[pool->free_count++] = page;
+  }
+}
+
+static size_t bwpp_kv_page_offset(const BwppKvPagePool *pool, uint32_t page) {
+  return (size_t)page * pool->kv_heads * pool->page_tokens * pool->head_dim;
+}
+
+static int bwpp_kv_seq_reserve(BwppKvSeq *seq, uint32_t pages) {
+  if (pages <= seq->page_capacity) {
+    return 1;
+  }
+  uint32_t next = seq->page_capacity ? seq->page_capacity * 2 : 8;
+  while (next < pages) {
+    next *= 2;
+  }
+  uint32_t *table = (uint32_t *)realloc(seq->pages, sizeof(uint32_t) * next);
+  if (!table) {
+    return 0;
+  }
+  seq->pages = table;
+  seq->page_capacity = next;
+  return 1;
+}
+
+void bwpp_kv_seq_init(BwppKvSeq *seq) {
+  memset(seq, 0, sizeof(*seq));
+}
+
+void bwpp_kv_seq_release(BwppKvPagePool *pool, BwppKvSeq *seq) {
+  bwpp_kv_seq_truncate(pool, seq, 0);
+  free(seq->pages);
+  bwpp_kv_seq_init(seq);
+}
+
+int bwpp_kv_seq_append(BwppKvPagePool *pool,
+                       BwppKvSeq *seq,
+                       const float *k,
+                       const float *v,
+                       uint32_t tokens,
+                       uint32_t ld) {
+  uint32_t pt = pool->page_tokens;
+  if (!pool->k || tokens == 0) {
+    return pool->k != NULL;
+  }
+  uint32_t pages = (uint32_t)(((uint64_t)seq->length + tokens + pt - 1) / pt);
+  /* a partly filled last page that another sequence shares is copied first */
+  int cow = seq->length % pt != 0 && pool->refs[seq->pages[seq->page_count - 1]] > 1;
+  uint32_t need = pages - seq->page_count + (cow ? 1 : 0);
+  if (need > pool->free_count || !bwpp_kv_seq_reserve(seq, pages)) {
+    return 0;
+  }
+  if (ld == 0) {
+    ld = pool->head_dim;
+  }
+  size_t page_floats = (size_t)pool->kv_heads * pt * pool->head_dim;
+  if (cow) {
+    uint32_t old = seq->pages[seq->page_count - 1];
+    uint32_t page = bwpp_kv_page_take(pool);
+    memcpy(pool->k + bwpp_kv_page_offset(pool, page), pool->k + bwpp_kv_page_offset(pool, old),
+           sizeof(float) * page_floats);
+    memcpy(pool->v + bwpp_kv_page_offset(pool, page), pool->v + bwpp_kv_page_offset(pool, old),
+           sizeof(float) * page_floats);
+    bwpp_kv_page_drop(pool, old);
+    seq->pages[seq->page_count - 1] = page;
+  }
+  while (seq->page_count < pages) {
+    seq->pages[seq->page_count++] = bwpp_kv_page_take(pool);
+  }
+  size_t row_bytes = sizeof(float) * pool->head_dim;
+  for (uint32_t t = 0; t < tokens; ++t) {
+    uint32_t n = seq->length + t;
+    size_t base = bwpp_kv_page_offset(pool, seq->pages[n / pt]) + (size_t)(n % pt) * pool->head_dim;
+    for (uint32_t h = 0; h < pool->kv_heads; ++h) {
+      size_t dst = base + (size_t)h * pt * pool->head_dim;
+      size_t src = ((size_t)h * tokens + t) * ld;
+      memcpy(pool->k + dst, k + src, row_bytes);
+      memcpy(pool->v + dst, v + src, row_bytes);
+    }
+  }
+  seq->length += tokens;
+  return 1;
+}
+
+int bwpp_kv_seq_fork(BwppKvPagePool *pool, BwppKvSeq *dst, const BwppKvSeq *src) {
+  if (!bwpp_kv_seq_reserve(dst, src->page_count)) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < src->page_count; ++i) {
+    dst->pages[i] = src->pages[i];
+    pool->refs[src->pages[i]]++;
+  }
+  dst->page_count = src->page_count;
+  dst->length = src->length;
+  return 1;
+}
+
+void bwpp_kv_seq_truncate(BwppKvPagePool *pool, BwppKvSeq *seq, uint32_t length) {
+  if (length >= seq->length) {
+    return;
+  }
+  uint32_t pages = (length + pool->page_tokens - 1) / pool->page_tokens;
+  while (seq->page_count > pages) {
+    bwpp_kv_page_drop(pool, seq->pages[--seq->page_count]);
+  }
+  seq->length = length;
+}
+
+int bwpp_kv_seq_batch_table(const BwppKvSeq *seqs,
+                            uint32_t count,
+                            uint32_t *table,
+                            uint32_t stride,
+                            uint32_t *lens) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (seqs[i].page_count > stride) {
+      return 0;
+    }
+    for (uint32_t j = 0; j < seqs[i].page_count; ++j) {
+      table[(size_t)i * stride + j] = seqs[i].pages[j];
+    }
+    lens[i] = seqs[i].length;
+  }
+  return 1;
+}
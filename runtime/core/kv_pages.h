@@ -0,0 +1,69 @@
+#ifndef BWPP_KV_PAGES_H
+#define BWPP_KV_PAGES_H
+
+#include "arena.h"
+#include <stdint.h>
+
+/* Block-paged K/V store shared by many sequences. Pages hold page_tokens rows
+   of every K/V head ([page][kv_heads][page_tokens][head_dim], f32) and come
+   from one arena allocation, so memory is bounded by the page count rather
+   than by each sequence's worst-case length. Pages are reference counted:
+   forked sequences share their prefix and copy a page only when writing to
+   one still in use elsewhere. */
+typedef struct {
+  uint32_t kv_heads;
+  uint32_t head_dim;
+  uint32_t page_tokens;
+  uint32_t page_count;
+  float *k;
+  float *v;
+  uint32_t *refs;
+  uint32_t *free_pages;
+  uint32_t free_count;
+} BwppKvPagePool;
+
+/* One sequence's page table; pages[i] holds tokens [i, i + 1) * page_tokens. */
+typedef struct {
+  uint32_t *pages;
+  uint32_t page_count;
+  uint32_t page_capacity;
+  uint32_t length;
+} BwppKvSeq;
+
+int bwpp_kv_pool_init(BwppKvPagePool *pool,
+                      BwppArena *arena,
+                      uint32_t kv_heads,
+                      uint32_t head_dim,
+                      uint32_t page_tokens,
+                      uint32_t page_count);
+
+void bwpp_kv_seq_init(BwppKvSeq *seq);
+/* Returns the sequence's pages to the pool and frees its table. */
+void bwpp_kv_seq_release(BwppKvPagePool *pool, BwppKvSeq *seq);
+
+/* Appends `tokens` rows per head; k/v are [kv_heads, tokens, head_dim] with
+   row stride ld (0 means head_dim). Returns 0, changing nothing, when the
+   pool is out of pages or the table cannot grow. */
+int bwpp_kv_seq_append(BwppKvPagePool *pool,
+                       BwppKvSeq *seq,
+                       const float *k,
+                       const float *v,
+                       uint32_t tokens,
+                       uint32_t ld);
+
+/* dst (empty) shares every page of src; returns 0 if the table allocation fails. */
+int bwpp_kv_seq_fork(BwppKvPagePool *pool, BwppKvSeq *dst, const BwppKvSeq *src);
+
+/* Drops tokens past `length`, releasing pages that become empty. */
+void bwpp_kv_seq_truncate(BwppKvPagePool *pool, BwppKvSeq *seq, uint32_t length);
+
+/* Writes each sequence's page ids into table[i * stride ...] and its length
+   into lens[i], the form the paged attention kernels read. Returns 0 if a
+   sequence needs more than stride pages. */
+int bwpp_kv_seq_batch_table(const BwppKvSeq *seqs,
+                            uint32_t count,
+                            uint32_t *table,
+                            uint32_t stride,
+                            uint32_t *lens);
+
+#endif
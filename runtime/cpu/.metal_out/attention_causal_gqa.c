@@ -0,0 +1,222 @@
+/* BW++ C output: C11 + SIMD intrinsics, shapes baked in.
+   Build: cc -std=c11 -O3 -march=native -shared -fPIC <this.c> -o <lib.so> -lm */
+/* bwpp.meta: ops=3 reversible_regions=0 */
+/* bwpp.meta: kernel=attention_f32 */
+/* bwpp.meta: block=128,128,32 */
+/* bwpp.meta: problem=8,19,33,20 */
+/* bwpp.plan: 0=load role=1 */
+/* bwpp.plan: 1=load role=2 */
+/* bwpp.plan: 2=matmul role=3 */
+/* bwpp.plan: 3=softmax role=3 */
+/* bwpp.plan: 4=load role=2 */
+/* bwpp.plan: 5=matmul role=3 */
+/* bwpp.plan: 6=store role=3 */
+/* bwpp.meta: aux_kernel=softmax_f32 */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define BWPP_SIMD "avx512"
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define BWPP_SIMD "avx2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BWPP_SIMD "neon"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BWPP_SIMD "sse2"
+#else
+#define BWPP_SIMD "scalar"
+#endif
+
+#if defined(__GNUC__)
+#define BWPP_EXPORT __attribute__((visibility("default")))
+#else
+#define BWPP_EXPORT
+#endif
+
+BWPP_EXPORT const char bwpp_simd[] = BWPP_SIMD;
+
+/* y += a * x */
+static inline void bwpp_axpy(float *y, const float *x, float a, uint32_t n) {
+  uint32_t i = 0;
+#if defined(__AVX512F__)
+  __m512 va = _mm512_set1_ps(a);
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+#elif defined(__AVX2__) && defined(__FMA__)
+  __m256 va = _mm256_set1_ps(a);
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  }
+#elif defined(__ARM_NEON)
+  float32x4_t va = vdupq_n_f32(a);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), va, vld1q_f32(x + i)));
+  }
+#elif defined(__SSE2__)
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+static inline float bwpp_dot(const float *a, const float *b, uint32_t n) {
+  uint32_t i = 0;
+  float sum = 0.0f;
+#if defined(__AVX512F__)
+  __m512 acc = _mm512_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+  }
+  sum = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__) && defined(__FMA__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+  }
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+  sum = _mm_cvtss_f32(lo);
+#elif defined(__ARM_NEON)
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (; i + 4 <= n; i += 4) {
+    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) +
+        vgetq_lane_f32(acc, 3);
+#elif defined(__SSE2__)
+  __m128 acc = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+static inline float bwpp_silu(float x) {
+  return x / (1.0f + expf(-x));
+}
+
+#define BWPP_ATT_BATCH 2
+#define BWPP_ATT_HEADS 4
+#define BWPP_ATT_KV_HEADS 2
+#define BWPP_ATT_M 19
+#define BWPP_ATT_N 33
+#define BWPP_ATT_K 20
+#define BWPP_ATT_D 20
+#define BWPP_ATT_BLOCK_N 128
+#define BWPP_ATT_CAUSAL 1
+#define BWPP_ATT_KV_LEN 1
+
+BWPP_EXPORT const uint32_t bwpp_attention_shape[9] = {
+  BWPP_ATT_BATCH, BWPP_ATT_HEADS, BWPP_ATT_KV_HEADS, BWPP_ATT_M, BWPP_ATT_N,
+  BWPP_ATT_K, BWPP_ATT_D, BWPP_ATT_CAUSAL, BWPP_ATT_KV_LEN
+};
+
+/* softmax(Q K^T) V per head with an online softmax over BLOCK_N keys at a
+   time. Q/O are [batch, heads, M, *], K/V [batch, kv_heads, N, *]; KvLen
+   holds one key length per batch entry. */
+BWPP_EXPORT void bwpp_attention_f32(const float *Q,
+                                    const float *K,
+                                    const float *V,
+                                    float *O,
+                                    const uint32_t *KvLen) {
+  (void)KvLen;
+  for (uint32_t bh = 0; bh < BWPP_ATT_BATCH * BWPP_ATT_HEADS; ++bh) {
+    uint32_t b = bh / BWPP_ATT_HEADS;
+    uint32_t kvh = (bh % BWPP_ATT_HEADS) / (BWPP_ATT_HEADS / BWPP_ATT_KV_HEADS);
+    const float *qh = Q + (size_t)bh * BWPP_ATT_M * BWPP_ATT_K;
+    float *oh = O + (size_t)bh * BWPP_ATT_M * BWPP_ATT_D;
+    const float *kh = K + ((size_t)b * BWPP_ATT_KV_HEADS + kvh) * BWPP_ATT_N * BWPP_ATT_K;
+    const float *vh = V + ((size_t)b * BWPP_ATT_KV_HEADS + kvh) * BWPP_ATT_N * BWPP_ATT_D;
+    uint32_t n_len = BWPP_ATT_N;
+#if BWPP_ATT_KV_LEN
+    if (KvLen && KvLen[b] < n_len) {
+      n_len = KvLen[b];
+    }
+#endif
+    for (uint32_t m = 0; m < BWPP_ATT_M; ++m) {
+      const float *q = qh + (size_t)m * BWPP_ATT_K;
+      float *o = oh + (size_t)m * BWPP_ATT_D;
+      uint32_t n_end = n_len;
+#if BWPP_ATT_CAUSAL
+      /* bottom-right aligned: row m sees keys n <= m + n_len - M */
+      int64_t lim = (int64_t)m + (int64_t)n_len - BWPP_ATT_M + 1;
+      n_end = lim <= 0 ? 0 : (lim < (int64_t)n_len ? (uint32_t)lim : n_len);
+#endif
+      float acc[BWPP_ATT_D];
+      float s[BWPP_ATT_BLOCK_N];
+      float maxv = -INFINITY;
+      float sum = 0.0f;
+      memset(acc, 0, sizeof(acc));
+      for (uint32_t n0 = 0; n0 < n_end; n0 += BWPP_ATT_BLOCK_N) {
+        uint32_t n1 = n0 + BWPP_ATT_BLOCK_N < n_end ? n0 + BWPP_ATT_BLOCK_N : n_end;
+        float bmax = -INFINITY;
+        for (uint32_t n = n0; n < n1; ++n) {
+          s[n - n0] = bwpp_dot(q, kh + (size_t)n * BWPP_ATT_K, BWPP_ATT_K);
+          bmax = s[n - n0] > bmax ? s[n - n0] : bmax;
+        }
+        if (bmax > maxv) {
+          float scale = expf(maxv - bmax);
+          for (uint32_t d = 0; d < BWPP_ATT_D; ++d) {
+            acc[d] *= scale;
+          }
+          sum *= scale;
+          maxv = bmax;
+        }
+        for (uint32_t n = n0; n < n1; ++n) {
+          float w = expf(s[n - n0] - maxv);
+          sum += w;
+          bwpp_axpy(acc, vh + (size_t)n * BWPP_ATT_D, w, BWPP_ATT_D);
+        }
+      }
+      float inv = sum > 0.0f ? 1.0f / sum : 0.0f;
+      for (uint32_t d = 0; d < BWPP_ATT_D; ++d) {
+        o[d] = acc[d] * inv;
+      }
+    }
+  }
+}
+
+#define BWPP_SOFTMAX_ROWS 152
+#define BWPP_SOFTMAX_COLS 33
+
+BWPP_EXPORT const uint32_t bwpp_softmax_shape[2] = { BWPP_SOFTMAX_ROWS, BWPP_SOFTMAX_COLS };
+
+BWPP_EXPORT void bwpp_softmax_f32(const float *X, float *Y) {
+  for (uint32_t r = 0; r < BWPP_SOFTMAX_ROWS; ++r) {
+    const float *x = X + (size_t)r * BWPP_SOFTMAX_COLS;
+    float *y = Y + (size_t)r * BWPP_SOFTMAX_COLS;
+    float maxv = -INFINITY;
+    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {
+      maxv = x[c] > maxv ? x[c] : maxv;
+    }
+    float sum = 0.0f;
+    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {
+      y[c] = expf(x[c] - maxv);
+      sum += y[c];
+    }
+    float inv = sum > 0.0f ? 1.0f / sum : 0.0f;
+    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {
+      y[c] *= inv;
+    }
+  }
+}
@@ -0,0 +1,288 @@
+// BW++ Metal output stub
+// bwpp.meta: ops=3 reversible_regions=0
+// bwpp.meta: reversible_policy=auto
+// bwpp.meta: kernel=attention_f16
+// bwpp.meta: attention_plan=tile_ir_stub
+// bwpp.meta: fused_attention_candidate=1
+// bwpp.meta: attention_mask=causal,kv_len
+// bwpp.meta: attention_heads=gqa
+// bwpp.meta: layout=row_major
+// bwpp.meta: block=128,128,32
+// bwpp.meta: problem=8,19,33,20
+// bwpp.meta: grid=1,1,8
+// bwpp.meta: tile=16,16,16
+// bwpp.meta: params=M,N,K,D,ldq,ldk,ldv,ldo,batch,heads,kv_heads,causal,kv_rows
+
+// bwpp.plan: 0=load role=1
+// bwpp.plan: 1=load role=2
+// bwpp.plan: 2=matmul role=3
+// bwpp.plan: 3=softmax role=3
+// bwpp.plan: 4=load role=2
+// bwpp.plan: 5=matmul role=3
+// bwpp.plan: 6=store role=3
+
+// bwpp.meta: aux_kernel=softmax_f16
+#include <metal_stdlib>
+using namespace metal;
+
+#define TILE_M 16
+#define TILE_N 16
+#define TILE_K 16
+
+#define BWPP_ATT_TILE_M TILE_M
+#define BWPP_ATT_TILE_N TILE_N
+#define BWPP_ATT_TILE_K TILE_K
+#ifndef BWPP_FAST_MATH
+#define BWPP_FAST_MATH 1
+#endif
+#if BWPP_FAST_MATH
+#define BWPP_EXP(x) fast::exp(x)
+#else
+#define BWPP_EXP(x) exp(x)
+#endif
+#define BWPP_ATT_CAUSAL 1
+#define BWPP_ATT_KV_LEN 1
+
+struct BwppAttentionParams {
+  uint M;
+  uint N;
+  uint K;
+  uint D;
+  uint ldq;
+  uint ldk;
+  uint ldv;
+  uint ldo;
+  uint batch;
+  uint heads;
+  uint kv_heads;
+  uint causal;
+  uint kv_rows;
+};
+
+kernel void bwpp_attention_f16(
+    device const half *Q [[buffer(0)]],
+    device const half *K [[buffer(1)]],
+    device const half *V [[buffer(2)]],
+    device half *O [[buffer(3)]],
+    constant BwppAttentionParams &p [[buffer(4)]],
+    device const uint *KvLen [[buffer(5)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  const uint tile = BWPP_ATT_TILE_M;
+  uint heads = p.heads ? p.heads : 1;
+  uint kv_heads = p.kv_heads ? p.kv_heads : heads;
+  uint group = heads / kv_heads;
+  uint b = tgid.z / heads;
+  uint h = tgid.z % heads;
+  uint kvh = h / group;
+  device const half *Qh = Q + (b * heads + h) * p.M * p.ldq;
+  device half *Oh = O + (b * heads + h) * p.M * p.ldo;
+  uint kv_rows = max(p.kv_rows, p.N);
+  device const half *Kh = K + (b * kv_heads + kvh) * kv_rows * p.ldk;
+  device const half *Vh = V + (b * kv_heads + kvh) * kv_rows * p.ldv;
+  uint n_len = p.N;
+#if BWPP_ATT_KV_LEN
+  n_len = min(p.N, KvLen[b]);
+#endif
+  bool causal = BWPP_ATT_CAUSAL || p.causal != 0;
+  int offset = int(n_len) - int(p.M);
+  uint n_end = n_len;
+  if (causal) {
+    // keys past the tile's last visible column are skipped as whole blocks
+    int lim = int(min(tgid.y * tile + tile, p.M)) + offset;
+    n_end = lim <= 0 ? 0 : min(n_len, uint(lim));
+  }
+  uint m = tgid.y * tile + tid.y;
+  uint d = tgid.x * tile + tid.x;
+  if (m >= p.M || d >= p.D) { return; }
+  threadgroup half Qtg[BWPP_ATT_TILE_M][BWPP_ATT_TILE_K];
+  threadgroup half Ktg[BWPP_ATT_TILE_N][BWPP_ATT_TILE_K];
+  threadgroup half Vtg0[BWPP_ATT_TILE_N][BWPP_ATT_TILE_M];
+  threadgroup half Vtg1[BWPP_ATT_TILE_N][BWPP_ATT_TILE_M];
+  threadgroup half (*Vcur)[BWPP_ATT_TILE_M] = Vtg0;
+  threadgroup half (*Vnext)[BWPP_ATT_TILE_M] = Vtg1;
+  threadgroup float Scores[BWPP_ATT_TILE_M][BWPP_ATT_TILE_N];
+  float maxv = -INFINITY;
+  float sum = 0.0f;
+  float out = 0.0f;
+  uint vd0 = tgid.x * tile + tid.x;
+  uint vn0 = tid.y;
+  if (vn0 < n_end && vd0 < p.D) {
+    Vcur[tid.y][tid.x] = Vh[vn0 * p.ldv + vd0];
+  } else {
+    Vcur[tid.y][tid.x] = half(0.0f);
+  }
+  threadgroup_barrier(mem_flags::mem_threadgroup);
+  for (uint n0 = 0; n0 < n_end; n0 += tile) {
+    if (tid.x == 0) {
+      for (uint i = 0; i < BWPP_ATT_TILE_N; ++i) { Scores[tid.y][i] = 0.0f; }
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k0 = 0; k0 < p.K; k0 += tile) {
+      uint qk = k0 + tid.x;
+      if (m < p.M && qk < p.K) {
+        Qtg[tid.y][tid.x] = Qh[m * p.ldq + qk];
+      } else {
+        Qtg[tid.y][tid.x] = half(0.0f);
+      }
+      uint nk = n0 + tid.y;
+      if (nk < n_end && qk < p.K) {
+        Ktg[tid.y][tid.x] = Kh[nk * p.ldk + qk];
+      } else {
+        Ktg[tid.y][tid.x] = half(0.0f);
+      }
+      threadgroup_barrier(mem_flags::mem_threadgroup);
+      if (tid.x == 0) {
+        float qrow[BWPP_ATT_TILE_K];
+        for (uint kk = 0; kk < tile; ++kk) { qrow[kk] = float(Qtg[tid.y][kk]); }
+        for (uint n = 0; n < tile; ++n) {
+          float acc = 0.0f;
+          uint kk = 0;
+          for (; kk + 1 < tile; kk += 2) {
+            float2 q2 = float2(qrow[kk], qrow[kk + 1]);
+            float2 k2 = float2(Ktg[n][kk], Ktg[n][kk + 1]);
+            acc += q2.x * k2.x + q2.y * k2.y;
+          }
+          if (kk < tile) { acc += qrow[kk] * float(Ktg[n][kk]); }
+          Scores[tid.y][n] += acc;
+        }
+      }
+      threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+    uint next_n0 = n0 + tile;
+    if (next_n0 < n_end) {
+      uint vn = next_n0 + tid.y;
+      if (vn < n_end && vd0 < p.D) {
+        Vnext[tid.y][tid.x] = Vh[vn * p.ldv + vd0];
+      } else {
+        Vnext[tid.y][tid.x] = half(0.0f);
+      }
+    } else {
+      Vnext[tid.y][tid.x] = half(0.0f);
+    }
+    for (uint n = 0; n < tile; ++n) {
+      uint idx = n0 + n;
+      if (idx >= n_end) { continue; }
+      if (causal && int(idx) > int(m) + offset) { continue; }
+      float score = Scores[tid.y][n];
+      if (score > maxv) {
+        float scale = BWPP_EXP(maxv - score);
+        out = out * scale + float(Vcur[n][tid.x]);
+        sum = sum * scale + 1.0f;
+        maxv = score;
+      } else {
+        float w = BWPP_EXP(score - maxv);
+        out += w * float(Vcur[n][tid.x]);
+        sum += w;
+      }
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    threadgroup half (*Vtmp)[BWPP_ATT_TILE_M] = Vcur;
+    Vcur = Vnext;
+    Vnext = Vtmp;
+  }
+  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+  Oh[m * p.ldo + d] = half(out * inv);
+}
+
+#define BWPP_SOFTMAX_TILE 128
+
+struct BwppSoftmaxParams {
+  uint rows;
+  uint cols;
+  uint ld;
+};
+
+kernel void bwpp_softmax_f16(
+    device const half *X [[buffer(0)]],
+    device half *Y [[buffer(1)]],
+    constant BwppSoftmaxParams &p [[buffer(2)]],
+    uint gid [[thread_position_in_grid]]) {
+  uint row = gid;
+  if (row >= p.rows) { return; }
+  float maxv = -INFINITY;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]);
+      maxv = max(maxv, v);
+    }
+  }
+  float sum = 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float e = exp(float(X[row * p.ld + c]) - maxv);
+      Y[row * p.ld + c] = half(e);
+      sum += e;
+    }
+  }
+  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      Y[row * p.ld + c] = half(float(Y[row * p.ld + c]) * inv);
+    }
+  }
+}
+
+// bwpp.meta: region_kernels=1
+// bwpp.schedule: dispatches=1 kernels=1 slab_bytes=6080
+// bwpp.schedule: dispatch=0 kernel=bwpp_k0_attention nodes=0,1,2 grid=2,2,8 threadgroup=16,16,1 buffers=v0:input,v1:input,v3:input,v2:input,v6:slab+0
+
+inline float bwpp_region_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+inline float bwpp_region_silu_grad(float x, float dy) {
+  float s = 1.0f / (1.0f + exp(-x));
+  return dy * s * (1.0f + x * (1.0f - s));
+}
+
+// bwpp_k0_attention: attention nodes=0,1,2 dispatches=0
+kernel void bwpp_k0_attention(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device const uint *b2 [[buffer(2)]],
+    device const half *b3 [[buffer(3)]],
+    device half *b4 [[buffer(4)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  uint m = tgid.y * 16 + tid.y;
+  uint d = tgid.x * 16 + tid.x;
+  if (m >= 19u || d >= 20u) { return; }
+  uint r = tgid.z * 19u + m;
+  uint oq = 0;
+  oq += (tgid.z / 1u % 4u) / 1u * 380u;
+  oq += (tgid.z / 4u % 2u) / 1u * 1520u;
+  uint ok = 0;
+  ok += (tgid.z / 1u % 4u) / 2u * 660u;
+  ok += (tgid.z / 4u % 2u) / 1u * 1320u;
+  uint ov = 0;
+  ov += (tgid.z / 1u % 4u) / 2u * 660u;
+  ov += (tgid.z / 4u % 2u) / 1u * 1320u;
+  uint len = 33u;
+  uint kv = uint(b2[r / 76u]);
+  if (kv < 33u) { len = kv; }
+  int lim = int(len);
+  lim = clamp(int(r % 19u) + int(len) - 19 + 1, 0, lim);
+  float maxv = -INFINITY;
+  float sum = 0.0f;
+  float acc = 0.0f;
+  for (int n = 0; n < lim; ++n) {
+    float s = 0.0f;
+    for (uint k = 0; k < 20u; ++k) {
+      s += float(b0[oq + m * 20u + k]) * float(b1[ok + uint(n) * 20u + k]);
+    }
+    float mx = max(maxv, s);
+    float scale = exp(maxv - mx);
+    float w = exp(s - mx);
+    sum = sum * scale + w;
+    acc = acc * scale + w * float(b3[ov + uint(n) * 20u + d]);
+    maxv = mx;
+  }
+  float y = sum > 0.0f ? acc / sum : 0.0f;
+  uint i = tgid.z * 380u + m * 20u + d;
+  b4[i] = half(y);
+}
+
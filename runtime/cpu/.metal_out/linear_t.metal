@@ -0,0 +1,132 @@
+// BW++ Metal output stub
+// bwpp.meta: ops=2 reversible_regions=0
+// bwpp.meta: reversible_policy=auto
+// bwpp.meta: kernel=matmul_f16
+// bwpp.meta: layout=row_major
+// bwpp.meta: block=128,128,32
+// bwpp.meta: problem=1,37,45,29
+// bwpp.meta: grid=1,1,1
+// bwpp.meta: tile=16,16,16
+// bwpp.meta: epilogue=silu
+// bwpp.meta: params=M,N,K,lda,ldb,ldc
+
+#include <metal_stdlib>
+using namespace metal;
+
+#define TILE_M 16
+#define TILE_N 16
+#define TILE_K 16
+
+#define BWPP_BLOCK_M 128
+#define BWPP_BLOCK_N 128
+#define BWPP_BLOCK_K 32
+
+#define BWPP_EPILOGUE_ADD 0
+#define BWPP_EPILOGUE_SILU 1
+
+struct BwppMatmulParams {
+  uint M;
+  uint N;
+  uint K;
+  uint lda;
+  uint ldb;
+  uint ldc;
+};
+
+inline float bwpp_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+kernel void bwpp_matmul_f16(
+    device const half *A [[buffer(0)]],
+    device const half *B [[buffer(1)]],
+    device half *C [[buffer(2)]],
+    constant BwppMatmulParams &p [[buffer(3)]],
+    device const half *Bias [[buffer(4)]],
+    uint2 tid [[thread_position_in_threadgroup]],
+    uint2 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup half As[TILE_M][TILE_K];
+  threadgroup half Bs[TILE_K][TILE_N];
+  uint row = tgid.y * TILE_M + tid.y;
+  uint col = tgid.x * TILE_N + tid.x;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < p.K; k0 += TILE_K) {
+    uint a_col = k0 + tid.x;
+    if (row < p.M && a_col < p.K) {
+      As[tid.y][tid.x] = A[row * p.lda + a_col];
+    } else {
+      As[tid.y][tid.x] = half(0.0f);
+    }
+    uint b_row = k0 + tid.y;
+    if (b_row < p.K && col < p.N) {
+      Bs[tid.y][tid.x] = B[b_row * p.ldb + col];
+    } else {
+      Bs[tid.y][tid.x] = half(0.0f);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < TILE_K; ++k) {
+      acc += float(As[tid.y][k]) * float(Bs[k][tid.x]);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < p.M && col < p.N) {
+    float out = acc;
+#if BWPP_EPILOGUE_ADD
+    out += float(Bias[col]);
+#endif
+#if BWPP_EPILOGUE_SILU
+    out = bwpp_silu(out);
+#endif
+    C[row * p.ldc + col] = half(out);
+  }
+}
+
+// bwpp.meta: region_kernels=1
+// bwpp.schedule: dispatches=1 kernels=1 slab_bytes=3392
+// bwpp.schedule: dispatch=0 kernel=bwpp_k0_matmul nodes=0,1 grid=3,3,1 threadgroup=16,16,1 buffers=v0:input,v1:input,v3:slab+0
+
+inline float bwpp_region_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+inline float bwpp_region_silu_grad(float x, float dy) {
+  float s = 1.0f / (1.0f + exp(-x));
+  return dy * s * (1.0f + x * (1.0f - s));
+}
+
+// bwpp_k0_matmul: matmul nodes=0,1 dispatches=0
+inline float bwpp_k0_matmul_epi(uint i, float x, device const half *b0, device const half *b1) {
+  float t1 = bwpp_region_silu(x);
+  return t1;
+}
+
+kernel void bwpp_k0_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 29u; k0 += 16) {
+    As[tid.y][tid.x] = row < 37u && k0 + tid.x < 29u ? float(A[row * 29u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 29u && col < 45u ? float(B[col * 29u + k0 + tid.y]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 37u && col < 45u) {
+    uint i = tgid.z * 1665u + row * 45u + col;
+    b2[i] = half(bwpp_k0_matmul_epi(i, acc, b0, b1));
+  }
+}
+
@@ -0,0 +1,222 @@
+/* BW++ C output: C11 + SIMD intrinsics, shapes baked in.
+   Build: cc -std=c11 -O3 -march=native -shared -fPIC <this.c> -o <lib.so> -lm */
+/* bwpp.meta: ops=3 reversible_regions=0 */
+/* bwpp.meta: kernel=matmul_f32 */
+/* bwpp.meta: block=128,128,32 */
+/* bwpp.meta: problem=1,7,45,45 */
+/* bwpp.plan: 0=load role=1 */
+/* bwpp.plan: 1=load role=2 */
+/* bwpp.plan: 2=matmul role=3 */
+/* bwpp.plan: 3=store role=3 */
+/* bwpp.meta: aux_kernel=softmax_f32 */
+/* bwpp.meta: aux_kernel=rmsnorm_f32 */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define BWPP_SIMD "avx512"
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define BWPP_SIMD "avx2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BWPP_SIMD "neon"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BWPP_SIMD "sse2"
+#else
+#define BWPP_SIMD "scalar"
+#endif
+
+#if defined(__GNUC__)
+#define BWPP_EXPORT __attribute__((visibility("default")))
+#else
+#define BWPP_EXPORT
+#endif
+
+BWPP_EXPORT const char bwpp_simd[] = BWPP_SIMD;
+
+/* y += a * x */
+static inline void bwpp_axpy(float *y, const float *x, float a, uint32_t n) {
+  uint32_t i = 0;
+#if defined(__AVX512F__)
+  __m512 va = _mm512_set1_ps(a);
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+#elif defined(__AVX2__) && defined(__FMA__)
+  __m256 va = _mm256_set1_ps(a);
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  }
+#elif defined(__ARM_NEON)
+  float32x4_t va = vdupq_n_f32(a);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), va, vld1q_f32(x + i)));
+  }
+#elif defined(__SSE2__)
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+static inline float bwpp_dot(const float *a, const float *b, uint32_t n) {
+  uint32_t i = 0;
+  float sum = 0.0f;
+#if defined(__AVX512F__)
+  __m512 acc = _mm512_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+  }
+  sum = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__) && defined(__FMA__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+  }
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+  sum = _mm_cvtss_f32(lo);
+#elif defined(__ARM_NEON)
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (; i + 4 <= n; i += 4) {
+    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) +
+        vgetq_lane_f32(acc, 3);
+#elif defined(__SSE2__)
+  __m128 acc = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+static inline float bwpp_silu(float x) {
+  return x / (1.0f + expf(-x));
+}
+
+#define BWPP_MM_BATCH 1
+#define BWPP_MM_M 7
+#define BWPP_MM_N 45
+#define BWPP_MM_K 45
+#define BWPP_MM_A_STRIDE 0
+#define BWPP_MM_B_STRIDE 0
+#define BWPP_MM_TRANS_A 0
+#define BWPP_MM_TRANS_B 0
+#define BWPP_BLOCK_M 128
+#define BWPP_BLOCK_N 128
+#define BWPP_BLOCK_K 32
+#define BWPP_EPILOGUE_ADD 0
+#define BWPP_EPILOGUE_SILU 0
+
+BWPP_EXPORT const uint32_t bwpp_matmul_shape[6] = {
+  BWPP_MM_BATCH, BWPP_MM_M, BWPP_MM_N, BWPP_MM_K, BWPP_MM_A_STRIDE, BWPP_MM_B_STRIDE
+};
+BWPP_EXPORT const int bwpp_matmul_epilogue[2] = { BWPP_EPILOGUE_ADD, BWPP_EPILOGUE_SILU };
+BWPP_EXPORT const int bwpp_matmul_trans[2] = { BWPP_MM_TRANS_A, BWPP_MM_TRANS_B };
+
+/* C[b] = A[b] @ B[b] (+ Bias, silu); dense row-major, A stored [K, M] when
+   BWPP_MM_TRANS_A and B stored [N, K] when BWPP_MM_TRANS_B, Bias has N entries. */
+BWPP_EXPORT void bwpp_matmul_f32(const float *A, const float *B, float *C, const float *Bias) {
+  (void)Bias;
+  for (uint32_t b = 0; b < BWPP_MM_BATCH; ++b) {
+    const float *a = A + (size_t)b * BWPP_MM_A_STRIDE;
+    const float *bm = B + (size_t)b * BWPP_MM_B_STRIDE;
+    float *c = C + (size_t)b * BWPP_MM_M * BWPP_MM_N;
+    memset(c, 0, sizeof(float) * BWPP_MM_M * BWPP_MM_N);
+    for (uint32_t i0 = 0; i0 < BWPP_MM_M; i0 += BWPP_BLOCK_M) {
+      uint32_t i1 = i0 + BWPP_BLOCK_M < BWPP_MM_M ? i0 + BWPP_BLOCK_M : BWPP_MM_M;
+      for (uint32_t k0 = 0; k0 < BWPP_MM_K; k0 += BWPP_BLOCK_K) {
+        uint32_t k1 = k0 + BWPP_BLOCK_K < BWPP_MM_K ? k0 + BWPP_BLOCK_K : BWPP_MM_K;
+        for (uint32_t j0 = 0; j0 < BWPP_MM_N; j0 += BWPP_BLOCK_N) {
+          uint32_t j1 = j0 + BWPP_BLOCK_N < BWPP_MM_N ? j0 + BWPP_BLOCK_N : BWPP_MM_N;
+          for (uint32_t i = i0; i < i1; ++i) {
+            float *crow = c + (size_t)i * BWPP_MM_N + j0;
+            for (uint32_t k = k0; k < k1; ++k) {
+              bwpp_axpy(crow, bm + (size_t)k * BWPP_MM_N + j0, a[(size_t)i * BWPP_MM_K + k], j1 - j0);
+            }
+          }
+        }
+      }
+#if BWPP_EPILOGUE_ADD || BWPP_EPILOGUE_SILU
+      /* fused epilogue while the block's rows are still in cache */
+      for (uint32_t i = i0; i < i1; ++i) {
+        float *row = c + (size_t)i * BWPP_MM_N;
+#if BWPP_EPILOGUE_ADD
+        bwpp_axpy(row, Bias, 1.0f, BWPP_MM_N);
+#endif
+#if BWPP_EPILOGUE_SILU
+        for (uint32_t j = 0; j < BWPP_MM_N; ++j) {
+          row[j] = bwpp_silu(row[j]);
+        }
+#endif
+      }
+#endif
+    }
+  }
+}
+
+#define BWPP_SOFTMAX_ROWS 7
+#define BWPP_SOFTMAX_COLS 45
+
+BWPP_EXPORT const uint32_t bwpp_softmax_shape[2] = { BWPP_SOFTMAX_ROWS, BWPP_SOFTMAX_COLS };
+
+BWPP_EXPORT void bwpp_softmax_f32(const float *X, float *Y) {
+  for (uint32_t r = 0; r < BWPP_SOFTMAX_ROWS; ++r) {
+    const float *x = X + (size_t)r * BWPP_SOFTMAX_COLS;
+    float *y = Y + (size_t)r * BWPP_SOFTMAX_COLS;
+    float maxv = -INFINITY;
+    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {
+      maxv = x[c] > maxv ? x[c] : maxv;
+    }
+    float sum = 0.0f;
+    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {
+      y[c] = expf(x[c] - maxv);
+      sum += y[c];
+    }
+    float inv = sum > 0.0f ? 1.0f / sum : 0.0f;
+    for (uint32_t c = 0; c < BWPP_SOFTMAX_COLS; ++c) {
+      y[c] *= inv;
+    }
+  }
+}
+
+#define BWPP_RMSNORM_ROWS 7
+#define BWPP_RMSNORM_COLS 45
+#define BWPP_RMSNORM_EPS 9.99999975e-06f
+
+BWPP_EXPORT const uint32_t bwpp_rmsnorm_shape[2] = { BWPP_RMSNORM_ROWS, BWPP_RMSNORM_COLS };
+BWPP_EXPORT const float bwpp_rmsnorm_eps = BWPP_RMSNORM_EPS;
+
+/* Gamma and Beta hold COLS entries each and may be NULL. */
+BWPP_EXPORT void bwpp_rmsnorm_f32(const float *X, const float *Gamma, float *Y, const float *Beta) {
+  for (uint32_t r = 0; r < BWPP_RMSNORM_ROWS; ++r) {
+    const float *x = X + (size_t)r * BWPP_RMSNORM_COLS;
+    float *y = Y + (size_t)r * BWPP_RMSNORM_COLS;
+    float sumsq = bwpp_dot(x, x, BWPP_RMSNORM_COLS);
+    float inv = 1.0f / sqrtf(sumsq / (float)BWPP_RMSNORM_COLS + BWPP_RMSNORM_EPS);
+    for (uint32_t c = 0; c < BWPP_RMSNORM_COLS; ++c) {
+      float g = Gamma ? Gamma[c] : 1.0f;
+      float b = Beta ? Beta[c] : 0.0f;
+      y[c] = x[c] * inv * g + b;
+    }
+  }
+}
@@ -0,0 +1,254 @@
+// BW++ Metal output stub
+// bwpp.meta: ops=3 reversible_regions=0
+// bwpp.meta: reversible_policy=auto
+// bwpp.meta: kernel=matmul_f16
+// bwpp.meta: layout=row_major
+// bwpp.meta: block=128,128,32
+// bwpp.meta: problem=1,7,45,45
+// bwpp.meta: grid=1,1,1
+// bwpp.meta: tile=16,16,16
+// bwpp.meta: params=M,N,K,lda,ldb,ldc
+
+// bwpp.meta: aux_kernel=softmax_f16
+// bwpp.meta: aux_kernel=rmsnorm_f16
+#include <metal_stdlib>
+using namespace metal;
+
+#define TILE_M 16
+#define TILE_N 16
+#define TILE_K 16
+
+#define BWPP_BLOCK_M 128
+#define BWPP_BLOCK_N 128
+#define BWPP_BLOCK_K 32
+
+#define BWPP_EPILOGUE_ADD 0
+#define BWPP_EPILOGUE_SILU 0
+
+struct BwppMatmulParams {
+  uint M;
+  uint N;
+  uint K;
+  uint lda;
+  uint ldb;
+  uint ldc;
+};
+
+inline float bwpp_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+kernel void bwpp_matmul_f16(
+    device const half *A [[buffer(0)]],
+    device const half *B [[buffer(1)]],
+    device half *C [[buffer(2)]],
+    constant BwppMatmulParams &p [[buffer(3)]],
+    device const half *Bias [[buffer(4)]],
+    uint2 tid [[thread_position_in_threadgroup]],
+    uint2 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup half As[TILE_M][TILE_K];
+  threadgroup half Bs[TILE_K][TILE_N];
+  uint row = tgid.y * TILE_M + tid.y;
+  uint col = tgid.x * TILE_N + tid.x;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < p.K; k0 += TILE_K) {
+    uint a_col = k0 + tid.x;
+    if (row < p.M && a_col < p.K) {
+      As[tid.y][tid.x] = A[row * p.lda + a_col];
+    } else {
+      As[tid.y][tid.x] = half(0.0f);
+    }
+    uint b_row = k0 + tid.y;
+    if (b_row < p.K && col < p.N) {
+      Bs[tid.y][tid.x] = B[b_row * p.ldb + col];
+    } else {
+      Bs[tid.y][tid.x] = half(0.0f);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < TILE_K; ++k) {
+      acc += float(As[tid.y][k]) * float(Bs[k][tid.x]);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < p.M && col < p.N) {
+    float out = acc;
+#if BWPP_EPILOGUE_ADD
+    out += float(Bias[col]);
+#endif
+#if BWPP_EPILOGUE_SILU
+    out = bwpp_silu(out);
+#endif
+    C[row * p.ldc + col] = half(out);
+  }
+}
+
+#define BWPP_SOFTMAX_TILE 128
+
+struct BwppSoftmaxParams {
+  uint rows;
+  uint cols;
+  uint ld;
+};
+
+kernel void bwpp_softmax_f16(
+    device const half *X [[buffer(0)]],
+    device half *Y [[buffer(1)]],
+    constant BwppSoftmaxParams &p [[buffer(2)]],
+    uint gid [[thread_position_in_grid]]) {
+  uint row = gid;
+  if (row >= p.rows) { return; }
+  float maxv = -INFINITY;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]);
+      maxv = max(maxv, v);
+    }
+  }
+  float sum = 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float e = exp(float(X[row * p.ld + c]) - maxv);
+      Y[row * p.ld + c] = half(e);
+      sum += e;
+    }
+  }
+  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      Y[row * p.ld + c] = half(float(Y[row * p.ld + c]) * inv);
+    }
+  }
+}
+
+#define BWPP_RMSNORM_TILE 128
+
+struct BwppRmsnormParams {
+  uint rows;
+  uint cols;
+  uint ld;
+  float eps;
+};
+
+kernel void bwpp_rmsnorm_f16(
+    device const half *X [[buffer(0)]],
+    device const half *Gamma [[buffer(1)]],
+    device half *Y [[buffer(2)]],
+    constant BwppRmsnormParams &p [[buffer(3)]],
+    device const half *Beta [[buffer(4)]],
+    uint gid [[thread_position_in_grid]]) {
+  uint row = gid;
+  if (row >= p.rows) { return; }
+  float sumsq = 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_RMSNORM_TILE) {
+    uint cmax = min(c0 + BWPP_RMSNORM_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]);
+      sumsq += v * v;
+    }
+  }
+  float inv = rsqrt(sumsq / float(p.cols) + p.eps);
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_RMSNORM_TILE) {
+    uint cmax = min(c0 + BWPP_RMSNORM_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]) * inv;
+      float g = Gamma ? float(Gamma[c]) : 1.0f;
+      float b = Beta ? float(Beta[c]) : 0.0f;
+      Y[row * p.ld + c] = half(v * g + b);
+    }
+  }
+}
+
+// bwpp.meta: region_kernels=3
+// bwpp.schedule: dispatches=3 kernels=3 slab_bytes=1280
+// bwpp.schedule: dispatch=0 kernel=bwpp_k0_matmul nodes=0 grid=3,1,1 threadgroup=16,16,1 buffers=v0:input,v1:input,v3:slab+0
+// bwpp.schedule: dispatch=1 kernel=bwpp_k1_reduction nodes=1 grid=1,1,1 threadgroup=64,1,1 buffers=v3:slab+0,v4:slab+640
+// bwpp.schedule: dispatch=2 kernel=bwpp_k2_reduction nodes=2 grid=1,1,1 threadgroup=64,1,1 buffers=v4:slab+640,v2:input,v5:slab+0
+
+inline float bwpp_region_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+inline float bwpp_region_silu_grad(float x, float dy) {
+  float s = 1.0f / (1.0f + exp(-x));
+  return dy * s * (1.0f + x * (1.0f - s));
+}
+
+// bwpp_k0_matmul: matmul nodes=0 dispatches=0
+kernel void bwpp_k0_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 45u; k0 += 16) {
+    As[tid.y][tid.x] = row < 7u && k0 + tid.x < 45u ? float(A[row * 45u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 45u && col < 45u ? float(B[(k0 + tid.y) * 45u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 7u && col < 45u) {
+    uint i = tgid.z * 315u + row * 45u + col;
+    b2[i] = half(acc);
+  }
+}
+
+// bwpp_k1_reduction: reduction nodes=1 dispatches=1
+kernel void bwpp_k1_reduction(
+    device const half *b0 [[buffer(0)]],
+    device half *b1 [[buffer(1)]],
+    uint gid [[thread_position_in_grid]]) {
+  if (gid >= 7u) { return; }
+  uint base = gid * 45u;
+  int lim = 45;
+  float maxv = -INFINITY;
+  for (int c = 0; c < lim; ++c) {
+    maxv = max(maxv, float(b0[base + uint(c)]));
+  }
+  float sum = 0.0f;
+  for (int c = 0; c < lim; ++c) {
+    sum += exp(float(b0[base + uint(c)]) - maxv);
+  }
+  float inv = sum > 0.0f ? 1.0f / sum : 0.0f;
+  for (uint c = 0; c < 45u; ++c) {
+    uint i = base + c;
+    float y = int(c) < lim ? exp(float(b0[i]) - maxv) * inv : 0.0f;
+    b1[i] = half(y);
+  }
+}
+
+// bwpp_k2_reduction: reduction nodes=2 dispatches=2
+kernel void bwpp_k2_reduction(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint gid [[thread_position_in_grid]]) {
+  if (gid >= 7u) { return; }
+  uint base = gid * 45u;
+  float sumsq = 0.0f;
+  for (uint c = 0; c < 45u; ++c) {
+    float v = float(b0[base + c]);
+    sumsq += v * v;
+  }
+  float inv = 1.0f / sqrt(sumsq / 45.0f + 9.999999747e-06f);
+  for (uint c = 0; c < 45u; ++c) {
+    uint i = base + c;
+    float y = float(b0[i]) * inv * float(b1[c]);
+    b2[i] = half(y);
+  }
+}
+
@@ -0,0 +1,236 @@
+// BW++ Metal output stub
+// bwpp.meta: ops=10 reversible_regions=2
+// bwpp.meta: reversible_policy=auto
+// bwpp.meta: region=0 kind=reversible policy=auto
+// bwpp.meta: region=1 kind=reversible policy=auto
+// bwpp.meta: kernel=matmul_f16
+// bwpp.meta: layout=row_major
+// bwpp.meta: block=128,128,32
+// bwpp.meta: problem=1,128,256,64
+// bwpp.meta: grid=2,1,1
+// bwpp.meta: tile=16,16,16
+// bwpp.meta: epilogue=silu
+// bwpp.meta: params=M,N,K,lda,ldb,ldc
+
+// bwpp.meta: aux_kernel=rmsnorm_f16
+#include <metal_stdlib>
+using namespace metal;
+
+#define TILE_M 16
+#define TILE_N 16
+#define TILE_K 16
+
+#define BWPP_BLOCK_M 128
+#define BWPP_BLOCK_N 128
+#define BWPP_BLOCK_K 32
+
+#define BWPP_EPILOGUE_ADD 0
+#define BWPP_EPILOGUE_SILU 1
+
+struct BwppMatmulParams {
+  uint M;
+  uint N;
+  uint K;
+  uint lda;
+  uint ldb;
+  uint ldc;
+};
+
+inline float bwpp_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+kernel void bwpp_matmul_f16(
+    device const half *A [[buffer(0)]],
+    device const half *B [[buffer(1)]],
+    device half *C [[buffer(2)]],
+    constant BwppMatmulParams &p [[buffer(3)]],
+    device const half *Bias [[buffer(4)]],
+    uint2 tid [[thread_position_in_threadgroup]],
+    uint2 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup half As[TILE_M][TILE_K];
+  threadgroup half Bs[TILE_K][TILE_N];
+  uint row = tgid.y * TILE_M + tid.y;
+  uint col = tgid.x * TILE_N + tid.x;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < p.K; k0 += TILE_K) {
+    uint a_col = k0 + tid.x;
+    if (row < p.M && a_col < p.K) {
+      As[tid.y][tid.x] = A[row * p.lda + a_col];
+    } else {
+      As[tid.y][tid.x] = half(0.0f);
+    }
+    uint b_row = k0 + tid.y;
+    if (b_row < p.K && col < p.N) {
+      Bs[tid.y][tid.x] = B[b_row * p.ldb + col];
+    } else {
+      Bs[tid.y][tid.x] = half(0.0f);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < TILE_K; ++k) {
+      acc += float(As[tid.y][k]) * float(Bs[k][tid.x]);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < p.M && col < p.N) {
+    float out = acc;
+#if BWPP_EPILOGUE_ADD
+    out += float(Bias[col]);
+#endif
+#if BWPP_EPILOGUE_SILU
+    out = bwpp_silu(out);
+#endif
+    C[row * p.ldc + col] = half(out);
+  }
+}
+
+#define BWPP_RMSNORM_TILE 128
+
+struct BwppRmsnormParams {
+  uint rows;
+  uint cols;
+  uint ld;
+  float eps;
+};
+
+kernel void bwpp_rmsnorm_f16(
+    device const half *X [[buffer(0)]],
+    device const half *Gamma [[buffer(1)]],
+    device half *Y [[buffer(2)]],
+    constant BwppRmsnormParams &p [[buffer(3)]],
+    device const half *Beta [[buffer(4)]],
+    uint gid [[thread_position_in_grid]]) {
+  uint row = gid;
+  if (row >= p.rows) { return; }
+  float sumsq = 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_RMSNORM_TILE) {
+    uint cmax = min(c0 + BWPP_RMSNORM_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]);
+      sumsq += v * v;
+    }
+  }
+  float inv = rsqrt(sumsq / float(p.cols) + p.eps);
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_RMSNORM_TILE) {
+    uint cmax = min(c0 + BWPP_RMSNORM_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]) * inv;
+      float g = Gamma ? float(Gamma[c]) : 1.0f;
+      float b = Beta ? float(Beta[c]) : 0.0f;
+      Y[row * p.ld + c] = half(v * g + b);
+    }
+  }
+}
+
+// bwpp.meta: region_kernels=3
+// bwpp.schedule: dispatches=6 kernels=3 slab_bytes=98304
+// bwpp.schedule: dispatch=0 kernel=bwpp_k0_reduction nodes=0 grid=2,1,1 threadgroup=64,1,1 buffers=v0:input,v3:input,v7:slab+65536
+// bwpp.schedule: dispatch=1 kernel=bwpp_k1_matmul nodes=1,2 grid=16,8,1 threadgroup=16,16,1 buffers=v7:slab+65536,v1:input,v9:slab+0
+// bwpp.schedule: dispatch=2 kernel=bwpp_k2_matmul nodes=3,4 grid=4,8,1 threadgroup=16,16,1 buffers=v9:slab+0,v2:input,v0:input,v11:slab+65536
+// bwpp.schedule: dispatch=3 kernel=bwpp_k0_reduction nodes=5 grid=2,1,1 threadgroup=64,1,1 buffers=v11:slab+65536,v6:input,v12:slab+81920
+// bwpp.schedule: dispatch=4 kernel=bwpp_k1_matmul nodes=6,7 grid=16,8,1 threadgroup=16,16,1 buffers=v12:slab+81920,v4:input,v14:slab+0
+// bwpp.schedule: dispatch=5 kernel=bwpp_k2_matmul nodes=8,9 grid=4,8,1 threadgroup=16,16,1 buffers=v14:slab+0,v5:input,v11:slab+65536,v16:slab+81920
+
+inline float bwpp_region_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+inline float bwpp_region_silu_grad(float x, float dy) {
+  float s = 1.0f / (1.0f + exp(-x));
+  return dy * s * (1.0f + x * (1.0f - s));
+}
+
+// bwpp_k0_reduction: reduction nodes=0 dispatches=0,3
+kernel void bwpp_k0_reduction(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint gid [[thread_position_in_grid]]) {
+  if (gid >= 128u) { return; }
+  uint base = gid * 64u;
+  float sumsq = 0.0f;
+  for (uint c = 0; c < 64u; ++c) {
+    float v = float(b0[base + c]);
+    sumsq += v * v;
+  }
+  float inv = 1.0f / sqrt(sumsq / 64.0f + 9.999999747e-06f);
+  for (uint c = 0; c < 64u; ++c) {
+    uint i = base + c;
+    float y = float(b0[i]) * inv * float(b1[c]);
+    b2[i] = half(y);
+  }
+}
+
+// bwpp_k1_matmul: matmul nodes=1,2 dispatches=1,4
+inline float bwpp_k1_matmul_epi(uint i, float x, device const half *b0, device const half *b1) {
+  float t1 = bwpp_region_silu(x);
+  return t1;
+}
+
+kernel void bwpp_k1_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 64u; k0 += 16) {
+    As[tid.y][tid.x] = row < 128u && k0 + tid.x < 64u ? float(A[row * 64u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 64u && col < 256u ? float(B[(k0 + tid.y) * 256u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 128u && col < 256u) {
+    uint i = tgid.z * 32768u + row * 256u + col;
+    b2[i] = half(bwpp_k1_matmul_epi(i, acc, b0, b1));
+  }
+}
+
+// bwpp_k2_matmul: matmul nodes=3,4 dispatches=2,5
+inline float bwpp_k2_matmul_epi(uint i, float x, device const half *b0, device const half *b1, device const half *b2) {
+  float t1 = float(b2[i]) + x;
+  return t1;
+}
+
+kernel void bwpp_k2_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device const half *b2 [[buffer(2)]],
+    device half *b3 [[buffer(3)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 256u; k0 += 16) {
+    As[tid.y][tid.x] = row < 128u && k0 + tid.x < 256u ? float(A[row * 256u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 256u && col < 64u ? float(B[(k0 + tid.y) * 64u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 128u && col < 64u) {
+    uint i = tgid.z * 8192u + row * 64u + col;
+    b3[i] = half(bwpp_k2_matmul_epi(i, acc, b0, b1, b2));
+  }
+}
+
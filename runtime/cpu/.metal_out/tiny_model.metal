@@ -0,0 +1,550 @@
+// BW++ Metal output stub
+// bwpp.meta: ops=30 reversible_regions=0
+// bwpp.meta: reversible_policy=auto
+// bwpp.meta: kernel=attention_f16
+// bwpp.meta: attention_plan=tile_ir_stub
+// bwpp.meta: fused_attention_candidate=1
+// bwpp.meta: attention_mask=none
+// bwpp.meta: attention_heads=mha
+// bwpp.meta: layout=row_major
+// bwpp.meta: block=128,128,32
+// bwpp.meta: problem=1,64,64,32
+// bwpp.meta: grid=1,1,1
+// bwpp.meta: tile=16,16,16
+// bwpp.meta: params=M,N,K,D,ldq,ldk,ldv,ldo,batch,heads,kv_heads,causal,kv_rows
+
+// bwpp.plan: 0=load role=1
+// bwpp.plan: 1=load role=2
+// bwpp.plan: 2=matmul role=3
+// bwpp.plan: 3=softmax role=3
+// bwpp.plan: 4=load role=2
+// bwpp.plan: 5=matmul role=3
+// bwpp.plan: 6=store role=3
+
+// bwpp.meta: aux_kernel=softmax_f16
+// bwpp.meta: aux_kernel=rmsnorm_f16
+#include <metal_stdlib>
+using namespace metal;
+
+#define TILE_M 16
+#define TILE_N 16
+#define TILE_K 16
+
+#define BWPP_ATT_TILE_M TILE_M
+#define BWPP_ATT_TILE_N TILE_N
+#define BWPP_ATT_TILE_K TILE_K
+#ifndef BWPP_FAST_MATH
+#define BWPP_FAST_MATH 1
+#endif
+#if BWPP_FAST_MATH
+#define BWPP_EXP(x) fast::exp(x)
+#else
+#define BWPP_EXP(x) exp(x)
+#endif
+#define BWPP_ATT_CAUSAL 0
+#define BWPP_ATT_KV_LEN 0
+
+struct BwppAttentionParams {
+  uint M;
+  uint N;
+  uint K;
+  uint D;
+  uint ldq;
+  uint ldk;
+  uint ldv;
+  uint ldo;
+  uint batch;
+  uint heads;
+  uint kv_heads;
+  uint causal;
+  uint kv_rows;
+};
+
+kernel void bwpp_attention_f16(
+    device const half *Q [[buffer(0)]],
+    device const half *K [[buffer(1)]],
+    device const half *V [[buffer(2)]],
+    device half *O [[buffer(3)]],
+    constant BwppAttentionParams &p [[buffer(4)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  const uint tile = BWPP_ATT_TILE_M;
+  uint heads = p.heads ? p.heads : 1;
+  uint kv_heads = p.kv_heads ? p.kv_heads : heads;
+  uint group = heads / kv_heads;
+  uint b = tgid.z / heads;
+  uint h = tgid.z % heads;
+  uint kvh = h / group;
+  device const half *Qh = Q + (b * heads + h) * p.M * p.ldq;
+  device half *Oh = O + (b * heads + h) * p.M * p.ldo;
+  uint kv_rows = max(p.kv_rows, p.N);
+  device const half *Kh = K + (b * kv_heads + kvh) * kv_rows * p.ldk;
+  device const half *Vh = V + (b * kv_heads + kvh) * kv_rows * p.ldv;
+  uint n_len = p.N;
+#if BWPP_ATT_KV_LEN
+  n_len = min(p.N, KvLen[b]);
+#endif
+  bool causal = BWPP_ATT_CAUSAL || p.causal != 0;
+  int offset = int(n_len) - int(p.M);
+  uint n_end = n_len;
+  if (causal) {
+    // keys past the tile's last visible column are skipped as whole blocks
+    int lim = int(min(tgid.y * tile + tile, p.M)) + offset;
+    n_end = lim <= 0 ? 0 : min(n_len, uint(lim));
+  }
+  uint m = tgid.y * tile + tid.y;
+  uint d = tgid.x * tile + tid.x;
+  if (m >= p.M || d >= p.D) { return; }
+  threadgroup half Qtg[BWPP_ATT_TILE_M][BWPP_ATT_TILE_K];
+  threadgroup half Ktg[BWPP_ATT_TILE_N][BWPP_ATT_TILE_K];
+  threadgroup half Vtg0[BWPP_ATT_TILE_N][BWPP_ATT_TILE_M];
+  threadgroup half Vtg1[BWPP_ATT_TILE_N][BWPP_ATT_TILE_M];
+  threadgroup half (*Vcur)[BWPP_ATT_TILE_M] = Vtg0;
+  threadgroup half (*Vnext)[BWPP_ATT_TILE_M] = Vtg1;
+  threadgroup float Scores[BWPP_ATT_TILE_M][BWPP_ATT_TILE_N];
+  float maxv = -INFINITY;
+  float sum = 0.0f;
+  float out = 0.0f;
+  uint vd0 = tgid.x * tile + tid.x;
+  uint vn0 = tid.y;
+  if (vn0 < n_end && vd0 < p.D) {
+    Vcur[tid.y][tid.x] = Vh[vn0 * p.ldv + vd0];
+  } else {
+    Vcur[tid.y][tid.x] = half(0.0f);
+  }
+  threadgroup_barrier(mem_flags::mem_threadgroup);
+  for (uint n0 = 0; n0 < n_end; n0 += tile) {
+    if (tid.x == 0) {
+      for (uint i = 0; i < BWPP_ATT_TILE_N; ++i) { Scores[tid.y][i] = 0.0f; }
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k0 = 0; k0 < p.K; k0 += tile) {
+      uint qk = k0 + tid.x;
+      if (m < p.M && qk < p.K) {
+        Qtg[tid.y][tid.x] = Qh[m * p.ldq + qk];
+      } else {
+        Qtg[tid.y][tid.x] = half(0.0f);
+      }
+      uint nk = n0 + tid.y;
+      if (nk < n_end && qk < p.K) {
+        Ktg[tid.y][tid.x] = Kh[nk * p.ldk + qk];
+      } else {
+        Ktg[tid.y][tid.x] = half(0.0f);
+      }
+      threadgroup_barrier(mem_flags::mem_threadgroup);
+      if (tid.x == 0) {
+        float qrow[BWPP_ATT_TILE_K];
+        for (uint kk = 0; kk < tile; ++kk) { qrow[kk] = float(Qtg[tid.y][kk]); }
+        for (uint n = 0; n < tile; ++n) {
+          float acc = 0.0f;
+          uint kk = 0;
+          for (; kk + 1 < tile; kk += 2) {
+            float2 q2 = float2(qrow[kk], qrow[kk + 1]);
+            float2 k2 = float2(Ktg[n][kk], Ktg[n][kk + 1]);
+            acc += q2.x * k2.x + q2.y * k2.y;
+          }
+          if (kk < tile) { acc += qrow[kk] * float(Ktg[n][kk]); }
+          Scores[tid.y][n] += acc;
+        }
+      }
+      threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+    uint next_n0 = n0 + tile;
+    if (next_n0 < n_end) {
+      uint vn = next_n0 + tid.y;
+      if (vn < n_end && vd0 < p.D) {
+        Vnext[tid.y][tid.x] = Vh[vn * p.ldv + vd0];
+      } else {
+        Vnext[tid.y][tid.x] = half(0.0f);
+      }
+    } else {
+      Vnext[tid.y][tid.x] = half(0.0f);
+    }
+    for (uint n = 0; n < tile; ++n) {
+      uint idx = n0 + n;
+      if (idx >= n_end) { continue; }
+      if (causal && int(idx) > int(m) + offset) { continue; }
+      float score = Scores[tid.y][n];
+      if (score > maxv) {
+        float scale = BWPP_EXP(maxv - score);
+        out = out * scale + float(Vcur[n][tid.x]);
+        sum = sum * scale + 1.0f;
+        maxv = score;
+      } else {
+        float w = BWPP_EXP(score - maxv);
+        out += w * float(Vcur[n][tid.x]);
+        sum += w;
+      }
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    threadgroup half (*Vtmp)[BWPP_ATT_TILE_M] = Vcur;
+    Vcur = Vnext;
+    Vnext = Vtmp;
+  }
+  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+  Oh[m * p.ldo + d] = half(out * inv);
+}
+
+#define BWPP_SOFTMAX_TILE 128
+
+struct BwppSoftmaxParams {
+  uint rows;
+  uint cols;
+  uint ld;
+};
+
+kernel void bwpp_softmax_f16(
+    device const half *X [[buffer(0)]],
+    device half *Y [[buffer(1)]],
+    constant BwppSoftmaxParams &p [[buffer(2)]],
+    uint gid [[thread_position_in_grid]]) {
+  uint row = gid;
+  if (row >= p.rows) { return; }
+  float maxv = -INFINITY;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]);
+      maxv = max(maxv, v);
+    }
+  }
+  float sum = 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float e = exp(float(X[row * p.ld + c]) - maxv);
+      Y[row * p.ld + c] = half(e);
+      sum += e;
+    }
+  }
+  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_SOFTMAX_TILE) {
+    uint cmax = min(c0 + BWPP_SOFTMAX_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      Y[row * p.ld + c] = half(float(Y[row * p.ld + c]) * inv);
+    }
+  }
+}
+
+#define BWPP_RMSNORM_TILE 128
+
+struct BwppRmsnormParams {
+  uint rows;
+  uint cols;
+  uint ld;
+  float eps;
+};
+
+kernel void bwpp_rmsnorm_f16(
+    device const half *X [[buffer(0)]],
+    device const half *Gamma [[buffer(1)]],
+    device half *Y [[buffer(2)]],
+    constant BwppRmsnormParams &p [[buffer(3)]],
+    device const half *Beta [[buffer(4)]],
+    uint gid [[thread_position_in_grid]]) {
+  uint row = gid;
+  if (row >= p.rows) { return; }
+  float sumsq = 0.0f;
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_RMSNORM_TILE) {
+    uint cmax = min(c0 + BWPP_RMSNORM_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]);
+      sumsq += v * v;
+    }
+  }
+  float inv = rsqrt(sumsq / float(p.cols) + p.eps);
+  for (uint c0 = 0; c0 < p.cols; c0 += BWPP_RMSNORM_TILE) {
+    uint cmax = min(c0 + BWPP_RMSNORM_TILE, p.cols);
+    for (uint c = c0; c < cmax; ++c) {
+      float v = float(X[row * p.ld + c]) * inv;
+      float g = Gamma ? float(Gamma[c]) : 1.0f;
+      float b = Beta ? float(Beta[c]) : 0.0f;
+      Y[row * p.ld + c] = half(v * g + b);
+    }
+  }
+}
+
+// bwpp.meta: region_kernels=8
+// bwpp.schedule: dispatches=20 kernels=8 slab_bytes=20480
+// bwpp.schedule: dispatch=0 kernel=bwpp_k0_reduction nodes=0 grid=1,1,1 threadgroup=64,1,1 buffers=v0:input,v7:input,v18:slab+0
+// bwpp.schedule: dispatch=1 kernel=bwpp_k1_matmul nodes=1 grid=2,4,1 threadgroup=16,16,1 buffers=v18:slab+0,v1:input,v19:slab+4096
+// bwpp.schedule: dispatch=2 kernel=bwpp_k1_matmul nodes=2 grid=2,4,1 threadgroup=16,16,1 buffers=v18:slab+0,v2:input,v20:slab+8192
+// bwpp.schedule: dispatch=3 kernel=bwpp_k1_matmul nodes=3 grid=2,4,1 threadgroup=16,16,1 buffers=v18:slab+0,v3:input,v21:slab+12288
+// bwpp.schedule: dispatch=4 kernel=bwpp_k2_attention nodes=4,5,6 grid=2,4,1 threadgroup=16,16,1 buffers=v19:slab+4096,v20:slab+8192,v21:slab+12288,v24:slab+0
+// bwpp.schedule: dispatch=5 kernel=bwpp_k3_matmul nodes=7,8 grid=2,4,1 threadgroup=16,16,1 buffers=v24:slab+0,v4:input,v0:input,v26:slab+8192
+// bwpp.schedule: dispatch=6 kernel=bwpp_k0_reduction nodes=9 grid=1,1,1 threadgroup=64,1,1 buffers=v26:slab+8192,v8:input,v27:slab+12288
+// bwpp.schedule: dispatch=7 kernel=bwpp_k4_matmul nodes=10,11 grid=4,4,1 threadgroup=16,16,1 buffers=v27:slab+12288,v5:input,v29:slab+0
+// bwpp.schedule: dispatch=8 kernel=bwpp_k5_matmul nodes=12,13 grid=2,4,1 threadgroup=16,16,1 buffers=v29:slab+0,v6:input,v26:slab+8192,v31:slab+12288
+// bwpp.schedule: dispatch=9 kernel=bwpp_k0_reduction nodes=14 grid=1,1,1 threadgroup=64,1,1 buffers=v31:slab+12288,v15:input,v32:slab+0
+// bwpp.schedule: dispatch=10 kernel=bwpp_k1_matmul nodes=15 grid=2,4,1 threadgroup=16,16,1 buffers=v32:slab+0,v9:input,v33:slab+4096
+// bwpp.schedule: dispatch=11 kernel=bwpp_k1_matmul nodes=16 grid=2,4,1 threadgroup=16,16,1 buffers=v32:slab+0,v10:input,v34:slab+8192
+// bwpp.schedule: dispatch=12 kernel=bwpp_k1_matmul nodes=17 grid=2,4,1 threadgroup=16,16,1 buffers=v32:slab+0,v11:input,v35:slab+16384
+// bwpp.schedule: dispatch=13 kernel=bwpp_k2_attention nodes=18,19,20 grid=2,4,1 threadgroup=16,16,1 buffers=v33:slab+4096,v34:slab+8192,v35:slab+16384,v38:slab+0
+// bwpp.schedule: dispatch=14 kernel=bwpp_k3_matmul nodes=21,22 grid=2,4,1 threadgroup=16,16,1 buffers=v38:slab+0,v12:input,v31:slab+12288,v40:slab+8192
+// bwpp.schedule: dispatch=15 kernel=bwpp_k0_reduction nodes=23 grid=1,1,1 threadgroup=64,1,1 buffers=v40:slab+8192,v16:input,v41:slab+12288
+// bwpp.schedule: dispatch=16 kernel=bwpp_k4_matmul nodes=24,25 grid=4,4,1 threadgroup=16,16,1 buffers=v41:slab+12288,v13:input,v43:slab+0
+// bwpp.schedule: dispatch=17 kernel=bwpp_k5_matmul nodes=26,27 grid=2,4,1 threadgroup=16,16,1 buffers=v43:slab+0,v14:input,v40:slab+8192,v45:slab+12288
+// bwpp.schedule: dispatch=18 kernel=bwpp_k6_matmul nodes=28 grid=4,4,1 threadgroup=16,16,1 buffers=v45:slab+12288,v17:input,v46:slab+0
+// bwpp.schedule: dispatch=19 kernel=bwpp_k7_reduction nodes=29 grid=1,1,1 threadgroup=64,1,1 buffers=v46:slab+0,v47:slab+6400
+
+inline float bwpp_region_silu(float x) {
+  return x / (1.0f + exp(-x));
+}
+
+inline float bwpp_region_silu_grad(float x, float dy) {
+  float s = 1.0f / (1.0f + exp(-x));
+  return dy * s * (1.0f + x * (1.0f - s));
+}
+
+// bwpp_k0_reduction: reduction nodes=0 dispatches=0,6,9,15
+kernel void bwpp_k0_reduction(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint gid [[thread_position_in_grid]]) {
+  if (gid >= 64u) { return; }
+  uint base = gid * 32u;
+  float sumsq = 0.0f;
+  for (uint c = 0; c < 32u; ++c) {
+    float v = float(b0[base + c]);
+    sumsq += v * v;
+  }
+  float inv = 1.0f / sqrt(sumsq / 32.0f + 9.999999747e-06f);
+  for (uint c = 0; c < 32u; ++c) {
+    uint i = base + c;
+    float y = float(b0[i]) * inv * float(b1[c]);
+    b2[i] = half(y);
+  }
+}
+
+// bwpp_k1_matmul: matmul nodes=1 dispatches=1,2,3,10,11,12
+kernel void bwpp_k1_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 32u; k0 += 16) {
+    As[tid.y][tid.x] = row < 64u && k0 + tid.x < 32u ? float(A[row * 32u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 32u && col < 32u ? float(B[(k0 + tid.y) * 32u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 64u && col < 32u) {
+    uint i = tgid.z * 2048u + row * 32u + col;
+    b2[i] = half(acc);
+  }
+}
+
+// bwpp_k2_attention: attention nodes=4,5,6 dispatches=4,13
+kernel void bwpp_k2_attention(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device const half *b2 [[buffer(2)]],
+    device half *b3 [[buffer(3)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  uint m = tgid.y * 16 + tid.y;
+  uint d = tgid.x * 16 + tid.x;
+  if (m >= 64u || d >= 32u) { return; }
+  uint oq = 0;
+  uint ok = 0;
+  uint ov = 0;
+  int lim = 64;
+  float maxv = -INFINITY;
+  float sum = 0.0f;
+  float acc = 0.0f;
+  for (int n = 0; n < lim; ++n) {
+    float s = 0.0f;
+    for (uint k = 0; k < 32u; ++k) {
+      s += float(b0[oq + m * 32u + k]) * float(b1[ok + uint(n) * 32u + k]);
+    }
+    float mx = max(maxv, s);
+    float scale = exp(maxv - mx);
+    float w = exp(s - mx);
+    sum = sum * scale + w;
+    acc = acc * scale + w * float(b2[ov + uint(n) * 32u + d]);
+    maxv = mx;
+  }
+  float y = sum > 0.0f ? acc / sum : 0.0f;
+  uint i = tgid.z * 2048u + m * 32u + d;
+  b3[i] = half(y);
+}
+
+// bwpp_k3_matmul: matmul nodes=7,8 dispatches=5,14
+inline float bwpp_k3_matmul_epi(uint i, float x, device const half *b0, device const half *b1, device const half *b2) {
+  float t1 = float(b2[i]) + x;
+  return t1;
+}
+
+kernel void bwpp_k3_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device const half *b2 [[buffer(2)]],
+    device half *b3 [[buffer(3)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 32u; k0 += 16) {
+    As[tid.y][tid.x] = row < 64u && k0 + tid.x < 32u ? float(A[row * 32u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 32u && col < 32u ? float(B[(k0 + tid.y) * 32u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 64u && col < 32u) {
+    uint i = tgid.z * 2048u + row * 32u + col;
+    b3[i] = half(bwpp_k3_matmul_epi(i, acc, b0, b1, b2));
+  }
+}
+
+// bwpp_k4_matmul: matmul nodes=10,11 dispatches=7,16
+inline float bwpp_k4_matmul_epi(uint i, float x, device const half *b0, device const half *b1) {
+  float t1 = bwpp_region_silu(x);
+  return t1;
+}
+
+kernel void bwpp_k4_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 32u; k0 += 16) {
+    As[tid.y][tid.x] = row < 64u && k0 + tid.x < 32u ? float(A[row * 32u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 32u && col < 64u ? float(B[(k0 + tid.y) * 64u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 64u && col < 64u) {
+    uint i = tgid.z * 4096u + row * 64u + col;
+    b2[i] = half(bwpp_k4_matmul_epi(i, acc, b0, b1));
+  }
+}
+
+// bwpp_k5_matmul: matmul nodes=12,13 dispatches=8,17
+inline float bwpp_k5_matmul_epi(uint i, float x, device const half *b0, device const half *b1, device const half *b2) {
+  float t1 = float(b2[i]) + x;
+  return t1;
+}
+
+kernel void bwpp_k5_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device const half *b2 [[buffer(2)]],
+    device half *b3 [[buffer(3)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 64u; k0 += 16) {
+    As[tid.y][tid.x] = row < 64u && k0 + tid.x < 64u ? float(A[row * 64u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 64u && col < 32u ? float(B[(k0 + tid.y) * 32u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 64u && col < 32u) {
+    uint i = tgid.z * 2048u + row * 32u + col;
+    b3[i] = half(bwpp_k5_matmul_epi(i, acc, b0, b1, b2));
+  }
+}
+
+// bwpp_k6_matmul: matmul nodes=28 dispatches=18
+kernel void bwpp_k6_matmul(
+    device const half *b0 [[buffer(0)]],
+    device const half *b1 [[buffer(1)]],
+    device half *b2 [[buffer(2)]],
+    uint3 tid [[thread_position_in_threadgroup]],
+    uint3 tgid [[threadgroup_position_in_grid]]) {
+  threadgroup float As[16][16];
+  threadgroup float Bs[16][16];
+  uint row = tgid.y * 16 + tid.y;
+  uint col = tgid.x * 16 + tid.x;
+  uint oa = 0;
+  uint ob = 0;
+  device const half *A = b0 + oa;
+  device const half *B = b1 + ob;
+  float acc = 0.0f;
+  for (uint k0 = 0; k0 < 32u; k0 += 16) {
+    As[tid.y][tid.x] = row < 64u && k0 + tid.x < 32u ? float(A[row * 32u + k0 + tid.x]) : 0.0f;
+    Bs[tid.y][tid.x] = k0 + tid.y < 32u && col < 50u ? float(B[(k0 + tid.y) * 50u + col]) : 0.0f;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    for (uint k = 0; k < 16; ++k) {
+      acc += As[tid.y][k] * Bs[k][tid.x];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+  }
+  if (row < 64u && col < 50u) {
+    uint i = tgid.z * 3200u + row * 50u + col;
+    b2[i] = half(acc);
+  }
+}
+
+// bwpp_k7_reduction: reduction nodes=29 dispatches=19
+kernel void bwpp_k7_reduction(
+    device const half *b0 [[buffer(0)]],
+    device half *b1 [[buffer(1)]],
+    uint gid [[thread_position_in_grid]]) {
+  if (gid >= 64u) { return; }
+  uint base = gid * 50u;
+  int lim = 50;
+  float maxv = -INFINITY;
+  for (int c = 0; c < lim; ++c) {
+    maxv = max(maxv, float(b0[base + uint(c)]));
+  }
+  float sum = 0.0f;
+  for (int c = 0; c < lim; ++c) {
+    sum += exp(float(b0[base + uint(c)]) - maxv);
+  }
+  float inv = sum > 0.0f ? 1.0f / sum : 0.0f;
+  for (uint c = 0; c < 50u; ++c) {
+    uint i = base + c;
+    float y = int(c) < lim ? exp(float(b0[i]) - maxv) * inv : 0.0f;
+    b1[i] = half(y);
+  }
+}
+
@@ -0,0 +1,359 @@
+#include "bwpp_cpu_attention.h"
+#include "bwpp_cpu_kernels.h"
+#include <math.h>
+#include <stddef.h>
+
+static uint32_t bwpp_att_block_n(uint32_t N, uint32_t K, uint32_t D) {
+  uint32_t row_bytes = (K + D) * (uint32_t)sizeof(float);
+  uint32_t bn = row_bytes ? BWPP_ATT_L2_BYTES / row_bytes : BWPP_ATT_BLOCK_N_MAX;
+  if (bn < BWPP_ATT_BLOCK_N_MIN) {
+    bn = BWPP_ATT_BLOCK_N_MIN;
+  }
+  if (bn > BWPP_ATT_BLOCK_N_MAX) {
+    bn = BWPP_ATT_BLOCK_N_MAX;
+  }
+  return bn < N ? bn : N;
+}
+
+int bwpp_cpu_attention_params_resolve(const BwppCpuAttentionParams *params,
+                                      BwppCpuAttentionParams *out) {
+  BwppCpuAttentionParams p = *params;
+  if (p.batch == 0) {
+    p.batch = 1;
+  }
+  if (p.heads == 0) {
+    p.heads = 1;
+  }
+  if (p.kv_heads == 0) {
+    p.kv_heads = p.heads;
+  }
+  if (p.kv_rows < p.N) {
+    p.kv_rows = p.N;
+  }
+  *out = p;
+  return p.kv_heads <= p.heads && p.heads % p.kv_heads == 0;
+}
+
+/* Online-softmax update of one query row with keys [n0, n0 + cnt). */
+static void bwpp_att_row_block(const BwppCpuKernels *kern,
+                               const float *qrow,
+                               const float *kh,
+                               const float *vh,
+                               uint32_t n0,
+                               uint32_t cnt,
+                               const BwppCpuAttentionParams *p,
+                               float *scores,
+                               float *orow,
+                               float *maxp,
+                               float *sump) {
+  float blk_max = -INFINITY;
+  for (uint32_t n = 0; n < cnt; ++n) {
+    scores[n] = kern->dot(qrow, kh + (size_t)(n0 + n) * p->ldk, p->K);
+    blk_max = scores[n] > blk_max ? scores[n] : blk_max;
+  }
+  if (blk_max > *maxp) {
+    /* rescale what was accumulated under the old max */
+    float scale = expf(*maxp - blk_max);
+    kern->scale(orow, scale, p->D);
+    *sump *= scale;
+    *maxp = blk_max;
+  }
+  float maxv = *maxp;
+  for (uint32_t n = 0; n < cnt; ++n) {
+    float w = expf(scores[n] - maxv);
+    *sump += w;
+    kern->axpy(orow, w, vh + (size_t)(n0 + n) * p->ldv, p->D);
+  }
+}
+
+/* Number of keys query row m may see out of len. */
+static uint32_t bwpp_att_row_limit(const BwppCpuAttentionParams *p, uint32_t len, uint32_t m) {
+  if (!p->causal) {
+    return len;
+  }
+  int64_t lim = (int64_t)m + (int64_t)len - (int64_t)p->M + 1;
+  return lim <= 0 ? 0 : (lim < (int64_t)len ? (uint32_t)lim : len);
+}
+
+void bwpp_cpu_attention_tiled_f32(const float *q,
+                                  const float *k,
+                                  const float *v,
+                                  float *o,
+                                  uint32_t M,
+                                  uint32_t N,
+                                  uint32_t K,
+                                  uint32_t D,
+                                  uint32_t ldq,
+                                  uint32_t ldk,
+                                  uint32_t ldv,
+                                  uint32_t ldo) {
+  BwppCpuAttentionParams params = { M, N, K, D, ldq, ldk, ldv, ldo, 1, 1, 1, 0, 0 };
+  bwpp_cpu_attention_masked_f32(q, k, v, o, NULL, &params);
+}
+
+uint32_t bwpp_cpu_attention_masked_items(const BwppCpuAttentionParams *params) {
+  if (!params) {
+    return 0;
+  }
+  BwppCpuAttentionParams p;
+  if (!bwpp_cpu_attention_params_resolve(params, &p)) {
+    return 0;
+  }
+  uint32_t blocks = (p.M + BWPP_ATT_BLOCK_M - 1) / BWPP_ATT_BLOCK_M;
+  return p.batch * p.kv_heads * blocks;
+}
+
+/* Shared by the contiguous and paged layouts. Contiguous K/V are walked in
+   L2-sized blocks; paged K/V one page at a time, each page a block. */
+static void bwpp_att_range(const float *q,
+                           const float *k,
+                           const float *v,
+                           const BwppCpuKvPages *pages,
+                           float *o,
+                           const uint32_t *kv_len,
+                           const BwppCpuAttentionParams *params,
+                           uint32_t begin,
+                           uint32_t end) {
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  BwppCpuAttentionParams p;
+  if (!bwpp_cpu_attention_params_resolve(params, &p)) {
+    return;
+  }
+  uint32_t group = p.heads / p.kv_heads;
+  uint32_t blocks = (p.M + BWPP_ATT_BLOCK_M - 1) / BWPP_ATT_BLOCK_M;
+  uint32_t bn = pages ? pages->page_tokens : bwpp_att_block_n(p.N, p.K, p.D);
+  /* scratch is bounded, so it lives on the stack and the kernel cannot fail */
+  float scores[BWPP_ATT_BLOCK_N_MAX];
+  float row_max[BWPP_ATT_GROUP_MAX * BWPP_ATT_BLOCK_M];
+  float row_sum[BWPP_ATT_GROUP_MAX * BWPP_ATT_BLOCK_M];
+
+  for (uint32_t item = begin; item < end; ++item) {
+    uint32_t mb = item % blocks;
+    uint32_t kvh = (item / blocks) % p.kv_heads;
+    uint32_t b = item / blocks / p.kv_heads;
+    uint32_t m0 = mb * BWPP_ATT_BLOCK_M;
+    uint32_t bm = p.M - m0 < BWPP_ATT_BLOCK_M ? p.M - m0 : BWPP_ATT_BLOCK_M;
+    uint32_t len = kv_len && kv_len[b] < p.N ? kv_len[b] : p.N;
+    /* no row of this query block sees a key at or past n_end */
+    uint32_t n_end = bwpp_att_row_limit(&p, len, m0 + bm - 1);
+    const float *kh = NULL;
+    const float *vh = NULL;
+    if (!pages) {
+      kh = k + (size_t)(b * p.kv_heads + kvh) * p.kv_rows * p.ldk;
+      vh = v + (size_t)(b * p.kv_heads + kvh) * p.kv_rows * p.ldv;
+    }
+
+    uint32_t g_end = (kvh + 1) * group;
+    for (uint32_t h0 = kvh * group; h0 < g_end; h0 += BWPP_ATT_GROUP_MAX) {
+      uint32_t h1 = g_end - h0 < BWPP_ATT_GROUP_MAX ? g_end : h0 + BWPP_ATT_GROUP_MAX;
+      for (uint32_t h = h0; h < h1; ++h) {
+        float *oh = o + ((size_t)(b * p.heads + h) * p.M + m0) * p.ldo;
+        for (uint32_t i = 0; i < bm; ++i) {
+          float *orow = oh + (size_t)i * p.ldo;
+          for (uint32_t d = 0; d < p.D; ++d) {
+            orow[d] = 0.0f;
+          }
+          row_max[(h - h0) * BWPP_ATT_BLOCK_M + i] = -INFINITY;
+          row_sum[(h - h0) * BWPP_ATT_BLOCK_M + i] = 0.0f;
+        }
+      }
+
+      for (uint32_t n0 = 0; n0 < n_end; n0 += bn) {
+        uint32_t nb = n_end - n0 < bn ? n_end - n0 : bn;
+        const float *kb = kh;
+        const float *vb = vh;
+        uint32_t off = n0;
+        if (pages) {
+          uint32_t page = pages->table[(size_t)b * pages->table_stride + n0 / bn];
+          kb = pages->k + ((size_t)page * p.kv_heads + kvh) * bn * p.ldk;
+          vb = pages->v + ((size_t)page * p.kv_heads + kvh) * bn * p.ldv;
+          off = 0;
+        }
+        /* every Q head of the group consumes this K/V block before the next */
+        for (uint32_t h = h0; h < h1; ++h) {
+          const float *qh = q + ((size_t)(b * p.heads + h) * p.M + m0) * p.ldq;
+          float *oh = o + ((size_t)(b * p.heads + h) * p.M + m0) * p.ldo;
+          for (uint32_t i = 0; i < bm; ++i) {
+            uint32_t lim = bwpp_att_row_limit(&p, len, m0 + i);
+            if (lim <= n0) {
+              continue;
+            }
+            uint32_t cnt = lim - n0 < nb ? lim - n0 : nb;
+            /* pages may be wider than the score row */
+            for (uint32_t c = 0; c < cnt; c += BWPP_ATT_BLOCK_N_MAX) {
+              uint32_t cc = cnt - c < BWPP_ATT_BLOCK_N_MAX ? cnt - c : BWPP_ATT_BLOCK_N_MAX;
+              bwpp_att_row_block(kern, qh + (size_t)i * p.ldq, kb, vb, off + c, cc, &p, scores,
+                                 oh + (size_t)i * p.ldo,
+                                 &row_max[(h - h0) * BWPP_ATT_BLOCK_M + i],
+                                 &row_sum[(h - h0) * BWPP_ATT_BLOCK_M + i]);
+            }
+          }
+        }
+      }
+
+      for (uint32_t h = h0; h < h1; ++h) {
+        float *oh = o + ((size_t)(b * p.heads + h) * p.M + m0) * p.ldo;
+        for (uint32_t i = 0; i < bm; ++i) {
+          float sum = row_sum[(h - h0) * BWPP_ATT_BLOCK_M + i];
+          float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+          kern->scale(oh + (size_t)i * p.ldo, inv, p.D);
+        }
+      }
+    }
+  }
+}
+
+void bwpp_cpu_attention_masked_range_f32(const float *q,
+                                         const float *k,
+                                         const float *v,
+                                         float *o,
+                                         const uint32_t *kv_len,
+                                         const BwppCpuAttentionParams *params,
+                                         uint32_t begin,
+                                         uint32_t end) {
+  if (!q || !k || !v || !o || !params || params->M == 0 || begin >= end) {
+    return;
+  }
+  bwpp_att_range(q, k, v, NULL, o, kv_len, params, begin, end);
+}
+
+void bwpp_cpu_attention_paged_range_f32(const float *q,
+                                        const BwppCpuKvPages *pages,
+                                        float *o,
+                                        const uint32_t *kv_len,
+                                        const BwppCpuAttentionParams *params,
+                                        uint32_t begin,
+                                        uint32_t end) {
+  if (!q || !pages || !pages->k || !pages->v || !pages->table || pages->page_tokens == 0 ||
+      !o || !params || params->M == 0 || begin >= end) {
+    return;
+  }
+  bwpp_att_range(q, NULL, NULL, pages, o, kv_len, params, begin, end);
+}
+
+void bwpp_cpu_attention_paged_f32(const float *q,
+                                  const BwppCpuKvPages *pages,
+                                  float *o,
+                                  const uint32_t *kv_len,
+                                  const BwppCpuAttentionParams *params) {
+  bwpp_cpu_attention_paged_range_f32(q, pages, o, kv_len, params, 0,
+                                     bwpp_cpu_attention_masked_items(params));
+}
+
+void bwpp_cpu_attention_masked_f32(const float *q,
+                                   const float *k,
+                                   const float *v,
+                                   float *o,
+                                   const uint32_t *kv_len,
+                                   const BwppCpuAttentionParams *params) {
+  bwpp_cpu_attention_masked_range_f32(q, k, v, o, kv_len, params, 0,
+                                      bwpp_cpu_attention_masked_items(params));
+}
+
+void bwpp_cpu_attention_split_range_f32(const float *q,
+                                        const float *k,
+                                        const float *v,
+                                        const uint32_t *kv_len,
+                                        const BwppCpuAttentionParams *params,
+                                        uint32_t splits,
+                                        float *partial,
+                                        uint32_t begin,
+                                        uint32_t end) {
+  if (!q || !k || !v || !params || !partial || splits == 0 || begin >= end) {
+    return;
+  }
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  BwppCpuAttentionParams p;
+  if (!bwpp_cpu_attention_params_resolve(params, &p)) {
+    return;
+  }
+  uint32_t group = p.heads / p.kv_heads;
+  uint32_t split_keys = (p.N + splits - 1) / splits;
+  uint32_t bn = bwpp_att_block_n(split_keys, p.K, p.D);
+  size_t row_floats = (size_t)p.D + 2;
+  /* bn never exceeds BWPP_ATT_BLOCK_N_MAX, so the score row cannot fail */
+  float scores[BWPP_ATT_BLOCK_N_MAX];
+
+  for (uint32_t item = begin; item < end; ++item) {
+    uint32_t s = item % splits;
+    uint32_t kvh = (item / splits) % p.kv_heads;
+    uint32_t b = item / splits / p.kv_heads;
+    uint32_t h0 = kvh * group;
+    uint32_t h1 = h0 + group;
+    uint32_t len = kv_len && kv_len[b] < p.N ? kv_len[b] : p.N;
+    uint32_t s0 = s * split_keys;
+    uint32_t s1 = s0 + split_keys < len ? s0 + split_keys : len;
+    const float *kh = k + (size_t)(b * p.kv_heads + kvh) * p.kv_rows * p.ldk;
+    const float *vh = v + (size_t)(b * p.kv_heads + kvh) * p.kv_rows * p.ldv;
+
+    for (uint32_t h = h0; h < h1; ++h) {
+      const float *qh = q + (size_t)(b * p.heads + h) * p.M * p.ldq;
+      float *ph = partial + ((size_t)(b * p.heads + h) * splits + s) * p.M * row_floats;
+      for (uint32_t i = 0; i < p.M; ++i) {
+        float *prow = ph + (size_t)i * row_floats;
+        float *maxp = prow + p.D;
+        float *sump = prow + p.D + 1;
+        for (uint32_t d = 0; d < p.D; ++d) {
+          prow[d] = 0.0f;
+        }
+        *maxp = -INFINITY;
+        *sump = 0.0f;
+        uint32_t lim = bwpp_att_row_limit(&p, len, i);
+        uint32_t n_end = lim < s1 ? lim : s1;
+        for (uint32_t n0 = s0; n0 < n_end; n0 += bn) {
+          uint32_t cnt = n_end - n0 < bn ? n_end - n0 : bn;
+          bwpp_att_row_block(kern, qh + (size_t)i * p.ldq, kh, vh, n0, cnt, &p, scores,
+                             prow, maxp, sump);
+        }
+      }
+    }
+  }
+}
+
+void bwpp_cpu_attention_split_merge_f32(const float *partial,
+                                        float *o,
+                                        const BwppCpuAttentionParams *params,
+                                        uint32_t splits,
+                                        uint32_t begin,
+                                        uint32_t end) {
+  if (!partial || !o || !params || splits == 0) {
+    return;
+  }
+  BwppCpuAttentionParams p;
+  if (!bwpp_cpu_attention_params_resolve(params, &p)) {
+    return;
+  }
+  size_t row_floats = (size_t)p.D + 2;
+  for (uint32_t bh = begin; bh < end; ++bh) {
+    const float *ph = partial + (size_t)bh * splits * p.M * row_floats;
+    float *oh = o + (size_t)bh * p.M * p.ldo;
+    for (uint32_t i = 0; i < p.M; ++i) {
+      float *orow = oh + (size_t)i * p.ldo;
+      float maxv = -INFINITY;
+      for (uint32_t s = 0; s < splits; ++s) {
+        float m = ph[((size_t)s * p.M + i) * row_floats + p.D];
+        maxv = m > maxv ? m : maxv;
+      }
+      for (uint32_t d = 0; d < p.D; ++d) {
+        orow[d] = 0.0f;
+      }
+      float sum = 0.0f;
+      for (uint32_t s = 0; s < splits && maxv > -INFINITY; ++s) {
+        const float *prow = ph + ((size_t)s * p.M + i) * row_floats;
+        if (prow[p.D] == -INFINITY) {
+          continue;
+        }
+        /* each slice accumulated against its own max; rescale to the common one */
+        float scale = expf(prow[p.D] - maxv);
+        sum += prow[p.D + 1] * scale;
+        for (uint32_t d = 0; d < p.D; ++d) {
+          orow[d] += prow[d] * scale;
+        }
+      }
+      float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+      for (uint32_t d = 0; d < p.D; ++d) {
+        orow[d] *= inv;
+      }
+    }
+  }
+}
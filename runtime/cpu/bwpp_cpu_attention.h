@@ -0,0 +1,132 @@
+#ifndef BWPP_CPU_ATTENTION_H
+#define BWPP_CPU_ATTENTION_H
+
+#include <stdint.h>
+
+/* Query rows processed together against one K/V block. */
+#define BWPP_ATT_BLOCK_M 32
+
+/* K/V block rows are sized so one block of K and V stays in this much L2. */
+#define BWPP_ATT_L2_BYTES (256u * 1024u)
+#define BWPP_ATT_BLOCK_N_MIN 16
+#define BWPP_ATT_BLOCK_N_MAX 1024
+
+/* Q heads of a GQA group that walk one K/V block together; larger groups
+   walk it once per this many heads. Bounds the on-stack row state. */
+#define BWPP_ATT_GROUP_MAX 8
+
+/* Flash-style attention, same contract as bwpp_cpu_attention_f32. Streams
+   K/V in L2-sized blocks with a running max and running sum per query row
+   (the recurrence bwpp_attention_f16 uses), so the M x N score matrix is
+   never materialized: O(M*N*(K+D)) work, O(BLOCK_M*BLOCK_N) scratch. */
+void bwpp_cpu_attention_tiled_f32(const float *q,
+                                  const float *k,
+                                  const float *v,
+                                  float *o,
+                                  uint32_t M,
+                                  uint32_t N,
+                                  uint32_t K,
+                                  uint32_t D,
+                                  uint32_t ldq,
+                                  uint32_t ldk,
+                                  uint32_t ldv,
+                                  uint32_t ldo);
+
+/* Batched multi-head attention, mirroring BwppAttentionParams on the Metal
+   side. Zero fields keep the dense single-head defaults. Q/O are laid out
+   [batch, heads, M, *] and K/V [batch, kv_heads, kv_rows, *], each row one
+   leading dimension apart; a KV cache passes its capacity as kv_rows. */
+typedef struct {
+  uint32_t M;
+  uint32_t N;
+  uint32_t K;
+  uint32_t D;
+  uint32_t ldq;
+  uint32_t ldk;
+  uint32_t ldv;
+  uint32_t ldo;
+  uint32_t batch;    /* 0 -> 1 */
+  uint32_t heads;    /* 0 -> 1 */
+  uint32_t kv_heads; /* 0 -> heads; must divide heads, heads / kv_heads Q heads share one K/V head */
+  uint32_t causal;   /* bottom-right aligned: row m sees keys n <= m + len - M */
+  uint32_t kv_rows;  /* rows per K/V head; values below N mean N */
+} BwppCpuAttentionParams;
+
+/* Copies params into out with the zero defaults filled in. Returns 0 when
+   kv_heads exceeds heads or does not divide it; the kernels then do nothing. */
+int bwpp_cpu_attention_params_resolve(const BwppCpuAttentionParams *params,
+                                      BwppCpuAttentionParams *out);
+
+/* kv_len holds one key length per batch entry (NULL means N); keys at or past
+   it are padding. Rows that see no key are written as zeros. Key blocks past
+   the causal limit of a query block are skipped, and the Q heads of a group
+   walk each K/V block together so it is streamed once per group. */
+void bwpp_cpu_attention_masked_f32(const float *q,
+                                   const float *k,
+                                   const float *v,
+                                   float *o,
+                                   const uint32_t *kv_len,
+                                   const BwppCpuAttentionParams *params);
+
+/* Work items are (batch, kv head, query block) triples; the range variant
+   runs items [begin, end) so callers can split the work across threads. */
+uint32_t bwpp_cpu_attention_masked_items(const BwppCpuAttentionParams *params);
+void bwpp_cpu_attention_masked_range_f32(const float *q,
+                                         const float *k,
+                                         const float *v,
+                                         float *o,
+                                         const uint32_t *kv_len,
+                                         const BwppCpuAttentionParams *params,
+                                         uint32_t begin,
+                                         uint32_t end);
+
+/* K/V gathered through a page table instead of one buffer per head. Pages
+   hold page_tokens rows of every K/V head, laid out
+   [page][kv_heads][page_tokens][ld]; batch entry b's key n lives in page
+   table[b * table_stride + n / page_tokens]. kv_rows is ignored. */
+typedef struct {
+  const float *k;
+  const float *v;
+  const uint32_t *table;
+  uint32_t table_stride;
+  uint32_t page_tokens;
+} BwppCpuKvPages;
+
+/* bwpp_cpu_attention_masked_f32 over paged K/V, one page per key block.
+   Items are the same as bwpp_cpu_attention_masked_items. */
+void bwpp_cpu_attention_paged_f32(const float *q,
+                                  const BwppCpuKvPages *pages,
+                                  float *o,
+                                  const uint32_t *kv_len,
+                                  const BwppCpuAttentionParams *params);
+void bwpp_cpu_attention_paged_range_f32(const float *q,
+                                        const BwppCpuKvPages *pages,
+                                        float *o,
+                                        const uint32_t *kv_len,
+                                        const BwppCpuAttentionParams *params,
+                                        uint32_t begin,
+                                        uint32_t end);
+
+/* Split-K attention for decoding, where M is 1 (or a few speculative tokens)
+   and batch * heads alone is too little parallel work. The key range is cut
+   into `splits` slices; items (batch, kv head, slice) write, per query row,
+   D unnormalized outputs then the slice's running max and sum into
+   partial[batch * heads][splits][M][D + 2]. The merge rescales the slices to
+   a common max and normalizes; its items are the batch * heads Q heads. */
+void bwpp_cpu_attention_split_range_f32(const float *q,
+                                        const float *k,
+                                        const float *v,
+                                        const uint32_t *kv_len,
+                                        const BwppCpuAttentionParams *params,
+                                        uint32_t splits,
+                                        float *partial,
+                                        uint32_t begin,
+                                        uint32_t end);
+void bwpp_cpu_attention_split_merge_f32(const float *partial,
+                                        float *o,
+                                        const BwppCpuAttentionParams *params,
+                                        uint32_t splits,
+                                        uint32_t begin,
+                                        uint32_t end);
+
+#endif
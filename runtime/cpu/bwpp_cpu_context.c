@@ -0,0 +1,386 @@
+#include "bwpp_cpu_context.h"
+#include "bwpp_cpu_attention.h"
+#include "bwpp_cpu_gemm.h"
+#include "bwpp_cpu_kernels.h"
+#include <stdlib.h>
+
+/* Output tile for threaded matmul; multiples of every ISA's register tile.
+   Shrunk for small problems so each worker gets a few tiles to steal. */
+#define BWPP_CTX_TILE_M 96
+#define BWPP_CTX_TILE_N 256
+#define BWPP_CTX_TILE_M_MIN 24
+#define BWPP_CTX_TILE_N_MIN 64
+
+/* Rows handed out per chunk aim at roughly this many elements. */
+#define BWPP_CTX_ROW_ELEMS 4096
+
+/* Decode split-K: only for a handful of query rows, and no slice shorter
+   than this many keys so the merge stays cheap. */
+#define BWPP_CTX_DECODE_M_MAX 8
+#define BWPP_CTX_DECODE_SPLIT_MIN 128
+
+BwppCpuContext *bwpp_cpu_context_create(uint32_t threads) {
+  BwppCpuContext *ctx = (BwppCpuContext *)calloc(1, sizeof(BwppCpuContext));
+  if (!ctx) {
+    return NULL;
+  }
+  /* resolve the ISA table before workers can race on its lazy init */
+  (void)bwpp_cpu_kernels();
+  if (threads != 1) {
+    ctx->pool = bwpp_cpu_pool_create(threads);
+    if (!ctx->pool) {
+      free(ctx);
+      return NULL;
+    }
+  }
+  ctx->threads = bwpp_cpu_pool_threads(ctx->pool);
+  return ctx;
+}
+
+void bwpp_cpu_context_destroy(BwppCpuContext *ctx) {
+  if (!ctx) {
+    return;
+  }
+  bwpp_cpu_pool_destroy(ctx->pool);
+  free(ctx->pack_a);
+  free(ctx->pack_b);
+  free(ctx);
+}
+
+static BwppCpuPool *bwpp_ctx_pool(BwppCpuContext *ctx) {
+  return ctx ? ctx->pool : NULL;
+}
+
+static uint32_t bwpp_ctx_row_grain(uint32_t cols) {
+  uint32_t grain = cols ? BWPP_CTX_ROW_ELEMS / cols : 1;
+  return grain ? grain : 1;
+}
+
+typedef struct {
+  const float *a;
+  const float *b;
+  float *c;
+  uint32_t M;
+  uint32_t N;
+  uint32_t K;
+  uint32_t lda;
+  uint32_t ldb;
+  uint32_t ldc;
+  int trans_a;
+  int trans_b;
+  const float *bias;
+  int apply_silu;
+  int apply_bias;
+  uint32_t tile_m;
+  uint32_t tile_n;
+  uint32_t tiles_n;
+  float *pack_a;
+  float *pack_b;
+  int pack_in_tile;
+} BwppMatmulJob;
+
+/* Makes room for B packed whole and one A buffer per worker. Returns 0 when
+   either cannot be allocated; the caller then packs per tile. */
+static int bwpp_ctx_reserve_packs(BwppCpuContext *ctx, size_t b_floats) {
+  if (!ctx->pack_a) {
+    ctx->pack_a = (float *)malloc(sizeof(float) * BWPP_GEMM_PACK_A_FLOATS * ctx->threads);
+    if (!ctx->pack_a) {
+      return 0;
+    }
+  }
+  if (ctx->pack_b_cap < b_floats) {
+    /* the old contents are dead, so skip realloc's copy */
+    free(ctx->pack_b);
+    ctx->pack_b_cap = 0;
+    ctx->pack_b = (float *)malloc(sizeof(float) * b_floats);
+    if (!ctx->pack_b) {
+      return 0;
+    }
+    ctx->pack_b_cap = b_floats;
+  }
+  return 1;
+}
+
+static void bwpp_matmul_pack_b_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  (void)worker;
+  const BwppMatmulJob *job = (const BwppMatmulJob *)arg;
+  uint32_t j0 = begin * job->tile_n;
+  uint32_t j1 = end * job->tile_n < job->N ? end * job->tile_n : job->N;
+  bwpp_cpu_gemm_pack_b_f32(job->b, job->N, job->K, job->ldb, job->trans_b, j0, j1, job->pack_b);
+}
+
+static void bwpp_matmul_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  const BwppMatmulJob *job = (const BwppMatmulJob *)arg;
+  for (uint32_t t = begin; t < end; ++t) {
+    uint32_t i0 = (t / job->tiles_n) * job->tile_m;
+    uint32_t j0 = (t % job->tiles_n) * job->tile_n;
+    uint32_t mt = job->M - i0 < job->tile_m ? job->M - i0 : job->tile_m;
+    uint32_t nt = job->N - j0 < job->tile_n ? job->N - j0 : job->tile_n;
+    if (job->pack_b) {
+      if (job->pack_in_tile) {
+        /* a single row of tiles: pack this tile's columns while they are hot */
+        bwpp_cpu_gemm_pack_b_f32(job->b, job->N, job->K, job->ldb, job->trans_b, j0, j0 + nt,
+                                 job->pack_b);
+      }
+      bwpp_cpu_gemm_packed_f32(job->a + (job->trans_a ? i0 : (size_t)i0 * job->lda), job->pack_b,
+                               job->c + (size_t)i0 * job->ldc + j0,
+                               mt, job->N, job->K, job->lda, job->ldc, job->trans_a, j0, nt,
+                               job->bias ? job->bias + j0 : NULL, job->apply_silu, job->apply_bias,
+                               job->pack_a + BWPP_GEMM_PACK_A_FLOATS * worker);
+      continue;
+    }
+    bwpp_cpu_gemm_trans_f32(job->a + (job->trans_a ? i0 : (size_t)i0 * job->lda),
+                            job->b + (job->trans_b ? (size_t)j0 * job->ldb : j0),
+                            job->c + (size_t)i0 * job->ldc + j0,
+                            mt, nt, job->K, job->lda, job->ldb, job->ldc, job->trans_a, job->trans_b,
+                            job->bias ? job->bias + j0 : NULL,
+                            job->apply_silu, job->apply_bias);
+  }
+}
+
+void bwpp_cpu_matmul_ctx_f32(BwppCpuContext *ctx,
+                             const float *a,
+                             const float *b,
+                             float *c,
+                             uint32_t M,
+                             uint32_t N,
+                             uint32_t K,
+                             uint32_t lda,
+                             uint32_t ldb,
+                             uint32_t ldc,
+                             const float *bias,
+                             int apply_silu,
+                             int apply_bias) {
+  bwpp_cpu_matmul_trans_ctx_f32(ctx, a, b, c, M, N, K, lda, ldb, ldc, 0, 0, bias, apply_silu, apply_bias);
+}
+
+void bwpp_cpu_matmul_trans_ctx_f32(BwppCpuContext *ctx,
+                                   const float *a,
+                                   const float *b,
+                                   float *c,
+                                   uint32_t M,
+                                   uint32_t N,
+                                   uint32_t K,
+                                   uint32_t lda,
+                                   uint32_t ldb,
+                                   uint32_t ldc,
+                                   int trans_a,
+                                   int trans_b,
+                                   const float *bias,
+                                   int apply_silu,
+                                   int apply_bias) {
+  if (!a || !b || !c || M == 0 || N == 0) {
+    return;
+  }
+  BwppMatmulJob job = { a, b, c, M, N, K, lda, ldb, ldc, trans_a, trans_b, bias, apply_silu, apply_bias,
+                        BWPP_CTX_TILE_M, BWPP_CTX_TILE_N, 0, NULL, NULL, 0 };
+  uint32_t want = ctx ? ctx->threads * 4 : 1;
+  for (;;) {
+    uint32_t tiles_m = (M + job.tile_m - 1) / job.tile_m;
+    uint32_t tiles_n = (N + job.tile_n - 1) / job.tile_n;
+    if (tiles_m * tiles_n >= want) {
+      break;
+    }
+    if (job.tile_n > BWPP_CTX_TILE_N_MIN && job.tile_n >= job.tile_m) {
+      job.tile_n /= 2;
+    } else if (job.tile_m > BWPP_CTX_TILE_M_MIN) {
+      job.tile_m /= 2;
+    } else {
+      break;
+    }
+  }
+  uint32_t tiles_m = (M + job.tile_m - 1) / job.tile_m;
+  job.tiles_n = (N + job.tile_n - 1) / job.tile_n;
+  /* tile_n is a multiple of every register tile, so columns of tiles pack
+     disjoint B panels */
+  if (ctx && K > 0 && bwpp_ctx_reserve_packs(ctx, bwpp_cpu_gemm_packed_b_floats(N, K))) {
+    job.pack_a = ctx->pack_a;
+    job.pack_b = ctx->pack_b;
+    job.pack_in_tile = tiles_m == 1;
+    if (!job.pack_in_tile) {
+      bwpp_cpu_pool_parallel_for(ctx->pool, job.tiles_n, 1, bwpp_matmul_pack_b_task, &job);
+    }
+  }
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), tiles_m * job.tiles_n, 1, bwpp_matmul_task, &job);
+}
+
+typedef struct {
+  const float *x;
+  float *y;
+  const float *gamma;
+  const float *beta;
+  uint32_t cols;
+  uint32_t ld;
+  float eps;
+} BwppRowJob;
+
+static void bwpp_softmax_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  (void)worker;
+  const BwppRowJob *job = (const BwppRowJob *)arg;
+  size_t off = (size_t)begin * job->ld;
+  bwpp_cpu_softmax_simd_f32(job->x + off, job->y + off, end - begin, job->cols, job->ld);
+}
+
+static void bwpp_rmsnorm_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  (void)worker;
+  const BwppRowJob *job = (const BwppRowJob *)arg;
+  size_t off = (size_t)begin * job->ld;
+  bwpp_cpu_rmsnorm_simd_f32(job->x + off, job->y + off, job->gamma, job->beta,
+                            end - begin, job->cols, job->ld, job->eps);
+}
+
+void bwpp_cpu_softmax_ctx_f32(BwppCpuContext *ctx,
+                              const float *x,
+                              float *y,
+                              uint32_t rows,
+                              uint32_t cols,
+                              uint32_t ld) {
+  if (!x || !y) {
+    return;
+  }
+  BwppRowJob job = { x, y, NULL, NULL, cols, ld, 0.0f };
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), rows, bwpp_ctx_row_grain(cols), bwpp_softmax_task, &job);
+}
+
+void bwpp_cpu_rmsnorm_ctx_f32(BwppCpuContext *ctx,
+                              const float *x,
+                              float *y,
+                              const float *gamma,
+                              const float *beta,
+                              uint32_t rows,
+                              uint32_t cols,
+                              uint32_t ld,
+                              float eps) {
+  if (!x || !y || cols == 0) {
+    return;
+  }
+  BwppRowJob job = { x, y, gamma, beta, cols, ld, eps };
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), rows, bwpp_ctx_row_grain(cols), bwpp_rmsnorm_task, &job);
+}
+
+typedef struct {
+  const float *q;
+  const float *k;
+  const float *v;
+  float *o;
+  const uint32_t *kv_len;
+  BwppCpuAttentionParams params;
+  const BwppCpuKvPages *pages;
+} BwppAttentionJob;
+
+static void bwpp_attention_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  (void)worker;
+  const BwppAttentionJob *job = (const BwppAttentionJob *)arg;
+  if (job->pages) {
+    bwpp_cpu_attention_paged_range_f32(job->q, job->pages, job->o, job->kv_len, &job->params,
+                                       begin, end);
+    return;
+  }
+  bwpp_cpu_attention_masked_range_f32(job->q, job->k, job->v, job->o, job->kv_len,
+                                      &job->params, begin, end);
+}
+
+void bwpp_cpu_attention_masked_ctx_f32(BwppCpuContext *ctx,
+                                       const float *q,
+                                       const float *k,
+                                       const float *v,
+                                       float *o,
+                                       const uint32_t *kv_len,
+                                       const BwppCpuAttentionParams *params) {
+  if (!q || !k || !v || !o || !params) {
+    return;
+  }
+  BwppAttentionJob job = { q, k, v, o, kv_len, *params, NULL };
+  /* one (batch, kv head, query block) per chunk: causal blocks differ in
+     cost, which stealing evens out */
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), bwpp_cpu_attention_masked_items(params), 1,
+                             bwpp_attention_task, &job);
+}
+
+void bwpp_cpu_attention_ctx_f32(BwppCpuContext *ctx,
+                                const float *q,
+                                const float *k,
+                                const float *v,
+                                float *o,
+                                uint32_t M,
+                                uint32_t N,
+                                uint32_t K,
+                                uint32_t D,
+                                uint32_t ldq,
+                                uint32_t ldk,
+                                uint32_t ldv,
+                                uint32_t ldo) {
+  BwppCpuAttentionParams params = { M, N, K, D, ldq, ldk, ldv, ldo, 1, 1, 1, 0, 0 };
+  bwpp_cpu_attention_masked_ctx_f32(ctx, q, k, v, o, NULL, &params);
+}
+
+void bwpp_cpu_attention_paged_ctx_f32(BwppCpuContext *ctx,
+                                      const float *q,
+                                      const BwppCpuKvPages *pages,
+                                      float *o,
+                                      const uint32_t *kv_len,
+                                      const BwppCpuAttentionParams *params) {
+  if (!q || !pages || !o || !params) {
+    return;
+  }
+  BwppAttentionJob job = { q, NULL, NULL, o, kv_len, *params, pages };
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), bwpp_cpu_attention_masked_items(params), 1,
+                             bwpp_attention_task, &job);
+}
+
+typedef struct {
+  const float *q;
+  const float *k;
+  const float *v;
+  float *o;
+  const uint32_t *kv_len;
+  BwppCpuAttentionParams params;
+  uint32_t splits;
+  float *partial;
+} BwppDecodeJob;
+
+static void bwpp_decode_split_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  (void)worker;
+  const BwppDecodeJob *job = (const BwppDecodeJob *)arg;
+  bwpp_cpu_attention_split_range_f32(job->q, job->k, job->v, job->kv_len, &job->params,
+                                     job->splits, job->partial, begin, end);
+}
+
+static void bwpp_decode_merge_task(void *arg, uint32_t begin, uint32_t end, uint32_t worker) {
+  (void)worker;
+  const BwppDecodeJob *job = (const BwppDecodeJob *)arg;
+  bwpp_cpu_attention_split_merge_f32(job->partial, job->o, &job->params, job->splits, begin, end);
+}
+
+void bwpp_cpu_attention_decode_ctx_f32(BwppCpuContext *ctx,
+                                       const float *q,
+                                       const float *k,
+                                       const float *v,
+                                       float *o,
+                                       const uint32_t *kv_len,
+                                       const BwppCpuAttentionParams *params) {
+  BwppCpuAttentionParams p;
+  if (!q || !k || !v || !o || !params || !bwpp_cpu_attention_params_resolve(params, &p)) {
+    return;
+  }
+  uint32_t threads = ctx ? ctx->threads : 1;
+  uint32_t heads_kv = p.batch * p.kv_heads;
+  uint32_t splits = 1;
+  if (threads > 1 && p.M <= BWPP_CTX_DECODE_M_MAX && heads_kv < 2 * threads) {
+    uint32_t max_splits = p.N / BWPP_CTX_DECODE_SPLIT_MIN;
+    splits = (4 * threads + heads_kv - 1) / heads_kv;
+    splits = splits < max_splits ? splits : max_splits;
+  }
+  float *partial = NULL;
+  if (splits > 1) {
+    partial = (float *)malloc(sizeof(float) * (size_t)p.batch * p.heads * splits * p.M * (p.D + 2));
+  }
+  if (!partial) {
+    bwpp_cpu_attention_masked_ctx_f32(ctx, q, k, v, o, kv_len, params);
+    return;
+  }
+  BwppDecodeJob job = { q, k, v, o, kv_len, p, splits, partial };
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), heads_kv * splits, 1, bwpp_decode_split_task, &job);
+  bwpp_cpu_pool_parallel_for(bwpp_ctx_pool(ctx), p.batch * p.heads, 1, bwpp_decode_merge_task, &job);
+  free(partial);
+}
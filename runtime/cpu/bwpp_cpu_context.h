@@ -0,0 +1,118 @@
+#ifndef BWPP_CPU_CONTEXT_H
+#define BWPP_CPU_CONTEXT_H
+
+#include "bwpp_cpu_attention.h"
+#include "bwpp_cpu_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Owns the thread pool so repeated kernel calls never pay thread spawn, and
+   the GEMM pack buffers so repeated matmuls never pay their allocation. */
+typedef struct {
+  BwppCpuPool *pool;
+  uint32_t threads;
+  float *pack_a;     /* BWPP_GEMM_PACK_A_FLOATS per worker, indexed by worker */
+  float *pack_b;     /* B packed once per matmul, read by every C tile */
+  size_t pack_b_cap; /* floats */
+} BwppCpuContext;
+
+/* threads == 0 uses every online core; 1 runs everything on the caller. */
+BwppCpuContext *bwpp_cpu_context_create(uint32_t threads);
+void bwpp_cpu_context_destroy(BwppCpuContext *ctx);
+
+/* Threaded kernels with the contracts of their bwpp_cpu_ref.h counterparts.
+   Matmul packs B once, split by columns of C tiles, then splits C into 2D
+   tiles that each pack their rows of A into the worker's buffer; softmax,
+   rmsnorm and attention split over rows (queries), attention running the
+   tiled kernel per query block. A NULL ctx runs inline. */
+void bwpp_cpu_matmul_ctx_f32(BwppCpuContext *ctx,
+                             const float *a,
+                             const float *b,
+                             float *c,
+                             uint32_t M,
+                             uint32_t N,
+                             uint32_t K,
+                             uint32_t lda,
+                             uint32_t ldb,
+                             uint32_t ldc,
+                             const float *bias,
+                             int apply_silu,
+                             int apply_bias);
+
+/* Threaded bwpp_cpu_gemm_trans_f32: A and/or B read transposed in place. */
+void bwpp_cpu_matmul_trans_ctx_f32(BwppCpuContext *ctx,
+                                   const float *a,
+                                   const float *b,
+                                   float *c,
+                                   uint32_t M,
+                                   uint32_t N,
+                                   uint32_t K,
+                                   uint32_t lda,
+                                   uint32_t ldb,
+                                   uint32_t ldc,
+                                   int trans_a,
+                                   int trans_b,
+                                   const float *bias,
+                                   int apply_silu,
+                                   int apply_bias);
+
+void bwpp_cpu_softmax_ctx_f32(BwppCpuContext *ctx,
+                              const float *x,
+                              float *y,
+                              uint32_t rows,
+                              uint32_t cols,
+                              uint32_t ld);
+
+void bwpp_cpu_rmsnorm_ctx_f32(BwppCpuContext *ctx,
+                              const float *x,
+                              float *y,
+                              const float *gamma,
+                              const float *beta,
+                              uint32_t rows,
+                              uint32_t cols,
+                              uint32_t ld,
+                              float eps);
+
+void bwpp_cpu_attention_ctx_f32(BwppCpuContext *ctx,
+                                const float *q,
+                                const float *k,
+                                const float *v,
+                                float *o,
+                                uint32_t M,
+                                uint32_t N,
+                                uint32_t K,
+                                uint32_t D,
+                                uint32_t ldq,
+                                uint32_t ldk,
+                                uint32_t ldv,
+                                uint32_t ldo);
+
+/* bwpp_cpu_attention_masked_f32 split over (batch, kv head, query block). */
+void bwpp_cpu_attention_masked_ctx_f32(BwppCpuContext *ctx,
+                                       const float *q,
+                                       const float *k,
+                                       const float *v,
+                                       float *o,
+                                       const uint32_t *kv_len,
+                                       const BwppCpuAttentionParams *params);
+
+/* bwpp_cpu_attention_paged_f32 split like the masked path. */
+void bwpp_cpu_attention_paged_ctx_f32(BwppCpuContext *ctx,
+                                      const float *q,
+                                      const BwppCpuKvPages *pages,
+                                      float *o,
+                                      const uint32_t *kv_len,
+                                      const BwppCpuAttentionParams *params);
+
+/* Decode attention (M of 1 up to a few speculative tokens) over a long K/V
+   cache: when batch * kv_heads cannot fill the pool the keys are split
+   across workers and merged. Falls back to the masked path otherwise. */
+void bwpp_cpu_attention_decode_ctx_f32(BwppCpuContext *ctx,
+                                       const float *q,
+                                       const float *k,
+                                       const float *v,
+                                       float *o,
+                                       const uint32_t *kv_len,
+                                       const BwppCpuAttentionParams *params);
+
+#endif
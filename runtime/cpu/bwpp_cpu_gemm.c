@@ -0,0 +1,293 @@
+#include "bwpp_cpu_gemm.h"
+#include "bwpp_cpu_kernels.h"
+#include "bwpp_cpu_ref.h"
+#include <math.h>
+#include <stdlib.h>
+
+static float bwpp_silu(float x) {
+  return x / (1.0f + expf(-x));
+}
+
+static uint32_t bwpp_min_u32(uint32_t a, uint32_t b) {
+  return a < b ? a : b;
+}
+
+static uint32_t bwpp_round_up(uint32_t v, uint32_t m) {
+  return (v + m - 1) / m * m;
+}
+
+/* Pack an mc x kc block of A into mr_tile-row micro-panels, k-major inside each
+   panel, zero-padding the last panel. Element (i, p) sits at a[i * rs + p * cs],
+   so a transposed A packs in place. */
+static void bwpp_pack_a(const float *a,
+                        size_t rs,
+                        size_t cs,
+                        uint32_t mc,
+                        uint32_t kc,
+                        uint32_t mr_tile,
+                        float *dst) {
+  for (uint32_t ir = 0; ir < mc; ir += mr_tile) {
+    uint32_t mr = bwpp_min_u32(mr_tile, mc - ir);
+    for (uint32_t p = 0; p < kc; ++p) {
+      for (uint32_t i = 0; i < mr_tile; ++i) {
+        dst[i] = i < mr ? a[(ir + i) * rs + p * cs] : 0.0f;
+      }
+      dst += mr_tile;
+    }
+  }
+}
+
+/* Pack a kc x nc block of B into nr_tile-column micro-panels, k-major inside each
+   panel, zero-padding the last panel. Element (p, j) sits at b[p * rs + j * cs]. */
+static void bwpp_pack_b(const float *b,
+                        size_t rs,
+                        size_t cs,
+                        uint32_t kc,
+                        uint32_t nc,
+                        uint32_t nr_tile,
+                        float *dst) {
+  for (uint32_t jr = 0; jr < nc; jr += nr_tile) {
+    uint32_t nr = bwpp_min_u32(nr_tile, nc - jr);
+    for (uint32_t p = 0; p < kc; ++p) {
+      const float *src = b + p * rs + jr * cs;
+      if (cs == 1) {
+        for (uint32_t j = 0; j < nr_tile; ++j) {
+          dst[j] = j < nr ? src[j] : 0.0f;
+        }
+      } else {
+        for (uint32_t j = 0; j < nr_tile; ++j) {
+          dst[j] = j < nr ? src[j * cs] : 0.0f;
+        }
+      }
+      dst += nr_tile;
+    }
+  }
+}
+
+/* Unblocked fallback for transposed operands when the pack buffers cannot be
+   allocated. */
+static void bwpp_gemm_strided(const float *a,
+                              size_t rs_a,
+                              size_t cs_a,
+                              const float *b,
+                              size_t rs_b,
+                              size_t cs_b,
+                              float *c,
+                              uint32_t M,
+                              uint32_t N,
+                              uint32_t K,
+                              uint32_t ldc,
+                              const float *bias,
+                              int apply_silu) {
+  for (uint32_t i = 0; i < M; ++i) {
+    for (uint32_t j = 0; j < N; ++j) {
+      float acc = 0.0f;
+      for (uint32_t p = 0; p < K; ++p) {
+        acc += a[i * rs_a + p * cs_a] * b[p * rs_b + j * cs_b];
+      }
+      if (bias) {
+        acc += bias[j];
+      }
+      c[(size_t)i * ldc + j] = apply_silu ? bwpp_silu(acc) : acc;
+    }
+  }
+}
+
+/* Write an mr x nr accumulator tile into C. The first K block overwrites C,
+   later blocks accumulate; the epilogue runs once the last K block lands. */
+static void bwpp_gemm_store(const float *acc,
+                            uint32_t acc_ld,
+                            float *c,
+                            uint32_t ldc,
+                            uint32_t mr,
+                            uint32_t nr,
+                            int first,
+                            int last,
+                            const float *bias,
+                            int apply_silu) {
+  for (uint32_t i = 0; i < mr; ++i) {
+    float *row = c + i * ldc;
+    for (uint32_t j = 0; j < nr; ++j) {
+      float a = acc[i * acc_ld + j];
+      float v = first ? a : row[j] + a;
+      if (last) {
+        if (bias) {
+          v += bias[j];
+        }
+        if (apply_silu) {
+          v = bwpp_silu(v);
+        }
+      }
+      row[j] = v;
+    }
+  }
+}
+
+void bwpp_cpu_gemm_f32(const float *a,
+                       const float *b,
+                       float *c,
+                       uint32_t M,
+                       uint32_t N,
+                       uint32_t K,
+                       uint32_t lda,
+                       uint32_t ldb,
+                       uint32_t ldc,
+                       const float *bias,
+                       int apply_silu,
+                       int apply_bias) {
+  bwpp_cpu_gemm_trans_f32(a, b, c, M, N, K, lda, ldb, ldc, 0, 0, bias, apply_silu, apply_bias);
+}
+
+/* One KC block of C += A * B over nc columns: packs MC x KC blocks of A
+   into pack_a and runs the micro-kernel against B panels already packed at
+   pack_b (panel jr at pack_b + jr * kc). */
+static void bwpp_gemm_block(const BwppCpuKernels *kern,
+                            const float *a,
+                            size_t rs_a,
+                            size_t cs_a,
+                            const float *pack_b,
+                            float *c,
+                            uint32_t M,
+                            uint32_t nc,
+                            uint32_t kc,
+                            uint32_t ldc,
+                            int first,
+                            int last,
+                            const float *bias,
+                            int apply_silu,
+                            float *pack_a) {
+  uint32_t mr_tile = kern->mr;
+  uint32_t nr_tile = kern->nr;
+  /* keep MC a multiple of the register tile so only the last panel pads */
+  uint32_t mc_block = BWPP_GEMM_MC / mr_tile * mr_tile;
+  float acc[BWPP_GEMM_MR_MAX * BWPP_GEMM_NR_MAX];
+  for (uint32_t ic = 0; ic < M; ic += mc_block) {
+    uint32_t mc = bwpp_min_u32(mc_block, M - ic);
+    bwpp_pack_a(a + ic * rs_a, rs_a, cs_a, mc, kc, mr_tile, pack_a);
+    for (uint32_t jr = 0; jr < nc; jr += nr_tile) {
+      uint32_t nr = bwpp_min_u32(nr_tile, nc - jr);
+      const float *bp = pack_b + (size_t)jr * kc;
+      for (uint32_t ir = 0; ir < mc; ir += mr_tile) {
+        uint32_t mr = bwpp_min_u32(mr_tile, mc - ir);
+        const float *ap = pack_a + (size_t)ir * kc;
+        kern->gemm_ukernel(kc, ap, bp, acc);
+        bwpp_gemm_store(acc, nr_tile, c + (size_t)(ic + ir) * ldc + jr, ldc, mr, nr,
+                        first, last, bias ? bias + jr : NULL, apply_silu);
+      }
+    }
+  }
+}
+
+void bwpp_cpu_gemm_trans_f32(const float *a,
+                             const float *b,
+                             float *c,
+                             uint32_t M,
+                             uint32_t N,
+                             uint32_t K,
+                             uint32_t lda,
+                             uint32_t ldb,
+                             uint32_t ldc,
+                             int trans_a,
+                             int trans_b,
+                             const float *bias,
+                             int apply_silu,
+                             int apply_bias) {
+  if (!a || !b || !c || M == 0 || N == 0) {
+    return;
+  }
+  size_t rs_a = trans_a ? 1 : lda;
+  size_t cs_a = trans_a ? lda : 1;
+  size_t rs_b = trans_b ? 1 : ldb;
+  size_t cs_b = trans_b ? ldb : 1;
+  if (K == 0) {
+    bwpp_cpu_matmul_f32(a, b, c, M, N, K, lda, ldb, ldc, bias, apply_silu, apply_bias);
+    return;
+  }
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  uint32_t nr_tile = kern->nr;
+  const float *ep_bias = (apply_bias && bias) ? bias : NULL;
+  uint32_t kc_max = bwpp_min_u32(K, BWPP_GEMM_KC);
+  uint32_t mc_max = bwpp_round_up(bwpp_min_u32(M, BWPP_GEMM_MC / kern->mr * kern->mr), kern->mr);
+  uint32_t nc_max = bwpp_round_up(bwpp_min_u32(N, BWPP_GEMM_NC), nr_tile);
+  float *pack_a = (float *)malloc(sizeof(float) * (size_t)mc_max * kc_max);
+  float *pack_b = (float *)malloc(sizeof(float) * (size_t)nc_max * kc_max);
+  if (!pack_a || !pack_b) {
+    free(pack_a);
+    free(pack_b);
+    if (trans_a || trans_b) {
+      bwpp_gemm_strided(a, rs_a, cs_a, b, rs_b, cs_b, c, M, N, K, ldc, ep_bias, apply_silu);
+    } else {
+      bwpp_cpu_matmul_f32(a, b, c, M, N, K, lda, ldb, ldc, bias, apply_silu, apply_bias);
+    }
+    return;
+  }
+
+  for (uint32_t jc = 0; jc < N; jc += BWPP_GEMM_NC) {
+    uint32_t nc = bwpp_min_u32(BWPP_GEMM_NC, N - jc);
+    for (uint32_t pc = 0; pc < K; pc += BWPP_GEMM_KC) {
+      uint32_t kc = bwpp_min_u32(BWPP_GEMM_KC, K - pc);
+      bwpp_pack_b(b + pc * rs_b + jc * cs_b, rs_b, cs_b, kc, nc, nr_tile, pack_b);
+      bwpp_gemm_block(kern, a + pc * cs_a, rs_a, cs_a, pack_b, c + jc, M, nc, kc, ldc,
+                      pc == 0, pc + kc == K, ep_bias ? ep_bias + jc : NULL, apply_silu, pack_a);
+    }
+  }
+
+  free(pack_a);
+  free(pack_b);
+}
+
+size_t bwpp_cpu_gemm_packed_b_floats(uint32_t N, uint32_t K) {
+  return (size_t)bwpp_round_up(N, bwpp_cpu_kernels()->nr) * K;
+}
+
+void bwpp_cpu_gemm_pack_b_f32(const float *b,
+                              uint32_t N,
+                              uint32_t K,
+                              uint32_t ldb,
+                              int trans_b,
+                              uint32_t j0,
+                              uint32_t j1,
+                              float *packed) {
+  if (!b || !packed || j0 >= j1 || j1 > N) {
+    return;
+  }
+  size_t rs_b = trans_b ? 1 : ldb;
+  size_t cs_b = trans_b ? ldb : 1;
+  uint32_t nr_tile = bwpp_cpu_kernels()->nr;
+  size_t n_pad = bwpp_round_up(N, nr_tile);
+  for (uint32_t pc = 0; pc < K; pc += BWPP_GEMM_KC) {
+    uint32_t kc = bwpp_min_u32(BWPP_GEMM_KC, K - pc);
+    bwpp_pack_b(b + pc * rs_b + j0 * cs_b, rs_b, cs_b, kc, j1 - j0, nr_tile,
+                packed + pc * n_pad + (size_t)j0 * kc);
+  }
+}
+
+void bwpp_cpu_gemm_packed_f32(const float *a,
+                              const float *packed_b,
+                              float *c,
+                              uint32_t M,
+                              uint32_t N,
+                              uint32_t K,
+                              uint32_t lda,
+                              uint32_t ldc,
+                              int trans_a,
+                              uint32_t j0,
+                              uint32_t nt,
+                              const float *bias,
+                              int apply_silu,
+                              int apply_bias,
+                              float *pack_a) {
+  if (!a || !packed_b || !c || !pack_a || M == 0 || nt == 0 || K == 0) {
+    return;
+  }
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  size_t rs_a = trans_a ? 1 : lda;
+  size_t cs_a = trans_a ? lda : 1;
+  size_t n_pad = bwpp_round_up(N, kern->nr);
+  const float *ep_bias = (apply_bias && bias) ? bias : NULL;
+  for (uint32_t pc = 0; pc < K; pc += BWPP_GEMM_KC) {
+    uint32_t kc = bwpp_min_u32(BWPP_GEMM_KC, K - pc);
+    bwpp_gemm_block(kern, a + pc * cs_a, rs_a, cs_a, packed_b + pc * n_pad + (size_t)j0 * kc, c,
+                    M, nt, kc, ldc, pc == 0, pc + kc == K, ep_bias, apply_silu, pack_a);
+  }
+}
@@ -0,0 +1,99 @@
+#ifndef BWPP_CPU_GEMM_H
+#define BWPP_CPU_GEMM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Cache blocking: KC x NR B panel stays in L1, MC x KC A block in L2,
+   KC x NC B block in L3. */
+#define BWPP_GEMM_KC 256
+#define BWPP_GEMM_MC 128
+#define BWPP_GEMM_NC 4096
+
+/* A scratch one packed GEMM call needs: an MC x KC block. */
+#define BWPP_GEMM_PACK_A_FLOATS ((size_t)BWPP_GEMM_MC * BWPP_GEMM_KC)
+
+typedef void (*BwppCpuMatmulFn)(const float *a,
+                                const float *b,
+                                float *c,
+                                uint32_t M,
+                                uint32_t N,
+                                uint32_t K,
+                                uint32_t lda,
+                                uint32_t ldb,
+                                uint32_t ldc,
+                                const float *bias,
+                                int apply_silu,
+                                int apply_bias);
+
+/* Packed, cache-blocked GEMM. Same contract as bwpp_cpu_matmul_f32. The
+   micro-kernel and its register tile come from the active bwpp_cpu_kernels()
+   table. */
+void bwpp_cpu_gemm_f32(const float *a,
+                       const float *b,
+                       float *c,
+                       uint32_t M,
+                       uint32_t N,
+                       uint32_t K,
+                       uint32_t lda,
+                       uint32_t ldb,
+                       uint32_t ldc,
+                       const float *bias,
+                       int apply_silu,
+                       int apply_bias);
+
+/* bwpp_cpu_gemm_f32 with an operand stored transposed: under trans_a, A is
+   K x M with row stride lda; under trans_b, B is N x K with row stride ldb.
+   Packing reads them in place, so neither is copied first. */
+void bwpp_cpu_gemm_trans_f32(const float *a,
+                             const float *b,
+                             float *c,
+                             uint32_t M,
+                             uint32_t N,
+                             uint32_t K,
+                             uint32_t lda,
+                             uint32_t ldb,
+                             uint32_t ldc,
+                             int trans_a,
+                             int trans_b,
+                             const float *bias,
+                             int apply_silu,
+                             int apply_bias);
+
+/* B packed once and shared by several GEMM calls, so the threaded matmul
+   does not repack it for every C tile. Columns are padded to the register
+   tile; each KC block of rows holds NR-wide, k-major panels. */
+size_t bwpp_cpu_gemm_packed_b_floats(uint32_t N, uint32_t K);
+
+/* Packs columns [j0, j1) of B (trans_b as in bwpp_cpu_gemm_trans_f32) into
+   the shared layout. j0 must be a multiple of the register tile NR, so
+   disjoint column ranges can be packed in parallel. */
+void bwpp_cpu_gemm_pack_b_f32(const float *b,
+                              uint32_t N,
+                              uint32_t K,
+                              uint32_t ldb,
+                              int trans_b,
+                              uint32_t j0,
+                              uint32_t j1,
+                              float *packed);
+
+/* C (M x nt) = A * B[:, j0 .. j0 + nt) from a B packed whole (N columns).
+   j0 is a multiple of NR; bias starts at column j0. pack_a holds
+   BWPP_GEMM_PACK_A_FLOATS of caller-owned scratch. K must be nonzero. */
+void bwpp_cpu_gemm_packed_f32(const float *a,
+                              const float *packed_b,
+                              float *c,
+                              uint32_t M,
+                              uint32_t N,
+                              uint32_t K,
+                              uint32_t lda,
+                              uint32_t ldc,
+                              int trans_a,
+                              uint32_t j0,
+                              uint32_t nt,
+                              const float *bias,
+                              int apply_silu,
+                              int apply_bias,
+                              float *pack_a);
+
+#endif
@@ -0,0 +1,289 @@
+#include "bwpp_cpu_kernels.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+#define SCALAR_MR 4
+#define SCALAR_NR 8
+
+static void bwpp_scalar_gemm_ukernel(uint32_t kc, const float *ap, const float *bp, float *acc) {
+  float c[SCALAR_MR][SCALAR_NR];
+  for (uint32_t i = 0; i < SCALAR_MR; ++i) {
+    for (uint32_t j = 0; j < SCALAR_NR; ++j) {
+      c[i][j] = 0.0f;
+    }
+  }
+  for (uint32_t p = 0; p < kc; ++p) {
+    for (uint32_t i = 0; i < SCALAR_MR; ++i) {
+      float av = ap[i];
+      for (uint32_t j = 0; j < SCALAR_NR; ++j) {
+        c[i][j] += av * bp[j];
+      }
+    }
+    ap += SCALAR_MR;
+    bp += SCALAR_NR;
+  }
+  for (uint32_t i = 0; i < SCALAR_MR; ++i) {
+    for (uint32_t j = 0; j < SCALAR_NR; ++j) {
+      acc[i * SCALAR_NR + j] = c[i][j];
+    }
+  }
+}
+
+static float bwpp_scalar_dot(const float *a, const float *b, uint32_t n) {
+  float acc = 0.0f;
+  for (uint32_t i = 0; i < n; ++i) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+static void bwpp_scalar_axpy(float *y, float alpha, const float *x, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+static void bwpp_scalar_scale(float *y, float alpha, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    y[i] *= alpha;
+  }
+}
+
+static void bwpp_scalar_softmax_row(const float *x, float *y, uint32_t n) {
+  float maxv = -INFINITY;
+  for (uint32_t c = 0; c < n; ++c) {
+    if (x[c] > maxv) {
+      maxv = x[c];
+    }
+  }
+  float sum = 0.0f;
+  for (uint32_t c = 0; c < n; ++c) {
+    float e = expf(x[c] - maxv);
+    y[c] = e;
+    sum += e;
+  }
+  float inv = sum > 0.0f ? (1.0f / sum) : 0.0f;
+  for (uint32_t c = 0; c < n; ++c) {
+    y[c] *= inv;
+  }
+}
+
+static void bwpp_scalar_rmsnorm_row(const float *x,
+                                    float *y,
+                                    const float *gamma,
+                                    const float *beta,
+                                    uint32_t n,
+                                    float eps) {
+  float sumsq = 0.0f;
+  for (uint32_t c = 0; c < n; ++c) {
+    sumsq += x[c] * x[c];
+  }
+  float inv = 1.0f / sqrtf(sumsq / (float)n + eps);
+  for (uint32_t c = 0; c < n; ++c) {
+    float v = x[c] * inv;
+    if (gamma) {
+      v *= gamma[c];
+    }
+    if (beta) {
+      v += beta[c];
+    }
+    y[c] = v;
+  }
+}
+
+static const BwppCpuKernels bwpp_scalar_kernels = {
+  BWPP_CPU_ISA_SCALAR,
+  "scalar",
+  SCALAR_MR,
+  SCALAR_NR,
+  bwpp_scalar_gemm_ukernel,
+  bwpp_scalar_dot,
+  bwpp_scalar_axpy,
+  bwpp_scalar_scale,
+  bwpp_scalar_softmax_row,
+  bwpp_scalar_rmsnorm_row
+};
+
+static int bwpp_host_supports(BwppCpuIsa isa) {
+  switch (isa) {
+    case BWPP_CPU_ISA_SCALAR:
+      return 1;
+#if defined(__x86_64__) || defined(__i386__)
+    case BWPP_CPU_ISA_SSE4:
+      return __builtin_cpu_supports("sse4.1");
+    case BWPP_CPU_ISA_AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case BWPP_CPU_ISA_AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+#if defined(__aarch64__)
+    case BWPP_CPU_ISA_NEON:
+#if defined(__linux__) && defined(HWCAP_ASIMD)
+      return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#else
+      return 1;
+#endif
+#endif
+    default:
+      return 0;
+  }
+}
+
+const BwppCpuKernels *bwpp_cpu_kernels_get(BwppCpuIsa isa) {
+  const BwppCpuKernels *table = NULL;
+  switch (isa) {
+    case BWPP_CPU_ISA_SCALAR: table = &bwpp_scalar_kernels; break;
+    case BWPP_CPU_ISA_SSE4: table = bwpp_cpu_kernels_sse4(); break;
+    case BWPP_CPU_ISA_AVX2: table = bwpp_cpu_kernels_avx2(); break;
+    case BWPP_CPU_ISA_AVX512: table = bwpp_cpu_kernels_avx512(); break;
+    case BWPP_CPU_ISA_NEON: table = bwpp_cpu_kernels_neon(); break;
+    default: break;
+  }
+  if (!table || !bwpp_host_supports(isa)) {
+    return NULL;
+  }
+  return table;
+}
+
+const char *bwpp_cpu_isa_name(BwppCpuIsa isa) {
+  switch (isa) {
+    case BWPP_CPU_ISA_SCALAR: return "scalar";
+    case BWPP_CPU_ISA_SSE4: return "sse4";
+    case BWPP_CPU_ISA_AVX2: return "avx2";
+    case BWPP_CPU_ISA_AVX512: return "avx512";
+    case BWPP_CPU_ISA_NEON: return "neon";
+    default: return "unknown";
+  }
+}
+
+int bwpp_cpu_isa_parse(const char *name, BwppCpuIsa *out) {
+  if (!name) {
+    return 0;
+  }
+  for (int i = 0; i < BWPP_CPU_ISA_COUNT; ++i) {
+    if (strcmp(name, bwpp_cpu_isa_name((BwppCpuIsa)i)) == 0) {
+      *out = (BwppCpuIsa)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Widest first; BWPP_CPU_ISA skips everything ahead of the named ISA. */
+static const BwppCpuIsa bwpp_isa_preference[] = {
+  BWPP_CPU_ISA_AVX512,
+  BWPP_CPU_ISA_AVX2,
+  BWPP_CPU_ISA_SSE4,
+  BWPP_CPU_ISA_NEON,
+  BWPP_CPU_ISA_SCALAR
+};
+
+static const BwppCpuKernels *bwpp_active_kernels = NULL;
+
+static const BwppCpuKernels *bwpp_detect_kernels(void) {
+  uint32_t count = (uint32_t)(sizeof(bwpp_isa_preference) / sizeof(bwpp_isa_preference[0]));
+  uint32_t start = 0;
+  BwppCpuIsa cap;
+  const char *env = getenv("BWPP_CPU_ISA");
+  if (env && bwpp_cpu_isa_parse(env, &cap)) {
+    while (start < count && bwpp_isa_preference[start] != cap) {
+      start++;
+    }
+  }
+  for (uint32_t i = start; i < count; ++i) {
+    const BwppCpuKernels *table = bwpp_cpu_kernels_get(bwpp_isa_preference[i]);
+    if (table) {
+      return table;
+    }
+  }
+  return &bwpp_scalar_kernels;
+}
+
+const BwppCpuKernels *bwpp_cpu_kernels(void) {
+  if (!bwpp_active_kernels) {
+    bwpp_active_kernels = bwpp_detect_kernels();
+  }
+  return bwpp_active_kernels;
+}
+
+int bwpp_cpu_kernels_select(BwppCpuIsa isa) {
+  const BwppCpuKernels *table = bwpp_cpu_kernels_get(isa);
+  if (!table) {
+    return 0;
+  }
+  bwpp_active_kernels = table;
+  return 1;
+}
+
+void bwpp_cpu_softmax_simd_f32(const float *x,
+                               float *y,
+                               uint32_t rows,
+                               uint32_t cols,
+                               uint32_t ld) {
+  if (!x || !y) {
+    return;
+  }
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  for (uint32_t r = 0; r < rows; ++r) {
+    kern->softmax_row(x + (size_t)r * ld, y + (size_t)r * ld, cols);
+  }
+}
+
+void bwpp_cpu_rmsnorm_simd_f32(const float *x,
+                               float *y,
+                               const float *gamma,
+                               const float *beta,
+                               uint32_t rows,
+                               uint32_t cols,
+                               uint32_t ld,
+                               float eps) {
+  if (!x || !y || cols == 0) {
+    return;
+  }
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  for (uint32_t r = 0; r < rows; ++r) {
+    kern->rmsnorm_row(x + (size_t)r * ld, y + (size_t)r * ld, gamma, beta, cols, eps);
+  }
+}
+
+void bwpp_cpu_attention_simd_f32(const float *q,
+                                 const float *k,
+                                 const float *v,
+                                 float *o,
+                                 uint32_t M,
+                                 uint32_t N,
+                                 uint32_t K,
+                                 uint32_t D,
+                                 uint32_t ldq,
+                                 uint32_t ldk,
+                                 uint32_t ldv,
+                                 uint32_t ldo) {
+  if (!q || !k || !v || !o) {
+    return;
+  }
+  const BwppCpuKernels *kern = bwpp_cpu_kernels();
+  float *scores = (float *)malloc(sizeof(float) * (N ? N : 1));
+  if (!scores) {
+    return;
+  }
+  for (uint32_t m = 0; m < M; ++m) {
+    const float *qrow = q + (size_t)m * ldq;
+    float *orow = o + (size_t)m * ldo;
+    for (uint32_t n = 0; n < N; ++n) {
+      scores[n] = kern->dot(qrow, k + (size_t)n * ldk, K);
+    }
+    kern->softmax_row(scores, scores, N);
+    for (uint32_t d = 0; d < D; ++d) {
+      orow[d] = 0.0f;
+    }
+    for (uint32_t n = 0; n < N; ++n) {
+      kern->axpy(orow, scores[n], v + (size_t)n * ldv, D);
+    }
+  }
+  free(scores);
+}
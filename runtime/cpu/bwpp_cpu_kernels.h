@@ -0,0 +1,90 @@
+#ifndef BWPP_CPU_KERNELS_H
+#define BWPP_CPU_KERNELS_H
+
+#include <stdint.h>
+
+/* Largest register tile any ISA uses; GEMM scratch is sized from these. */
+#define BWPP_GEMM_MR_MAX 8
+#define BWPP_GEMM_NR_MAX 32
+
+typedef enum {
+  BWPP_CPU_ISA_SCALAR = 0,
+  BWPP_CPU_ISA_SSE4,
+  BWPP_CPU_ISA_AVX2,
+  BWPP_CPU_ISA_AVX512,
+  BWPP_CPU_ISA_NEON,
+  BWPP_CPU_ISA_COUNT
+} BwppCpuIsa;
+
+/* Per-ISA kernel table. The scalar table is the fallback and the oracle the
+   vector tables are tested against. */
+typedef struct {
+  BwppCpuIsa isa;
+  const char *name;
+  uint32_t mr;
+  uint32_t nr;
+  /* acc[mr * nr] = packed A panel (kc x mr) times packed B panel (kc x nr). */
+  void (*gemm_ukernel)(uint32_t kc, const float *ap, const float *bp, float *acc);
+  float (*dot)(const float *a, const float *b, uint32_t n);
+  void (*axpy)(float *y, float alpha, const float *x, uint32_t n);
+  void (*scale)(float *y, float alpha, uint32_t n);
+  void (*softmax_row)(const float *x, float *y, uint32_t n);
+  void (*rmsnorm_row)(const float *x,
+                      float *y,
+                      const float *gamma,
+                      const float *beta,
+                      uint32_t n,
+                      float eps);
+} BwppCpuKernels;
+
+/* Active table. Chosen on first use from CPUID (x86) or HWCAP (ARM); the
+   BWPP_CPU_ISA environment variable (scalar|sse4|avx2|avx512|neon) caps it. */
+const BwppCpuKernels *bwpp_cpu_kernels(void);
+
+/* Table for one ISA, or NULL when it is not compiled in or not supported by
+   the host. */
+const BwppCpuKernels *bwpp_cpu_kernels_get(BwppCpuIsa isa);
+
+/* Force the active table (tests, benchmarks). Returns 0 if unsupported. */
+int bwpp_cpu_kernels_select(BwppCpuIsa isa);
+
+const char *bwpp_cpu_isa_name(BwppCpuIsa isa);
+int bwpp_cpu_isa_parse(const char *name, BwppCpuIsa *out);
+
+/* Vectorized counterparts of the reference kernels, same contracts. */
+void bwpp_cpu_softmax_simd_f32(const float *x,
+                               float *y,
+                               uint32_t rows,
+                               uint32_t cols,
+                               uint32_t ld);
+
+void bwpp_cpu_rmsnorm_simd_f32(const float *x,
+                               float *y,
+                               const float *gamma,
+                               const float *beta,
+                               uint32_t rows,
+                               uint32_t cols,
+                               uint32_t ld,
+                               float eps);
+
+void bwpp_cpu_attention_simd_f32(const float *q,
+                                 const float *k,
+                                 const float *v,
+                                 float *o,
+                                 uint32_t M,
+                                 uint32_t N,
+                                 uint32_t K,
+                                 uint32_t D,
+                                 uint32_t ldq,
+                                 uint32_t ldk,
+                                 uint32_t ldv,
+                                 uint32_t ldo);
+
+/* Per-ISA tables, defined in bwpp_cpu_kernels_x86.c / bwpp_cpu_kernels_neon.c.
+   They return NULL when the file was built for another architecture. */
+const BwppCpuKernels *bwpp_cpu_kernels_sse4(void);
+const BwppCpuKernels *bwpp_cpu_kernels_avx2(void);
+const BwppCpuKernels *bwpp_cpu_kernels_avx512(void);
+const BwppCpuKernels *bwpp_cpu_kernels_neon(void);
+
+#endif
@@ -0,0 +1,183 @@
+#include "bwpp_cpu_kernels.h"
+#include <stddef.h>
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+#include <math.h>
+
+/* 8x8 register tile: 16 accumulators out of 32 vector registers. */
+#define NEON_MR 8
+#define NEON_NR 8
+
+/* Same Cephes-style expf as the x86 kernels. */
+static float32x4_t bwpp_neon_exp(float32x4_t x) {
+  x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-87.3365447505531f)), vdupq_n_f32(88.3762626647949f));
+  float32x4_t n = vrndnq_f32(vmulq_n_f32(x, 1.44269504088896341f));
+  x = vfmsq_n_f32(x, n, 0.693359375f);
+  x = vfmsq_n_f32(x, n, -2.12194440e-4f);
+  float32x4_t y = vdupq_n_f32(1.9875691500e-4f);
+  y = vfmaq_f32(vdupq_n_f32(1.3981999507e-3f), y, x);
+  y = vfmaq_f32(vdupq_n_f32(8.3334519073e-3f), y, x);
+  y = vfmaq_f32(vdupq_n_f32(4.1665795894e-2f), y, x);
+  y = vfmaq_f32(vdupq_n_f32(1.6666665459e-1f), y, x);
+  y = vfmaq_f32(vdupq_n_f32(5.0000001201e-1f), y, x);
+  y = vfmaq_f32(vaddq_f32(x, vdupq_n_f32(1.0f)), vmulq_f32(y, x), x);
+  int32x4_t e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+  return vmulq_f32(y, vreinterpretq_f32_s32(e));
+}
+
+static void bwpp_neon_gemm_ukernel(uint32_t kc, const float *ap, const float *bp, float *acc) {
+  float32x4_t c[NEON_MR][2];
+  for (uint32_t i = 0; i < NEON_MR; ++i) {
+    c[i][0] = vdupq_n_f32(0.0f);
+    c[i][1] = vdupq_n_f32(0.0f);
+  }
+  for (uint32_t p = 0; p < kc; ++p) {
+    float32x4_t b0 = vld1q_f32(bp);
+    float32x4_t b1 = vld1q_f32(bp + 4);
+    float32x4_t a0 = vld1q_f32(ap);
+    float32x4_t a1 = vld1q_f32(ap + 4);
+    c[0][0] = vfmaq_laneq_f32(c[0][0], b0, a0, 0);
+    c[0][1] = vfmaq_laneq_f32(c[0][1], b1, a0, 0);
+    c[1][0] = vfmaq_laneq_f32(c[1][0], b0, a0, 1);
+    c[1][1] = vfmaq_laneq_f32(c[1][1], b1, a0, 1);
+    c[2][0] = vfmaq_laneq_f32(c[2][0], b0, a0, 2);
+    c[2][1] = vfmaq_laneq_f32(c[2][1], b1, a0, 2);
+    c[3][0] = vfmaq_laneq_f32(c[3][0], b0, a0, 3);
+    c[3][1] = vfmaq_laneq_f32(c[3][1], b1, a0, 3);
+    c[4][0] = vfmaq_laneq_f32(c[4][0], b0, a1, 0);
+    c[4][1] = vfmaq_laneq_f32(c[4][1], b1, a1, 0);
+    c[5][0] = vfmaq_laneq_f32(c[5][0], b0, a1, 1);
+    c[5][1] = vfmaq_laneq_f32(c[5][1], b1, a1, 1);
+    c[6][0] = vfmaq_laneq_f32(c[6][0], b0, a1, 2);
+    c[6][1] = vfmaq_laneq_f32(c[6][1], b1, a1, 2);
+    c[7][0] = vfmaq_laneq_f32(c[7][0], b0, a1, 3);
+    c[7][1] = vfmaq_laneq_f32(c[7][1], b1, a1, 3);
+    ap += NEON_MR;
+    bp += NEON_NR;
+  }
+  for (uint32_t i = 0; i < NEON_MR; ++i) {
+    vst1q_f32(acc + i * NEON_NR, c[i][0]);
+    vst1q_f32(acc + i * NEON_NR + 4, c[i][1]);
+  }
+}
+
+static float bwpp_neon_dot(const float *a, const float *b, uint32_t n) {
+  float32x4_t s0 = vdupq_n_f32(0.0f);
+  float32x4_t s1 = vdupq_n_f32(0.0f);
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    s0 = vfmaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+    s1 = vfmaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  for (; i + 4 <= n; i += 4) {
+    s0 = vfmaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  float acc = vaddvq_f32(vaddq_f32(s0, s1));
+  for (; i < n; ++i) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+static void bwpp_neon_axpy(float *y, float alpha, const float *x, uint32_t n) {
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vfmaq_n_f32(vld1q_f32(y + i), vld1q_f32(x + i), alpha));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+static void bwpp_neon_scale(float *y, float alpha, uint32_t n) {
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vmulq_n_f32(vld1q_f32(y + i), alpha));
+  }
+  for (; i < n; ++i) {
+    y[i] *= alpha;
+  }
+}
+
+static void bwpp_neon_softmax_row(const float *x, float *y, uint32_t n) {
+  uint32_t i = 0;
+  float32x4_t vmax = vdupq_n_f32(-INFINITY);
+  for (; i + 4 <= n; i += 4) {
+    vmax = vmaxq_f32(vmax, vld1q_f32(x + i));
+  }
+  float maxv = vmaxvq_f32(vmax);
+  for (; i < n; ++i) {
+    maxv = x[i] > maxv ? x[i] : maxv;
+  }
+  float32x4_t vm = vdupq_n_f32(maxv);
+  float32x4_t vsum = vdupq_n_f32(0.0f);
+  for (i = 0; i + 4 <= n; i += 4) {
+    float32x4_t e = bwpp_neon_exp(vsubq_f32(vld1q_f32(x + i), vm));
+    vst1q_f32(y + i, e);
+    vsum = vaddq_f32(vsum, e);
+  }
+  float sum = vaddvq_f32(vsum);
+  for (; i < n; ++i) {
+    float e = expf(x[i] - maxv);
+    y[i] = e;
+    sum += e;
+  }
+  bwpp_neon_scale(y, sum > 0.0f ? (1.0f / sum) : 0.0f, n);
+}
+
+static void bwpp_neon_rmsnorm_row(const float *x,
+                                  float *y,
+                                  const float *gamma,
+                                  const float *beta,
+                                  uint32_t n,
+                                  float eps) {
+  float inv = 1.0f / sqrtf(bwpp_neon_dot(x, x, n) / (float)n + eps);
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v = vmulq_n_f32(vld1q_f32(x + i), inv);
+    if (gamma) {
+      v = vmulq_f32(v, vld1q_f32(gamma + i));
+    }
+    if (beta) {
+      v = vaddq_f32(v, vld1q_f32(beta + i));
+    }
+    vst1q_f32(y + i, v);
+  }
+  for (; i < n; ++i) {
+    float v = x[i] * inv;
+    if (gamma) {
+      v *= gamma[i];
+    }
+    if (beta) {
+      v += beta[i];
+    }
+    y[i] = v;
+  }
+}
+
+static const BwppCpuKernels bwpp_neon_kernels = {
+  BWPP_CPU_ISA_NEON,
+  "neon",
+  NEON_MR,
+  NEON_NR,
+  bwpp_neon_gemm_ukernel,
+  bwpp_neon_dot,
+  bwpp_neon_axpy,
+  bwpp_neon_scale,
+  bwpp_neon_softmax_row,
+  bwpp_neon_rmsnorm_row
+};
+
+const BwppCpuKernels *bwpp_cpu_kernels_neon(void) {
+  return &bwpp_neon_kernels;
+}
+
+#else
+
+const BwppCpuKernels *bwpp_cpu_kernels_neon(void) {
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,561 @@
+#include "bwpp_cpu_kernels.h"
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <math.h>
+
+/* Each ISA is compiled with a per-function target attribute so the file
+   builds with baseline flags; dispatch guarantees it only runs on hosts that
+   have the instructions. */
+#define BWPP_SSE4 __attribute__((target("sse4.1")))
+#define BWPP_AVX2 __attribute__((target("avx2,fma")))
+#define BWPP_AVX512 __attribute__((target("avx512f")))
+
+/* Cephes-style expf: range-reduce to x = n*ln2 + r, degree-5 polynomial for
+   e^r, scale by 2^n through the exponent bits. Input is clamped so n stays
+   in the normal range. */
+#define EXP_HI 88.3762626647949f
+#define EXP_LO -87.3365447505531f
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+/* ---- SSE4: 4x8 register tile ---- */
+
+#define SSE4_MR 4
+#define SSE4_NR 8
+
+BWPP_SSE4 static __m128 bwpp_sse4_exp(__m128 x) {
+  x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+  __m128 n = _mm_round_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)),
+                          _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(EXP_C1)));
+  x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(EXP_C2)));
+  __m128 y = _mm_set1_ps(EXP_P0);
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+  y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, x), x), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+  __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23);
+  return _mm_mul_ps(y, _mm_castsi128_ps(e));
+}
+
+BWPP_SSE4 static float bwpp_sse4_hsum(__m128 v) {
+  __m128 sh = _mm_movehdup_ps(v);
+  __m128 s = _mm_add_ps(v, sh);
+  sh = _mm_movehl_ps(sh, s);
+  return _mm_cvtss_f32(_mm_add_ss(s, sh));
+}
+
+BWPP_SSE4 static float bwpp_sse4_hmax(__m128 v) {
+  v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+BWPP_SSE4 static void bwpp_sse4_gemm_ukernel(uint32_t kc, const float *ap, const float *bp, float *acc) {
+  __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+  __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+  __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+  __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+  for (uint32_t p = 0; p < kc; ++p) {
+    __m128 b0 = _mm_loadu_ps(bp);
+    __m128 b1 = _mm_loadu_ps(bp + 4);
+    __m128 a = _mm_set1_ps(ap[0]);
+    c00 = _mm_add_ps(c00, _mm_mul_ps(a, b0));
+    c01 = _mm_add_ps(c01, _mm_mul_ps(a, b1));
+    a = _mm_set1_ps(ap[1]);
+    c10 = _mm_add_ps(c10, _mm_mul_ps(a, b0));
+    c11 = _mm_add_ps(c11, _mm_mul_ps(a, b1));
+    a = _mm_set1_ps(ap[2]);
+    c20 = _mm_add_ps(c20, _mm_mul_ps(a, b0));
+    c21 = _mm_add_ps(c21, _mm_mul_ps(a, b1));
+    a = _mm_set1_ps(ap[3]);
+    c30 = _mm_add_ps(c30, _mm_mul_ps(a, b0));
+    c31 = _mm_add_ps(c31, _mm_mul_ps(a, b1));
+    ap += SSE4_MR;
+    bp += SSE4_NR;
+  }
+  _mm_storeu_ps(acc + 0, c00);
+  _mm_storeu_ps(acc + 4, c01);
+  _mm_storeu_ps(acc + 8, c10);
+  _mm_storeu_ps(acc + 12, c11);
+  _mm_storeu_ps(acc + 16, c20);
+  _mm_storeu_ps(acc + 20, c21);
+  _mm_storeu_ps(acc + 24, c30);
+  _mm_storeu_ps(acc + 28, c31);
+}
+
+BWPP_SSE4 static float bwpp_sse4_dot(const float *a, const float *b, uint32_t n) {
+  __m128 s0 = _mm_setzero_ps();
+  __m128 s1 = _mm_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  for (; i + 4 <= n; i += 4) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float acc = bwpp_sse4_hsum(_mm_add_ps(s0, s1));
+  for (; i < n; ++i) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+BWPP_SSE4 static void bwpp_sse4_axpy(float *y, float alpha, const float *x, uint32_t n) {
+  __m128 va = _mm_set1_ps(alpha);
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+BWPP_SSE4 static void bwpp_sse4_scale(float *y, float alpha, uint32_t n) {
+  __m128 va = _mm_set1_ps(alpha);
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(y + i), va));
+  }
+  for (; i < n; ++i) {
+    y[i] *= alpha;
+  }
+}
+
+BWPP_SSE4 static void bwpp_sse4_softmax_row(const float *x, float *y, uint32_t n) {
+  uint32_t i = 0;
+  __m128 vmax = _mm_set1_ps(-INFINITY);
+  for (; i + 4 <= n; i += 4) {
+    vmax = _mm_max_ps(vmax, _mm_loadu_ps(x + i));
+  }
+  float maxv = bwpp_sse4_hmax(vmax);
+  for (; i < n; ++i) {
+    maxv = x[i] > maxv ? x[i] : maxv;
+  }
+  __m128 vm = _mm_set1_ps(maxv);
+  __m128 vsum = _mm_setzero_ps();
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128 e = bwpp_sse4_exp(_mm_sub_ps(_mm_loadu_ps(x + i), vm));
+    _mm_storeu_ps(y + i, e);
+    vsum = _mm_add_ps(vsum, e);
+  }
+  float sum = bwpp_sse4_hsum(vsum);
+  for (; i < n; ++i) {
+    float e = expf(x[i] - maxv);
+    y[i] = e;
+    sum += e;
+  }
+  bwpp_sse4_scale(y, sum > 0.0f ? (1.0f / sum) : 0.0f, n);
+}
+
+BWPP_SSE4 static void bwpp_sse4_rmsnorm_row(const float *x,
+                                            float *y,
+                                            const float *gamma,
+                                            const float *beta,
+                                            uint32_t n,
+                                            float eps) {
+  float inv = 1.0f / sqrtf(bwpp_sse4_dot(x, x, n) / (float)n + eps);
+  __m128 vi = _mm_set1_ps(inv);
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(x + i), vi);
+    if (gamma) {
+      v = _mm_mul_ps(v, _mm_loadu_ps(gamma + i));
+    }
+    if (beta) {
+      v = _mm_add_ps(v, _mm_loadu_ps(beta + i));
+    }
+    _mm_storeu_ps(y + i, v);
+  }
+  for (; i < n; ++i) {
+    float v = x[i] * inv;
+    if (gamma) {
+      v *= gamma[i];
+    }
+    if (beta) {
+      v += beta[i];
+    }
+    y[i] = v;
+  }
+}
+
+static const BwppCpuKernels bwpp_sse4_kernels = {
+  BWPP_CPU_ISA_SSE4,
+  "sse4",
+  SSE4_MR,
+  SSE4_NR,
+  bwpp_sse4_gemm_ukernel,
+  bwpp_sse4_dot,
+  bwpp_sse4_axpy,
+  bwpp_sse4_scale,
+  bwpp_sse4_softmax_row,
+  bwpp_sse4_rmsnorm_row
+};
+
+/* ---- AVX2 + FMA: 6x16 register tile ---- */
+
+#define AVX2_MR 6
+#define AVX2_NR 16
+
+BWPP_AVX2 static __m256 bwpp_avx2_exp(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+  __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)),
+                             _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_C1), x);
+  x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_C2), x);
+  __m256 y = _mm256_set1_ps(EXP_P0);
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+  y = _mm256_fmadd_ps(_mm256_mul_ps(y, x), x, _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+  __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+}
+
+BWPP_AVX2 static float bwpp_avx2_hsum(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  __m128 sh = _mm_movehdup_ps(lo);
+  __m128 s = _mm_add_ps(lo, sh);
+  sh = _mm_movehl_ps(sh, s);
+  return _mm_cvtss_f32(_mm_add_ss(s, sh));
+}
+
+BWPP_AVX2 static float bwpp_avx2_hmax(__m256 v) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+BWPP_AVX2 static void bwpp_avx2_gemm_ukernel(uint32_t kc, const float *ap, const float *bp, float *acc) {
+  __m256 c[AVX2_MR][2];
+  for (uint32_t i = 0; i < AVX2_MR; ++i) {
+    c[i][0] = _mm256_setzero_ps();
+    c[i][1] = _mm256_setzero_ps();
+  }
+  for (uint32_t p = 0; p < kc; ++p) {
+    __m256 b0 = _mm256_loadu_ps(bp);
+    __m256 b1 = _mm256_loadu_ps(bp + 8);
+    for (uint32_t i = 0; i < AVX2_MR; ++i) {
+      __m256 a = _mm256_broadcast_ss(ap + i);
+      c[i][0] = _mm256_fmadd_ps(a, b0, c[i][0]);
+      c[i][1] = _mm256_fmadd_ps(a, b1, c[i][1]);
+    }
+    ap += AVX2_MR;
+    bp += AVX2_NR;
+  }
+  for (uint32_t i = 0; i < AVX2_MR; ++i) {
+    _mm256_storeu_ps(acc + i * AVX2_NR, c[i][0]);
+    _mm256_storeu_ps(acc + i * AVX2_NR + 8, c[i][1]);
+  }
+}
+
+BWPP_AVX2 static float bwpp_avx2_dot(const float *a, const float *b, uint32_t n) {
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+  }
+  float acc = bwpp_avx2_hsum(_mm256_add_ps(s0, s1));
+  for (; i < n; ++i) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+BWPP_AVX2 static void bwpp_avx2_axpy(float *y, float alpha, const float *x, uint32_t n) {
+  __m256 va = _mm256_set1_ps(alpha);
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+BWPP_AVX2 static void bwpp_avx2_scale(float *y, float alpha, uint32_t n) {
+  __m256 va = _mm256_set1_ps(alpha);
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(y + i), va));
+  }
+  for (; i < n; ++i) {
+    y[i] *= alpha;
+  }
+}
+
+BWPP_AVX2 static void bwpp_avx2_softmax_row(const float *x, float *y, uint32_t n) {
+  uint32_t i = 0;
+  __m256 vmax = _mm256_set1_ps(-INFINITY);
+  for (; i + 8 <= n; i += 8) {
+    vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(x + i));
+  }
+  float maxv = bwpp_avx2_hmax(vmax);
+  for (; i < n; ++i) {
+    maxv = x[i] > maxv ? x[i] : maxv;
+  }
+  __m256 vm = _mm256_set1_ps(maxv);
+  __m256 vsum = _mm256_setzero_ps();
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256 e = bwpp_avx2_exp(_mm256_sub_ps(_mm256_loadu_ps(x + i), vm));
+    _mm256_storeu_ps(y + i, e);
+    vsum = _mm256_add_ps(vsum, e);
+  }
+  float sum = bwpp_avx2_hsum(vsum);
+  for (; i < n; ++i) {
+    float e = expf(x[i] - maxv);
+    y[i] = e;
+    sum += e;
+  }
+  bwpp_avx2_scale(y, sum > 0.0f ? (1.0f / sum) : 0.0f, n);
+}
+
+BWPP_AVX2 static void bwpp_avx2_rmsnorm_row(const float *x,
+                                            float *y,
+                                            const float *gamma,
+                                            const float *beta,
+                                            uint32_t n,
+                                            float eps) {
+  float inv = 1.0f / sqrtf(bwpp_avx2_dot(x, x, n) / (float)n + eps);
+  __m256 vi = _mm256_set1_ps(inv);
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_mul_ps(_mm256_loadu_ps(x + i), vi);
+    if (gamma) {
+      v = _mm256_mul_ps(v, _mm256_loadu_ps(gamma + i));
+    }
+    if (beta) {
+      v = _mm256_add_ps(v, _mm256_loadu_ps(beta + i));
+    }
+    _mm256_storeu_ps(y + i, v);
+  }
+  for (; i < n; ++i) {
+    float v = x[i] * inv;
+    if (gamma) {
+      v *= gamma[i];
+    }
+    if (beta) {
+      v += beta[i];
+    }
+    y[i] = v;
+  }
+}
+
+static const BwppCpuKernels bwpp_avx2_kernels = {
+  BWPP_CPU_ISA_AVX2,
+  "avx2",
+  AVX2_MR,
+  AVX2_NR,
+  bwpp_avx2_gemm_ukernel,
+  bwpp_avx2_dot,
+  bwpp_avx2_axpy,
+  bwpp_avx2_scale,
+  bwpp_avx2_softmax_row,
+  bwpp_avx2_rmsnorm_row
+};
+
+/* ---- AVX-512F: 8x32 register tile, masked tails ---- */
+
+#define AVX512_MR 8
+#define AVX512_NR 32
+
+BWPP_AVX512 static __m512 bwpp_avx512_exp(__m512 x) {
+  x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+  __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(EXP_LOG2E)),
+                                  _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_C1), x);
+  x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_C2), x);
+  __m512 y = _mm512_set1_ps(EXP_P0);
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+  y = _mm512_fmadd_ps(_mm512_mul_ps(y, x), x, _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+  __m512i e = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23);
+  return _mm512_mul_ps(y, _mm512_castsi512_ps(e));
+}
+
+BWPP_AVX512 static __mmask16 bwpp_avx512_tail(uint32_t rem) {
+  return (__mmask16)((1u << rem) - 1u);
+}
+
+BWPP_AVX512 static void bwpp_avx512_gemm_ukernel(uint32_t kc, const float *ap, const float *bp, float *acc) {
+  __m512 c[AVX512_MR][2];
+  for (uint32_t i = 0; i < AVX512_MR; ++i) {
+    c[i][0] = _mm512_setzero_ps();
+    c[i][1] = _mm512_setzero_ps();
+  }
+  for (uint32_t p = 0; p < kc; ++p) {
+    __m512 b0 = _mm512_loadu_ps(bp);
+    __m512 b1 = _mm512_loadu_ps(bp + 16);
+    for (uint32_t i = 0; i < AVX512_MR; ++i) {
+      __m512 a = _mm512_set1_ps(ap[i]);
+      c[i][0] = _mm512_fmadd_ps(a, b0, c[i][0]);
+      c[i][1] = _mm512_fmadd_ps(a, b1, c[i][1]);
+    }
+    ap += AVX512_MR;
+    bp += AVX512_NR;
+  }
+  for (uint32_t i = 0; i < AVX512_MR; ++i) {
+    _mm512_storeu_ps(acc + i * AVX512_NR, c[i][0]);
+    _mm512_storeu_ps(acc + i * AVX512_NR + 16, c[i][1]);
+  }
+}
+
+BWPP_AVX512 static float bwpp_avx512_dot(const float *a, const float *b, uint32_t n) {
+  __m512 s0 = _mm512_setzero_ps();
+  __m512 s1 = _mm512_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+  }
+  if (i < n) {
+    __mmask16 m = bwpp_avx512_tail(n - i);
+    s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), s1);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+BWPP_AVX512 static void bwpp_avx512_axpy(float *y, float alpha, const float *x, uint32_t n) {
+  __m512 va = _mm512_set1_ps(alpha);
+  uint32_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+  if (i < n) {
+    __mmask16 m = bwpp_avx512_tail(n - i);
+    __m512 r = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i));
+    _mm512_mask_storeu_ps(y + i, m, r);
+  }
+}
+
+BWPP_AVX512 static void bwpp_avx512_scale(float *y, float alpha, uint32_t n) {
+  __m512 va = _mm512_set1_ps(alpha);
+  uint32_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_mul_ps(_mm512_loadu_ps(y + i), va));
+  }
+  if (i < n) {
+    __mmask16 m = bwpp_avx512_tail(n - i);
+    _mm512_mask_storeu_ps(y + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, y + i), va));
+  }
+}
+
+BWPP_AVX512 static void bwpp_avx512_softmax_row(const float *x, float *y, uint32_t n) {
+  uint32_t i = 0;
+  __m512 vmax = _mm512_set1_ps(-INFINITY);
+  for (; i + 16 <= n; i += 16) {
+    vmax = _mm512_max_ps(vmax, _mm512_loadu_ps(x + i));
+  }
+  if (i < n) {
+    vmax = _mm512_max_ps(vmax, _mm512_mask_loadu_ps(vmax, bwpp_avx512_tail(n - i), x + i));
+  }
+  float maxv = _mm512_reduce_max_ps(vmax);
+  __m512 vm = _mm512_set1_ps(maxv);
+  __m512 vsum = _mm512_setzero_ps();
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m512 e = bwpp_avx512_exp(_mm512_sub_ps(_mm512_loadu_ps(x + i), vm));
+    _mm512_storeu_ps(y + i, e);
+    vsum = _mm512_add_ps(vsum, e);
+  }
+  if (i < n) {
+    __mmask16 m = bwpp_avx512_tail(n - i);
+    __m512 e = bwpp_avx512_exp(_mm512_sub_ps(_mm512_mask_loadu_ps(vm, m, x + i), vm));
+    e = _mm512_maskz_mov_ps(m, e);
+    _mm512_mask_storeu_ps(y + i, m, e);
+    vsum = _mm512_add_ps(vsum, e);
+  }
+  float sum = _mm512_reduce_add_ps(vsum);
+  bwpp_avx512_scale(y, sum > 0.0f ? (1.0f / sum) : 0.0f, n);
+}
+
+BWPP_AVX512 static void bwpp_avx512_rmsnorm_row(const float *x,
+                                                float *y,
+                                                const float *gamma,
+                                                const float *beta,
+                                                uint32_t n,
+                                                float eps) {
+  float inv = 1.0f / sqrtf(bwpp_avx512_dot(x, x, n) / (float)n + eps);
+  __m512 vi = _mm512_set1_ps(inv);
+  for (uint32_t i = 0; i < n; i += 16) {
+    __mmask16 m = n - i >= 16 ? (__mmask16)0xFFFF : bwpp_avx512_tail(n - i);
+    __m512 v = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, x + i), vi);
+    if (gamma) {
+      v = _mm512_mul_ps(v, _mm512_maskz_loadu_ps(m, gamma + i));
+    }
+    if (beta) {
+      v = _mm512_add_ps(v, _mm512_maskz_loadu_ps(m, beta + i));
+    }
+    _mm512_mask_storeu_ps(y + i, m, v);
+  }
+}
+
+static const BwppCpuKernels bwpp_avx512_kernels = {
+  BWPP_CPU_ISA_AVX512,
+  "avx512",
+  AVX512_MR,
+  AVX512_NR,
+  bwpp_avx512_gemm_ukernel,
+  bwpp_avx512_dot,
+  bwpp_avx512_axpy,
+  bwpp_avx512_scale,
+  bwpp_avx512_softmax_row,
+  bwpp_avx512_rmsnorm_row
+};
+
+const BwppCpuKernels *bwpp_cpu_kernels_sse4(void) {
+  return &bwpp_sse4_kernels;
+}
+
+const BwppCpuKernels *bwpp_cpu_kernels_avx2(void) {
+  return &bwpp_avx2_kernels;
+}
+
+const BwppCpuKernels *bwpp_cpu_kernels_avx512(void) {
+  return &bwpp_avx512_kernels;
+}
+
+#else
+
+const BwppCpuKernels *bwpp_cpu_kernels_sse4(void) {
+  return NULL;
+}
+
+const BwppCpuKernels *bwpp_cpu_kernels_avx2(void) {
+  return NULL;
+}
+
+const BwppCpuKernels *bwpp_cpu_kernels_avx512(void) {
+  return NULL;
+}
+
+#endif
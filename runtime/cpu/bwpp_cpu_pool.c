@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bwpp_cpu_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define BWPP_POOL_MAX_THREADS 256
+
+/* One cache line per worker: [begin, end) packed as end << 32 | begin so the
+   owner and thieves can both move it with a single CAS. */
+typedef struct {
+  _Atomic uint64_t range;
+  char pad[64 - sizeof(uint64_t)];
+} BwppCpuPoolSlot;
+
+typedef struct {
+  BwppCpuPool *pool;
+  uint32_t index;
+} BwppCpuWorker;
+
+struct BwppCpuPool {
+  uint32_t threads;
+  pthread_t *handles;
+  BwppCpuWorker *workers;
+  BwppCpuPoolSlot *slots;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  uint64_t generation;
+  uint32_t running;
+  int shutdown;
+  BwppCpuTaskFn fn;
+  void *arg;
+  uint32_t grain;
+};
+
+static uint64_t bwpp_range_pack(uint32_t begin, uint32_t end) {
+  return ((uint64_t)end << 32) | begin;
+}
+
+static int bwpp_pool_take(BwppCpuPoolSlot *slot, uint32_t grain, uint32_t *out_begin, uint32_t *out_end) {
+  uint64_t cur = atomic_load(&slot->range);
+  for (;;) {
+    uint32_t begin = (uint32_t)cur;
+    uint32_t end = (uint32_t)(cur >> 32);
+    if (begin >= end) {
+      return 0;
+    }
+    uint32_t next = end - begin > grain ? begin + grain : end;
+    if (atomic_compare_exchange_weak(&slot->range, &cur, bwpp_range_pack(next, end))) {
+      *out_begin = begin;
+      *out_end = next;
+      return 1;
+    }
+  }
+}
+
+/* Move the back half of some other worker's range into our (empty) slot. */
+static int bwpp_pool_steal(BwppCpuPool *pool, uint32_t self) {
+  for (uint32_t off = 1; off < pool->threads; ++off) {
+    BwppCpuPoolSlot *victim = &pool->slots[(self + off) % pool->threads];
+    uint64_t cur = atomic_load(&victim->range);
+    for (;;) {
+      uint32_t begin = (uint32_t)cur;
+      uint32_t end = (uint32_t)(cur >> 32);
+      if (begin >= end) {
+        break;
+      }
+      uint32_t remaining = end - begin;
+      uint32_t mid = remaining <= pool->grain ? begin : end - remaining / 2;
+      if (atomic_compare_exchange_weak(&victim->range, &cur, bwpp_range_pack(begin, mid))) {
+        atomic_store(&pool->slots[self].range, bwpp_range_pack(mid, end));
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void bwpp_pool_run(BwppCpuPool *pool, uint32_t self) {
+  uint32_t begin = 0;
+  uint32_t end = 0;
+  for (;;) {
+    if (bwpp_pool_take(&pool->slots[self], pool->grain, &begin, &end)) {
+      pool->fn(pool->arg, begin, end, self);
+    } else if (!bwpp_pool_steal(pool, self)) {
+      return;
+    }
+  }
+}
+
+static void *bwpp_pool_worker_main(void *p) {
+  BwppCpuWorker *worker = (BwppCpuWorker *)p;
+  BwppCpuPool *pool = worker->pool;
+  uint64_t seen = 0;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->shutdown && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    if (pool->shutdown) {
+      break;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+    bwpp_pool_run(pool, worker->index);
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+BwppCpuPool *bwpp_cpu_pool_create(uint32_t threads) {
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? (uint32_t)online : 1;
+  }
+  if (threads > BWPP_POOL_MAX_THREADS) {
+    threads = BWPP_POOL_MAX_THREADS;
+  }
+  BwppCpuPool *pool = (BwppCpuPool *)calloc(1, sizeof(BwppCpuPool));
+  if (!pool) {
+    return NULL;
+  }
+  pool->threads = threads;
+  pool->slots = (BwppCpuPoolSlot *)calloc(threads, sizeof(BwppCpuPoolSlot));
+  pool->handles = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  pool->workers = (BwppCpuWorker *)calloc(threads, sizeof(BwppCpuWorker));
+  if (!pool->slots || !pool->handles || !pool->workers) {
+    free(pool->slots);
+    free(pool->handles);
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  for (uint32_t i = 0; i < threads; ++i) {
+    atomic_init(&pool->slots[i].range, 0);
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+  }
+  for (uint32_t i = 1; i < threads; ++i) {
+    if (pthread_create(&pool->handles[i], NULL, bwpp_pool_worker_main, &pool->workers[i]) != 0) {
+      /* run with however many workers did start */
+      pool->threads = i;
+      break;
+    }
+  }
+  return pool;
+}
+
+void bwpp_cpu_pool_destroy(BwppCpuPool *pool) {
+  if (!pool) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (uint32_t i = 1; i < pool->threads; ++i) {
+    pthread_join(pool->handles[i], NULL);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  pthread_cond_destroy(&pool->done);
+  free(pool->slots);
+  free(pool->handles);
+  free(pool->workers);
+  free(pool);
+}
+
+uint32_t bwpp_cpu_pool_threads(const BwppCpuPool *pool) {
+  return pool ? pool->threads : 1;
+}
+
+void bwpp_cpu_pool_parallel_for(BwppCpuPool *pool,
+                                uint32_t count,
+                                uint32_t grain,
+                                BwppCpuTaskFn fn,
+                                void *arg) {
+  if (!fn || count == 0) {
+    return;
+  }
+  if (grain == 0) {
+    grain = 1;
+  }
+  if (!pool || pool->threads <= 1 || count <= grain) {
+    fn(arg, 0, count, 0);
+    return;
+  }
+  uint32_t threads = pool->threads;
+  for (uint32_t w = 0; w < threads; ++w) {
+    uint32_t begin = (uint32_t)((uint64_t)count * w / threads);
+    uint32_t end = (uint32_t)((uint64_t)count * (w + 1) / threads);
+    atomic_store(&pool->slots[w].range, bwpp_range_pack(begin, end));
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->grain = grain;
+  pool->running = threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  bwpp_pool_run(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
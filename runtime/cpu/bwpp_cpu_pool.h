@@ -0,0 +1,27 @@
+#ifndef BWPP_CPU_POOL_H
+#define BWPP_CPU_POOL_H
+
+#include <stdint.h>
+
+/* Persistent work-stealing thread pool. Workers are spawned once and park
+   between jobs; the calling thread joins in as worker 0. */
+typedef struct BwppCpuPool BwppCpuPool;
+
+/* Runs items [begin, end) on the given worker (0 .. threads-1). */
+typedef void (*BwppCpuTaskFn)(void *arg, uint32_t begin, uint32_t end, uint32_t worker);
+
+/* threads == 0 picks the number of online cores. Returns NULL on failure. */
+BwppCpuPool *bwpp_cpu_pool_create(uint32_t threads);
+void bwpp_cpu_pool_destroy(BwppCpuPool *pool);
+uint32_t bwpp_cpu_pool_threads(const BwppCpuPool *pool);
+
+/* Splits [0, count) evenly across workers; each worker pops grain-sized
+   chunks from its own range and steals half of a busy worker's remainder
+   once it runs dry. Returns after every item ran. A NULL pool runs inline. */
+void bwpp_cpu_pool_parallel_for(BwppCpuPool *pool,
+                                uint32_t count,
+                                uint32_t grain,
+                                BwppCpuTaskFn fn,
+                                void *arg);
+
+#endif
@@ -1,5 +1,6 @@
 #include "bwpp_cpu_ref.h"
 #include <math.h>
+#include <stddef.h>
 
 static float bwpp_silu(float x) {
   return x / (1.0f + expf(-x));
@@ -143,6 +144,47 @@ void bwpp_cpu_attention_f32(const float *q,
   }
 }
 
+void bwpp_cpu_attention_masked_ref_f32(const float *q,
+                                       const float *k,
+                                       const float *v,
+                                       float *o,
+                                       const uint32_t *kv_len,
+                                       const BwppCpuAttentionParams *params) {
+  if (!q || !k || !v || !o || !params) {
+    return;
+  }
+  uint32_t batch = params->batch ? params->batch : 1;
+  uint32_t heads = params->heads ? params->heads : 1;
+  uint32_t kv_heads = params->kv_heads ? params->kv_heads : heads;
+  if (kv_heads > heads || heads % kv_heads != 0) {
+    return;
+  }
+  uint32_t group = heads / kv_heads;
+  uint32_t M = params->M;
+  uint32_t N = params->N;
+  size_t rows = params->kv_rows > N ? params->kv_rows : N;
+  for (uint32_t b = 0; b < batch; ++b) {
+    uint32_t len = kv_len && kv_len[b] < N ? kv_len[b] : N;
+    for (uint32_t h = 0; h < heads; ++h) {
+      uint32_t kvh = h / group;
+      const float *qh = q + (size_t)(b * heads + h) * M * params->ldq;
+      float *oh = o + (size_t)(b * heads + h) * M * params->ldo;
+      const float *kh = k + (size_t)(b * kv_heads + kvh) * rows * params->ldk;
+      const float *vh = v + (size_t)(b * kv_heads + kvh) * rows * params->ldv;
+      for (uint32_t m = 0; m < M; ++m) {
+        int64_t limit = len;
+        if (params->causal) {
+          int64_t last = (int64_t)m + (int64_t)len - (int64_t)M + 1;
+          limit = last < 0 ? 0 : (last < limit ? last : limit);
+        }
+        bwpp_cpu_attention_f32(qh + (size_t)m * params->ldq, kh, vh, oh + (size_t)m * params->ldo,
+                               1, (uint32_t)limit, params->K, params->D,
+                               params->ldq, params->ldk, params->ldv, params->ldo);
+      }
+    }
+  }
+}
+
 void bwpp_cpu_reduce_max_mask_f32(const float *x,
                                   float *mask,
                                   uint32_t rows,
@@ -1,6 +1,7 @@
 #ifndef BWPP_CPU_REF_H
 #define BWPP_CPU_REF_H
 
+#include "bwpp_cpu_attention.h"
 #include <stdint.h>
 
 void bwpp_cpu_matmul_f32(const float *a,
@@ -44,6 +45,15 @@ void bwpp_cpu_attention_f32(const float *q,
                             uint32_t ldv,
                             uint32_t ldo);
 
+/* Oracle for bwpp_cpu_attention_masked_f32: one dense row at a time over the
+   keys that row may see. */
+void bwpp_cpu_attention_masked_ref_f32(const float *q,
+                                       const float *k,
+                                       const float *v,
+                                       float *o,
+                                       const uint32_t *kv_len,
+                                       const BwppCpuAttentionParams *params);
+
 void bwpp_cpu_reduce_max_mask_f32(const float *x,
                                   float *mask,
                                   uint32_t rows,
@@ -0,0 +1,60 @@
+#include "arena.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNK 256
+
+int main(void) {
+  BwppChunkArena arena;
+  bwpp_chunk_arena_init(&arena, CHUNK);
+  int ok = 1;
+  /* many small blocks spill into new chunks, aligned and intact */
+  uint32_t *blocks[64];
+  for (uint32_t i = 0; i < 64; ++i) {
+    blocks[i] = (uint32_t *)bwpp_chunk_arena_alloc(&arena, 3 * sizeof(uint32_t) + i % 5, 16);
+    ok &= blocks[i] != NULL && (uintptr_t)blocks[i] % 16 == 0;
+    if (blocks[i]) {
+      blocks[i][0] = i;
+      blocks[i][2] = i * 7;
+    }
+  }
+  for (uint32_t i = 0; ok && i < 64; ++i) {
+    ok &= blocks[i][0] == i && blocks[i][2] == i * 7;
+  }
+  /* the newest block grows in place while its chunk has room */
+  uint8_t *bytes = (uint8_t *)bwpp_chunk_arena_alloc(&arena, 8, 1);
+  ok &= bytes != NULL;
+  if (bytes) {
+    memset(bytes, 0x5a, 8);
+    ok &= bwpp_chunk_arena_grow(&arena, bytes, 8, 16, 1) == bytes;
+  }
+  /* a doubling array past the chunk size moves and keeps its contents */
+  uint32_t *items = NULL;
+  uint32_t capacity = 0;
+  for (uint32_t i = 0; ok && i < 1000; ++i) {
+    if (i == capacity) {
+      uint32_t next = capacity ? capacity * 2 : 4;
+      items = (uint32_t *)bwpp_chunk_arena_grow(&arena, items, capacity * sizeof(uint32_t),
+                                                next * sizeof(uint32_t), sizeof(uint32_t));
+      capacity = next;
+      ok &= items != NULL;
+      bwpp_chunk_arena_alloc(&arena, 1, 1); /* so the next grow must copy */
+    }
+    if (items) {
+      items[i] = i * 3 + 1;
+    }
+  }
+  for (uint32_t i = 0; ok && i < 1000; ++i) {
+    ok &= items[i] == i * 3 + 1;
+  }
+  ok &= bytes == NULL || (bytes[0] == 0x5a && bytes[7] == 0x5a);
+  bwpp_chunk_arena_destroy(&arena);
+  ok &= arena.head == NULL;
+  if (!ok) {
+    fprintf(stderr, "CPU FAIL chunk_arena\n");
+    return 1;
+  }
+  printf("CPU PASS chunk_arena chunk=%u\n", CHUNK);
+  return 0;
+}
@@ -0,0 +1,236 @@
+#include "bwpp_cpu_ref.h"
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Loads a shared object built from `bwppc --emit-c` and checks each kernel
+   it exports against the CPU reference at the shapes baked into it. */
+
+typedef void (*BwppCMatmulFn)(const float *, const float *, float *, const float *);
+typedef void (*BwppCSoftmaxFn)(const float *, float *);
+typedef void (*BwppCRmsnormFn)(const float *, const float *, float *, const float *);
+typedef void (*BwppCAttentionFn)(const float *, const float *, const float *, float *, const uint32_t *);
+
+static void fill(float *dst, size_t count, uint32_t seed, float scale) {
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = (float)((i * 7u + seed * 13u) % 23u) * scale - 0.1f;
+  }
+}
+
+static int check(const char *name, const float *out, const float *ref, size_t count, float tol) {
+  float max_err = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    float diff = fabsf(out[i] - ref[i]);
+    if (!(diff <= max_err)) {
+      max_err = diff;
+    }
+  }
+  if (!(max_err <= tol)) {
+    fprintf(stderr, "CPU FAIL codegen_c %s max_err=%.6f\n", name, max_err);
+    return -1;
+  }
+  printf("CPU PASS codegen_c %s max_err=%.6f\n", name, max_err);
+  return 1;
+}
+
+/* Row-major copy of each [rows, cols] matrix of `src` stored transposed. */
+static void untranspose(const float *src, float *dst, size_t mats, uint32_t rows, uint32_t cols) {
+  for (size_t m = 0; m < mats; ++m) {
+    for (uint32_t r = 0; r < rows; ++r) {
+      for (uint32_t c = 0; c < cols; ++c) {
+        dst[(m * rows + r) * cols + c] = src[(m * cols + c) * rows + r];
+      }
+    }
+  }
+}
+
+static int test_matmul(void *lib) {
+  const uint32_t *shape = (const uint32_t *)dlsym(lib, "bwpp_matmul_shape");
+  BwppCMatmulFn fn = (BwppCMatmulFn)dlsym(lib, "bwpp_matmul_f32");
+  if (!shape || !fn) {
+    return 0;
+  }
+  uint32_t batch = shape[0];
+  uint32_t M = shape[1];
+  uint32_t N = shape[2];
+  uint32_t K = shape[3];
+  uint32_t a_stride = shape[4];
+  uint32_t b_stride = shape[5];
+  const int *ep = (const int *)dlsym(lib, "bwpp_matmul_epilogue");
+  int ep_add = ep ? ep[0] : 0;
+  int ep_silu = ep ? ep[1] : 0;
+  const int *trans = (const int *)dlsym(lib, "bwpp_matmul_trans");
+  int trans_a = trans ? trans[0] : 0;
+  int trans_b = trans ? trans[1] : 0;
+  size_t a_count = (size_t)(a_stride ? batch : 1) * M * K;
+  size_t b_count = (size_t)(b_stride ? batch : 1) * K * N;
+  float *a = (float *)malloc(sizeof(float) * a_count);
+  float *b = (float *)malloc(sizeof(float) * b_count);
+  float *bias = (float *)malloc(sizeof(float) * N);
+  float *c = (float *)malloc(sizeof(float) * batch * M * N);
+  float *ref = (float *)malloc(sizeof(float) * batch * M * N);
+  float *ad = (float *)malloc(sizeof(float) * a_count);
+  float *bd = (float *)malloc(sizeof(float) * b_count);
+  int rc = -1;
+  if (a && b && bias && c && ref && ad && bd) {
+    fill(a, a_count, 1, 0.01f);
+    fill(b, b_count, 2, 0.01f);
+    fill(bias, N, 3, 0.02f);
+    fn(a, b, c, bias);
+    /* the reference takes dense row-major operands */
+    if (trans_a) {
+      untranspose(a, ad, a_count / ((size_t)M * K), M, K);
+    }
+    if (trans_b) {
+      untranspose(b, bd, b_count / ((size_t)K * N), K, N);
+    }
+    for (uint32_t i = 0; i < batch; ++i) {
+      bwpp_cpu_matmul_f32((trans_a ? ad : a) + (size_t)i * a_stride, (trans_b ? bd : b) + (size_t)i * b_stride,
+                          ref + (size_t)i * M * N, M, N, K, K, N, N, bias, ep_silu, ep_add);
+    }
+    rc = check(trans_a || trans_b ? "matmul_trans" : "matmul", c, ref, (size_t)batch * M * N, 1e-4f);
+  }
+  free(a);
+  free(b);
+  free(bias);
+  free(c);
+  free(ref);
+  free(ad);
+  free(bd);
+  return rc;
+}
+
+static int test_softmax(void *lib) {
+  const uint32_t *shape = (const uint32_t *)dlsym(lib, "bwpp_softmax_shape");
+  BwppCSoftmaxFn fn = (BwppCSoftmaxFn)dlsym(lib, "bwpp_softmax_f32");
+  if (!shape || !fn) {
+    return 0;
+  }
+  size_t count = (size_t)shape[0] * shape[1];
+  float *x = (float *)malloc(sizeof(float) * count);
+  float *y = (float *)malloc(sizeof(float) * count);
+  float *ref = (float *)malloc(sizeof(float) * count);
+  int rc = -1;
+  if (x && y && ref) {
+    fill(x, count, 4, 0.1f);
+    fn(x, y);
+    bwpp_cpu_softmax_f32(x, ref, shape[0], shape[1], shape[1]);
+    rc = check("softmax", y, ref, count, 1e-5f);
+  }
+  free(x);
+  free(y);
+  free(ref);
+  return rc;
+}
+
+static int test_rmsnorm(void *lib) {
+  const uint32_t *shape = (const uint32_t *)dlsym(lib, "bwpp_rmsnorm_shape");
+  const float *eps = (const float *)dlsym(lib, "bwpp_rmsnorm_eps");
+  BwppCRmsnormFn fn = (BwppCRmsnormFn)dlsym(lib, "bwpp_rmsnorm_f32");
+  if (!shape || !eps || !fn) {
+    return 0;
+  }
+  size_t count = (size_t)shape[0] * shape[1];
+  float *x = (float *)malloc(sizeof(float) * count);
+  float *y = (float *)malloc(sizeof(float) * count);
+  float *ref = (float *)malloc(sizeof(float) * count);
+  float *gamma = (float *)malloc(sizeof(float) * shape[1]);
+  int rc = -1;
+  if (x && y && ref && gamma) {
+    fill(x, count, 5, 0.05f);
+    fill(gamma, shape[1], 6, 0.1f);
+    fn(x, gamma, y, NULL);
+    bwpp_cpu_rmsnorm_f32(x, ref, gamma, NULL, shape[0], shape[1], shape[1], *eps);
+    rc = check("rmsnorm", y, ref, count, 1e-5f);
+  }
+  free(x);
+  free(y);
+  free(ref);
+  free(gamma);
+  return rc;
+}
+
+static int test_attention(void *lib) {
+  const uint32_t *shape = (const uint32_t *)dlsym(lib, "bwpp_attention_shape");
+  BwppCAttentionFn fn = (BwppCAttentionFn)dlsym(lib, "bwpp_attention_f32");
+  if (!shape || !fn) {
+    return 0;
+  }
+  BwppCpuAttentionParams p = {0};
+  p.batch = shape[0];
+  p.heads = shape[1];
+  p.kv_heads = shape[2];
+  p.M = shape[3];
+  p.N = shape[4];
+  p.K = shape[5];
+  p.D = shape[6];
+  p.causal = shape[7];
+  p.ldq = p.K;
+  p.ldk = p.K;
+  p.ldv = p.D;
+  p.ldo = p.D;
+  size_t q_count = (size_t)p.batch * p.heads * p.M * p.K;
+  size_t k_count = (size_t)p.batch * p.kv_heads * p.N * p.K;
+  size_t v_count = (size_t)p.batch * p.kv_heads * p.N * p.D;
+  size_t o_count = (size_t)p.batch * p.heads * p.M * p.D;
+  float *q = (float *)malloc(sizeof(float) * q_count);
+  float *k = (float *)malloc(sizeof(float) * k_count);
+  float *v = (float *)malloc(sizeof(float) * v_count);
+  float *o = (float *)malloc(sizeof(float) * o_count);
+  float *ref = (float *)malloc(sizeof(float) * o_count);
+  uint32_t *kv_len = (uint32_t *)malloc(sizeof(uint32_t) * p.batch);
+  int rc = -1;
+  if (q && k && v && o && ref && kv_len) {
+    fill(q, q_count, 7, 0.02f);
+    fill(k, k_count, 8, 0.02f);
+    fill(v, v_count, 9, 0.03f);
+    /* shorter key lengths only matter when the kernel was built with them */
+    for (uint32_t b = 0; b < p.batch; ++b) {
+      kv_len[b] = shape[8] ? p.N - (b * 3u) % (p.N ? p.N : 1u) : p.N;
+    }
+    fn(q, k, v, o, kv_len);
+    bwpp_cpu_attention_masked_ref_f32(q, k, v, ref, kv_len, &p);
+    rc = check("attention", o, ref, o_count, 1e-5f);
+  }
+  free(q);
+  free(k);
+  free(v);
+  free(o);
+  free(ref);
+  free(kv_len);
+  return rc;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <kernels.so>\n", argv[0]);
+    return 1;
+  }
+  void *lib = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+  if (!lib) {
+    fprintf(stderr, "failed to load %s: %s\n", argv[1], dlerror());
+    return 1;
+  }
+  int results[4];
+  results[0] = test_matmul(lib);
+  results[1] = test_attention(lib);
+  results[2] = test_softmax(lib);
+  results[3] = test_rmsnorm(lib);
+  int ran = 0;
+  int failed = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    ran += results[i] != 0;
+    failed |= results[i] < 0;
+  }
+  const char *simd = (const char *)dlsym(lib, "bwpp_simd");
+  if (simd && !failed) {
+    printf("CPU PASS codegen_c simd=%s\n", simd);
+  }
+  dlclose(lib);
+  if (!ran) {
+    fprintf(stderr, "no kernels found in %s\n", argv[1]);
+    return 1;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include "bwpp_cpu_gemm.h"
+#include "bwpp_cpu_ref.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void fill_matrix(float *dst, uint32_t rows, uint32_t cols, uint32_t ld, float scale) {
+  for (uint32_t i = 0; i < rows; ++i) {
+    for (uint32_t j = 0; j < cols; ++j) {
+      dst[i * ld + j] = (float)((i * 7 + j * 13) % 17) * scale - 0.3f;
+    }
+  }
+}
+
+/* dst (cols x rows, row stride ld_dst) = src^T */
+static void transpose_matrix(const float *src, uint32_t rows, uint32_t cols, uint32_t ld_src, float *dst,
+                             uint32_t ld_dst) {
+  for (uint32_t i = 0; i < rows; ++i) {
+    for (uint32_t j = 0; j < cols; ++j) {
+      dst[j * ld_dst + i] = src[i * ld_src + j];
+    }
+  }
+}
+
+static int check_case(uint32_t M, uint32_t N, uint32_t K, uint32_t pad, int ep_add, int ep_silu, int trans) {
+  uint32_t lda = K + pad;
+  uint32_t ldb = N + pad;
+  uint32_t ldc = N + pad;
+  float *a = (float *)malloc(sizeof(float) * M * lda);
+  float *b = (float *)malloc(sizeof(float) * (K ? K : 1) * ldb);
+  float *c = (float *)malloc(sizeof(float) * M * ldc);
+  float *ref = (float *)malloc(sizeof(float) * M * ldc);
+  float *bias = (float *)malloc(sizeof(float) * N);
+  /* the operands as bwpp_cpu_gemm_trans_f32 reads them under `trans` */
+  uint32_t lda_t = M + pad;
+  uint32_t ldb_t = K + pad;
+  float *at = (float *)malloc(sizeof(float) * (K ? K : 1) * lda_t);
+  float *bt = (float *)malloc(sizeof(float) * N * ldb_t);
+  if (!a || !b || !c || !ref || !bias || !at || !bt) {
+    free(a);
+    free(b);
+    free(c);
+    free(ref);
+    free(bias);
+    free(at);
+    free(bt);
+    return 0;
+  }
+  fill_matrix(a, M, K, lda, 0.05f);
+  fill_matrix(b, K, N, ldb, 0.03f);
+  for (uint32_t i = 0; i < M * ldc; ++i) {
+    c[i] = 0.0f;
+    ref[i] = 0.0f;
+  }
+  for (uint32_t i = 0; i < N; ++i) {
+    bias[i] = 0.01f * (float)(i % 11);
+  }
+  bwpp_cpu_matmul_f32(a, b, ref, M, N, K, lda, ldb, ldc, bias, ep_silu, ep_add);
+  if (trans) {
+    transpose_matrix(a, M, K, lda, at, lda_t);
+    transpose_matrix(b, K, N, ldb, bt, ldb_t);
+    int ta = trans & 1;
+    int tb = (trans >> 1) & 1;
+    bwpp_cpu_gemm_trans_f32(ta ? at : a, tb ? bt : b, c, M, N, K, ta ? lda_t : lda, tb ? ldb_t : ldb, ldc,
+                            ta, tb, bias, ep_silu, ep_add);
+  } else {
+    bwpp_cpu_gemm_f32(a, b, c, M, N, K, lda, ldb, ldc, bias, ep_silu, ep_add);
+  }
+  float max_err = 0.0f;
+  for (uint32_t i = 0; i < M; ++i) {
+    for (uint32_t j = 0; j < N; ++j) {
+      float diff = fabsf(c[i * ldc + j] - ref[i * ldc + j]);
+      float tol = 1e-4f * (1.0f + fabsf(ref[i * ldc + j]));
+      if (diff > tol && diff > max_err) {
+        max_err = diff;
+      }
+    }
+  }
+  free(a);
+  free(b);
+  free(c);
+  free(ref);
+  free(bias);
+  free(at);
+  free(bt);
+  if (max_err > 0.0f) {
+    fprintf(stderr, "CPU FAIL gemm M=%u N=%u K=%u pad=%u max_err=%.6f ep_add=%d ep_silu=%d trans=%d\n",
+            M, N, K, pad, max_err, ep_add, ep_silu, trans);
+    return 0;
+  }
+  return 1;
+}
+
+int main(void) {
+  static const uint32_t shapes[][3] = {
+    { 1, 1, 1 },
+    { 4, 8, 16 },
+    { 5, 9, 3 },
+    { 17, 31, 300 },
+    { 130, 70, 257 },
+    { 64, 4100, 8 },
+    { 3, 3, 0 },
+  };
+  int ok = 1;
+  uint32_t cases = 0;
+  for (uint32_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+    for (int ep = 0; ep < 4; ++ep) {
+      uint32_t pad = (s + (uint32_t)ep) % 3;
+      ok &= check_case(shapes[s][0], shapes[s][1], shapes[s][2], pad, ep & 1, (ep >> 1) & 1, 0);
+      cases++;
+    }
+    /* transposed A, B, both */
+    for (int trans = 1; trans < 4; ++trans) {
+      ok &= check_case(shapes[s][0], shapes[s][1], shapes[s][2], (s + (uint32_t)trans) % 3, trans & 1, 0, trans);
+      cases++;
+    }
+  }
+  if (!ok) {
+    return 1;
+  }
+  printf("CPU PASS gemm cases=%u\n", cases);
+  return 0;
+}
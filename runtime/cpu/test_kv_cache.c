@@ -0,0 +1,97 @@
+#include "bwpp_cpu_context.h"
+#include "bwpp_cpu_ref.h"
+#include "kv_cache.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEADS 4
+#define KV_HEADS 2
+#define HEAD_DIM 16
+#define CAPACITY 700
+
+static void fill(float *dst, uint32_t count, uint32_t seed, float scale) {
+  for (uint32_t i = 0; i < count; ++i) {
+    dst[i] = (float)((i * 7 + seed * 13) % 23) * scale - 0.3f;
+  }
+}
+
+/* Decode M query rows per head against the cache; compare with the reference. */
+static int check_step(BwppCpuContext *ctx, const BwppKvCache *cache, uint32_t M, uint32_t seed) {
+  BwppTensor kt = bwpp_kv_cache_k_view(cache);
+  BwppTensor vt = bwpp_kv_cache_v_view(cache);
+  BwppCpuAttentionParams p = { M, (uint32_t)kt.shape[1], HEAD_DIM, HEAD_DIM,
+                               HEAD_DIM, (uint32_t)kt.stride[1], (uint32_t)vt.stride[1], HEAD_DIM,
+                               1, HEADS, KV_HEADS, M > 1, (uint32_t)(kt.stride[0] / kt.stride[1]) };
+  uint32_t count = HEADS * M * HEAD_DIM;
+  float *q = (float *)malloc(sizeof(float) * count);
+  float *o = (float *)malloc(sizeof(float) * count);
+  float *ref = (float *)malloc(sizeof(float) * count);
+  int ok = 0;
+  if (q && o && ref) {
+    fill(q, count, seed, 0.04f);
+    bwpp_cpu_attention_masked_ref_f32(q, (const float *)kt.buffer, (const float *)vt.buffer, ref, NULL, &p);
+    bwpp_cpu_attention_decode_ctx_f32(ctx, q, (const float *)kt.buffer, (const float *)vt.buffer, o, NULL, &p);
+    ok = 1;
+    for (uint32_t i = 0; i < count; ++i) {
+      if (fabsf(o[i] - ref[i]) > 1e-4f * (1.0f + fabsf(ref[i]))) {
+        fprintf(stderr, "CPU FAIL kv_cache decode len=%u M=%u idx=%u got=%.6f ref=%.6f\n",
+                cache->length, M, i, o[i], ref[i]);
+        ok = 0;
+        break;
+      }
+    }
+  }
+  free(q);
+  free(o);
+  free(ref);
+  return ok;
+}
+
+int main(void) {
+  BwppArena arena;
+  if (!bwpp_arena_init(&arena, sizeof(float) * 2 * KV_HEADS * CAPACITY * HEAD_DIM + 256)) {
+    return 1;
+  }
+  BwppKvCache cache;
+  BwppCpuContext *ctx = bwpp_cpu_context_create(3);
+  uint32_t prefill = 400;
+  float *k = (float *)malloc(sizeof(float) * KV_HEADS * prefill * HEAD_DIM);
+  float *v = (float *)malloc(sizeof(float) * KV_HEADS * prefill * HEAD_DIM);
+  int ok = ctx && k && v && bwpp_kv_cache_init(&cache, &arena, KV_HEADS, HEAD_DIM, CAPACITY);
+  uint32_t steps = 0;
+  if (ok) {
+    fill(k, KV_HEADS * prefill * HEAD_DIM, 1, 0.05f);
+    fill(v, KV_HEADS * prefill * HEAD_DIM, 2, 0.1f);
+    ok &= bwpp_kv_cache_append(&cache, k, v, prefill, 0);
+    /* token-by-token decode, each step appending the new token's K/V */
+    for (uint32_t t = 0; t < 6 && ok; ++t, ++steps) {
+      fill(k, KV_HEADS * HEAD_DIM, t + 3, 0.05f);
+      fill(v, KV_HEADS * HEAD_DIM, t + 4, 0.1f);
+      ok &= bwpp_kv_cache_append(&cache, k, v, 1, 0);
+      ok &= check_step(ctx, &cache, 1, t);
+    }
+    /* four speculative tokens verified causally, two rejected */
+    fill(k, KV_HEADS * 4 * HEAD_DIM, 9, 0.05f);
+    fill(v, KV_HEADS * 4 * HEAD_DIM, 10, 0.1f);
+    ok &= bwpp_kv_cache_append(&cache, k, v, 4, 0);
+    ok &= check_step(ctx, &cache, 4, 7);
+    bwpp_kv_cache_truncate(&cache, cache.length - 2);
+    ok &= cache.length == prefill + 8;
+    ok &= check_step(ctx, &cache, 1, 8);
+    steps += 2;
+    /* full cache refuses the append and stays unchanged */
+    ok &= !bwpp_kv_cache_append(&cache, k, v, CAPACITY, 0);
+    ok &= cache.length == prefill + 8;
+  }
+  free(k);
+  free(v);
+  bwpp_cpu_context_destroy(ctx);
+  bwpp_arena_destroy(&arena);
+  if (!ok) {
+    fprintf(stderr, "CPU FAIL kv_cache\n");
+    return 1;
+  }
+  printf("CPU PASS kv_cache steps=%u\n", steps);
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include "bwpp_cpu_context.h"
+#include "bwpp_cpu_ref.h"
+#include "kv_pages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEADS 4
+#define KV_HEADS 2
+#define HEAD_DIM 16
+#define PAGE_TOKENS 16
+#define PAGES 64
+#define SEQS 3
+#define MAX_LEN 256
+
+/* contiguous copy of what each sequence should hold: [SEQS][KV_HEADS][MAX_LEN][HEAD_DIM] */
+static float shadow_k[SEQS * KV_HEADS * MAX_LEN * HEAD_DIM];
+static float shadow_v[SEQS * KV_HEADS * MAX_LEN * HEAD_DIM];
+
+static void fill(float *dst, uint32_t count, uint32_t seed, float scale) {
+  for (uint32_t i = 0; i < count; ++i) {
+    dst[i] = (float)((i * 7 + seed * 13) % 23) * scale - 0.3f;
+  }
+}
+
+static int append(BwppKvPagePool *pool, BwppKvSeq *seqs, uint32_t s, uint32_t tokens, uint32_t seed) {
+  float k[KV_HEADS * 64 * HEAD_DIM];
+  float v[KV_HEADS * 64 * HEAD_DIM];
+  fill(k, KV_HEADS * tokens * HEAD_DIM, seed, 0.05f);
+  fill(v, KV_HEADS * tokens * HEAD_DIM, seed + 1, 0.1f);
+  uint32_t len = seqs[s].length;
+  for (uint32_t h = 0; h < KV_HEADS; ++h) {
+    size_t dst = (((size_t)s * KV_HEADS + h) * MAX_LEN + len) * HEAD_DIM;
+    memcpy(shadow_k + dst, k + (size_t)h * tokens * HEAD_DIM, sizeof(float) * tokens * HEAD_DIM);
+    memcpy(shadow_v + dst, v + (size_t)h * tokens * HEAD_DIM, sizeof(float) * tokens * HEAD_DIM);
+  }
+  return bwpp_kv_seq_append(pool, &seqs[s], k, v, tokens, 0);
+}
+
+static int fork_seq(BwppKvPagePool *pool, BwppKvSeq *seqs, uint32_t dst, uint32_t src) {
+  size_t per_seq = (size_t)KV_HEADS * MAX_LEN * HEAD_DIM;
+  memcpy(shadow_k + dst * per_seq, shadow_k + src * per_seq, sizeof(float) * per_seq);
+  memcpy(shadow_v + dst * per_seq, shadow_v + src * per_seq, sizeof(float) * per_seq);
+  return bwpp_kv_seq_fork(pool, &seqs[dst], &seqs[src]);
+}
+
+/* Paged attention over all sequences vs the reference on the shadow copies. */
+static int check(BwppCpuContext *ctx, const BwppKvPagePool *pool, const BwppKvSeq *seqs, uint32_t M) {
+  uint32_t table[SEQS * (MAX_LEN / PAGE_TOKENS)];
+  uint32_t lens[SEQS];
+  if (!bwpp_kv_seq_batch_table(seqs, SEQS, table, MAX_LEN / PAGE_TOKENS, lens)) {
+    return 0;
+  }
+  BwppCpuKvPages pages = { pool->k, pool->v, table, MAX_LEN / PAGE_TOKENS, PAGE_TOKENS };
+  BwppCpuAttentionParams p = { M, MAX_LEN, HEAD_DIM, HEAD_DIM, HEAD_DIM, HEAD_DIM, HEAD_DIM, HEAD_DIM,
+                               SEQS, HEADS, KV_HEADS, M > 1, 0 };
+  uint32_t count = SEQS * HEADS * M * HEAD_DIM;
+  float *q = (float *)malloc(sizeof(float) * count);
+  float *o = (float *)malloc(sizeof(float) * count);
+  float *ref = (float *)malloc(sizeof(float) * count);
+  int ok = 0;
+  if (q && o && ref) {
+    fill(q, count, M, 0.04f);
+    bwpp_cpu_attention_masked_ref_f32(q, shadow_k, shadow_v, ref, lens, &p);
+    bwpp_cpu_attention_paged_ctx_f32(ctx, q, &pages, o, lens, &p);
+    ok = 1;
+    for (uint32_t i = 0; i < count; ++i) {
+      if (fabsf(o[i] - ref[i]) > 1e-4f * (1.0f + fabsf(ref[i]))) {
+        fprintf(stderr, "CPU FAIL kv_pages attention M=%u idx=%u got=%.6f ref=%.6f\n", M, i, o[i], ref[i]);
+        ok = 0;
+        break;
+      }
+    }
+  }
+  free(q);
+  free(o);
+  free(ref);
+  return ok;
+}
+
+int main(void) {
+  BwppArena arena;
+  if (!bwpp_arena_init(&arena, sizeof(float) * 2 * PAGES * KV_HEADS * PAGE_TOKENS * HEAD_DIM + 4096)) {
+    return 1;
+  }
+  BwppKvPagePool pool;
+  BwppKvSeq seqs[SEQS];
+  for (uint32_t s = 0; s < SEQS; ++s) {
+    bwpp_kv_seq_init(&seqs[s]);
+  }
+  BwppCpuContext *ctx = bwpp_cpu_context_create(3);
+  int ok = ctx && bwpp_kv_pool_init(&pool, &arena, KV_HEADS, HEAD_DIM, PAGE_TOKENS, PAGES);
+  if (ok) {
+    /* shared 50-token prompt: three full pages and a partial one */
+    ok &= append(&pool, seqs, 0, 50, 1);
+    ok &= fork_seq(&pool, seqs, 1, 0);
+    ok &= fork_seq(&pool, seqs, 2, 0);
+    ok &= pool.free_count == PAGES - 4 && pool.refs[seqs[0].pages[0]] == 3;
+    /* each writer copies the shared partial page; the full ones stay shared */
+    ok &= append(&pool, seqs, 1, 10, 2);
+    ok &= append(&pool, seqs, 2, 40, 3);
+    ok &= append(&pool, seqs, 0, 1, 4);
+    ok &= seqs[1].pages[0] == seqs[0].pages[0] && seqs[1].pages[3] != seqs[0].pages[3];
+    ok &= pool.refs[seqs[0].pages[2]] == 3;
+    ok &= check(ctx, &pool, seqs, 1);
+    ok &= check(ctx, &pool, seqs, 3);
+    /* roll back speculative tokens into a page, then append across it */
+    bwpp_kv_seq_truncate(&pool, &seqs[2], 70);
+    ok &= append(&pool, seqs, 2, 33, 5);
+    ok &= check(ctx, &pool, seqs, 1);
+    /* out of pages: the append fails and leaves the sequence as it was */
+    uint32_t len = seqs[0].length;
+    float big[KV_HEADS * 64 * HEAD_DIM] = { 0 };
+    for (uint32_t i = 0; i < PAGES && bwpp_kv_seq_append(&pool, &seqs[0], big, big, 64, 0); ++i) {
+    }
+    ok &= pool.free_count < 4 && seqs[0].length % 64 == len % 64;
+    for (uint32_t s = 0; s < SEQS; ++s) {
+      bwpp_kv_seq_release(&pool, &seqs[s]);
+    }
+    ok &= pool.free_count == PAGES;
+  }
+  bwpp_cpu_context_destroy(ctx);
+  bwpp_arena_destroy(&arena);
+  if (!ok) {
+    fprintf(stderr, "CPU FAIL kv_pages\n");
+    return 1;
+  }
+  printf("CPU PASS kv_pages seqs=%u pages=%u\n", SEQS, PAGES);
+  return 0;
+}
@@ -1,3 +1,5 @@
+#include "bwpp_cpu_gemm.h"
+#include "bwpp_cpu_kernels.h"
 #include "bwpp_cpu_ref.h"
 #include <math.h>
 #include <stdio.h>
@@ -41,6 +43,14 @@ static void fill_matrix(float *dst, uint32_t rows, uint32_t cols, float scale) {
   }
 }
 
+static BwppCpuMatmulFn bwpp_matmul = bwpp_cpu_matmul_f32;
+static void (*bwpp_softmax)(const float *, float *, uint32_t, uint32_t, uint32_t) = bwpp_cpu_softmax_f32;
+static void (*bwpp_rmsnorm)(const float *, float *, const float *, const float *,
+                            uint32_t, uint32_t, uint32_t, float) = bwpp_cpu_rmsnorm_f32;
+static void (*bwpp_attention)(const float *, const float *, const float *, float *,
+                              uint32_t, uint32_t, uint32_t, uint32_t,
+                              uint32_t, uint32_t, uint32_t, uint32_t) = bwpp_cpu_attention_f32;
+
 static float bwpp_silu(float x) {
   return x / (1.0f + expf(-x));
 }
@@ -116,7 +126,7 @@ static int test_matmul(const char *src) {
       ref[row * N + col] = out;
     }
   }
-  bwpp_cpu_matmul_f32(a, b, c, M, N, K, K, N, N, bias, ep_silu, ep_add);
+  bwpp_matmul(a, b, c, M, N, K, K, N, N, bias, ep_silu, ep_add);
   float max_err = 0.0f;
   for (uint32_t i = 0; i < M * N; ++i) {
     float diff = fabsf(c[i] - ref[i]);
@@ -167,7 +177,7 @@ static int test_softmax(const char *src) {
       ref[r * ld + c] *= inv;
     }
   }
-  bwpp_cpu_softmax_f32(x, y, rows, cols, ld);
+  bwpp_softmax(x, y, rows, cols, ld);
   float max_err = 0.0f;
   for (uint32_t i = 0; i < rows * cols; ++i) {
     float diff = fabsf(y[i] - ref[i]);
@@ -214,7 +224,7 @@ static int test_rmsnorm(const char *src) {
       ref[r * ld + c] = x[r * ld + c] * inv * gamma[c];
     }
   }
-  bwpp_cpu_rmsnorm_f32(x, y, gamma, NULL, rows, cols, ld, eps);
+  bwpp_rmsnorm(x, y, gamma, NULL, rows, cols, ld, eps);
   float max_err = 0.0f;
   for (uint32_t i = 0; i < rows * cols; ++i) {
     float diff = fabsf(y[i] - ref[i]);
@@ -285,7 +295,7 @@ static int test_attention(const char *src) {
     }
   }
 
-  bwpp_cpu_attention_f32(q, k, v, o, M, N, K, D, K, K, D, D);
+  bwpp_attention(q, k, v, o, M, N, K, D, K, K, D, D);
   float max_err = 0.0f;
   for (uint32_t i = 0; i < M * D; ++i) {
     float diff = fabsf(o[i] - ref[i]);
@@ -303,9 +313,15 @@ static int test_attention(const char *src) {
 
 int main(int argc, char **argv) {
   if (argc < 2) {
-    fprintf(stderr, "usage: %s <output.metal>\n", argv[0]);
+    fprintf(stderr, "usage: %s <output.metal> [--fast]\n", argv[0]);
     return 1;
   }
+  if (argc > 2 && strcmp(argv[2], "--fast") == 0) {
+    bwpp_matmul = bwpp_cpu_gemm_f32;
+    bwpp_softmax = bwpp_cpu_softmax_simd_f32;
+    bwpp_rmsnorm = bwpp_cpu_rmsnorm_simd_f32;
+    bwpp_attention = bwpp_cpu_attention_simd_f32;
+  }
   size_t len = 0;
   char *src = read_file(argv[1], &len);
   if (!src) {
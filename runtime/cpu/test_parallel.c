@@ -0,0 +1,121 @@
+#include "bwpp_cpu_context.h"
+#include "bwpp_cpu_ref.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void fill(float *dst, uint32_t count, uint32_t seed, float scale) {
+  for (uint32_t i = 0; i < count; ++i) {
+    dst[i] = (float)((i * 5 + seed * 11) % 19) * scale - 0.2f;
+  }
+}
+
+static int compare(const char *what, uint32_t threads, const float *got, const float *ref, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    float diff = fabsf(got[i] - ref[i]);
+    if (diff > 1e-4f * (1.0f + fabsf(ref[i]))) {
+      fprintf(stderr, "CPU FAIL parallel %s threads=%u idx=%u got=%.6f ref=%.6f\n",
+              what, threads, i, got[i], ref[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* a @ b from A^T and B^T, read in place */
+static int check_trans(BwppCpuContext *ctx, const float *a, const float *b, uint32_t M, uint32_t N, uint32_t K) {
+  float *at = (float *)malloc(sizeof(float) * K * M);
+  float *bt = (float *)malloc(sizeof(float) * N * K);
+  float *c = (float *)malloc(sizeof(float) * M * N);
+  float *ref = (float *)malloc(sizeof(float) * M * N);
+  int ok = 0;
+  if (at && bt && c && ref) {
+    bwpp_cpu_matmul_f32(a, b, ref, M, N, K, K, N, N, NULL, 0, 0);
+    for (uint32_t i = 0; i < M * K; ++i) {
+      at[(i % K) * M + i / K] = a[i];
+    }
+    for (uint32_t i = 0; i < K * N; ++i) {
+      bt[(i % N) * K + i / N] = b[i];
+    }
+    bwpp_cpu_matmul_trans_ctx_f32(ctx, at, bt, c, M, N, K, M, K, N, 1, 1, NULL, 0, 0);
+    ok = compare("matmul_trans", ctx->threads, c, ref, M * N);
+  }
+  free(at);
+  free(bt);
+  free(c);
+  free(ref);
+  return ok;
+}
+
+static int check(BwppCpuContext *ctx, uint32_t M, uint32_t N, uint32_t K) {
+  uint32_t D = N / 2 + 1;
+  float *a = (float *)malloc(sizeof(float) * M * K);
+  float *b = (float *)malloc(sizeof(float) * K * N);
+  float *bias = (float *)malloc(sizeof(float) * N);
+  float *gamma = (float *)malloc(sizeof(float) * K);
+  float *v = (float *)malloc(sizeof(float) * N * D);
+  float *c = (float *)malloc(sizeof(float) * M * N);
+  float *ref = (float *)malloc(sizeof(float) * M * N);
+  int ok = 0;
+  if (a && b && bias && gamma && v && c && ref) {
+    fill(a, M * K, 1, 0.03f);
+    fill(b, K * N, 2, 0.04f);
+    fill(bias, N, 3, 0.02f);
+    fill(gamma, K, 5, 0.1f);
+    fill(v, N * D, 4, 0.05f);
+    bwpp_cpu_matmul_f32(a, b, ref, M, N, K, K, N, N, bias, 1, 1);
+    bwpp_cpu_matmul_ctx_f32(ctx, a, b, c, M, N, K, K, N, N, bias, 1, 1);
+    ok = compare("matmul", ctx->threads, c, ref, M * N);
+    ok &= check_trans(ctx, a, b, M, N, K);
+    bwpp_cpu_softmax_f32(a, ref, M, K, K);
+    bwpp_cpu_softmax_ctx_f32(ctx, a, c, M, K, K);
+    ok &= compare("softmax", ctx->threads, c, ref, M * K);
+    bwpp_cpu_rmsnorm_f32(a, ref, gamma, NULL, M, K, K, 1e-5f);
+    bwpp_cpu_rmsnorm_ctx_f32(ctx, a, c, gamma, NULL, M, K, K, 1e-5f);
+    ok &= compare("rmsnorm", ctx->threads, c, ref, M * K);
+    /* self-attention over the first min(M, N) rows of a as keys */
+    uint32_t keys = M < N ? M : N;
+    bwpp_cpu_attention_f32(a, a, v, ref, M, keys, K, D, K, K, D, D);
+    bwpp_cpu_attention_ctx_f32(ctx, a, a, v, c, M, keys, K, D, K, K, D, D);
+    ok &= compare("attention", ctx->threads, c, ref, M * D);
+  }
+  free(a);
+  free(b);
+  free(bias);
+  free(gamma);
+  free(v);
+  free(c);
+  free(ref);
+  return ok;
+}
+
+int main(void) {
+  static const uint32_t thread_counts[] = { 1, 3, 0 };
+  static const uint32_t shapes[][3] = {
+    { 1, 1, 1 },
+    { 7, 13, 5 },
+    { 97, 300, 41 },
+    { 257, 129, 64 },
+    /* several KC blocks of the shared packed B */
+    { 130, 700, 600 },
+  };
+  int ok = 1;
+  for (uint32_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t) {
+    BwppCpuContext *ctx = bwpp_cpu_context_create(thread_counts[t]);
+    if (!ctx) {
+      fprintf(stderr, "CPU FAIL parallel context threads=%u\n", thread_counts[t]);
+      return 1;
+    }
+    for (uint32_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+      /* run each shape twice to exercise pool reuse */
+      ok &= check(ctx, shapes[s][0], shapes[s][1], shapes[s][2]);
+      ok &= check(ctx, shapes[s][0], shapes[s][1], shapes[s][2]);
+    }
+    bwpp_cpu_context_destroy(ctx);
+  }
+  if (!ok) {
+    return 1;
+  }
+  printf("CPU PASS parallel matmul+softmax+rmsnorm+attention\n");
+  return 0;
+}
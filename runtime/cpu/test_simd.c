@@ -0,0 +1,123 @@
+#include "bwpp_cpu_gemm.h"
+#include "bwpp_cpu_kernels.h"
+#include "bwpp_cpu_ref.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void fill(float *dst, uint32_t count, uint32_t seed, float scale) {
+  for (uint32_t i = 0; i < count; ++i) {
+    dst[i] = (float)((i * 7 + seed * 13) % 23) * scale - 0.25f;
+  }
+}
+
+static int compare(const char *what, const char *isa, const float *got, const float *ref, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    float diff = fabsf(got[i] - ref[i]);
+    if (diff > 1e-4f * (1.0f + fabsf(ref[i]))) {
+      fprintf(stderr, "CPU FAIL simd %s isa=%s idx=%u got=%.6f ref=%.6f\n",
+              what, isa, i, got[i], ref[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int check_matmul(const char *isa, uint32_t M, uint32_t N, uint32_t K) {
+  float *a = (float *)malloc(sizeof(float) * M * K);
+  float *b = (float *)malloc(sizeof(float) * K * N);
+  float *bias = (float *)malloc(sizeof(float) * N);
+  float *c = (float *)malloc(sizeof(float) * M * N);
+  float *ref = (float *)malloc(sizeof(float) * M * N);
+  int ok = 0;
+  if (a && b && bias && c && ref) {
+    fill(a, M * K, 1, 0.04f);
+    fill(b, K * N, 2, 0.03f);
+    fill(bias, N, 3, 0.01f);
+    bwpp_cpu_matmul_f32(a, b, ref, M, N, K, K, N, N, bias, 1, 1);
+    bwpp_cpu_gemm_f32(a, b, c, M, N, K, K, N, N, bias, 1, 1);
+    ok = compare("matmul", isa, c, ref, M * N);
+  }
+  free(a);
+  free(b);
+  free(bias);
+  free(c);
+  free(ref);
+  return ok;
+}
+
+static int check_rows(const char *isa, uint32_t rows, uint32_t cols) {
+  uint32_t count = rows * cols;
+  float *x = (float *)malloc(sizeof(float) * count);
+  float *gamma = (float *)malloc(sizeof(float) * cols);
+  float *beta = (float *)malloc(sizeof(float) * cols);
+  float *y = (float *)malloc(sizeof(float) * count);
+  float *ref = (float *)malloc(sizeof(float) * count);
+  int ok = 0;
+  if (x && gamma && beta && y && ref) {
+    fill(x, count, 4, 0.5f);
+    fill(gamma, cols, 5, 0.1f);
+    fill(beta, cols, 6, 0.05f);
+    bwpp_cpu_softmax_f32(x, ref, rows, cols, cols);
+    bwpp_cpu_softmax_simd_f32(x, y, rows, cols, cols);
+    ok = compare("softmax", isa, y, ref, count);
+    bwpp_cpu_rmsnorm_f32(x, ref, gamma, beta, rows, cols, cols, 1e-5f);
+    bwpp_cpu_rmsnorm_simd_f32(x, y, gamma, beta, rows, cols, cols, 1e-5f);
+    ok &= compare("rmsnorm", isa, y, ref, count);
+  }
+  free(x);
+  free(gamma);
+  free(beta);
+  free(y);
+  free(ref);
+  return ok;
+}
+
+static int check_attention(const char *isa, uint32_t M, uint32_t N, uint32_t K, uint32_t D) {
+  float *q = (float *)malloc(sizeof(float) * M * K);
+  float *k = (float *)malloc(sizeof(float) * N * K);
+  float *v = (float *)malloc(sizeof(float) * N * D);
+  float *o = (float *)malloc(sizeof(float) * M * D);
+  float *ref = (float *)malloc(sizeof(float) * M * D);
+  int ok = 0;
+  if (q && k && v && o && ref) {
+    fill(q, M * K, 7, 0.05f);
+    fill(k, N * K, 8, 0.05f);
+    fill(v, N * D, 9, 0.1f);
+    bwpp_cpu_attention_f32(q, k, v, ref, M, N, K, D, K, K, D, D);
+    bwpp_cpu_attention_simd_f32(q, k, v, o, M, N, K, D, K, K, D, D);
+    ok = compare("attention", isa, o, ref, M * D);
+  }
+  free(q);
+  free(k);
+  free(v);
+  free(o);
+  free(ref);
+  return ok;
+}
+
+int main(void) {
+  int ok = 1;
+  uint32_t tested = 0;
+  for (int i = 0; i < BWPP_CPU_ISA_COUNT; ++i) {
+    BwppCpuIsa isa = (BwppCpuIsa)i;
+    if (!bwpp_cpu_kernels_select(isa)) {
+      printf("CPU SKIP simd isa=%s\n", bwpp_cpu_isa_name(isa));
+      continue;
+    }
+    const char *name = bwpp_cpu_isa_name(isa);
+    ok &= check_matmul(name, 1, 1, 1);
+    ok &= check_matmul(name, 13, 37, 19);
+    ok &= check_matmul(name, 70, 129, 300);
+    ok &= check_rows(name, 3, 5);
+    ok &= check_rows(name, 7, 67);
+    ok &= check_attention(name, 5, 9, 16, 8);
+    ok &= check_attention(name, 17, 33, 35, 21);
+    tested++;
+  }
+  if (!ok) {
+    return 1;
+  }
+  printf("CPU PASS simd isas=%u\n", tested);
+  return 0;
+}
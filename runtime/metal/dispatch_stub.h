@@ -37,6 +37,17 @@ typedef struct {
   uint32_t ldk;
   uint32_t ldv;
   uint32_t ldo;
+  /* Zero keeps the dense single-head kernel: batch 0 -> 1, heads 0 -> 1,
+     kv_heads 0 -> heads (kv_heads < heads is GQA/MQA and must divide heads;
+     the dispatch is skipped otherwise), causal 0 -> off unless the source
+     declared softmax(..., causal). Q/O are [batch, heads, M, *] and
+     K/V are [batch, kv_heads, kv_rows, *], kv_rows 0 -> N (a KV cache passes
+     its capacity and the live length as N). */
+  uint32_t batch;
+  uint32_t heads;
+  uint32_t kv_heads;
+  uint32_t causal;
+  uint32_t kv_rows;
 } BwppAttentionParams;
 
 void bwpp_metal_dispatch_matmul(id<MTLDevice> device,
@@ -73,6 +84,18 @@ void bwpp_metal_dispatch_attention(id<MTLDevice> device,
                                    BwppAttentionParams params,
                                    NSString *mslSource);
 
+/* kv_len: per-batch key lengths (uint32), bound at buffer(5) for kernels
+   emitted with attention_mask=kv_len; may be nil otherwise. */
+void bwpp_metal_dispatch_attention_masked(id<MTLDevice> device,
+                                          id<MTLCommandQueue> queue,
+                                          id<MTLBuffer> q,
+                                          id<MTLBuffer> k,
+                                          id<MTLBuffer> v,
+                                          id<MTLBuffer> o,
+                                          id<MTLBuffer> kv_len,
+                                          BwppAttentionParams params,
+                                          NSString *mslSource);
+
 #ifdef __cplusplus
 }
 #endif
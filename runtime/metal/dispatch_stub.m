@@ -261,6 +261,18 @@ void bwpp_metal_dispatch_attention(id<MTLDevice> device,
                                    id<MTLBuffer> o,
                                    BwppAttentionParams params,
                                    NSString *mslSource) {
+  bwpp_metal_dispatch_attention_masked(device, queue, q, k, v, o, nil, params, mslSource);
+}
+
+void bwpp_metal_dispatch_attention_masked(id<MTLDevice> device,
+                                          id<MTLCommandQueue> queue,
+                                          id<MTLBuffer> q,
+                                          id<MTLBuffer> k,
+                                          id<MTLBuffer> v,
+                                          id<MTLBuffer> o,
+                                          id<MTLBuffer> kv_len,
+                                          BwppAttentionParams params,
+                                          NSString *mslSource) {
   if (!device || !queue || !q || !k || !v || !o || !mslSource) {
     return;
   }
@@ -271,6 +283,20 @@ void bwpp_metal_dispatch_attention(id<MTLDevice> device,
   if (strstr(src, "bwpp.meta: kernel=attention_f16") == NULL) {
     return;
   }
+  char mask[32] = {0};
+  const char *maskPtr = strstr(src, "bwpp.meta: attention_mask=");
+  if (maskPtr && sscanf(maskPtr, "bwpp.meta: attention_mask=%31s", mask) == 1 &&
+      strstr(mask, "kv_len") && !kv_len) {
+    /* the kernel reads key lengths from buffer(5) */
+    return;
+  }
+  uint32_t batch = params.batch ? params.batch : 1;
+  uint32_t heads = params.heads ? params.heads : 1;
+  uint32_t kvHeads = params.kv_heads ? params.kv_heads : heads;
+  if (kvHeads > heads || heads % kvHeads != 0) {
+    /* the kernel maps Q head h to K/V head h / (heads / kv_heads) */
+    return;
+  }
 
   static BwppPipelineCache cache = {0};
   uint32_t tileM = 0;
@@ -317,11 +343,14 @@ void bwpp_metal_dispatch_attention(id<MTLDevice> device,
   [enc setBuffer:v offset:0 atIndex:2];
   [enc setBuffer:o offset:0 atIndex:3];
   [enc setBuffer:paramsBuf offset:0 atIndex:4];
+  if (kv_len) {
+    [enc setBuffer:kv_len offset:0 atIndex:5];
+  }
 
   MTLSize tg = MTLSizeMake(tile, tile, 1);
   MTLSize grid = MTLSizeMake((params.D + tile - 1) / tile,
                              (params.M + tile - 1) / tile,
-                             1);
+                             batch * heads);
   [enc dispatchThreadgroups:grid threadsPerThreadgroup:tg];
   [enc endEncoding];
   [cmd commit];